@@ -0,0 +1,230 @@
+#ifndef CAFFE_EXAMPLES_BATCH_CLASSIFIER_HPP_
+#define CAFFE_EXAMPLES_BATCH_CLASSIFIER_HPP_
+
+#include <boost/bind.hpp>
+#include <caffe/caffe.hpp>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace caffe;  // NOLINT(build/namespaces)
+using std::string;
+
+/* Pair (label, confidence) representing a prediction. */
+typedef std::pair<string, float> Prediction;
+
+/* Classifies images submitted from any number of threads. The requests are
+ * grouped into batches of up to max_batch_size images, waiting at most
+ * timeout_ms for a batch to fill, so that the network runs once per batch
+ * rather than once per image. The images of a batch are preprocessed in
+ * parallel, straight into the input layer, and num_workers batches run at
+ * once, sharing the weights. */
+class BatchClassifier {
+ public:
+  BatchClassifier(const string& model_file,
+                  const string& trained_file,
+                  const string& mean_file,
+                  const string& label_file,
+                  int max_batch_size = 16,
+                  int timeout_ms = 5,
+                  int num_workers = 1);
+
+  /* Return the future output of the network (the class probabilities) for
+   * img. */
+  boost::unique_future<std::vector<float> > Submit(const cv::Mat& img);
+
+  /* Return the top N predictions for the output of the network. */
+  std::vector<Prediction> TopN(const std::vector<float>& output,
+                               int N = 5) const;
+
+  /* Classify img and wait for its top N predictions. */
+  std::vector<Prediction> Classify(const cv::Mat& img, int N = 5);
+
+  const InferenceBatcher<float>& batcher() const { return *batcher_; }
+
+ private:
+  void SetMean(const string& mean_file);
+
+  void Preprocess(const cv::Mat& img, float* input_data) const;
+
+ private:
+  shared_ptr<InferenceEngine<float> > engine_;
+  shared_ptr<InferenceBatcher<float> > batcher_;
+  cv::Size input_geometry_;
+  int num_channels_;
+  cv::Mat mean_;
+  std::vector<string> labels_;
+};
+
+inline BatchClassifier::BatchClassifier(const string& model_file,
+                                        const string& trained_file,
+                                        const string& mean_file,
+                                        const string& label_file,
+                                        int max_batch_size,
+                                        int timeout_ms,
+                                        int num_workers) {
+#ifdef CPU_ONLY
+  Caffe::set_mode(Caffe::CPU);
+#else
+  Caffe::set_mode(Caffe::GPU);
+#endif
+
+  /* Load the network once; the workers share its weights. */
+  engine_.reset(new InferenceEngine<float>(model_file, trained_file));
+  const Net<float>& net = *engine_->net();
+
+  CHECK_EQ(net.num_inputs(), 1) << "Network should have exactly one input.";
+  CHECK_EQ(net.num_outputs(), 1) << "Network should have exactly one output.";
+
+  Blob<float>* input_layer = net.input_blobs()[0];
+  num_channels_ = input_layer->channels();
+  CHECK(num_channels_ == 3 || num_channels_ == 1)
+    << "Input layer should have 1 or 3 channels.";
+  input_geometry_ = cv::Size(input_layer->width(), input_layer->height());
+
+  /* Load the binaryproto mean file. */
+  SetMean(mean_file);
+
+  /* Load labels. */
+  std::ifstream labels(label_file.c_str());
+  CHECK(labels) << "Unable to open labels file " << label_file;
+  string line;
+  while (std::getline(labels, line))
+    labels_.push_back(string(line));
+
+  Blob<float>* output_layer = net.output_blobs()[0];
+  CHECK_EQ(labels_.size(), output_layer->channels())
+    << "Number of labels is different from the output layer dimension.";
+
+  batcher_.reset(new InferenceBatcher<float>(engine_, max_batch_size,
+                                             timeout_ms, num_workers));
+}
+
+inline boost::unique_future<std::vector<float> > BatchClassifier::Submit(
+    const cv::Mat& img) {
+  return batcher_->Submit(
+      boost::bind(&BatchClassifier::Preprocess, this, img, _1));
+}
+
+static bool PairCompare(const std::pair<float, int>& lhs,
+                        const std::pair<float, int>& rhs) {
+  return lhs.first > rhs.first;
+}
+
+/* Return the indices of the top N values of vector v. */
+static std::vector<int> Argmax(const std::vector<float>& v, int N) {
+  std::vector<std::pair<float, int> > pairs;
+  for (size_t i = 0; i < v.size(); ++i)
+    pairs.push_back(std::make_pair(v[i], i));
+  std::partial_sort(pairs.begin(), pairs.begin() + N, pairs.end(), PairCompare);
+
+  std::vector<int> result;
+  for (int i = 0; i < N; ++i)
+    result.push_back(pairs[i].second);
+  return result;
+}
+
+inline std::vector<Prediction> BatchClassifier::TopN(
+    const std::vector<float>& output, int N) const {
+  N = std::min<int>(labels_.size(), N);
+  std::vector<int> maxN = Argmax(output, N);
+  std::vector<Prediction> predictions;
+  for (int i = 0; i < N; ++i) {
+    int idx = maxN[i];
+    predictions.push_back(std::make_pair(labels_[idx], output[idx]));
+  }
+
+  return predictions;
+}
+
+inline std::vector<Prediction> BatchClassifier::Classify(const cv::Mat& img,
+                                                         int N) {
+  return TopN(Submit(img).get(), N);
+}
+
+/* Load the mean file in binaryproto format. */
+inline void BatchClassifier::SetMean(const string& mean_file) {
+  BlobProto blob_proto;
+  ReadProtoFromBinaryFileOrDie(mean_file.c_str(), &blob_proto);
+
+  /* Convert from BlobProto to Blob<float> */
+  Blob<float> mean_blob;
+  mean_blob.FromProto(blob_proto);
+  CHECK_EQ(mean_blob.channels(), num_channels_)
+    << "Number of channels of mean file doesn't match input layer.";
+
+  /* The format of the mean file is planar 32-bit float BGR or grayscale. */
+  std::vector<cv::Mat> channels;
+  float* data = mean_blob.mutable_cpu_data();
+  for (int i = 0; i < num_channels_; ++i) {
+    /* Extract an individual channel. */
+    cv::Mat channel(mean_blob.height(), mean_blob.width(), CV_32FC1, data);
+    channels.push_back(channel);
+    data += mean_blob.height() * mean_blob.width();
+  }
+
+  /* Merge the separate channels into a single image. */
+  cv::Mat mean;
+  cv::merge(channels, mean);
+
+  /* Compute the global mean pixel value and create a mean image
+   * filled with this value. */
+  cv::Scalar channel_mean = cv::mean(mean);
+  mean_ = cv::Mat(input_geometry_, mean.type(), channel_mean);
+}
+
+/* Preprocess img into its item of the input layer, which starts at
+ * input_data. It runs on the threads of the batcher, for several images at
+ * once. */
+inline void BatchClassifier::Preprocess(const cv::Mat& img,
+                                        float* input_data) const {
+  /* Convert the input image to the input image format of the network. */
+  cv::Mat sample;
+  if (img.channels() == 3 && num_channels_ == 1)
+    cv::cvtColor(img, sample, cv::COLOR_BGR2GRAY);
+  else if (img.channels() == 4 && num_channels_ == 1)
+    cv::cvtColor(img, sample, cv::COLOR_BGRA2GRAY);
+  else if (img.channels() == 4 && num_channels_ == 3)
+    cv::cvtColor(img, sample, cv::COLOR_BGRA2BGR);
+  else if (img.channels() == 1 && num_channels_ == 3)
+    cv::cvtColor(img, sample, cv::COLOR_GRAY2BGR);
+  else
+    sample = img;
+
+  cv::Mat sample_resized;
+  if (sample.size() != input_geometry_)
+    cv::resize(sample, sample_resized, input_geometry_);
+  else
+    sample_resized = sample;
+
+  cv::Mat sample_float;
+  if (num_channels_ == 3)
+    sample_resized.convertTo(sample_float, CV_32FC3);
+  else
+    sample_resized.convertTo(sample_float, CV_32FC1);
+
+  cv::Mat sample_normalized;
+  cv::subtract(sample_float, mean_, sample_normalized);
+
+  /* Wrap the channels of the item in cv::Mat objects, so that splitting
+   * writes the separate BGR planes directly to the input layer. */
+  std::vector<cv::Mat> input_channels;
+  for (int i = 0; i < num_channels_; ++i) {
+    cv::Mat channel(input_geometry_.height, input_geometry_.width, CV_32FC1,
+                    input_data);
+    input_channels.push_back(channel);
+    input_data += input_geometry_.area();
+  }
+  cv::split(sample_normalized, input_channels);
+
+  CHECK(reinterpret_cast<float*>(input_channels.at(0).data)
+        == input_data - num_channels_ * input_geometry_.area())
+    << "Input channels are not wrapping the input layer of the network.";
+}
+
+#endif  // CAFFE_EXAMPLES_BATCH_CLASSIFIER_HPP_
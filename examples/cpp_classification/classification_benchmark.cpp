@@ -0,0 +1,133 @@
+#include <caffe/caffe.hpp>
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#endif  // USE_OPENCV
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#ifdef USE_OPENCV
+#include "batch_classifier.hpp"
+
+DEFINE_int32(batch_size, 16,
+    "The maximum number of images classified in one batch.");
+DEFINE_int32(timeout_ms, 5,
+    "The longest an image waits for its batch to fill, in ms.");
+DEFINE_int32(workers, 1,
+    "The number of batches classified at once.");
+DEFINE_int32(requests, 2000,
+    "The number of requests of the trace.");
+DEFINE_double(rate, 200,
+    "The mean number of requests per second of the trace.");
+DEFINE_int32(clients, 64,
+    "The number of client threads replaying the trace.");
+DEFINE_string(image, "",
+    "Optional; the image to classify, instead of random noise.");
+
+typedef boost::posix_time::ptime Time;
+
+static Time Now() {
+  return boost::posix_time::microsec_clock::universal_time();
+}
+
+/* Replays the requests of the trace assigned to one client: it submits each
+ * one at its arrival time, or as soon as the previous one is answered if that
+ * is later. Latencies are measured from the arrival times, so that a client
+ * falling behind does not hide the queueing delay. */
+static void ReplayTrace(BatchClassifier* classifier, const cv::Mat* img,
+                        const std::vector<double>* arrivals, Time start,
+                        int first, int step, std::vector<double>* latencies) {
+  for (int i = first; i < arrivals->size(); i += step) {
+    const Time arrival =
+        start + boost::posix_time::microseconds(
+            static_cast<int64_t>((*arrivals)[i] * 1e6));
+    if (Now() < arrival)
+      boost::this_thread::sleep(arrival);
+    classifier->Submit(*img).get();
+    (*latencies)[i] = (Now() - arrival).total_microseconds() / 1000.;
+  }
+}
+
+static double Percentile(const std::vector<double>& sorted, double p) {
+  const int index = std::min<int>(sorted.size() - 1, p * sorted.size());
+  return sorted[index];
+}
+
+int main(int argc, char** argv) {
+  ::gflags::SetUsageMessage("Replay a synthetic trace of requests through "
+      "the batching classifier and report its throughput and latency.\n"
+      "Usage: classification_benchmark [FLAGS] deploy.prototxt "
+      "network.caffemodel mean.binaryproto labels.txt");
+  caffe::GlobalInit(&argc, &argv);
+  if (argc != 5) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0],
+        "examples/cpp_classification/classification_benchmark");
+    return 1;
+  }
+  BatchClassifier classifier(argv[1], argv[2], argv[3], argv[4],
+                             FLAGS_batch_size, FLAGS_timeout_ms,
+                             FLAGS_workers);
+
+  cv::Mat img;
+  if (FLAGS_image.empty()) {
+    img = cv::Mat(256, 256, CV_8UC3);
+    cv::randu(img, cv::Scalar::all(0), cv::Scalar::all(255));
+  } else {
+    img = cv::imread(FLAGS_image, -1);
+    CHECK(!img.empty()) << "Unable to decode image " << FLAGS_image;
+  }
+
+  /* The trace: Poisson arrivals at the given rate. */
+  CHECK_GT(FLAGS_rate, 0);
+  CHECK_GT(FLAGS_requests, 0);
+  CHECK_GT(FLAGS_clients, 0);
+  std::vector<double> arrivals(FLAGS_requests);
+  std::vector<double> gaps(FLAGS_requests);
+  caffe_rng_uniform<double>(FLAGS_requests, 1e-9, 1, &gaps[0]);
+  double arrival = 0;
+  for (int i = 0; i < FLAGS_requests; ++i) {
+    arrival += -std::log(gaps[i]) / FLAGS_rate;
+    arrivals[i] = arrival;
+  }
+
+  /* Warm up with one request. */
+  classifier.Classify(img);
+  const int warmup_batches = classifier.batcher().num_batches();
+
+  std::vector<double> latencies(FLAGS_requests);
+  const Time start = Now();
+  boost::thread_group clients;
+  for (int i = 0; i < FLAGS_clients; ++i) {
+    clients.create_thread(boost::bind(&ReplayTrace, &classifier, &img,
+        &arrivals, start, i, FLAGS_clients, &latencies));
+  }
+  clients.join_all();
+  const double elapsed = (Now() - start).total_microseconds() / 1e6;
+
+  std::sort(latencies.begin(), latencies.end());
+  double latency_sum = 0;
+  for (int i = 0; i < latencies.size(); ++i)
+    latency_sum += latencies[i];
+  const int batches = classifier.batcher().num_batches() - warmup_batches;
+  LOG(INFO) << "Offered load: " << FLAGS_rate << " requests/s, "
+            << FLAGS_requests << " requests.";
+  LOG(INFO) << "Throughput: " << FLAGS_requests / elapsed << " requests/s.";
+  LOG(INFO) << "Mean batch size: "
+            << static_cast<double>(FLAGS_requests) / batches << ".";
+  LOG(INFO) << "Latency: mean " << latency_sum / latencies.size()
+            << " ms, p50 " << Percentile(latencies, 0.5)
+            << " ms, p90 " << Percentile(latencies, 0.9)
+            << " ms, p99 " << Percentile(latencies, 0.99)
+            << " ms, max " << latencies.back() << " ms.";
+  return 0;
+}
+#else
+int main(int argc, char** argv) {
+  LOG(FATAL) << "This example requires OpenCV; compile with USE_OPENCV.";
+}
+#endif  // USE_OPENCV
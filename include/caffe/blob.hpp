@@ -24,7 +24,8 @@ template <typename Dtype>
 class Blob {
  public:
   Blob()
-       : data_(), diff_(), count_(0), capacity_(0) {}
+       : data_(), diff_(), count_(0), capacity_(0), data_tag_(-1),
+         diff_tag_(-1) {}
 
   /// @brief Deprecated; use <code>Blob(const vector<int>& shape)</code>.
   explicit Blob(const int num, const int channels, const int height,
@@ -262,9 +263,23 @@ class Blob {
    * shared_ptr calls its destructor when reset with the "=" operator.
    */
   void ShareDiff(const Blob& other);
+  /**
+   * @brief Keep the data and the diff in the given memory, which must hold
+   *        count() elements; Reshape keeps using it while it is large enough.
+   *
+   * This lets blobs that are never needed at the same time share memory.
+   */
+  void UseMemory(const shared_ptr<SyncedMemory>& data,
+                 const shared_ptr<SyncedMemory>& diff);
 
   bool ShapeEquals(const BlobProto& other);
 
+  /**
+   * @brief Tag the memory of the data and of the diff for accounting, now and
+   *        whenever Reshape reallocates it; see SyncedMemory::Tag.
+   */
+  void set_memory_tags(int data_tag, int diff_tag);
+
  protected:
   shared_ptr<SyncedMemory> data_;
   shared_ptr<SyncedMemory> diff_;
@@ -272,6 +287,9 @@ class Blob {
   vector<int> shape_;
   int count_;
   int capacity_;
+  // The tags of the memory, -1 to leave the memory with the scope tag.
+  int data_tag_;
+  int diff_tag_;
 
   DISABLE_COPY_AND_ASSIGN(Blob);
 };  // class Blob
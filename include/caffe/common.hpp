@@ -97,6 +97,8 @@ using std::vector;
 // Currently it initializes google flags and google logging.
 void GlobalInit(int* pargc, char*** pargv);
 
+class ThreadPool;
+
 // A singleton class to hold common caffe stuff, such as the handler that
 // caffe is going to use for cublas, curand, etc.
 class Caffe {
@@ -109,6 +111,9 @@ class Caffe {
   static Caffe& Get();
 
   enum Brew { CPU, GPU };
+  // The instruction sets of the hand-written CPU kernels, in increasing order
+  // (see util/cpu_dispatch.hpp). AVX2 comes with FMA.
+  enum SIMDLevel { BASELINE, SSE4, AVX2, AVX512 };
 
   // This random number generator facade hides boost and CUDA rng
   // implementation from one another (for cross-platform compatibility).
@@ -163,6 +168,18 @@ class Caffe {
   inline static void set_solver_count(int val) { Get().solver_count_ = val; }
   inline static bool root_solver() { return Get().root_solver_; }
   inline static void set_root_solver(bool val) { Get().root_solver_ = val; }
+  // The number of threads sharing the CPU computation of a layer (see
+  // parallel_for). Unlike the mode, it is the same for all threads. Setting it
+  // to 0 uses every core the process may run on; the default is 1.
+  static int num_threads();
+  static void set_num_threads(const int num_threads);
+  // The pool of num_threads() threads shared by all of Caffe.
+  static shared_ptr<ThreadPool> thread_pool();
+  // The instruction set the hand-written CPU kernels run with, for all
+  // threads. It starts at the best one the CPU supports, and may be lowered
+  // for testing or comparison, though not changed while kernels run.
+  static SIMDLevel simd_level();
+  static void set_simd_level(const SIMDLevel level);
 
  protected:
 #ifndef CPU_ONLY
@@ -14,6 +14,32 @@
 
 namespace caffe {
 
+// Blobs at least this large are filled in parallel from a Philox generator
+// keyed by Caffe::rng_stream(); smaller ones, not worth splitting, keep
+// drawing from Caffe::rng_stream() itself. Either way, the values depend on
+// the seed alone, not on the number of threads.
+const int kParallelFillMinCount = 1 << 16;
+
+template <typename Dtype>
+void FillUniform(const Dtype a, const Dtype b, Blob<Dtype>* blob) {
+  if (blob->count() >= kParallelFillMinCount) {
+    caffe_rng_uniform(blob->count(), a, b, blob->mutable_cpu_data(),
+                      Philox::FromCaffeRNG());
+  } else {
+    caffe_rng_uniform(blob->count(), a, b, blob->mutable_cpu_data());
+  }
+}
+
+template <typename Dtype>
+void FillGaussian(const Dtype mu, const Dtype sigma, Blob<Dtype>* blob) {
+  if (blob->count() >= kParallelFillMinCount) {
+    caffe_rng_gaussian(blob->count(), mu, sigma, blob->mutable_cpu_data(),
+                       Philox::FromCaffeRNG());
+  } else {
+    caffe_rng_gaussian(blob->count(), mu, sigma, blob->mutable_cpu_data());
+  }
+}
+
 /// @brief Fills a Blob with constant or randomly-generated data.
 template <typename Dtype>
 class Filler {
@@ -53,8 +79,8 @@ class UniformFiller : public Filler<Dtype> {
       : Filler<Dtype>(param) {}
   virtual void Fill(Blob<Dtype>* blob) {
     CHECK(blob->count());
-    caffe_rng_uniform<Dtype>(blob->count(), Dtype(this->filler_param_.min()),
-        Dtype(this->filler_param_.max()), blob->mutable_cpu_data());
+    FillUniform(Dtype(this->filler_param_.min()),
+        Dtype(this->filler_param_.max()), blob);
     CHECK_EQ(this->filler_param_.sparse(), -1)
          << "Sparsity not supported by this Filler.";
   }
@@ -69,8 +95,8 @@ class GaussianFiller : public Filler<Dtype> {
   virtual void Fill(Blob<Dtype>* blob) {
     Dtype* data = blob->mutable_cpu_data();
     CHECK(blob->count());
-    caffe_rng_gaussian<Dtype>(blob->count(), Dtype(this->filler_param_.mean()),
-        Dtype(this->filler_param_.std()), blob->mutable_cpu_data());
+    FillGaussian(Dtype(this->filler_param_.mean()),
+        Dtype(this->filler_param_.std()), blob);
     int sparse = this->filler_param_.sparse();
     CHECK_GE(sparse, -1);
     if (sparse >= 0) {
@@ -105,7 +131,7 @@ class PositiveUnitballFiller : public Filler<Dtype> {
   virtual void Fill(Blob<Dtype>* blob) {
     Dtype* data = blob->mutable_cpu_data();
     DCHECK(blob->count());
-    caffe_rng_uniform<Dtype>(blob->count(), 0, 1, blob->mutable_cpu_data());
+    FillUniform(Dtype(0), Dtype(1), blob);
     // We expect the filler to not be called very frequently, so we will
     // just use a simple implementation
     int dim = blob->count() / blob->num();
@@ -158,8 +184,7 @@ class XavierFiller : public Filler<Dtype> {
       n = fan_out;
     }
     Dtype scale = sqrt(Dtype(3) / n);
-    caffe_rng_uniform<Dtype>(blob->count(), -scale, scale,
-        blob->mutable_cpu_data());
+    FillUniform(-scale, scale, blob);
     CHECK_EQ(this->filler_param_.sparse(), -1)
          << "Sparsity not supported by this Filler.";
   }
@@ -200,8 +225,7 @@ class MSRAFiller : public Filler<Dtype> {
       n = fan_out;
     }
     Dtype std = sqrt(Dtype(2) / n);
-    caffe_rng_gaussian<Dtype>(blob->count(), Dtype(0), std,
-        blob->mutable_cpu_data());
+    FillGaussian(Dtype(0), std, blob);
     CHECK_EQ(this->filler_param_.sparse(), -1)
          << "Sparsity not supported by this Filler.";
   }
@@ -0,0 +1,107 @@
+#ifndef CAFFE_INFERENCE_BATCHER_HPP_
+#define CAFFE_INFERENCE_BATCHER_HPP_
+
+#include <boost/function.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/future.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <deque>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/inference_engine.hpp"
+#include "caffe/net.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Groups the requests submitted from any number of threads into
+ *        batches, and runs them on executors of an InferenceEngine.
+ *
+ * A batch closes once it holds max_batch_size requests, or once its first
+ * request has waited timeout_ms. Each of num_workers threads runs batches on
+ * an executor of its own, preparing the inputs of a batch in parallel on
+ * Caffe::thread_pool(). The workers take over the Caffe mode and device of
+ * the thread constructing the batcher. The net must have a single input,
+ * whose first axis is the batch.
+ */
+template <typename Dtype>
+class InferenceBatcher {
+ public:
+  /// @brief Writes the input of one request to the given item of the input
+  ///        blob. It runs on any thread and must not block.
+  typedef boost::function<void(Dtype*)> Prepare;
+
+  /**
+   * @param max_queue If positive, Submit blocks while max_queue requests
+   *        wait for a batch.
+   */
+  InferenceBatcher(const shared_ptr<InferenceEngine<Dtype> >& engine,
+      int max_batch_size, int timeout_ms, int num_workers = 1,
+      int max_queue = 0);
+  /// @brief Answers the requests still queued, then stops the workers.
+  ~InferenceBatcher();
+
+  /**
+   * @brief Queue a request; it is safe to call from several threads at once.
+   *
+   * @return The future outputs of the request: its item of each output blob
+   *         of the net, one after the other.
+   */
+  boost::unique_future<vector<Dtype> > Submit(const Prepare& prepare);
+  /**
+   * @brief Like Submit, but returns false at once rather than block if the
+   *        queue is full.
+   */
+  bool TrySubmit(const Prepare& prepare,
+      boost::unique_future<vector<Dtype> >* result);
+
+  /// @brief The number of values of one item of the input blob.
+  inline int input_dim() const { return input_dim_; }
+  /// @brief The number of requests waiting for a batch.
+  int queue_size() const;
+  /// @brief The number of batches formed so far.
+  int num_batches() const;
+  /// @brief The number of requests taken into batches so far.
+  int num_requests() const;
+
+ protected:
+  struct Request {
+    Prepare prepare;
+    shared_ptr<boost::promise<vector<Dtype> > > promise;
+    boost::system_time arrival;
+  };
+
+  // Queues a request, blocking while the queue is full only if block is set.
+  bool Enqueue(const Prepare& prepare, bool block,
+      boost::unique_future<vector<Dtype> >* result);
+  void WorkerEntry(int worker);
+  // Waits for the next batch; returns false once stopped with no request left.
+  bool NextBatch(vector<Request>* batch);
+  void RunBatch(Net<Dtype>* net, const vector<Request>& batch);
+  void PrepareItem(const vector<Request>* batch, Dtype* input_data, int i);
+
+  shared_ptr<InferenceEngine<Dtype> > engine_;
+  const int max_batch_size_;
+  const int timeout_ms_;
+  const int max_queue_;
+  int input_dim_;
+  Caffe::Brew mode_;
+  int device_;
+  vector<shared_ptr<Net<Dtype> > > executors_;
+  vector<shared_ptr<boost::thread> > workers_;
+  std::deque<Request> queue_;
+  bool stop_;
+  int num_batches_;
+  int num_requests_;
+  mutable boost::mutex mutex_;
+  // Signals both new requests to the workers and room in the queue.
+  boost::condition_variable condition_;
+
+  DISABLE_COPY_AND_ASSIGN(InferenceBatcher);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_INFERENCE_BATCHER_HPP_
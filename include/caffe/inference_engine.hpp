@@ -0,0 +1,56 @@
+#ifndef CAFFE_INFERENCE_ENGINE_HPP_
+#define CAFFE_INFERENCE_ENGINE_HPP_
+
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Holds the weights of a net for the TEST phase once, and creates
+ *        executors that run it on requests of their own.
+ *
+ * An executor is a Net owning its activations only: its layers read the
+ * parameter blobs of the engine's net, which are never written during
+ * inference, so executors need no locks and any number of them run
+ * concurrently, one thread each. Each thread sets its own Caffe mode (and
+ * device) before running an executor; the engine's net must not be updated
+ * while executors run.
+ */
+template <typename Dtype>
+class InferenceEngine {
+ public:
+  /**
+   * @brief Load the net from param_file and its weights from
+   *        trained_filename.
+   */
+  InferenceEngine(const string& param_file, const string& trained_filename);
+  /**
+   * @brief Load the net from param, keeping the weights of its fillers or
+   *        blobs if trained_filename is empty.
+   */
+  explicit InferenceEngine(const NetParameter& param,
+      const string& trained_filename = "");
+
+  /// @brief Create an executor sharing the weights; it is safe to call from
+  ///        several threads at once.
+  shared_ptr<Net<Dtype> > CreateExecutor() const;
+
+  /// @brief The net holding the weights, which may serve as one executor.
+  inline const shared_ptr<Net<Dtype> >& net() const { return net_; }
+
+ protected:
+  void Init(const NetParameter& param, const string& trained_filename);
+
+  NetParameter param_;
+  shared_ptr<Net<Dtype> > net_;
+
+  DISABLE_COPY_AND_ASSIGN(InferenceEngine);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_INFERENCE_ENGINE_HPP_
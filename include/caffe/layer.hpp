@@ -294,6 +294,21 @@ class Layer {
     return true;
   }
 
+  /**
+   * @brief Returns whether Forward computes the same tops when run again on
+   *        the same bottoms, as the Net does to recompute activations in
+   *        backward (see checkpoint_every in NetParameter).
+   *
+   * Draws from Caffe::rng_stream() repeat, as the Net restores the stream
+   * for the recomputation.
+   */
+  virtual inline bool ForwardIsRepeatable() const { return true; }
+  /**
+   * @brief Returns whether Forward changes the parameter blobs of the layer,
+   *        which the Net then saves and restores around a recomputation.
+   */
+  virtual inline bool ForwardChangesBlobs() const { return false; }
+
   /**
    * @brief Specifies whether the layer should compute gradients w.r.t. a
    *        parameter at a particular index given by param_id.
@@ -6,6 +6,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/grouped_conv.hpp"
 #include "caffe/util/im2col.hpp"
 
 namespace caffe {
@@ -92,6 +93,8 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   bool bias_term_;
   bool is_1x1_;
   bool force_nd_im2col_;
+  /// @brief Whether the CPU runs the direct grouped kernels, without im2col.
+  bool grouped_direct_;
 
  private:
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
@@ -164,6 +167,7 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   int kernel_dim_;
   int col_offset_;
   int output_offset_;
+  GroupedConvGeometry grouped_geometry_;
 
   Blob<Dtype> col_buffer_;
   Blob<Dtype> bias_multiplier_;
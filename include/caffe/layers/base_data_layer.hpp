@@ -51,10 +51,24 @@ class Batch {
   Blob<Dtype> data_, label_;
 };
 
+/**
+ * @brief Provides base for data layers that load their batches on a prefetch
+ *        thread.
+ *
+ * The prefetch thread fills a ring of data_param.prefetch batches ahead of the
+ * net, kDefaultPrefetch if unset. If data_param.max_prefetch is greater, the ring grows up to it while
+ * the net waits on the thread although the thread had filled the ring before,
+ * so that bursts in loading times are absorbed. Statistics of the queue depth
+ * are logged every kStatsInterval forwards.
+ */
 template <typename Dtype>
 class BasePrefetchingDataLayer :
     public BaseDataLayer<Dtype>, public InternalThread {
  public:
+  // The batches of the ring unless data_param.prefetch says otherwise, fewer
+  // than the DataReader queues by default since each holds a whole batch.
+  static const int kDefaultPrefetch = 3;
+
   explicit BasePrefetchingDataLayer(const LayerParameter& param);
   // LayerSetUp: implements common data layer setup functionality, and calls
   // DataLayerSetUp to do special data layer setup for individual layer types.
@@ -67,16 +81,29 @@ class BasePrefetchingDataLayer :
   virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
 
-  // Prefetches batches (asynchronously if to GPU memory)
-  static const int PREFETCH_COUNT = 3;
+  static const int kStatsInterval = 1000;
 
  protected:
   virtual void InternalThreadEntry();
   virtual void load_batch(Batch<Dtype>* batch) = 0;
+  // Pops the next loaded batch, growing the ring and logging the queue
+  // statistics as needed.
+  Batch<Dtype>* NextBatch();
+  // Adds a batch to the ring, shaped like batch.
+  void AddBatch(const Batch<Dtype>& batch);
 
-  Batch<Dtype> prefetch_[PREFETCH_COUNT];
+  // Prefetches batches (asynchronously if to GPU memory)
+  vector<shared_ptr<Batch<Dtype> > > prefetch_;
   BlockingQueue<Batch<Dtype>*> prefetch_free_;
   BlockingQueue<Batch<Dtype>*> prefetch_full_;
+  int max_prefetch_;
+  // Whether the prefetch thread has filled the ring since it last grew.
+  bool ring_filled_;
+  // The queue statistics since they were last logged.
+  int forward_count_;
+  int empty_count_;
+  int depth_sum_;
+  double wait_time_;
 
   Blob<Dtype> transformed_data_;
 };
@@ -50,6 +50,8 @@ class BatchNormLayer : public Layer<Dtype> {
       const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "BatchNorm"; }
+  /// The moving statistics are updated in forward.
+  virtual inline bool ForwardChangesBlobs() const { return !use_global_stats_; }
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
 
@@ -70,7 +72,7 @@ class BatchNormLayer : public Layer<Dtype> {
   Dtype eps_;
 
   // extra temporarary variables is used to carry out sums/broadcasting
-  // using BLAS
+  // using BLAS on the GPU
   Blob<Dtype> batch_sum_multiplier_;
   Blob<Dtype> num_by_chans_;
   Blob<Dtype> spatial_sum_multiplier_;
@@ -58,6 +58,8 @@ class ConvolutionLayer : public BaseConvolutionLayer<Dtype> {
    *  first group and input channels 3-4 and output channels 5-8 into the second
    *  group.
    *  - bias_term (\b optional, default true). Whether to have a bias.
+   *  - fuse_relu / relu_negative_slope (\b optional, default false / 0).
+   *  Whether to apply a ReLU to the output, as set by the layer fusion pass.
    *  - engine: convolution has CAFFE (matrix multiplication) and CUDNN (library
    *    kernels + stream parallelism) engines.
    */
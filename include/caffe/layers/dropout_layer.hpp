@@ -39,6 +39,10 @@ class DropoutLayer : public NeuronLayer<Dtype> {
       const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "Dropout"; }
+  /// The GPU masks come from cuRAND, which cannot be replayed.
+  virtual inline bool ForwardIsRepeatable() const {
+    return this->phase_ != TRAIN || Caffe::mode() == Caffe::CPU;
+  }
 
  protected:
   /**
@@ -67,7 +71,11 @@ class DropoutLayer : public NeuronLayer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
   /// when divided by UINT_MAX, the randomly generated values @f$u\sim U(0,1)@f$
+  /// (GPU only; the CPU generates the mask again from rng_key_ in backward)
   Blob<unsigned int> rand_vec_;
+  /// the key of the Philox generator of the current mask, drawn from
+  /// Caffe::rng_stream() for each mask, so that the masks follow the seed
+  uint64_t rng_key_;
   /// the probability @f$ p @f$ of dropping any input
   Dtype threshold_;
   /// the scale for undropped inputs at train time @f$ 1 / (1 - p) @f$
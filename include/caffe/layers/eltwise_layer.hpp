@@ -38,6 +38,12 @@ class EltwiseLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  /// @brief Forward_cpu and Backward_cpu on the elements [begin, end).
+  void Forward_cpu_range(const vector<const Dtype*>& bottom_data,
+      Dtype* top_data, int* mask, const int begin, const int end);
+  void Backward_cpu_range(const vector<const Dtype*>& bottom_data,
+      const int bottom_id, const Dtype* top_data, const Dtype* top_diff,
+      const int* mask, Dtype* bottom_diff, const int begin, const int end);
 
   EltwiseParameter_EltwiseOp op_;
   vector<Dtype> coeffs_;
@@ -0,0 +1,66 @@
+#ifndef CAFFE_HDF5_PREFETCH_DATA_LAYER_HPP_
+#define CAFFE_HDF5_PREFETCH_DATA_LAYER_HPP_
+
+#include "hdf5.h"
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/base_data_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Provides data to the Net from HDF5 files, reading them on the
+ *        prefetch thread in chunks of hdf5_data_param.chunk_size rows.
+ *
+ * Unlike HDF5DataLayer, it never holds a whole file in memory, and opening
+ * the next file does not stall the net. The tops are the datasets of the
+ * same names: data and, optionally, a label. Since the HDF5 library is called
+ * from the prefetch thread, other HDF5 I/O in the process (e.g. HDF5
+ * snapshots) requires an HDF5 built thread-safe.
+ */
+template <typename Dtype>
+class HDF5PrefetchDataLayer : public BasePrefetchingDataLayer<Dtype> {
+ public:
+  explicit HDF5PrefetchDataLayer(const LayerParameter& param)
+      : BasePrefetchingDataLayer<Dtype>(param), file_id_(-1) {}
+  virtual ~HDF5PrefetchDataLayer();
+  virtual void DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "HDF5PrefetchData"; }
+  virtual inline int ExactNumBottomBlobs() const { return 0; }
+  virtual inline int MinTopBlobs() const { return 1; }
+  virtual inline int MaxTopBlobs() const { return 2; }
+
+ protected:
+  virtual void load_batch(Batch<Dtype>* batch);
+  // Opens the current file and orders its chunks.
+  virtual void OpenFile();
+  // Reads the next chunk, moving on to the next file at the end of one.
+  virtual void LoadChunk();
+  virtual void Shuffle(vector<int>* order);
+
+  shared_ptr<Caffe::RNG> prefetch_rng_;
+  vector<std::string> hdf_filenames_;
+  vector<int> file_permutation_;
+  int current_file_;
+  hid_t file_id_;
+  int num_rows_;
+  // The first row of each chunk of the current file, in reading order.
+  vector<int> chunk_starts_;
+  int current_chunk_;
+  // The rows of the current chunk of each dataset.
+  vector<shared_ptr<Blob<Dtype> > > chunk_blobs_;
+  vector<int> row_permutation_;
+  int current_row_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_HDF5_PREFETCH_DATA_LAYER_HPP_
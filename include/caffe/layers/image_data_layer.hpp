@@ -1,6 +1,10 @@
 #ifndef CAFFE_IMAGE_DATA_LAYER_HPP_
 #define CAFFE_IMAGE_DATA_LAYER_HPP_
 
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#endif  // USE_OPENCV
+
 #include <string>
 #include <utility>
 #include <vector>
@@ -14,9 +18,15 @@
 
 namespace caffe {
 
+class ThreadPool;
+
 /**
  * @brief Provides data to the Net from image files.
  *
+ * image_data_param.threads threads read and decode the images of a batch
+ * concurrently, ahead of time: while a batch is transformed, the images of the
+ * next one are being read. The images come in the same order either way.
+ *
  * TODO(dox): thorough documentation for Forward and proto params.
  */
 template <typename Dtype>
@@ -36,9 +46,33 @@ class ImageDataLayer : public BasePrefetchingDataLayer<Dtype> {
   shared_ptr<Caffe::RNG> prefetch_rng_;
   virtual void ShuffleImages();
   virtual void load_batch(Batch<Dtype>* batch);
+  // Takes the lines of the next batch, from lines_id_ on.
+  virtual void NextBatchLines();
+  // Task 0 transforms the current batch, task i reads image i - 1 of the
+  // next one.
+  void LoadBatchTask(Batch<Dtype>* batch, Dtype* prefetch_data,
+      Dtype* prefetch_label, int i);
+  void TransformBatch(Batch<Dtype>* batch, Dtype* prefetch_data,
+      Dtype* prefetch_label);
+  void ReadImage(int item_id);
 
   vector<std::pair<std::string, int> > lines_;
   int lines_id_;
+#ifdef USE_OPENCV
+  // The lines and images of the batch being loaded and of the next one.
+  vector<std::pair<std::string, int> > batch_lines_;
+  vector<cv::Mat> batch_images_;
+  vector<std::pair<std::string, int> > next_lines_;
+  vector<cv::Mat> next_images_;
+#endif  // USE_OPENCV
+  shared_ptr<ThreadPool> read_pool_;
+  // Time spent in each stage since the last report, in microseconds. The
+  // read time adds up the time of every reader.
+  vector<double> read_times_;
+  double read_time_;
+  double wait_time_;
+  double trans_time_;
+  int timed_batches_;
 };
 
 
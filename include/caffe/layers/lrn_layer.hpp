@@ -56,6 +56,15 @@ class LRNLayer : public Layer<Dtype> {
   virtual void WithinChannelBackward(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
+  // The fused ACROSS_CHANNELS kernels, over the tiles [begin, end) of kTile
+  // pixels of the images.
+  static const int kTile = 64;
+  void CrossChannelForwardTiles(const int begin, const int end,
+      const Dtype* bottom_data, Dtype* scale_data, Dtype* top_data) const;
+  void CrossChannelBackwardTiles(const int begin, const int end,
+      const Dtype* top_diff, const Dtype* top_data, const Dtype* bottom_data,
+      const Dtype* scale_data, Dtype* bottom_diff) const;
+
   int size_;
   int pre_pad_;
   Dtype alpha_;
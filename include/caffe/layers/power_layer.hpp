@@ -73,6 +73,12 @@ class PowerLayer : public NeuronLayer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  /// @brief Forward_cpu and Backward_cpu on the elements [begin, end).
+  void Forward_cpu_range(const Dtype* bottom_data, Dtype* top_data,
+      const int begin, const int end);
+  void Backward_cpu_range(const Dtype* bottom_data, const Dtype* top_data,
+      const Dtype* top_diff, Dtype* bottom_diff, const int begin,
+      const int end);
 
   /// @brief @f$ \gamma @f$ from layer_param_.power_param()
   Dtype power_;
@@ -0,0 +1,101 @@
+#ifndef CAFFE_PYTHON_DATA_LAYER_HPP_
+#define CAFFE_PYTHON_DATA_LAYER_HPP_
+
+#include <boost/python.hpp>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/layers/base_data_layer.hpp"
+#include "caffe/layers/python_layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace bp = boost::python;
+
+namespace caffe {
+
+// Whether the calling thread holds the GIL.
+inline bool HoldsGIL() {
+#if PY_VERSION_HEX >= 0x03040000
+  return PyGILState_Check();
+#else
+  PyThreadState* state = PyGILState_GetThisThreadState();
+  return state && state == _PyThreadState_Current;
+#endif
+}
+
+/**
+ * @brief Provides data to the Net from a batch generator written in Python,
+ *        run on the prefetch thread.
+ *
+ * The generator is an instance of the class python_param.layer of the module
+ * python_param.module, built without arguments, with the methods setup(top),
+ * which shapes the tops, and next_batch(top), which fills them with the next
+ * batch; its attribute param_str is set to python_param.param_str first.
+ *
+ * next_batch receives the blobs of a batch of the prefetch ring and writes the
+ * batch in place. It holds the GIL only while it runs, so that the Python
+ * code overlaps with the computation of the net as long as the thread running
+ * the net does not hold the GIL (pycaffe releases it while nets and solvers
+ * run).
+ */
+template <typename Dtype>
+class PythonDataLayer : public BasePrefetchingDataLayer<Dtype> {
+ public:
+  PythonDataLayer(const LayerParameter& param, const bp::object& generator)
+      : BasePrefetchingDataLayer<Dtype>(param),
+        generator_(new bp::object(generator)) {}
+  virtual ~PythonDataLayer() {
+    // The prefetch thread may be waiting for the GIL held by the caller.
+    PyThreadState* state = HoldsGIL() ? PyEval_SaveThread() : NULL;
+    this->StopInternalThread();
+    if (state) {
+      PyEval_RestoreThread(state);
+    }
+    AcquireGIL gil;
+    generator_.reset();
+  }
+  virtual void DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+    {
+      AcquireGIL gil;
+      generator_->attr("param_str") = bp::str(
+          this->layer_param_.python_param().param_str());
+      generator_->attr("setup")(top);
+    }
+    for (int i = 0; i < this->prefetch_.size(); ++i) {
+      this->prefetch_[i]->data_.ReshapeLike(*top[0]);
+      if (this->output_labels_) {
+        this->prefetch_[i]->label_.ReshapeLike(*top[1]);
+      }
+    }
+  }
+
+  virtual inline const char* type() const { return "PythonData"; }
+  virtual inline int ExactNumBottomBlobs() const { return 0; }
+  virtual inline int MinTopBlobs() const { return 1; }
+  virtual inline int MaxTopBlobs() const { return 2; }
+
+ protected:
+  virtual void load_batch(Batch<Dtype>* batch) {
+    vector<Blob<Dtype>*> top(1, &batch->data_);
+    if (this->output_labels_) {
+      top.push_back(&batch->label_);
+    }
+    AcquireGIL gil;
+    try {
+      generator_->attr("next_batch")(top);
+    } catch (bp::error_already_set) {
+      PyErr_Print();
+      LOG(FATAL) << "Python data layer " << this->layer_param_.name()
+                 << " failed to generate a batch";
+    }
+  }
+
+  // Released with the GIL held.
+  shared_ptr<bp::object> generator_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_PYTHON_DATA_LAYER_HPP_
@@ -10,11 +10,27 @@ namespace bp = boost::python;
 
 namespace caffe {
 
+// Holds the GIL for the lifetime of the object: pycaffe releases it while
+// nets run, and nets may run their layers in threads of their own.
+class AcquireGIL {
+ public:
+  AcquireGIL() : state_(PyGILState_Ensure()) {}
+  ~AcquireGIL() { PyGILState_Release(state_); }
+
+ private:
+  PyGILState_STATE state_;
+};
+
 template <typename Dtype>
 class PythonLayer : public Layer<Dtype> {
  public:
   PythonLayer(PyObject* self, const LayerParameter& param)
       : Layer<Dtype>(param), self_(bp::handle<>(bp::borrowed(self))) { }
+  virtual ~PythonLayer() {
+    // The net may be destroyed from C++ without the GIL.
+    AcquireGIL gil;
+    self_ = bp::object();
+  }
 
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -24,12 +40,14 @@ class PythonLayer : public Layer<Dtype> {
         && !ShareInParallel()) {
       LOG(FATAL) << "PythonLayer is not implemented in Multi-GPU training";
     }
+    AcquireGIL gil;
     self_.attr("param_str") = bp::str(
         this->layer_param_.python_param().param_str());
     self_.attr("setup")(bottom, top);
   }
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+    AcquireGIL gil;
     self_.attr("reshape")(bottom, top);
   }
 
@@ -42,10 +60,12 @@ class PythonLayer : public Layer<Dtype> {
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+    AcquireGIL gil;
     self_.attr("forward")(bottom, top);
   }
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+    AcquireGIL gil;
     self_.attr("backward")(top, propagate_down, bottom);
   }
 
@@ -23,9 +23,14 @@ class ReLULayer : public NeuronLayer<Dtype> {
    *     with ReLULayer options:
    *   - negative_slope (\b optional, default 0).
    *     the value @f$ \nu @f$ by which negative values are multiplied.
+   *   - bit_mask (\b optional, default false).
+   *     whether to keep the signs of the inputs as a bit mask for the CPU
+   *     backward instead of reading the inputs again.
    */
   explicit ReLULayer(const LayerParameter& param)
       : NeuronLayer<Dtype>(param) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "ReLU"; }
 
@@ -78,6 +83,10 @@ class ReLULayer : public NeuronLayer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  /// with bit_mask, bit i % 32 of word i / 32 tells whether input i is
+  /// positive
+  Blob<unsigned int> mask_;
 };
 
 }  // namespace caffe
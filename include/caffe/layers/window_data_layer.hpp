@@ -1,6 +1,10 @@
 #ifndef CAFFE_WINDOW_DATA_LAYER_HPP_
 #define CAFFE_WINDOW_DATA_LAYER_HPP_
 
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#endif  // USE_OPENCV
+
 #include <string>
 #include <utility>
 #include <vector>
@@ -14,10 +18,15 @@
 
 namespace caffe {
 
+class ThreadPool;
+
 /**
  * @brief Provides data to the Net from windows of images files, specified
  *        by a window data file.
  *
+ * window_data_param.threads threads decode the images of a batch, each once
+ * however many of its windows were sampled, then crop and warp the windows.
+ *
  * TODO(dox): thorough documentation for Forward and proto params.
  */
 template <typename Dtype>
@@ -36,6 +45,10 @@ class WindowDataLayer : public BasePrefetchingDataLayer<Dtype> {
  protected:
   virtual unsigned int PrefetchRand();
   virtual void load_batch(Batch<Dtype>* batch);
+  // Parses the text window file.
+  virtual void ReadWindowFile(const string& filename, WindowDataIndex* index);
+  void DecodeImage(int i);
+  void ExtractWindow(Dtype* top_data, Dtype* top_label, int item_id);
 
   shared_ptr<Caffe::RNG> prefetch_rng_;
   vector<std::pair<std::string, vector<int> > > image_database_;
@@ -48,6 +61,20 @@ class WindowDataLayer : public BasePrefetchingDataLayer<Dtype> {
   bool has_mean_values_;
   bool cache_images_;
   vector<std::pair<std::string, Datum > > image_database_cache_;
+  shared_ptr<ThreadPool> window_pool_;
+  // The windows sampled for the batch being loaded, and the images they come
+  // from, each decoded once.
+  vector<vector<float> > batch_windows_;
+  vector<int> batch_mirrors_;
+  vector<int> batch_image_ids_;
+  // The index in batch_image_ids_ of the image of each window.
+  vector<int> batch_image_slots_;
+#ifdef USE_OPENCV
+  vector<cv::Mat> batch_images_;
+#endif  // USE_OPENCV
+  // The time each task took, in microseconds.
+  vector<double> read_times_;
+  vector<double> trans_times_;
 };
 
 }  // namespace caffe
@@ -11,9 +11,12 @@
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/rng.hpp"
 
 namespace caffe {
 
+class ThreadPool;
+
 /**
  * @brief Connects Layer%s together into a directed acyclic graph (DAG)
  *        specified by a NetParameter.
@@ -26,6 +29,14 @@ class Net {
   explicit Net(const NetParameter& param, const Net* root_net = NULL);
   explicit Net(const string& param_file, Phase phase,
       const Net* root_net = NULL);
+  /**
+   * @brief Initialize a net whose layers use the parameters of the same-named
+   *        layers of weights_net, as ShareTrainedLayersWith would, instead of
+   *        allocating and filling their own.
+   *
+   * The net owns its activations only; see InferenceEngine.
+   */
+  Net(const NetParameter& param, const Net& weights_net);
   virtual ~Net() {}
 
   /// @brief Initialize a network with a NetParameter.
@@ -108,7 +119,8 @@ class Net {
   // trained layers from another net parameter instance.
   /**
    * @brief For an already initialized net, copies the pre-trained layers from
-   *        another Net.
+   *        another Net. If the layers of this net are fused, the same
+   *        source layers are folded first.
    */
   void CopyTrainedLayersFrom(const NetParameter& param);
   void CopyTrainedLayersFrom(const string trained_filename);
@@ -241,6 +253,40 @@ class Net {
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
 
+  /// @brief Set up the bottom views of blobs consumed by several layers.
+  void SetUpSharedBottoms();
+  /// @brief Point the bottom views of a layer at the current shared blobs.
+  void SyncSharedBottoms(const int layer_id);
+  /**
+   * @brief Tag the memory of the tops and of the parameters of each layer,
+   *        as "<layer>/data", "<layer>/diff" and "<layer>/params" (see
+   *        SyncedMemory::Tag). What the layers allocate themselves is tagged
+   *        "<layer>/workspace", unless they tag it otherwise.
+   */
+  void TagMemory();
+  /**
+   * @brief Cut the layers into segments for recomputation in backward and
+   *        find the blobs living in scratch memory (see checkpoint_every in
+   *        NetParameter).
+   */
+  void InitCheckpoints(const NetParameter& param);
+  /// @brief Point the blobs of each segment at the shared scratch memory,
+  ///        growing it to their current shapes.
+  void ShareCheckpointScratch();
+  /// @brief Run forward again for the layers of a segment whose tops are in
+  ///        scratch memory, as they ran in forward.
+  void RecomputeSegment(const int segment);
+  /// @brief Find the layers each layer has to wait for when running the
+  ///        independent layers concurrently.
+  void InitLayerGraph(const NetParameter& param);
+  /**
+   * @brief Run the layers from start to end on the branch threads, each as
+   *        soon as the layers it depends on are done.
+   */
+  void RunLayerGraph(const int start, const int end, const bool forward);
+  class LayerGraphRun;
+  /// @brief Helper for RunLayerGraph: run ready layers until all are done.
+  void RunLayerGraphWorker(LayerGraphRun* run, const bool forward);
   /// @brief Helper for displaying debug info in Forward.
   void ForwardDebugInfo(const int layer_id);
   /// @brief Helper for displaying debug info in Backward.
@@ -268,6 +314,13 @@ class Net {
   vector<vector<Blob<Dtype>*> > bottom_vecs_;
   vector<vector<int> > bottom_id_vecs_;
   vector<vector<bool> > bottom_need_backward_;
+  /// Without Split layers, a blob consumed by several layers is handed to
+  /// each of them as a view sharing its data. In backward, the first view to
+  /// be written shares the diff of the blob and the others write into a
+  /// scratch diff that is accumulated into it.
+  vector<vector<shared_ptr<Blob<Dtype> > > > shared_bottom_vecs_;
+  vector<shared_ptr<Blob<Dtype> > > shared_bottom_diffs_;
+  vector<bool> shared_diff_written_;
   /// top_vecs stores the vectors containing the output for each layer
   vector<vector<Blob<Dtype>*> > top_vecs_;
   vector<vector<int> > top_id_vecs_;
@@ -303,10 +356,39 @@ class Net {
   vector<bool> has_params_decay_;
   /// The bytes of memory used by this net
   size_t memory_used_;
+  /// The memory tag of what each layer allocates itself
+  vector<int> layer_workspace_tags_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
+  /// Whether the layers were fused for inference (see FuseLayers).
+  bool fuse_layers_;
+  /// The names of the layers fused into a convolution.
+  set<string> fused_layer_names_;
+  /// To run the independent layers concurrently (see branch_threads in
+  /// NetParameter), the layers each layer depends on in forward and in
+  /// backward. Backward runs in order if it is empty.
+  vector<vector<int> > forward_layer_deps_;
+  vector<vector<int> > backward_layer_deps_;
+  shared_ptr<ThreadPool> branch_pool_;
+  vector<Dtype> layer_losses_;
+  /// For checkpointing, the segment of each layer (empty if off), the first
+  /// layer of each segment, whether each layer is recomputed, and the state of
+  /// Caffe::rng_stream() before the last forward of each recomputed layer.
+  vector<int> layer_segments_;
+  vector<int> segment_starts_;
+  vector<bool> layer_recomputed_;
+  vector<rng_t> layer_rngs_;
+  /// The blobs of each segment living in scratch memory, largest first, and
+  /// the scratch memory, blob i of every segment using slot i.
+  vector<vector<int> > segment_scratch_blobs_;
+  vector<shared_ptr<SyncedMemory> > scratch_data_;
+  vector<shared_ptr<SyncedMemory> > scratch_diff_;
+  /// The segment whose scratch blobs hold its activations, -1 if none.
+  int live_segment_;
   /// The root net that actually holds the shared layers in data parallelism
   const Net* const root_net_;
+  /// The net whose parameters the layers use, if any
+  const Net* const weights_net_;
   DISABLE_COPY_AND_ASSIGN(Net);
 };
 
@@ -1,7 +1,10 @@
 #ifndef CAFFE_SYNCEDMEM_HPP_
 #define CAFFE_SYNCEDMEM_HPP_
 
+#include <stdint.h>
+
 #include <cstdlib>
+#include <string>
 
 #include "caffe/common.hpp"
 
@@ -40,18 +43,21 @@ inline void CaffeFreeHost(void* ptr, bool use_cuda) {
  * @brief Manages memory allocation and synchronization between the host (CPU)
  *        and device (GPU).
  *
- * TODO(dox): more thorough description.
+ * The bytes allocated by all SyncedMemory are counted, in total and per tag.
+ * A tag names what the memory is for, e.g. the tops or the parameters of a
+ * layer; new memory takes the tag of the innermost MemoryTagScope of the
+ * thread creating it, if any.
  */
 class SyncedMemory {
  public:
   SyncedMemory()
       : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(0), head_(UNINITIALIZED),
         own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false),
-        gpu_device_(-1) {}
+        gpu_device_(-1), tag_(scope_tag()), version_(0) {}
   explicit SyncedMemory(size_t size)
       : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(size), head_(UNINITIALIZED),
         own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false),
-        gpu_device_(-1) {}
+        gpu_device_(-1), tag_(scope_tag()), version_(0) {}
   ~SyncedMemory();
   const void* cpu_data();
   void set_cpu_data(void* data);
@@ -62,14 +68,58 @@ class SyncedMemory {
   enum SyncedHead { UNINITIALIZED, HEAD_AT_CPU, HEAD_AT_GPU, SYNCED };
   SyncedHead head() { return head_; }
   size_t size() { return size_; }
+  /// @brief Counts the calls that may change the data: mutable_cpu_data,
+  ///        mutable_gpu_data, set_cpu_data and set_gpu_data. A copy of the
+  ///        data, e.g. packed weights, is stale once it moves on; writes
+  ///        through a pointer obtained before the copy go unnoticed.
+  uint64_t version() const { return version_; }
+
+  /// @brief Data derived from the memory, e.g. the weights it holds packed
+  ///        for products, cached with it so that all who share the memory
+  ///        share it too, and freed with it.
+  class Derived {
+   public:
+    virtual ~Derived() {}
+  };
+  /// @brief The derived data cached with the memory, if any. Callers sharing
+  ///        the memory across threads must synchronize their use of it.
+  const shared_ptr<Derived>& derived() const { return derived_; }
+  void set_derived(const shared_ptr<Derived>& derived) { derived_ = derived; }
 
 #ifndef CPU_ONLY
   void async_gpu_push(const cudaStream_t& stream);
 #endif
 
+  /// @brief The tag of the memory, 0 if untagged.
+  int tag() const { return tag_; }
+  /// @brief Tags the memory, moving the bytes it holds to the new tag.
+  void set_tag(int tag);
+
+  /// @brief Bytes held on the host and the device, now and at most.
+  struct Usage {
+    Usage() : cpu(0), cpu_peak(0), gpu(0), gpu_peak(0) {}
+    size_t cpu;
+    size_t cpu_peak;
+    size_t gpu;
+    size_t gpu_peak;
+  };
+  /// @brief The id of the tag of the given name, registered on first use.
+  static int Tag(const string& name);
+  /// @brief The bytes held by the memory of a tag, untagged for tag 0.
+  static Usage TagUsage(int tag);
+  /// @brief The bytes held by all SyncedMemory.
+  static Usage TotalUsage();
+  /// @brief Restarts the peaks, of the total and of every tag, from now.
+  static void ResetPeakUsage();
+  /// @brief The tag of the innermost MemoryTagScope of the thread, or 0.
+  static int scope_tag();
+  static void set_scope_tag(int tag);
+
  private:
   void to_cpu();
   void to_gpu();
+  // Accounts bytes (negative when freed) to the tag of the memory.
+  void Account(bool gpu, int64_t bytes);
   void* cpu_ptr_;
   void* gpu_ptr_;
   size_t size_;
@@ -78,10 +128,30 @@ class SyncedMemory {
   bool cpu_malloc_use_cuda_;
   bool own_gpu_data_;
   int gpu_device_;
+  int tag_;
+  uint64_t version_;
+  shared_ptr<Derived> derived_;
 
   DISABLE_COPY_AND_ASSIGN(SyncedMemory);
 };  // class SyncedMemory
 
+/**
+ * @brief Tags the SyncedMemory created on the calling thread during the
+ *        lifetime of the object.
+ */
+class MemoryTagScope {
+ public:
+  explicit MemoryTagScope(int tag) : previous_(SyncedMemory::scope_tag()) {
+    SyncedMemory::set_scope_tag(tag);
+  }
+  ~MemoryTagScope() { SyncedMemory::set_scope_tag(previous_); }
+
+ private:
+  int previous_;
+
+  DISABLE_COPY_AND_ASSIGN(MemoryTagScope);
+};
+
 }  // namespace caffe
 
 #endif  // CAFFE_SYNCEDMEM_HPP_
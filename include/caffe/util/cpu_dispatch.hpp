@@ -0,0 +1,110 @@
+#ifndef CAFFE_UTIL_CPU_DISPATCH_HPP_
+#define CAFFE_UTIL_CPU_DISPATCH_HPP_
+
+#include <string>
+
+#include "caffe/common.hpp"
+
+/**
+ * Runtime selection of the instruction set of the hand-written CPU kernels,
+ * so that one binary built for the baseline ISA still runs them with AVX2 or
+ * AVX-512 where the CPU has it.
+ *
+ * A kernel is written once, as an inline function marked CAFFE_CPU_INLINE.
+ * CAFFE_CPU_VARIANTS defines a copy of it for each of Caffe::SIMDLevel,
+ * compiled by GCC or Clang for that instruction set, and CAFFE_CPU_DISPATCH
+ * picks the copy of Caffe::simd_level() as a function pointer:
+ *
+ *   template <typename Dtype>
+ *   static CAFFE_CPU_INLINE void scale_kernel(const int n, Dtype* x) { ... }
+ *   CAFFE_CPU_VARIANTS_TEMPLATE(Dtype, scale_kernel,
+ *       (const int n, Dtype* x), (n, x))
+ *   ...
+ *   CAFFE_CPU_DISPATCH_TEMPLATE(scale_kernel, Dtype)(n, x);
+ *
+ * Elsewhere, every level runs the one baseline copy.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CAFFE_CPU_DISPATCH_X86
+#define CAFFE_CPU_INLINE inline __attribute__((always_inline))
+#define CAFFE_TARGET_SSE4 __attribute__((target("sse4.2")))
+#define CAFFE_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define CAFFE_TARGET_AVX512 \
+    __attribute__((target("avx512f,avx512bw,avx512dq,avx512vl,avx2,fma")))
+#else
+#define CAFFE_CPU_INLINE inline
+#endif
+
+namespace caffe {
+
+/// @brief The name of a level, as taken by ParseSIMDLevel.
+const char* SIMDLevelName(const Caffe::SIMDLevel level);
+
+/// @brief The level of a name: baseline, sse4, avx2 or avx512.
+Caffe::SIMDLevel ParseSIMDLevel(const std::string& name);
+
+/// @brief The best level the CPU and the operating system support.
+Caffe::SIMDLevel DetectSIMDLevel();
+
+template <typename Fn>
+inline Fn cpu_dispatch(Fn baseline, Fn sse4, Fn avx2, Fn avx512) {
+  switch (Caffe::simd_level()) {
+  case Caffe::AVX512:
+    return avx512;
+  case Caffe::AVX2:
+    return avx2;
+  case Caffe::SSE4:
+    return sse4;
+  default:
+    return baseline;
+  }
+}
+
+}  // namespace caffe
+
+#ifdef CAFFE_CPU_DISPATCH_X86
+
+// Defines name_baseline, name_sse4, name_avx2 and name_avx512, calling the
+// CAFFE_CPU_INLINE function name with the arguments args.
+#define CAFFE_CPU_VARIANTS(name, params, args) \
+  static void name##_baseline params { name args; } \
+  CAFFE_TARGET_SSE4 static void name##_sse4 params { name args; } \
+  CAFFE_TARGET_AVX2 static void name##_avx2 params { name args; } \
+  CAFFE_TARGET_AVX512 static void name##_avx512 params { name args; }
+
+// The same, for a function template of one type parameter T.
+#define CAFFE_CPU_VARIANTS_TEMPLATE(T, name, params, args) \
+  template <typename T> \
+  static void name##_baseline params { name args; } \
+  template <typename T> \
+  CAFFE_TARGET_SSE4 static void name##_sse4 params { name args; } \
+  template <typename T> \
+  CAFFE_TARGET_AVX2 static void name##_avx2 params { name args; } \
+  template <typename T> \
+  CAFFE_TARGET_AVX512 static void name##_avx512 params { name args; }
+
+#define CAFFE_CPU_DISPATCH(name) \
+  ::caffe::cpu_dispatch(&name##_baseline, &name##_sse4, &name##_avx2, \
+      &name##_avx512)
+
+#define CAFFE_CPU_DISPATCH_TEMPLATE(name, T) \
+  ::caffe::cpu_dispatch(&name##_baseline<T>, &name##_sse4<T>, \
+      &name##_avx2<T>, &name##_avx512<T>)
+
+#else  // Only the baseline.
+
+#define CAFFE_CPU_VARIANTS(name, params, args) \
+  static void name##_baseline params { name args; }
+
+#define CAFFE_CPU_VARIANTS_TEMPLATE(T, name, params, args) \
+  template <typename T> \
+  static void name##_baseline params { name args; }
+
+#define CAFFE_CPU_DISPATCH(name) (&name##_baseline)
+
+#define CAFFE_CPU_DISPATCH_TEMPLATE(name, T) (&name##_baseline<T>)
+
+#endif  // CAFFE_CPU_DISPATCH_X86
+
+#endif  // CAFFE_UTIL_CPU_DISPATCH_HPP_
@@ -0,0 +1,30 @@
+#ifndef CAFFE_UTIL_FUSE_LAYERS_HPP_
+#define CAFFE_UTIL_FUSE_LAYERS_HPP_
+
+#include <set>
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// Copy NetParameters with every Convolution -> BatchNorm -> Scale -> ReLU
+// chain replaced by a single Convolution layer. Any of BatchNorm, Scale and
+// ReLU may be missing from a chain, but they must follow in this order and
+// each intermediate blob must have no other consumer. BatchNorm is only folded
+// when it uses the global statistics, so the result is meant for inference.
+// If the layers of a chain carry their parameter blobs (as in a .caffemodel),
+// the BatchNorm and Scale transforms are folded into the weights and bias of
+// the convolution; otherwise only the layer structure is rewritten.
+void FuseLayers(const NetParameter& param, NetParameter* param_fused);
+
+// As above, fusing into a convolution only the layers named in fusable if it
+// is given, and adding the names of the layers fused away to fused_names if
+// given.
+void FuseLayers(const NetParameter& param, const set<string>* fusable,
+    NetParameter* param_fused, set<string>* fused_names);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_FUSE_LAYERS_HPP_
@@ -0,0 +1,50 @@
+#ifndef CAFFE_UTIL_GROUPED_CONV_HPP_
+#define CAFFE_UTIL_GROUPED_CONV_HPP_
+
+namespace caffe {
+
+/**
+ * Direct CPU kernels of a 2D convolution of many groups of few channels,
+ * e.g. depthwise, for one image, without im2col and with no GEMM per group.
+ *
+ * They go over the rows of the output, each tap of the kernel an update of a
+ * whole row vectorized over its positions, with the instruction set of
+ * Caffe::simd_level(), and in parallel over the channels.
+ */
+
+/// @brief The shape of a grouped convolution of one image.
+struct GroupedConvGeometry {
+  int groups;
+  int channels;    ///< Of the input, over all groups.
+  int num_output;  ///< Of the output, over all groups.
+  int height, width;
+  int output_h, output_w;
+  int kernel_h, kernel_w;
+  int pad_h, pad_w;
+  int stride_h, stride_w;
+  int dilation_h, dilation_w;
+};
+
+// The most input channels per group for which BaseConvolutionLayer runs the
+// kernels below instead of im2col and a GEMM per group.
+const int kGroupedConvMaxChannels = 4;
+
+/// @brief output = conv(input, weights), weights of shape
+///        (num_output, channels / groups, kernel_h, kernel_w).
+template <typename Dtype>
+void grouped_conv_forward_cpu(const GroupedConvGeometry& geometry,
+    const Dtype* input, const Dtype* weights, Dtype* output);
+
+/// @brief input_diff = the gradient of conv with respect to its input.
+template <typename Dtype>
+void grouped_conv_backward_cpu(const GroupedConvGeometry& geometry,
+    const Dtype* output_diff, const Dtype* weights, Dtype* input_diff);
+
+/// @brief weight_diff += the gradient of conv with respect to its weights.
+template <typename Dtype>
+void grouped_conv_weight_cpu(const GroupedConvGeometry& geometry,
+    const Dtype* input, const Dtype* output_diff, Dtype* weight_diff);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_GROUPED_CONV_HPP_
@@ -0,0 +1,20 @@
+#ifndef CAFFE_UTIL_IN_PLACE_ACTIVATIONS_HPP_
+#define CAFFE_UTIL_IN_PLACE_ACTIVATIONS_HPP_
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// Copy NetParameters with every ReLU and Dropout layer computing in place when
+// this saves a blob: the layer writes a new blob, its bottom has no other
+// consumer and no loss weight, and the layer producing the bottom does not
+// read its top in backward. The top of such a layer takes the name of its
+// bottom, in the layer and in the later layers reading it. Every ReLU layer
+// keeps a bit mask, so that its backward does not depend on the data later
+// in-place layers leave in the blob.
+void MakeActivationsInPlace(const NetParameter& param,
+                            NetParameter* param_in_place);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_IN_PLACE_ACTIVATIONS_HPP_
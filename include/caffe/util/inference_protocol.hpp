@@ -0,0 +1,99 @@
+#ifndef CAFFE_UTIL_INFERENCE_PROTOCOL_HPP_
+#define CAFFE_UTIL_INFERENCE_PROTOCOL_HPP_
+
+// The protocol between inference_server and its clients, over a Unix socket.
+//
+// Each message, either way, is a header of two uint32 in host byte order
+// followed by a payload of the given number of bytes:
+//   request:  type, payload size, payload
+//   response: status, payload size, payload
+// A connection carries any number of requests, one at a time.
+//
+// PREDICT: the payload is one input item of the net as float; the response
+//   payload is the outputs of the net for it as float.
+// INPUT_SHAPE: no payload; the response payload is the shape of the input
+//   blob as int32, the first axis being the batch.
+// METRICS: no payload; the response payload is a text report of the server
+//   metrics.
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+namespace caffe {
+namespace inference {
+
+enum RequestType { PREDICT = 0, INPUT_SHAPE = 1, METRICS = 2 };
+
+enum Status {
+  OK = 0,
+  // The queue of the server is full: retry later.
+  BUSY = 1,
+  BAD_REQUEST = 2
+};
+
+// Reads or writes size bytes, returning false if the connection closed.
+inline bool ReadFully(int fd, void* data, size_t size) {
+  char* p = static_cast<char*>(data);
+  while (size > 0) {
+    const ssize_t n = recv(fd, p, size, 0);
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+inline bool WriteFully(int fd, const void* data, size_t size) {
+  const char* p = static_cast<const char*>(data);
+  while (size > 0) {
+    const ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+// Reads a message whose payload is at most max_sizes[code] bytes, or none
+// for the codes beyond, returning false if the connection closed or the
+// header announced more. In the latter case nothing is allocated and
+// *oversized is set: the payload is left unread, so the connection is out
+// of step and the caller should refuse the message and close it.
+inline bool ReadMessage(int fd, uint32_t* code, std::vector<char>* payload,
+    const std::vector<uint32_t>& max_sizes, bool* oversized) {
+  uint32_t header[2];
+  *oversized = false;
+  if (!ReadFully(fd, header, sizeof(header))) {
+    return false;
+  }
+  *code = header[0];
+  const uint32_t max_size = header[0] < max_sizes.size() ?
+      max_sizes[header[0]] : 0;
+  if (header[1] > max_size) {
+    payload->clear();
+    *oversized = true;
+    return false;
+  }
+  payload->resize(header[1]);
+  return payload->empty() || ReadFully(fd, &(*payload)[0], payload->size());
+}
+
+inline bool WriteMessage(int fd, uint32_t code, const void* payload,
+    size_t size) {
+  const uint32_t header[2] = { code, static_cast<uint32_t>(size) };
+  return WriteFully(fd, header, sizeof(header)) &&
+      (size == 0 || WriteFully(fd, payload, size));
+}
+
+}  // namespace inference
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_INFERENCE_PROTOCOL_HPP_
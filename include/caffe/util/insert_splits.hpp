@@ -9,6 +9,8 @@ namespace caffe {
 
 // Copy NetParameters with SplitLayers added to replace any shared bottom
 // blobs with unique bottom blobs provided by the SplitLayer.
+// If param.insert_splits() is false, a SplitLayer is only added for shared
+// blobs that the Net cannot fan out directly (see NetParameter).
 void InsertSplits(const NetParameter& param, NetParameter* param_split);
 
 void ConfigureSplitLayer(const string& layer_name, const string& blob_name,
@@ -9,6 +9,7 @@
 #include "caffe/common.hpp"
 #include "caffe/util/device_alternate.hpp"
 #include "caffe/util/mkl_alternate.hpp"
+#include "caffe/util/philox.hpp"
 
 namespace caffe {
 
@@ -20,6 +21,82 @@ void caffe_cpu_gemm(const CBLAS_TRANSPOSE TransA,
     const Dtype alpha, const Dtype* A, const Dtype* B, const Dtype beta,
     Dtype* C);
 
+class SyncedMemory;
+
+/**
+ * @brief A constant operand of a product, such as the weights of a layer,
+ *        packed once for caffe_cpu_gemm_packed_a and caffe_cpu_gemm_packed_b.
+ *
+ * It holds a K x P matrix as panels of kPanel columns, each panel K rows of
+ * kPanel consecutive values, zero padded, which the products stream through
+ * with the other operand in registers. Pack skips the work when given the same
+ * source at the same version again, so that a layer may call it before every
+ * product with the SyncedMemory::version of its weights.
+ */
+template <typename Dtype>
+class PackedMatrix {
+ public:
+  static const int kPanel = 16;
+
+  PackedMatrix()
+      : K_(0), P_(0), trans_(CblasNoTrans), source_(NULL), version_(0) {}
+
+  /// @brief Packs op(B), of K x P, unless it is packed at this version.
+  void Pack(const CBLAS_TRANSPOSE TransB, const int K, const int P,
+      const Dtype* B, const uint64_t version);
+
+  inline int K() const { return K_; }
+  inline int P() const { return P_; }
+  /// @brief The source of the last Pack, as given.
+  inline const Dtype* source() const { return source_; }
+  inline CBLAS_TRANSPOSE trans() const { return trans_; }
+  /// @brief The version of the source at the last Pack.
+  inline uint64_t version() const { return version_; }
+  const Dtype* data() const;
+
+ private:
+  int K_;
+  int P_;
+  CBLAS_TRANSPOSE trans_;
+  const Dtype* source_;
+  uint64_t version_;
+  shared_ptr<SyncedMemory> data_;
+};
+
+/**
+ * @brief The packing of op(B), B the K x P matrix (P x K if transposed) at
+ *        offset in memory, cached with memory: all who share it, e.g. the
+ *        executors of an InferenceEngine, share one packing, redone once the
+ *        version of memory moves on. Thread-safe; a packing stays valid while
+ *        held.
+ */
+template <typename Dtype>
+shared_ptr<const PackedMatrix<Dtype> > caffe_cpu_packed(SyncedMemory* memory,
+    const CBLAS_TRANSPOSE TransB, const int K, const int P, const int offset);
+
+// The largest M (N) for which the packed products run their own kernel, one
+// pass over the packed matrix; above it, they call caffe_cpu_gemm on the
+// source of the packed matrix.
+const int kPackedGemmMaxRows = 16;
+
+/**
+ * @brief C = alpha op(A) B + beta C, with B packed as K x N, op(A) M x K and
+ *        C M x N, e.g. a fully connected layer on a small batch.
+ */
+template <typename Dtype>
+void caffe_cpu_gemm_packed_b(const CBLAS_TRANSPOSE TransA, const int M,
+    const Dtype alpha, const Dtype* A, const PackedMatrix<Dtype>& B,
+    const Dtype beta, Dtype* C);
+
+/**
+ * @brief C = alpha A op(B) + beta C, with A^T packed as K x M, op(B) K x N
+ *        and C M x N, e.g. a convolution on a small output.
+ */
+template <typename Dtype>
+void caffe_cpu_gemm_packed_a(const PackedMatrix<Dtype>& A,
+    const CBLAS_TRANSPOSE TransB, const int N, const Dtype alpha,
+    const Dtype* B, const Dtype beta, Dtype* C);
+
 template <typename Dtype>
 void caffe_cpu_gemv(const CBLAS_TRANSPOSE TransA, const int M, const int N,
     const Dtype alpha, const Dtype* A, const Dtype* x, const Dtype beta,
@@ -29,6 +106,12 @@ template <typename Dtype>
 void caffe_axpy(const int N, const Dtype alpha, const Dtype* X,
     Dtype* Y);
 
+// The number of threads used by the BLAS, where the BLAS lets us control it
+// (MKL and OpenBLAS); 1 otherwise.
+int caffe_blas_num_threads();
+
+void caffe_set_blas_num_threads(const int num_threads);
+
 template <typename Dtype>
 void caffe_cpu_axpby(const int N, const Dtype alpha, const Dtype* X,
     const Dtype beta, Dtype* Y);
@@ -85,12 +168,29 @@ void caffe_rng_bernoulli(const int n, const Dtype p, int* r);
 template <typename Dtype>
 void caffe_rng_bernoulli(const int n, const Dtype p, unsigned int* r);
 
+// The counter-based counterparts of the above: r[i] is value i of the stream
+// of philox, whatever the threads generating r in parallel (see parallel_for).
+template <typename Dtype>
+void caffe_rng_uniform(const int n, const Dtype a, const Dtype b, Dtype* r,
+                       const Philox& philox);
+
+template <typename Dtype>
+void caffe_rng_gaussian(const int n, const Dtype mu, const Dtype sigma,
+                        Dtype* r, const Philox& philox);
+
+template <typename Dtype>
+void caffe_rng_bernoulli(const int n, const Dtype p, unsigned int* r,
+                         const Philox& philox);
+
 template <typename Dtype>
 void caffe_exp(const int n, const Dtype* a, Dtype* y);
 
 template <typename Dtype>
 void caffe_log(const int n, const Dtype* a, Dtype* y);
 
+template <typename Dtype>
+void caffe_tanh(const int n, const Dtype* a, Dtype* y);
+
 template <typename Dtype>
 void caffe_abs(const int n, const Dtype* a, Dtype* y);
 
@@ -12,6 +12,8 @@ extern "C" {
 }
 #include <math.h>
 
+#include "caffe/util/simd_math.hpp"
+
 // Functions that caffe uses but are not present if MKL is not linked.
 
 // A simple way to define the vsl unary functions. The operation should
@@ -32,13 +34,34 @@ extern "C" {
   }
 
 DEFINE_VSL_UNARY_FUNC(Sqr, y[i] = a[i] * a[i]);
-DEFINE_VSL_UNARY_FUNC(Exp, y[i] = exp(a[i]));
-DEFINE_VSL_UNARY_FUNC(Ln, y[i] = log(a[i]));
 DEFINE_VSL_UNARY_FUNC(Abs, y[i] = fabs(a[i]));
 
-// A simple way to define the vsl unary functions with singular parameter b.
-// The operation should be in the form e.g. y[i] = pow(a[i], b)
-#define DEFINE_VSL_UNARY_FUNC_WITH_PARAM(name, operation) \
+// The same, with the float version computed by the vectorized kernel simd
+// of simd_math.hpp instead.
+#define DEFINE_VSL_UNARY_FUNC_SIMD(name, operation, simd) \
+  template<typename Dtype> \
+  void v##name(const int n, const Dtype* a, Dtype* y) { \
+    CHECK_GT(n, 0); CHECK(a); CHECK(y); \
+    for (int i = 0; i < n; ++i) { operation; } \
+  } \
+  inline void vs##name( \
+    const int n, const float* a, float* y) { \
+    CHECK_GT(n, 0); CHECK(a); CHECK(y); \
+    caffe::simd(n, a, y); \
+  } \
+  inline void vd##name( \
+      const int n, const double* a, double* y) { \
+    v##name<double>(n, a, y); \
+  }
+
+DEFINE_VSL_UNARY_FUNC_SIMD(Exp, y[i] = exp(a[i]), simd_exp);
+DEFINE_VSL_UNARY_FUNC_SIMD(Ln, y[i] = log(a[i]), simd_log);
+DEFINE_VSL_UNARY_FUNC_SIMD(Tanh, y[i] = tanh(a[i]), simd_tanh);
+
+// A simple way to define the vsl unary functions with singular parameter b,
+// the float version computed by simd. The operation should be in the form
+// e.g. y[i] = pow(a[i], b)
+#define DEFINE_VSL_UNARY_FUNC_WITH_PARAM_SIMD(name, operation, simd) \
   template<typename Dtype> \
   void v##name(const int n, const Dtype* a, const Dtype b, Dtype* y) { \
     CHECK_GT(n, 0); CHECK(a); CHECK(y); \
@@ -46,14 +69,15 @@ DEFINE_VSL_UNARY_FUNC(Abs, y[i] = fabs(a[i]));
   } \
   inline void vs##name( \
     const int n, const float* a, const float b, float* y) { \
-    v##name<float>(n, a, b, y); \
+    CHECK_GT(n, 0); CHECK(a); CHECK(y); \
+    caffe::simd(n, a, b, y); \
   } \
   inline void vd##name( \
       const int n, const double* a, const float b, double* y) { \
     v##name<double>(n, a, b, y); \
   }
 
-DEFINE_VSL_UNARY_FUNC_WITH_PARAM(Powx, y[i] = pow(a[i], b));
+DEFINE_VSL_UNARY_FUNC_WITH_PARAM_SIMD(Powx, y[i] = pow(a[i], b), simd_powx);
 
 // A simple way to define the vsl binary functions. The operation should
 // be in the form e.g. y[i] = a[i] + b[i]
@@ -0,0 +1,76 @@
+#ifndef CAFFE_UTIL_PHILOX_HPP_
+#define CAFFE_UTIL_PHILOX_HPP_
+
+#include <stdint.h>
+
+namespace caffe {
+
+/**
+ * @brief The Philox4x32-10 counter-based random number generator of Salmon et
+ *        al., "Parallel random numbers: as easy as 1, 2, 3" (SC 2011).
+ *
+ * Value i of the stream of a generator is a function of the key, the stream
+ * and i alone, so that any range of values can be generated on any thread, in
+ * any order, and generated again later, e.g. a dropout mask in backward. The
+ * values come in blocks of four, block b holding the values 4b to 4b + 3.
+ *
+ * The key typically tells apart the users of random numbers (a seed and a
+ * layer), the stream the uses of one user (an iteration).
+ */
+class Philox {
+ public:
+  Philox(uint64_t key, uint64_t stream) : key_(key), stream_(stream) {}
+
+  /// @brief A generator keyed by the next values of Caffe::rng_stream(), so
+  ///        that it follows Caffe::set_random_seed.
+  static Philox FromCaffeRNG(uint64_t stream = 0);
+
+  inline uint64_t key() const { return key_; }
+  inline uint64_t stream() const { return stream_; }
+
+  /// @brief Computes block b of the stream.
+  inline void Block(uint64_t b, uint32_t out[4]) const {
+    uint32_t c0 = static_cast<uint32_t>(b);
+    uint32_t c1 = static_cast<uint32_t>(b >> 32);
+    uint32_t c2 = static_cast<uint32_t>(stream_);
+    uint32_t c3 = static_cast<uint32_t>(stream_ >> 32);
+    uint32_t k0 = static_cast<uint32_t>(key_);
+    uint32_t k1 = static_cast<uint32_t>(key_ >> 32);
+    for (int round = 0; round < 10; ++round) {
+      const uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * c0;
+      const uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * c2;
+      const uint32_t hi0 = static_cast<uint32_t>(p0 >> 32);
+      const uint32_t hi1 = static_cast<uint32_t>(p1 >> 32);
+      c0 = hi1 ^ c1 ^ k0;
+      c1 = static_cast<uint32_t>(p1);
+      c2 = hi0 ^ c3 ^ k1;
+      c3 = static_cast<uint32_t>(p0);
+      k0 += 0x9E3779B9u;
+      k1 += 0xBB67AE85u;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+  }
+
+  /// @brief Value i of the stream.
+  inline uint32_t operator()(uint64_t i) const {
+    uint32_t block[4];
+    Block(i / 4, block);
+    return block[i % 4];
+  }
+
+  /// @brief Maps a value to [0, 1), with the 24 bits a float holds.
+  static inline float Uniform(uint32_t x) {
+    return (x >> 8) * (1.f / (1 << 24));
+  }
+
+ private:
+  uint64_t key_;
+  uint64_t stream_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_PHILOX_HPP_
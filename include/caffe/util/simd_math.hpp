@@ -0,0 +1,24 @@
+#ifndef CAFFE_UTIL_SIMD_MATH_HPP_
+#define CAFFE_UTIL_SIMD_MATH_HPP_
+
+namespace caffe {
+
+/**
+ * Vectorized float exp, log, pow and tanh, which caffe_exp, caffe_log,
+ * caffe_powx and caffe_tanh use without MKL.
+ *
+ * They evaluate the polynomial approximations of the Cephes library on eight
+ * lanes at a time, without branches, with the instruction set of
+ * Caffe::simd_level() (see cpu_dispatch.hpp). Against the correctly rounded
+ * results, exp, log and tanh stay within 2 ulps, and powx within
+ * 2 + 2 |b log(a)| ulps. Results below FLT_MIN flush to zero. NaN,
+ * infinities, zeros and negative inputs follow the C library.
+ */
+void simd_exp(const int n, const float* a, float* y);
+void simd_log(const int n, const float* a, float* y);
+void simd_powx(const int n, const float* a, const float b, float* y);
+void simd_tanh(const int n, const float* a, float* y);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SIMD_MATH_HPP_
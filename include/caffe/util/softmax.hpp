@@ -0,0 +1,48 @@
+#ifndef CAFFE_UTIL_SOFTMAX_HPP_
+#define CAFFE_UTIL_SOFTMAX_HPP_
+
+namespace caffe {
+
+/**
+ * The fused CPU kernels of the softmax over the channels of an array of shape
+ * (outer_num, channels, inner_num), in parallel over tiles of up to 64 inner
+ * positions of one outer index. Each tile makes its passes over the channels
+ * while they are in cache, and exponentiates with caffe_exp.
+ */
+
+/// @brief top = softmax(bottom).
+template <typename Dtype>
+void softmax_cpu(const int outer_num, const int channels, const int inner_num,
+    const Dtype* bottom_data, Dtype* top_data);
+
+/// @brief bottom_diff = (top_diff - dot(top_diff, top)) * top.
+template <typename Dtype>
+void softmax_backward_cpu(const int outer_num, const int channels,
+    const int inner_num, const Dtype* top_data, const Dtype* top_diff,
+    Dtype* bottom_diff);
+
+/**
+ * @brief Sums -log(softmax(bottom)[label]) over the positions whose label is
+ *        not ignore_label, without storing the probabilities. The count of
+ *        positions summed goes to *count.
+ *
+ * Each term is at most -log(FLT_MIN), as in SoftmaxWithLossLayer.
+ */
+template <typename Dtype>
+Dtype softmax_loss_cpu(const int outer_num, const int channels,
+    const int inner_num, const Dtype* bottom_data, const Dtype* label,
+    const bool has_ignore_label, const int ignore_label, int* count);
+
+/**
+ * @brief bottom_diff = scale * (prob - onehot(label)), and 0 at the positions
+ *        whose label is ignore_label.
+ */
+template <typename Dtype>
+void softmax_loss_backward_cpu(const int outer_num, const int channels,
+    const int inner_num, const Dtype* prob_data, const Dtype* label,
+    const bool has_ignore_label, const int ignore_label, const Dtype scale,
+    Dtype* bottom_diff);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SOFTMAX_HPP_
@@ -0,0 +1,73 @@
+#ifndef CAFFE_UTIL_THREAD_POOL_HPP_
+#define CAFFE_UTIL_THREAD_POOL_HPP_
+
+#include <boost/function.hpp>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+/**
+ Forward declare boost::thread instead of including boost/thread.hpp
+ to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+ */
+namespace boost { class thread; }
+
+namespace caffe {
+
+/**
+ * @brief A fixed set of threads running the tasks of one job at a time.
+ *
+ * The thread calling Run works on the tasks of its job as well, so a pool of
+ * size n runs n tasks at once with n - 1 worker threads. The workers take
+ * over the Caffe mode of the calling thread.
+ */
+class ThreadPool {
+ public:
+  explicit ThreadPool(int num_threads);
+  ~ThreadPool();
+
+  /// @brief The number of threads running the tasks, including the caller.
+  int size() const { return threads_.size() + 1; }
+
+  /**
+   * @brief Run task(i) for every i in [0, num_tasks) and return when all of
+   *        them are done.
+   *
+   * A job started while the pool runs another one, or from a task of any
+   * pool, runs its tasks in order on the calling thread instead; the cores
+   * are already busy then.
+   */
+  void Run(int num_tasks, const boost::function<void(int)>& task);
+
+  /// @brief The number of cores the process may run on.
+  static int NumAvailableCores();
+
+ private:
+  void Entry();
+  void RunTasks();
+
+  /**
+   Move synchronization fields out instead of including boost/thread.hpp
+   to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+   */
+  class sync;
+
+  vector<shared_ptr<boost::thread> > threads_;
+  shared_ptr<sync> sync_;
+
+DISABLE_COPY_AND_ASSIGN(ThreadPool);
+};
+
+/**
+ * @brief Run body(begin, end) on disjoint ranges covering [0, n), split among
+ *        the threads of Caffe::thread_pool().
+ *
+ * Each range spans at least grain_size elements, so that short loops stay on
+ * the calling thread.
+ */
+void parallel_for(const int n, const boost::function<void(int, int)>& body,
+    const int grain_size = 16384);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_THREAD_POOL_HPP_
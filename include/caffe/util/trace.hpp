@@ -0,0 +1,94 @@
+#ifndef CAFFE_UTIL_TRACE_HPP_
+#define CAFFE_UTIL_TRACE_HPP_
+
+#include <stdint.h>
+
+#include <boost/atomic.hpp>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/// @brief A span of time spent on one piece of work, as traced.
+struct TraceEvent {
+  static const int kMaxName = 48;
+
+  // Static strings: "forward", "backward", "prefetch", "solver", ...
+  const char* category;
+  // Truncated to kMaxName - 1 characters.
+  char name[kMaxName];
+  // In microseconds since the tracer started.
+  int64_t begin;
+  int64_t end;
+  // A small id of the thread, in the order the threads first recorded.
+  int thread;
+};
+
+/**
+ * @brief Records what the layers, the data prefetch threads and the solver
+ *        spend their time on, for export to the Chrome trace viewer.
+ *
+ * The events go into a ring of the given capacity, shared by all threads
+ * without locks, so that the oldest ones make room for new ones in long runs.
+ * While tracing is off, recording costs one branch. Start and Stop may come
+ * from any thread, Start waiting for the events being recorded; the export
+ * belongs to times the traced work is idle.
+ */
+class Tracer {
+ public:
+  static const int kDefaultCapacity = 1 << 18;
+
+  /// @brief Clears the ring and starts recording.
+  static void Start(int capacity = kDefaultCapacity);
+  /// @brief Stops recording, keeping the events recorded.
+  static void Stop();
+  static inline bool enabled() {
+    return enabled_.load(boost::memory_order_acquire);
+  }
+
+  /// @brief The current time in microseconds since the tracer started.
+  static int64_t Now();
+  static void Record(const char* category, const char* name, int64_t begin,
+                     int64_t end);
+
+  /// @brief The events in the ring, oldest first.
+  static vector<TraceEvent> Events();
+  /// @brief Writes the events in the Chrome trace event format, for
+  ///        chrome://tracing.
+  static void WriteChromeTrace(const string& filename);
+
+ private:
+  static boost::atomic<bool> enabled_;
+
+  DISABLE_COPY_AND_ASSIGN(Tracer);
+};
+
+/**
+ * @brief Records the lifetime of the object as an event if tracing is on.
+ *
+ * The strings must outlive the object.
+ */
+class TraceScope {
+ public:
+  TraceScope(const char* category, const char* name)
+      : category_(category), name_(Tracer::enabled() ? name : NULL),
+        begin_(name_ ? Tracer::Now() : 0) {}
+  ~TraceScope() {
+    if (name_) {
+      Tracer::Record(category_, name_, begin_, Tracer::Now());
+    }
+  }
+
+ private:
+  const char* category_;
+  const char* name_;
+  int64_t begin_;
+
+  DISABLE_COPY_AND_ASSIGN(TraceScope);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_TRACE_HPP_
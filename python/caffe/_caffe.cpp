@@ -23,6 +23,7 @@
 // You're strongly advised to upgrade to >= 1.7.
 #ifndef NPY_ARRAY_C_CONTIGUOUS
 #define NPY_ARRAY_C_CONTIGUOUS NPY_C_CONTIGUOUS
+#define NPY_ARRAY_WRITEABLE NPY_WRITEABLE
 #define PyArray_SetBaseObject(arr, x) (PyArray_BASE(arr) = (x))
 #endif
 
@@ -34,6 +35,18 @@ namespace caffe {
 typedef float Dtype;
 const int NPY_DTYPE = NPY_FLOAT32;
 
+// Releases the GIL for the lifetime of the object, so that other Python
+// threads run while the net computes. Python layers take it back while they
+// run (see python_layer.hpp).
+class ScopedGILRelease {
+ public:
+  ScopedGILRelease() : state_(PyEval_SaveThread()) {}
+  ~ScopedGILRelease() { PyEval_RestoreThread(state_); }
+
+ private:
+  PyThreadState* state_;
+};
+
 // Selecting mode.
 void set_mode_cpu() { Caffe::set_mode(Caffe::CPU); }
 void set_mode_gpu() { Caffe::set_mode(Caffe::GPU); }
@@ -95,6 +108,90 @@ shared_ptr<Net<Dtype> > Net_Init_Load(
   return net;
 }
 
+void Net_Forward(Net<Dtype>* net, int start, int end) {
+  ScopedGILRelease gil_release;
+  net->ForwardFromTo(start, end);
+}
+
+void Net_Backward(Net<Dtype>* net, int start, int end) {
+  ScopedGILRelease gil_release;
+  net->BackwardFromTo(start, end);
+}
+
+static PyArrayObject* CheckBindableArray(PyObject* obj, const string& name) {
+  if (!PyArray_Check(obj)) {
+    throw std::runtime_error(name + " must be an ndarray");
+  }
+  PyArrayObject* arr = reinterpret_cast<PyArrayObject*>(obj);
+  if (!(PyArray_FLAGS(arr) & NPY_ARRAY_C_CONTIGUOUS)) {
+    throw std::runtime_error(name + " must be C contiguous");
+  }
+  if (!(PyArray_FLAGS(arr) & NPY_ARRAY_WRITEABLE)) {
+    throw std::runtime_error(name + " must be writeable");
+  }
+  if (PyArray_TYPE(arr) != NPY_FLOAT32) {
+    throw std::runtime_error(name + " must be float32");
+  }
+  return arr;
+}
+
+static vector<int> ArrayShape(PyArrayObject* arr) {
+  return vector<int>(PyArray_DIMS(arr), PyArray_DIMS(arr) + PyArray_NDIM(arr));
+}
+
+// Runs the net forward on the memory of the given arrays, one per input and
+// one per output blob in order, without copying it: the input blobs are
+// reshaped like their arrays, the output arrays must have the shapes the
+// outputs then take, and the blobs stay bound to the arrays until they are
+// rebound or grow.
+void Net_ForwardInto(Net<Dtype>* net, bp::list inputs, bp::list outputs) {
+  const vector<Blob<Dtype>*>& input_blobs = net->input_blobs();
+  const vector<Blob<Dtype>*>& output_blobs = net->output_blobs();
+  if (bp::len(inputs) != input_blobs.size()) {
+    throw std::runtime_error("expected one array per input blob");
+  }
+  if (bp::len(outputs) != output_blobs.size()) {
+    throw std::runtime_error("expected one array per output blob");
+  }
+  vector<PyArrayObject*> input_arrs(input_blobs.size());
+  bool reshape = false;
+  for (int i = 0; i < input_blobs.size(); ++i) {
+    input_arrs[i] = CheckBindableArray(bp::object(inputs[i]).ptr(),
+        "input array");
+    const vector<int> shape = ArrayShape(input_arrs[i]);
+    if (shape != input_blobs[i]->shape()) {
+      input_blobs[i]->Reshape(shape);
+      reshape = true;
+    }
+  }
+  if (reshape) {
+    net->Reshape();
+  }
+  vector<PyArrayObject*> output_arrs(output_blobs.size());
+  for (int i = 0; i < output_blobs.size(); ++i) {
+    output_arrs[i] = CheckBindableArray(bp::object(outputs[i]).ptr(),
+        "output array");
+    if (ArrayShape(output_arrs[i]) != output_blobs[i]->shape()) {
+      throw std::runtime_error("output array does not have the shape "
+          + output_blobs[i]->shape_string() + " of its blob");
+    }
+  }
+  for (int i = 0; i < input_blobs.size(); ++i) {
+    input_blobs[i]->set_cpu_data(
+        static_cast<Dtype*>(PyArray_DATA(input_arrs[i])));
+  }
+  for (int i = 0; i < output_blobs.size(); ++i) {
+    output_blobs[i]->set_cpu_data(
+        static_cast<Dtype*>(PyArray_DATA(output_arrs[i])));
+  }
+  ScopedGILRelease gil_release;
+  net->Forward();
+  // In GPU mode, bring the outputs back into their arrays.
+  for (int i = 0; i < output_blobs.size(); ++i) {
+    output_blobs[i]->cpu_data();
+  }
+}
+
 void Net_Save(const Net<Dtype>& net, string filename) {
   NetParameter net_param;
   net.ToProto(&net_param, false);
@@ -139,6 +236,16 @@ Solver<Dtype>* GetSolverFromFile(const string& filename) {
   return SolverRegistry<Dtype>::CreateSolver(param);
 }
 
+void Solver_Step(Solver<Dtype>* solver, int iters) {
+  ScopedGILRelease gil_release;
+  solver->Step(iters);
+}
+
+void Solver_Solve(Solver<Dtype>* solver, const char* resume_file = NULL) {
+  ScopedGILRelease gil_release;
+  solver->Solve(resume_file);
+}
+
 struct NdarrayConverterGenerator {
   template <typename T> struct apply;
 };
@@ -207,7 +314,7 @@ bp::object BlobVec_add_blob(bp::tuple args, bp::dict kwargs) {
   return bp::object();
 }
 
-BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(SolveOverloads, Solve, 0, 1);
+BOOST_PYTHON_FUNCTION_OVERLOADS(SolveOverloads, Solver_Solve, 1, 2);
 
 BOOST_PYTHON_MODULE(_caffe) {
   // below, we prepend an underscore to methods that will be replaced
@@ -226,8 +333,9 @@ BOOST_PYTHON_MODULE(_caffe) {
     bp::no_init)
     .def("__init__", bp::make_constructor(&Net_Init))
     .def("__init__", bp::make_constructor(&Net_Init_Load))
-    .def("_forward", &Net<Dtype>::ForwardFromTo)
-    .def("_backward", &Net<Dtype>::BackwardFromTo)
+    .def("_forward", &Net_Forward)
+    .def("_backward", &Net_Backward)
+    .def("_forward_into", &Net_ForwardInto)
     .def("reshape", &Net<Dtype>::Reshape)
     // The cast is to select a particular overload.
     .def("copy_from", static_cast<void (Net<Dtype>::*)(const string)>(
@@ -294,9 +402,8 @@ BOOST_PYTHON_MODULE(_caffe) {
     .add_property("test_nets", bp::make_function(&Solver<Dtype>::test_nets,
           bp::return_internal_reference<>()))
     .add_property("iter", &Solver<Dtype>::iter)
-    .def("solve", static_cast<void (Solver<Dtype>::*)(const char*)>(
-          &Solver<Dtype>::Solve), SolveOverloads())
-    .def("step", &Solver<Dtype>::Step)
+    .def("solve", &Solver_Solve, SolveOverloads())
+    .def("step", &Solver_Step)
     .def("restore", &Solver<Dtype>::Restore)
     .def("snapshot", &Solver<Dtype>::Snapshot);
   bp::register_ptr_to_python<shared_ptr<Solver<Dtype> > >();
@@ -342,6 +449,11 @@ BOOST_PYTHON_MODULE(_caffe) {
   bp::class_<vector<bool> >("BoolVec")
     .def(bp::vector_indexing_suite<vector<bool> >());
 
+  // Python layers take the GIL from the threads running the nets.
+#if PY_VERSION_HEX < 0x03070000
+  PyEval_InitThreads();
+#endif
+
   // boost python expects a void (missing) return value, while import_array
   // returns NULL for python3. import_array1() forces a void return value.
   import_array1();
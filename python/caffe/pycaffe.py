@@ -124,6 +124,38 @@ def _Net_forward(self, blobs=None, start=None, end=None, **kwargs):
     return {out: self.blobs[out].data for out in outputs}
 
 
+def _Net_forward_into(self, outputs, **kwargs):
+    """
+    Forward pass on preallocated arrays, without copies: the input and output
+    blobs are bound to the given arrays, and the GIL is released while the
+    net runs.
+
+    Parameters
+    ----------
+    outputs : {output blob name: ndarray} dict receiving every output.
+    kwargs : Keys are input blob names and values are ndarrays for every
+             input; the input blobs are reshaped like them.
+
+    All arrays must be C-contiguous, writeable float32 ndarrays, and the
+    output arrays must have the shapes of the outputs for these inputs. The
+    blobs stay bound to the arrays after the call, until the next one.
+
+    Returns
+    -------
+    outputs : the dict of output arrays, filled in.
+    """
+    if set(kwargs.keys()) != set(self.inputs):
+        raise Exception('Input blob arguments do not match net inputs.')
+    if set(outputs.keys()) != set(self.outputs):
+        raise Exception('Output arrays do not match net outputs.')
+    inputs = [kwargs[in_] for in_ in self.inputs]
+    output_arrays = [outputs[out] for out in self.outputs]
+    self._forward_into(inputs, output_arrays)
+    # The blobs now use the memory of the arrays: keep them alive.
+    self._bound_arrays = (inputs, output_arrays)
+    return outputs
+
+
 def _Net_backward(self, diffs=None, start=None, end=None, **kwargs):
     """
     Backward pass: prepare diffs and run the net backward.
@@ -313,6 +345,7 @@ Net.blobs = _Net_blobs
 Net.blob_loss_weights = _Net_blob_loss_weights
 Net.params = _Net_params
 Net.forward = _Net_forward
+Net.forward_into = _Net_forward_into
 Net.backward = _Net_backward
 Net.forward_all = _Net_forward_all
 Net.forward_backward_all = _Net_forward_backward_all
@@ -3,6 +3,7 @@ import tempfile
 import os
 import numpy as np
 import six
+import threading
 
 import caffe
 
@@ -79,3 +80,75 @@ class TestNet(unittest.TestCase):
             for i in range(len(self.net.params[name])):
                 self.assertEqual(abs(self.net.params[name][i].data
                     - net2.params[name][i].data).sum(), 0)
+
+
+def input_net_file():
+    """Make a net prototxt with an input blob, returning the name of the
+    (temporary) file."""
+
+    f = tempfile.NamedTemporaryFile(mode='w+', delete=False)
+    f.write("""name: 'inputnet'
+    layer { type: 'Input' name: 'data' top: 'data'
+      input_param { shape { dim: 2 dim: 3 dim: 4 dim: 5 } } }
+    layer { type: 'InnerProduct' name: 'ip' bottom: 'data' top: 'ip'
+      inner_product_param { num_output: 7
+        weight_filler { type: 'gaussian' std: 1 }
+        bias_filler { type: 'gaussian' std: 1 } } }
+    layer { type: 'Softmax' name: 'prob' bottom: 'ip' top: 'prob' }""")
+    f.close()
+    return f.name
+
+
+class TestForwardInto(unittest.TestCase):
+    def setUp(self):
+        net_file = input_net_file()
+        self.net = caffe.Net(net_file, caffe.TEST)
+        os.remove(net_file)
+
+    def test_forward_into(self):
+        data = np.random.randn(2, 3, 4, 5).astype(np.float32)
+        expected = self.net.forward(data=data)['prob'].copy()
+        prob = np.zeros((2, 7), dtype=np.float32)
+        self.net.forward_into({'prob': prob}, data=data)
+        self.assertTrue(np.allclose(prob, expected))
+        # The blobs use the memory of the arrays.
+        self.assertEqual(self.net.blobs['data'].data.ctypes.data,
+                         data.ctypes.data)
+        self.assertEqual(self.net.blobs['prob'].data.ctypes.data,
+                         prob.ctypes.data)
+
+    def test_forward_into_reshape(self):
+        data = np.random.randn(5, 3, 4, 5).astype(np.float32)
+        prob = np.zeros((5, 7), dtype=np.float32)
+        self.net.forward_into({'prob': prob}, data=data)
+        self.assertEqual(list(self.net.blobs['data'].shape), [5, 3, 4, 5])
+        self.assertTrue(np.allclose(prob.sum(axis=1), 1))
+        with self.assertRaises(RuntimeError):
+            self.net.forward_into({'prob': np.zeros((2, 7), np.float32)},
+                                  data=data)
+        with self.assertRaises(RuntimeError):
+            self.net.forward_into({'prob': prob}, data=data.astype(np.float64))
+        with self.assertRaises(RuntimeError):
+            self.net.forward_into({'prob': prob}, data=data[:, :, :, ::2])
+
+    def test_threads(self):
+        """Nets run forward in threads at once give the serial results."""
+        net_file = input_net_file()
+        nets = [caffe.Net(net_file, caffe.TEST) for _ in range(4)]
+        os.remove(net_file)
+        for net in nets[1:]:
+            net.share_with(nets[0])
+        data = [np.random.randn(2, 3, 4, 5).astype(np.float32)
+                for _ in nets]
+        expected = [nets[0].forward(data=d)['prob'].copy() for d in data]
+        probs = [np.zeros((2, 7), dtype=np.float32) for _ in nets]
+        threads = [threading.Thread(target=net.forward_into,
+                                    args=({'prob': prob},),
+                                    kwargs={'data': d})
+                   for net, prob, d in zip(nets, probs, data)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        for prob, exp in zip(probs, expected):
+            self.assertTrue(np.allclose(prob, exp))
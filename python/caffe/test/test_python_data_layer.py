@@ -0,0 +1,70 @@
+import unittest
+import tempfile
+import os
+import numpy as np
+
+import caffe
+
+
+class CountingData(object):
+    """A batch generator counting the batches it generates"""
+
+    def setup(self, top):
+        self.batch_size = int(self.param_str)
+        self.count = 0
+        top[0].reshape(self.batch_size, 2, 3)
+        top[1].reshape(self.batch_size)
+
+    def next_batch(self, top):
+        top[0].data[...] = self.count
+        top[1].data[...] = np.arange(self.batch_size) + self.count
+        self.count += 1
+
+
+class ExceptionData(object):
+    """A batch generator for checking exceptions from Python"""
+
+    def setup(self, top):
+        raise RuntimeError
+
+
+def python_data_net_file(layer, prefetch=3):
+    with tempfile.NamedTemporaryFile(mode='w+', delete=False) as f:
+        f.write("""name: 'pythondatanet'
+        layer { type: 'PythonData' name: 'data' top: 'data' top: 'label'
+          data_param { prefetch: %d }
+          python_param { module: 'test_python_data_layer' layer: '%s'
+                         param_str: '4' } }
+        layer { type: 'Power' name: 'double' bottom: 'data' top: 'double'
+          power_param { scale: 2 } }""" % (prefetch, layer))
+        return f.name
+
+
+@unittest.skipIf('Python' not in caffe.layer_type_list(),
+    'Caffe built without Python layer support')
+class TestPythonDataLayer(unittest.TestCase):
+    def test_forward(self):
+        net_file = python_data_net_file('CountingData')
+        net = caffe.Net(net_file, caffe.TRAIN)
+        os.remove(net_file)
+        self.assertEqual(list(net.blobs['data'].shape), [4, 2, 3])
+        self.assertEqual(list(net.blobs['label'].shape), [4])
+        for i in range(10):
+            net.forward()
+            self.assertTrue(np.all(net.blobs['data'].data == i))
+            self.assertTrue(np.all(net.blobs['double'].data == 2 * i))
+            self.assertTrue(np.all(net.blobs['label'].data
+                                   == np.arange(4) + i))
+
+    def test_delete(self):
+        """The prefetch thread stops although the ring is full"""
+        net_file = python_data_net_file('CountingData', prefetch=1)
+        net = caffe.Net(net_file, caffe.TRAIN)
+        os.remove(net_file)
+        net.forward()
+        del net
+
+    def test_exception(self):
+        net_file = python_data_net_file('ExceptionData')
+        self.assertRaises(RuntimeError, caffe.Net, net_file, caffe.TEST)
+        os.remove(net_file)
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <climits>
 #include <vector>
 
@@ -39,6 +40,8 @@ void Blob<Dtype>::Reshape(const vector<int>& shape) {
     capacity_ = count_;
     data_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
     diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+    if (data_tag_ >= 0) { data_->set_tag(data_tag_); }
+    if (diff_tag_ >= 0) { diff_->set_tag(diff_tag_); }
   }
 }
 
@@ -61,14 +64,14 @@ template <typename Dtype>
 Blob<Dtype>::Blob(const int num, const int channels, const int height,
     const int width)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : capacity_(0), data_tag_(-1), diff_tag_(-1) {
   Reshape(num, channels, height, width);
 }
 
 template <typename Dtype>
 Blob<Dtype>::Blob(const vector<int>& shape)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : capacity_(0), data_tag_(-1), diff_tag_(-1) {
   Reshape(shape);
 }
 
@@ -144,6 +147,16 @@ void Blob<Dtype>::ShareDiff(const Blob& other) {
   diff_ = other.diff();
 }
 
+template <typename Dtype>
+void Blob<Dtype>::UseMemory(const shared_ptr<SyncedMemory>& data,
+                            const shared_ptr<SyncedMemory>& diff) {
+  CHECK_GE(data->size(), count_ * sizeof(Dtype));
+  CHECK_GE(diff->size(), count_ * sizeof(Dtype));
+  data_ = data;
+  diff_ = diff;
+  capacity_ = std::min(data->size(), diff->size()) / sizeof(Dtype);
+}
+
 // The "update" method is used for parameter blobs in a Net, which are stored
 // as Blob<float> or Blob<double> -- hence we do not define it for
 // Blob<int> or Blob<unsigned int>.
@@ -386,6 +399,14 @@ void Blob<Dtype>::scale_diff(Dtype scale_factor) {
   }
 }
 
+template <typename Dtype>
+void Blob<Dtype>::set_memory_tags(int data_tag, int diff_tag) {
+  data_tag_ = data_tag;
+  diff_tag_ = diff_tag;
+  if (data_ && data_tag_ >= 0) { data_->set_tag(data_tag_); }
+  if (diff_ && diff_tag_ >= 0) { diff_->set_tag(diff_tag_); }
+}
+
 template <typename Dtype>
 bool Blob<Dtype>::ShapeEquals(const BlobProto& other) {
   if (other.has_num() || other.has_channels() ||
@@ -5,7 +5,9 @@
 #include <ctime>
 
 #include "caffe/common.hpp"
+#include "caffe/util/cpu_dispatch.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -19,6 +21,48 @@ Caffe& Caffe::Get() {
   return *(thread_instance_.get());
 }
 
+// The thread pool is shared by all threads.
+static boost::mutex thread_pool_mutex_;
+static shared_ptr<ThreadPool> thread_pool_;
+static int num_threads_ = 1;
+
+int Caffe::num_threads() {
+  boost::mutex::scoped_lock lock(thread_pool_mutex_);
+  return num_threads_;
+}
+
+void Caffe::set_num_threads(const int num_threads) {
+  CHECK_GE(num_threads, 0) << "The number of threads cannot be negative.";
+  const int size =
+      num_threads > 0 ? num_threads : ThreadPool::NumAvailableCores();
+  boost::mutex::scoped_lock lock(thread_pool_mutex_);
+  if (size != num_threads_) {
+    num_threads_ = size;
+    // Running jobs keep the previous pool until they are done.
+    thread_pool_.reset();
+  }
+}
+
+shared_ptr<ThreadPool> Caffe::thread_pool() {
+  boost::mutex::scoped_lock lock(thread_pool_mutex_);
+  if (!thread_pool_) {
+    thread_pool_.reset(new ThreadPool(num_threads_));
+  }
+  return thread_pool_;
+}
+
+static Caffe::SIMDLevel simd_level_ = DetectSIMDLevel();
+
+Caffe::SIMDLevel Caffe::simd_level() {
+  return simd_level_;
+}
+
+void Caffe::set_simd_level(const SIMDLevel level) {
+  CHECK_LE(level, DetectSIMDLevel()) << "The CPU does not support "
+      << SIMDLevelName(level) << ".";
+  simd_level_ = level;
+}
+
 // random seeding
 int64_t cluster_seedgen(void) {
   int64_t s, seed, pid;
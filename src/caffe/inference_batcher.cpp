@@ -0,0 +1,197 @@
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <exception>
+#include <vector>
+
+#include "caffe/inference_batcher.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+InferenceBatcher<Dtype>::InferenceBatcher(
+    const shared_ptr<InferenceEngine<Dtype> >& engine, int max_batch_size,
+    int timeout_ms, int num_workers, int max_queue)
+    : engine_(engine), max_batch_size_(max_batch_size),
+      timeout_ms_(timeout_ms), max_queue_(max_queue), mode_(Caffe::mode()),
+      device_(0), stop_(false), num_batches_(0), num_requests_(0) {
+  CHECK_GT(max_batch_size, 0) << "Positive batch size required";
+  CHECK_GE(timeout_ms, 0) << "Non-negative timeout required";
+  CHECK_GT(num_workers, 0) << "Positive number of workers required";
+  CHECK_EQ(engine->net()->num_inputs(), 1)
+      << "Batching requires a net with exactly one input.";
+  input_dim_ = engine->net()->input_blobs()[0]->count(1);
+#ifndef CPU_ONLY
+  if (mode_ == Caffe::GPU) {
+    CUDA_CHECK(cudaGetDevice(&device_));
+  }
+#endif
+  for (int i = 0; i < num_workers; ++i) {
+    executors_.push_back(engine->CreateExecutor());
+  }
+  try {
+    for (int i = 0; i < num_workers; ++i) {
+      workers_.push_back(shared_ptr<boost::thread>(new boost::thread(
+          &InferenceBatcher<Dtype>::WorkerEntry, this, i)));
+    }
+  } catch (std::exception& e) {
+    LOG(FATAL) << "Thread exception: " << e.what();
+  }
+}
+
+template <typename Dtype>
+InferenceBatcher<Dtype>::~InferenceBatcher() {
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stop_ = true;
+  }
+  condition_.notify_all();
+  for (int i = 0; i < workers_.size(); ++i) {
+    try {
+      workers_[i]->join();
+    } catch (std::exception& e) {
+      LOG(FATAL) << "Thread exception: " << e.what();
+    }
+  }
+}
+
+template <typename Dtype>
+boost::unique_future<vector<Dtype> > InferenceBatcher<Dtype>::Submit(
+    const Prepare& prepare) {
+  boost::unique_future<vector<Dtype> > result;
+  Enqueue(prepare, true, &result);
+  return boost::move(result);
+}
+
+template <typename Dtype>
+bool InferenceBatcher<Dtype>::TrySubmit(const Prepare& prepare,
+    boost::unique_future<vector<Dtype> >* result) {
+  return Enqueue(prepare, false, result);
+}
+
+template <typename Dtype>
+bool InferenceBatcher<Dtype>::Enqueue(const Prepare& prepare, bool block,
+    boost::unique_future<vector<Dtype> >* result) {
+  Request request;
+  request.prepare = prepare;
+  request.promise.reset(new boost::promise<vector<Dtype> >());
+  boost::unique_future<vector<Dtype> > future = request.promise->get_future();
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    CHECK(!stop_) << "Submitting to a stopped batcher";
+    while (max_queue_ > 0 && queue_.size() >= max_queue_) {
+      if (!block) {
+        return false;
+      }
+      condition_.wait(lock);
+    }
+    request.arrival = boost::get_system_time();
+    queue_.push_back(request);
+  }
+  condition_.notify_all();
+  *result = boost::move(future);
+  return true;
+}
+
+template <typename Dtype>
+int InferenceBatcher<Dtype>::queue_size() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return queue_.size();
+}
+
+template <typename Dtype>
+int InferenceBatcher<Dtype>::num_batches() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return num_batches_;
+}
+
+template <typename Dtype>
+int InferenceBatcher<Dtype>::num_requests() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return num_requests_;
+}
+
+template <typename Dtype>
+void InferenceBatcher<Dtype>::WorkerEntry(int worker) {
+#ifndef CPU_ONLY
+  if (mode_ == Caffe::GPU) {
+    CUDA_CHECK(cudaSetDevice(device_));
+  }
+#endif
+  Caffe::set_mode(mode_);
+  vector<Request> batch;
+  while (NextBatch(&batch)) {
+    RunBatch(executors_[worker].get(), batch);
+  }
+}
+
+template <typename Dtype>
+bool InferenceBatcher<Dtype>::NextBatch(vector<Request>* batch) {
+  boost::mutex::scoped_lock lock(mutex_);
+  // Another worker may take the requests waited for, hence the loop.
+  while (true) {
+    while (queue_.empty() && !stop_) {
+      condition_.wait(lock);
+    }
+    if (queue_.empty()) {
+      return false;
+    }
+    const boost::system_time deadline =
+        queue_.front().arrival + boost::posix_time::milliseconds(timeout_ms_);
+    while (queue_.size() < max_batch_size_ && !stop_ &&
+        boost::get_system_time() < deadline) {
+      condition_.timed_wait(lock, deadline);
+    }
+    if (!queue_.empty()) {
+      break;
+    }
+  }
+  const int size = std::min<int>(queue_.size(), max_batch_size_);
+  batch->assign(queue_.begin(), queue_.begin() + size);
+  queue_.erase(queue_.begin(), queue_.begin() + size);
+  ++num_batches_;
+  num_requests_ += size;
+  lock.unlock();
+  condition_.notify_all();
+  return true;
+}
+
+template <typename Dtype>
+void InferenceBatcher<Dtype>::RunBatch(Net<Dtype>* net,
+    const vector<Request>& batch) {
+  Blob<Dtype>* input = net->input_blobs()[0];
+  vector<int> shape = input->shape();
+  shape[0] = batch.size();
+  input->Reshape(shape);
+  net->Reshape();
+  Caffe::thread_pool()->Run(batch.size(),
+      boost::bind(&InferenceBatcher<Dtype>::PrepareItem, this, &batch,
+                  input->mutable_cpu_data(), _1));
+  net->Forward();
+  const vector<Blob<Dtype>*>& outputs = net->output_blobs();
+  int output_dim = 0;
+  for (int j = 0; j < outputs.size(); ++j) {
+    output_dim += outputs[j]->count(1);
+  }
+  for (int i = 0; i < batch.size(); ++i) {
+    vector<Dtype> output(output_dim);
+    Dtype* output_data = &output[0];
+    for (int j = 0; j < outputs.size(); ++j) {
+      const int dim = outputs[j]->count(1);
+      caffe_copy(dim, outputs[j]->cpu_data() + i * dim, output_data);
+      output_data += dim;
+    }
+    batch[i].promise->set_value(output);
+  }
+}
+
+template <typename Dtype>
+void InferenceBatcher<Dtype>::PrepareItem(const vector<Request>* batch,
+    Dtype* input_data, int i) {
+  (*batch)[i].prepare(input_data + i * input_dim_);
+}
+
+INSTANTIATE_CLASS(InferenceBatcher);
+
+}  // namespace caffe
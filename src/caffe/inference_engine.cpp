@@ -0,0 +1,59 @@
+#include <string>
+#include <vector>
+
+#include "caffe/inference_engine.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+InferenceEngine<Dtype>::InferenceEngine(const string& param_file,
+    const string& trained_filename) {
+  NetParameter param;
+  ReadNetParamsFromTextFileOrDie(param_file, &param);
+  Init(param, trained_filename);
+}
+
+template <typename Dtype>
+InferenceEngine<Dtype>::InferenceEngine(const NetParameter& param,
+    const string& trained_filename) {
+  Init(param, trained_filename);
+}
+
+template <typename Dtype>
+void InferenceEngine<Dtype>::Init(const NetParameter& param,
+    const string& trained_filename) {
+  param_.CopyFrom(param);
+  param_.mutable_state()->set_phase(TEST);
+  net_.reset(new Net<Dtype>(param_));
+  if (!trained_filename.empty()) {
+    net_->CopyTrainedLayersFrom(trained_filename);
+  }
+  // Bring the weights to the current device now: executors only read them,
+  // and a first read from several threads at once would copy them
+  // concurrently.
+  const vector<shared_ptr<Blob<Dtype> > >& params = net_->params();
+  for (int i = 0; i < params.size(); ++i) {
+    switch (Caffe::mode()) {
+    case Caffe::CPU:
+      params[i]->cpu_data();
+      break;
+    case Caffe::GPU:
+#ifndef CPU_ONLY
+      params[i]->gpu_data();
+#else
+      NO_GPU;
+#endif
+      break;
+    }
+  }
+}
+
+template <typename Dtype>
+shared_ptr<Net<Dtype> > InferenceEngine<Dtype>::CreateExecutor() const {
+  return shared_ptr<Net<Dtype> >(new Net<Dtype>(param_, *net_));
+}
+
+INSTANTIATE_CLASS(InferenceEngine);
+
+}  // namespace caffe
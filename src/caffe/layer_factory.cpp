@@ -28,6 +28,7 @@
 #endif
 
 #ifdef WITH_PYTHON_LAYER
+#include "caffe/layers/python_data_layer.hpp"
 #include "caffe/layers/python_layer.hpp"
 #endif
 
@@ -50,7 +51,7 @@ shared_ptr<Layer<Dtype> > GetConvolutionLayer(
   if (engine == ConvolutionParameter_Engine_DEFAULT) {
     engine = ConvolutionParameter_Engine_CAFFE;
 #ifdef USE_CUDNN
-    if (!use_dilation) {
+    if (!use_dilation && !conv_param.fuse_relu()) {
       engine = ConvolutionParameter_Engine_CUDNN;
     }
 #endif
@@ -63,6 +64,10 @@ shared_ptr<Layer<Dtype> > GetConvolutionLayer(
       LOG(FATAL) << "CuDNN doesn't support the dilated convolution at Layer "
                  << param.name();
     }
+    if (conv_param.fuse_relu()) {
+      LOG(FATAL) << "CuDNN doesn't support the fused ReLU at Layer "
+                 << param.name();
+    }
     return shared_ptr<Layer<Dtype> >(new CuDNNConvolutionLayer<Dtype>(param));
 #endif
   } else {
@@ -239,9 +244,23 @@ shared_ptr<Layer<Dtype> > GetTanHLayer(const LayerParameter& param) {
 REGISTER_LAYER_CREATOR(TanH, GetTanHLayer);
 
 #ifdef WITH_PYTHON_LAYER
+// Starts the interpreter if Caffe embeds it, as in the caffe tool, and leaves
+// the GIL released: Python layers take it while they run, from whichever
+// thread runs them.
+static void InitPython() {
+  if (!Py_IsInitialized()) {
+    Py_Initialize();
+#if PY_VERSION_HEX < 0x03070000
+    PyEval_InitThreads();
+#endif
+    PyEval_SaveThread();
+  }
+}
+
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetPythonLayer(const LayerParameter& param) {
-  Py_Initialize();
+  InitPython();
+  AcquireGIL gil;
   try {
     bp::object module = bp::import(param.python_param().module().c_str());
     bp::object layer = module.attr(param.python_param().layer().c_str())(param);
@@ -253,6 +272,25 @@ shared_ptr<Layer<Dtype> > GetPythonLayer(const LayerParameter& param) {
 }
 
 REGISTER_LAYER_CREATOR(Python, GetPythonLayer);
+
+template <typename Dtype>
+shared_ptr<Layer<Dtype> > GetPythonDataLayer(const LayerParameter& param) {
+  InitPython();
+  AcquireGIL gil;
+  try {
+    // The tops are passed to the generator with the converters of pycaffe.
+    bp::import("caffe");
+    bp::object module = bp::import(param.python_param().module().c_str());
+    bp::object generator = module.attr(param.python_param().layer().c_str())();
+    return shared_ptr<Layer<Dtype> >(
+        new PythonDataLayer<Dtype>(param, generator));
+  } catch (bp::error_already_set) {
+    PyErr_Print();
+    throw;
+  }
+}
+
+REGISTER_LAYER_CREATOR(PythonData, GetPythonDataLayer);
 #endif
 
 // Layers that use their constructor as their default creator should be
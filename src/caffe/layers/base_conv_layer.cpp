@@ -3,6 +3,7 @@
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/base_conv_layer.hpp"
+#include "caffe/util/grouped_conv.hpp"
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/math_functions.hpp"
 
@@ -11,6 +12,9 @@ namespace caffe {
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+  // The column buffer is accounted apart from the rest of the workspace.
+  const int col_tag = SyncedMemory::Tag(this->layer_param_.name() + "/col");
+  col_buffer_.set_memory_tags(col_tag, col_tag);
   // Configure the kernel size, padding, stride, and inputs.
   ConvolutionParameter conv_param = this->layer_param_.convolution_param();
   force_nd_im2col_ = conv_param.force_nd_im2col();
@@ -129,6 +133,9 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     conv_out_channels_ = num_output_;
     conv_in_channels_ = channels_;
   }
+  // Many groups of few channels, e.g. depthwise, run direct on the CPU.
+  grouped_direct_ = group_ > 1 && num_spatial_axes_ == 2 && !force_nd_im2col_
+      && conv_in_channels_ / group_ <= kGroupedConvMaxChannels;
   // Handle the parameters: weights and biases.
   // - blobs_[0] holds the filter weights
   // - blobs_[1] holds the biases (optional)
@@ -239,6 +246,27 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     }
   }
   col_buffer_.Reshape(col_buffer_shape_);
+  if (grouped_direct_) {
+    const int* kernel_shape_data = kernel_shape_.cpu_data();
+    const int* pad_data = pad_.cpu_data();
+    const int* stride_data = stride_.cpu_data();
+    const int* dilation_data = dilation_.cpu_data();
+    grouped_geometry_.groups = group_;
+    grouped_geometry_.channels = conv_in_channels_;
+    grouped_geometry_.num_output = conv_out_channels_;
+    grouped_geometry_.height = conv_input_shape_data[1];
+    grouped_geometry_.width = conv_input_shape_data[2];
+    grouped_geometry_.output_h = col_buffer_shape_[1];
+    grouped_geometry_.output_w = col_buffer_shape_[2];
+    grouped_geometry_.kernel_h = kernel_shape_data[0];
+    grouped_geometry_.kernel_w = kernel_shape_data[1];
+    grouped_geometry_.pad_h = pad_data[0];
+    grouped_geometry_.pad_w = pad_data[1];
+    grouped_geometry_.stride_h = stride_data[0];
+    grouped_geometry_.stride_w = stride_data[1];
+    grouped_geometry_.dilation_h = dilation_data[0];
+    grouped_geometry_.dilation_w = dilation_data[1];
+  }
   bottom_dim_ = bottom[0]->count(channel_axis_);
   top_dim_ = top[0]->count(channel_axis_);
   num_kernels_im2col_ = conv_in_channels_ * conv_out_spatial_dim_;
@@ -256,6 +284,10 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
     const Dtype* weights, Dtype* output, bool skip_im2col) {
+  if (grouped_direct_) {
+    grouped_conv_forward_cpu(grouped_geometry_, input, weights, output);
+    return;
+  }
   const Dtype* col_buff = input;
   if (!is_1x1_) {
     if (!skip_im2col) {
@@ -263,6 +295,20 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
     }
     col_buff = col_buffer_.cpu_data();
   }
+  // Small outputs at test time: the weights packed once, until they change,
+  // and shared by all the nets sharing them.
+  if (this->phase_ == TEST && conv_out_spatial_dim_ <= kPackedGemmMaxRows
+      && weights == this->blobs_[0]->cpu_data()) {
+    for (int g = 0; g < group_; ++g) {
+      shared_ptr<const PackedMatrix<Dtype> > packed_weights =
+          caffe_cpu_packed<Dtype>(this->blobs_[0]->data().get(), CblasTrans,
+          kernel_dim_, conv_out_channels_ / group_, weight_offset_ * g);
+      caffe_cpu_gemm_packed_a<Dtype>(*packed_weights, CblasNoTrans,
+          conv_out_spatial_dim_, (Dtype)1., col_buff + col_offset_ * g,
+          (Dtype)0., output + output_offset_ * g);
+    }
+    return;
+  }
   for (int g = 0; g < group_; ++g) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
         group_, conv_out_spatial_dim_, kernel_dim_,
@@ -282,6 +328,10 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
     const Dtype* weights, Dtype* input) {
+  if (grouped_direct_) {
+    grouped_conv_backward_cpu(grouped_geometry_, output, weights, input);
+    return;
+  }
   Dtype* col_buff = col_buffer_.mutable_cpu_data();
   if (is_1x1_) {
     col_buff = input;
@@ -300,6 +350,10 @@ void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::weight_cpu_gemm(const Dtype* input,
     const Dtype* output, Dtype* weights) {
+  if (grouped_direct_) {
+    grouped_conv_weight_cpu(grouped_geometry_, input, output, weights);
+    return;
+  }
   const Dtype* col_buff = input;
   if (!is_1x1_) {
     conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
@@ -7,7 +7,9 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
 #include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/trace.hpp"
 
 namespace caffe {
 
@@ -32,13 +34,22 @@ void BaseDataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   DataLayerSetUp(bottom, top);
 }
 
+template <typename Dtype>
+const int BasePrefetchingDataLayer<Dtype>::kDefaultPrefetch;
+
 template <typename Dtype>
 BasePrefetchingDataLayer<Dtype>::BasePrefetchingDataLayer(
     const LayerParameter& param)
     : BaseDataLayer<Dtype>(param),
-      prefetch_free_(), prefetch_full_() {
-  for (int i = 0; i < PREFETCH_COUNT; ++i) {
-    prefetch_free_.push(&prefetch_[i]);
+      prefetch_(param.data_param().has_prefetch() ?
+          param.data_param().prefetch() : kDefaultPrefetch),
+      prefetch_free_(), prefetch_full_(),
+      max_prefetch_(param.data_param().max_prefetch()), ring_filled_(false),
+      forward_count_(0), empty_count_(0), depth_sum_(0), wait_time_(0) {
+  CHECK_GT(prefetch_.size(), 0) << "Positive prefetch required";
+  for (int i = 0; i < prefetch_.size(); ++i) {
+    prefetch_[i].reset(new Batch<Dtype>());
+    prefetch_free_.push(prefetch_[i].get());
   }
 }
 
@@ -50,18 +61,18 @@ void BasePrefetchingDataLayer<Dtype>::LayerSetUp(
   // calls so that the prefetch thread does not accidentally make simultaneous
   // cudaMalloc calls when the main thread is running. In some GPUs this
   // seems to cause failures if we do not so.
-  for (int i = 0; i < PREFETCH_COUNT; ++i) {
-    prefetch_[i].data_.mutable_cpu_data();
+  for (int i = 0; i < prefetch_.size(); ++i) {
+    prefetch_[i]->data_.mutable_cpu_data();
     if (this->output_labels_) {
-      prefetch_[i].label_.mutable_cpu_data();
+      prefetch_[i]->label_.mutable_cpu_data();
     }
   }
 #ifndef CPU_ONLY
   if (Caffe::mode() == Caffe::GPU) {
-    for (int i = 0; i < PREFETCH_COUNT; ++i) {
-      prefetch_[i].data_.mutable_gpu_data();
+    for (int i = 0; i < prefetch_.size(); ++i) {
+      prefetch_[i]->data_.mutable_gpu_data();
       if (this->output_labels_) {
-        prefetch_[i].label_.mutable_gpu_data();
+        prefetch_[i]->label_.mutable_gpu_data();
       }
     }
   }
@@ -81,9 +92,13 @@ void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
   }
 #endif
 
+  // The batches grown by load_batch count as the layer's workspace.
+  MemoryTagScope memory_tag(
+      SyncedMemory::Tag(this->layer_param_.name() + "/workspace"));
   try {
     while (!must_stop()) {
       Batch<Dtype>* batch = prefetch_free_.pop();
+      TraceScope trace("prefetch", this->layer_param_.name().c_str());
       load_batch(batch);
 #ifndef CPU_ONLY
       if (Caffe::mode() == Caffe::GPU) {
@@ -103,10 +118,72 @@ void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
 #endif
 }
 
+template <typename Dtype>
+Batch<Dtype>* BasePrefetchingDataLayer<Dtype>::NextBatch() {
+  // The net holds no batch here, so a full queue means that the prefetch
+  // thread is waiting for it.
+  const int depth = prefetch_full_.size();
+  if (depth == prefetch_.size()) {
+    ring_filled_ = true;
+  }
+  CPUTimer timer;
+  timer.Start();
+  Batch<Dtype>* batch = prefetch_full_.pop("Data layer prefetch queue empty");
+  wait_time_ += timer.MicroSeconds();
+  ++forward_count_;
+  depth_sum_ += depth;
+  if (depth == 0) {
+    ++empty_count_;
+    // The prefetch thread keeps up on average, but not through its bursts:
+    // let it run further ahead.
+    if (ring_filled_ && prefetch_.size() < max_prefetch_) {
+      AddBatch(*batch);
+      ring_filled_ = false;
+      LOG(INFO) << this->layer_param_.name() << " prefetches up to "
+                << prefetch_.size() << " batches";
+    }
+  }
+  if (forward_count_ == kStatsInterval) {
+    LOG(INFO) << this->layer_param_.name() << " prefetch queue: mean depth "
+              << static_cast<float>(depth_sum_) / forward_count_ << " of "
+              << prefetch_.size() << ", empty at " << empty_count_ << " of "
+              << forward_count_ << " forwards, waited "
+              << wait_time_ / 1000 << " ms.";
+    forward_count_ = 0;
+    empty_count_ = 0;
+    depth_sum_ = 0;
+    wait_time_ = 0;
+  }
+  return batch;
+}
+
+template <typename Dtype>
+void BasePrefetchingDataLayer<Dtype>::AddBatch(const Batch<Dtype>& batch) {
+  // Allocate on this thread, as in LayerSetUp, so that the host memory is
+  // pinned in GPU mode.
+  shared_ptr<Batch<Dtype> > new_batch(new Batch<Dtype>());
+  new_batch->data_.ReshapeLike(batch.data_);
+  new_batch->data_.mutable_cpu_data();
+  if (this->output_labels_) {
+    new_batch->label_.ReshapeLike(batch.label_);
+    new_batch->label_.mutable_cpu_data();
+  }
+#ifndef CPU_ONLY
+  if (Caffe::mode() == Caffe::GPU) {
+    new_batch->data_.mutable_gpu_data();
+    if (this->output_labels_) {
+      new_batch->label_.mutable_gpu_data();
+    }
+  }
+#endif
+  prefetch_.push_back(new_batch);
+  prefetch_free_.push(new_batch.get());
+}
+
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  Batch<Dtype>* batch = prefetch_full_.pop("Data layer prefetch queue empty");
+  Batch<Dtype>* batch = NextBatch();
   // Reshape to loaded data.
   top[0]->ReshapeLike(batch->data_);
   // Copy the data
@@ -1,8 +1,10 @@
+#include <boost/bind.hpp>
 #include <algorithm>
 #include <vector>
 
 #include "caffe/layers/batch_norm_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -71,6 +73,60 @@ void BatchNormLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+// The mean and the biased variance of the channels [begin, end). Each chunk
+// of spatial_dim values of a channel gets its own mean and sum of squared
+// deviations while in cache, which merge into those of the chunks before it
+// as in the parallel form of Welford's algorithm (Chan et al.), so that the
+// input is read from memory once.
+template <typename Dtype>
+static void batch_norm_stats(const int begin, const int end, const int num,
+    const int channels, const int spatial_dim, const Dtype* bottom_data,
+    Dtype* mean, Dtype* variance) {
+  for (int c = begin; c < end; ++c) {
+    Dtype mean_c = 0;
+    Dtype m2 = 0;
+    for (int n = 0; n < num; ++n) {
+      const Dtype* x = bottom_data + (n * channels + c) * spatial_dim;
+      Dtype sum = 0;
+      for (int i = 0; i < spatial_dim; ++i) {
+        sum += x[i];
+      }
+      const Dtype chunk_mean = sum / spatial_dim;
+      Dtype chunk_m2 = 0;
+      for (int i = 0; i < spatial_dim; ++i) {
+        const Dtype d = x[i] - chunk_mean;
+        chunk_m2 += d * d;
+      }
+      const Dtype delta = chunk_mean - mean_c;
+      const Dtype weight = Dtype(1) / (n + 1);
+      mean_c += delta * weight;
+      m2 += chunk_m2 + delta * delta * spatial_dim * n * weight;
+    }
+    mean[c] = mean_c;
+    variance[c] = m2 / (num * spatial_dim);
+  }
+}
+
+// Y = (X - mean) / std over the (num, channel) chunks [begin, end), also into
+// x_norm unless it is NULL.
+template <typename Dtype>
+static void batch_norm_normalize(const int begin, const int end,
+    const int channels, const int spatial_dim, const Dtype* bottom_data,
+    const Dtype* mean, const Dtype* std, Dtype* top_data, Dtype* x_norm) {
+  for (int nc = begin; nc < end; ++nc) {
+    const Dtype mean_c = mean[nc % channels];
+    const Dtype inv_std = Dtype(1) / std[nc % channels];
+    const Dtype* x = bottom_data + nc * spatial_dim;
+    Dtype* y = top_data + nc * spatial_dim;
+    for (int i = 0; i < spatial_dim; ++i) {
+      y[i] = (x[i] - mean_c) * inv_std;
+    }
+    if (x_norm) {
+      caffe_copy(spatial_dim, y, x_norm + nc * spatial_dim);
+    }
+  }
+}
+
 template <typename Dtype>
 void BatchNormLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
@@ -79,10 +135,6 @@ void BatchNormLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   int num = bottom[0]->shape(0);
   int spatial_dim = bottom[0]->count()/(bottom[0]->shape(0)*channels_);
 
-  if (bottom[0] != top[0]) {
-    caffe_copy(bottom[0]->count(), bottom_data, top_data);
-  }
-
   if (use_global_stats_) {
     // use the stored mean/variance estimates.
     const Dtype scale_factor = this->blobs_[2]->cpu_data()[0] == 0 ?
@@ -92,35 +144,11 @@ void BatchNormLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     caffe_cpu_scale(variance_.count(), scale_factor,
         this->blobs_[1]->cpu_data(), variance_.mutable_cpu_data());
   } else {
-    // compute mean
-    caffe_cpu_gemv<Dtype>(CblasNoTrans, channels_ * num, spatial_dim,
-        1. / (num * spatial_dim), bottom_data,
-        spatial_sum_multiplier_.cpu_data(), 0.,
-        num_by_chans_.mutable_cpu_data());
-    caffe_cpu_gemv<Dtype>(CblasTrans, num, channels_, 1.,
-        num_by_chans_.cpu_data(), batch_sum_multiplier_.cpu_data(), 0.,
-        mean_.mutable_cpu_data());
-  }
-
-  // subtract mean
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, channels_, 1, 1,
-      batch_sum_multiplier_.cpu_data(), mean_.cpu_data(), 0.,
-      num_by_chans_.mutable_cpu_data());
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels_ * num,
-      spatial_dim, 1, -1, num_by_chans_.cpu_data(),
-      spatial_sum_multiplier_.cpu_data(), 1., top_data);
-
-  if (!use_global_stats_) {
-    // compute variance using var(X) = E((X-EX)^2)
-    caffe_powx(top[0]->count(), top_data, Dtype(2),
-        temp_.mutable_cpu_data());  // (X-EX)^2
-    caffe_cpu_gemv<Dtype>(CblasNoTrans, channels_ * num, spatial_dim,
-        1. / (num * spatial_dim), temp_.cpu_data(),
-        spatial_sum_multiplier_.cpu_data(), 0.,
-        num_by_chans_.mutable_cpu_data());
-    caffe_cpu_gemv<Dtype>(CblasTrans, num, channels_, 1.,
-        num_by_chans_.cpu_data(), batch_sum_multiplier_.cpu_data(), 0.,
-        variance_.mutable_cpu_data());  // E((X_EX)^2)
+    // compute mean and variance
+    parallel_for(channels_, boost::bind(&batch_norm_stats<Dtype>, _1, _2,
+        num, channels_, spatial_dim, bottom_data, mean_.mutable_cpu_data(),
+        variance_.mutable_cpu_data()),
+        std::max(16384 / (num * spatial_dim), 1));
 
     // compute and save moving average
     this->blobs_[2]->mutable_cpu_data()[0] *= moving_average_fraction_;
@@ -139,39 +167,93 @@ void BatchNormLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   caffe_powx(variance_.count(), variance_.cpu_data(), Dtype(0.5),
              variance_.mutable_cpu_data());
 
-  // replicate variance to input size
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, channels_, 1, 1,
-      batch_sum_multiplier_.cpu_data(), variance_.cpu_data(), 0.,
-      num_by_chans_.mutable_cpu_data());
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels_ * num,
-      spatial_dim, 1, 1., num_by_chans_.cpu_data(),
-      spatial_sum_multiplier_.cpu_data(), 0., temp_.mutable_cpu_data());
-  caffe_div(temp_.count(), top_data, temp_.cpu_data(), top_data);
-  // TODO(cdoersch): The caching is only needed because later in-place layers
-  //                 might clobber the data.  Can we skip this if they won't?
-  caffe_copy(x_norm_.count(), top_data,
-      x_norm_.mutable_cpu_data());
+  // Out of place, backward normalizes the input again. In place, later
+  // in-place layers might clobber the top, so backward reads a copy.
+  Dtype* x_norm = bottom[0] == top[0] ? x_norm_.mutable_cpu_data() : NULL;
+  parallel_for(num * channels_, boost::bind(&batch_norm_normalize<Dtype>, _1,
+      _2, channels_, spatial_dim, bottom_data, mean_.cpu_data(),
+      variance_.cpu_data(), top_data, x_norm),
+      std::max(16384 / spatial_dim, 1));
+}
+
+// Per channel c in [begin, end), sum(dE/dY) to sums[c] and
+// sum(dE/dY \cdot (source - shift)) to sums[channels + c], with a shift of 0
+// when shift is NULL.
+template <typename Dtype>
+static void batch_norm_backward_sums(const int begin, const int end,
+    const int num, const int channels, const int spatial_dim,
+    const Dtype* top_diff, const Dtype* source, const Dtype* shift,
+    Dtype* sums) {
+  for (int c = begin; c < end; ++c) {
+    const Dtype shift_c = shift ? shift[c] : Dtype(0);
+    Dtype dy_total = 0;
+    Dtype dy_y_total = 0;
+    for (int n = 0; n < num; ++n) {
+      const int offset = (n * channels + c) * spatial_dim;
+      const Dtype* dy = top_diff + offset;
+      const Dtype* y = source + offset;
+      Dtype dy_sum = 0;
+      Dtype dy_y_sum = 0;
+      for (int i = 0; i < spatial_dim; ++i) {
+        dy_sum += dy[i];
+        dy_y_sum += dy[i] * (y[i] - shift_c);
+      }
+      dy_total += dy_sum;
+      dy_y_total += dy_y_sum;
+    }
+    sums[c] = dy_total;
+    sums[channels + c] = dy_y_total;
+  }
+}
+
+// dE/dX = a dE/dY + b (source - shift) + d over the (num, channel) chunks
+// [begin, end), with the per-channel a, b, shift and d one after the other in
+// coeffs. The source is not read when it is NULL.
+template <typename Dtype>
+static void batch_norm_backward(const int begin, const int end,
+    const int channels, const int spatial_dim, const Dtype* top_diff,
+    const Dtype* source, const Dtype* coeffs, Dtype* bottom_diff) {
+  for (int nc = begin; nc < end; ++nc) {
+    const int c = nc % channels;
+    const Dtype a = coeffs[c];
+    const Dtype* dy = top_diff + nc * spatial_dim;
+    Dtype* dx = bottom_diff + nc * spatial_dim;
+    if (!source) {
+      for (int i = 0; i < spatial_dim; ++i) {
+        dx[i] = a * dy[i];
+      }
+      continue;
+    }
+    const Dtype b = coeffs[channels + c];
+    const Dtype shift = coeffs[2 * channels + c];
+    const Dtype d = coeffs[3 * channels + c];
+    const Dtype* y = source + nc * spatial_dim;
+    for (int i = 0; i < spatial_dim; ++i) {
+      dx[i] = a * dy[i] + b * (y[i] - shift) + d;
+    }
+  }
 }
 
 template <typename Dtype>
 void BatchNormLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
-  const Dtype* top_diff;
-  if (bottom[0] != top[0]) {
-    top_diff = top[0]->cpu_diff();
-  } else {
-    caffe_copy(x_norm_.count(), top[0]->cpu_diff(), x_norm_.mutable_cpu_diff());
-    top_diff = x_norm_.cpu_diff();
-  }
+  const Dtype* top_diff = top[0]->cpu_diff();
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  int num = bottom[0]->shape()[0];
+  int spatial_dim = bottom[0]->count()/(bottom[0]->shape(0)*channels_);
+  const Dtype* std = variance_.cpu_data();
+  vector<Dtype> coeffs(4 * channels_);
   if (use_global_stats_) {
-    caffe_div(temp_.count(), top_diff, temp_.cpu_data(), bottom_diff);
+    for (int c = 0; c < channels_; ++c) {
+      coeffs[c] = 1 / std[c];
+    }
+    parallel_for(num * channels_, boost::bind(&batch_norm_backward<Dtype>,
+        _1, _2, channels_, spatial_dim, top_diff,
+        static_cast<const Dtype*>(NULL), &coeffs[0], bottom_diff),
+        std::max(16384 / spatial_dim, 1));
     return;
   }
-  const Dtype* top_data = x_norm_.cpu_data();
-  int num = bottom[0]->shape()[0];
-  int spatial_dim = bottom[0]->count()/(bottom[0]->shape(0)*channels_);
   // if Y = (X-mean(X))/(sqrt(var(X)+eps)), then
   //
   // dE(Y)/dX =
@@ -183,50 +265,32 @@ void BatchNormLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   // along all dimensions except the channels dimension.  In the above
   // equation, the operations allow for expansion (i.e. broadcast) along all
   // dimensions except the channels dimension where required.
-
-  // sum(dE/dY \cdot Y)
-  caffe_mul(temp_.count(), top_data, top_diff, bottom_diff);
-  caffe_cpu_gemv<Dtype>(CblasNoTrans, channels_ * num, spatial_dim, 1.,
-      bottom_diff, spatial_sum_multiplier_.cpu_data(), 0.,
-      num_by_chans_.mutable_cpu_data());
-  caffe_cpu_gemv<Dtype>(CblasTrans, num, channels_, 1.,
-      num_by_chans_.cpu_data(), batch_sum_multiplier_.cpu_data(), 0.,
-      mean_.mutable_cpu_data());
-
-  // reshape (broadcast) the above
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, channels_, 1, 1,
-      batch_sum_multiplier_.cpu_data(), mean_.cpu_data(), 0.,
-      num_by_chans_.mutable_cpu_data());
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels_ * num,
-      spatial_dim, 1, 1., num_by_chans_.cpu_data(),
-      spatial_sum_multiplier_.cpu_data(), 0., bottom_diff);
-
-  // sum(dE/dY \cdot Y) \cdot Y
-  caffe_mul(temp_.count(), top_data, bottom_diff, bottom_diff);
-
-  // sum(dE/dY)-sum(dE/dY \cdot Y) \cdot Y
-  caffe_cpu_gemv<Dtype>(CblasNoTrans, channels_ * num, spatial_dim, 1.,
-      top_diff, spatial_sum_multiplier_.cpu_data(), 0.,
-      num_by_chans_.mutable_cpu_data());
-  caffe_cpu_gemv<Dtype>(CblasTrans, num, channels_, 1.,
-      num_by_chans_.cpu_data(), batch_sum_multiplier_.cpu_data(), 0.,
-      mean_.mutable_cpu_data());
-  // reshape (broadcast) the above to make
-  // sum(dE/dY)-sum(dE/dY \cdot Y) \cdot Y
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, channels_, 1, 1,
-      batch_sum_multiplier_.cpu_data(), mean_.cpu_data(), 0.,
-      num_by_chans_.mutable_cpu_data());
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num * channels_,
-      spatial_dim, 1, 1., num_by_chans_.cpu_data(),
-      spatial_sum_multiplier_.cpu_data(), 1., bottom_diff);
-
-  // dE/dY - mean(dE/dY)-mean(dE/dY \cdot Y) \cdot Y
-  caffe_cpu_axpby(temp_.count(), Dtype(1), top_diff,
-      Dtype(-1. / (num * spatial_dim)), bottom_diff);
-
-  // note: temp_ still contains sqrt(var(X)+eps), computed during the forward
-  // pass.
-  caffe_div(temp_.count(), bottom_diff, temp_.cpu_data(), bottom_diff);
+  //
+  // Y is the copy of the top in place. Out of place, it is the input
+  // normalized again, as (X - mean(X)) / sqrt(var(X) + eps).
+  const bool in_place = bottom[0] == top[0];
+  const Dtype* source =
+      in_place ? x_norm_.cpu_data() : bottom[0]->cpu_data();
+  const Dtype* shift = in_place ? NULL : mean_.cpu_data();
+  vector<Dtype> sums(2 * channels_);
+  parallel_for(channels_, boost::bind(&batch_norm_backward_sums<Dtype>, _1,
+      _2, num, channels_, spatial_dim, top_diff, source, shift, &sums[0]),
+      std::max(16384 / (num * spatial_dim), 1));
+  const Dtype m = num * spatial_dim;
+  for (int c = 0; c < channels_; ++c) {
+    const Dtype inv_std = 1 / std[c];
+    // Y = scale (source - shift)
+    const Dtype scale = in_place ? Dtype(1) : inv_std;
+    const Dtype mean_dy = sums[c] / m;
+    const Dtype mean_dy_y = sums[channels_ + c] * scale / m;
+    coeffs[c] = inv_std;
+    coeffs[channels_ + c] = -mean_dy_y * scale * inv_std;
+    coeffs[2 * channels_ + c] = shift ? shift[c] : Dtype(0);
+    coeffs[3 * channels_ + c] = -mean_dy * inv_std;
+  }
+  parallel_for(num * channels_, boost::bind(&batch_norm_backward<Dtype>, _1,
+      _2, channels_, spatial_dim, top_diff, source, &coeffs[0], bottom_diff),
+      std::max(16384 / spatial_dim, 1));
 }
 
 
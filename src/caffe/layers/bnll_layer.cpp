@@ -1,23 +1,42 @@
+#include <boost/bind.hpp>
 #include <algorithm>
 #include <vector>
 
 #include "caffe/layers/bnll_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
 const float kBNLL_THRESHOLD = 50.;
 
+template <typename Dtype>
+static void bnll_forward(const int begin, const int end,
+    const Dtype* bottom_data, Dtype* top_data) {
+  for (int i = begin; i < end; ++i) {
+    top_data[i] = bottom_data[i] > 0 ?
+        bottom_data[i] + log(1. + exp(-bottom_data[i])) :
+        log(1. + exp(bottom_data[i]));
+  }
+}
+
+template <typename Dtype>
+static void bnll_backward(const int begin, const int end,
+    const Dtype* bottom_data, const Dtype* top_diff, Dtype* bottom_diff) {
+  Dtype expval;
+  for (int i = begin; i < end; ++i) {
+    expval = exp(std::min(bottom_data[i], Dtype(kBNLL_THRESHOLD)));
+    bottom_diff[i] = top_diff[i] * expval / (expval + 1.);
+  }
+}
+
 template <typename Dtype>
 void BNLLLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = bottom_data[i] > 0 ?
-        bottom_data[i] + log(1. + exp(-bottom_data[i])) :
-        log(1. + exp(bottom_data[i]));
-  }
+  parallel_for(count, boost::bind(&bnll_forward<Dtype>, _1, _2,
+      bottom_data, top_data));
 }
 
 template <typename Dtype>
@@ -29,11 +48,8 @@ void BNLLLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const Dtype* top_diff = top[0]->cpu_diff();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const int count = bottom[0]->count();
-    Dtype expval;
-    for (int i = 0; i < count; ++i) {
-      expval = exp(std::min(bottom_data[i], Dtype(kBNLL_THRESHOLD)));
-      bottom_diff[i] = top_diff[i] * expval / (expval + 1.);
-    }
+    parallel_for(count, boost::bind(&bnll_backward<Dtype>, _1, _2,
+        bottom_data, top_diff, bottom_diff));
   }
 }
 
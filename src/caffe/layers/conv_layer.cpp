@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/conv_layer.hpp"
@@ -25,6 +26,10 @@ template <typename Dtype>
 void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const Dtype* weight = this->blobs_[0]->cpu_data();
+  const ConvolutionParameter& conv_param =
+      this->layer_param_.convolution_param();
+  const bool fuse_relu = conv_param.fuse_relu();
+  const Dtype negative_slope = conv_param.relu_negative_slope();
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
@@ -35,6 +40,13 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
         const Dtype* bias = this->blobs_[1]->cpu_data();
         this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
       }
+      if (fuse_relu) {
+        Dtype* output = top_data + n * this->top_dim_;
+        for (int j = 0; j < this->top_dim_; ++j) {
+          output[j] = std::max(output[j], Dtype(0))
+              + negative_slope * std::min(output[j], Dtype(0));
+        }
+      }
     }
   }
 }
@@ -44,7 +56,19 @@ void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
   const Dtype* weight = this->blobs_[0]->cpu_data();
   Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
+  const ConvolutionParameter& conv_param =
+      this->layer_param_.convolution_param();
   for (int i = 0; i < top.size(); ++i) {
+    if (conv_param.fuse_relu()) {
+      // Backpropagate through the fused ReLU in-place; the output has the
+      // sign of the pre-activation.
+      const Dtype negative_slope = conv_param.relu_negative_slope();
+      const Dtype* top_data = top[i]->cpu_data();
+      Dtype* relu_diff = top[i]->mutable_cpu_diff();
+      for (int j = 0; j < top[i]->count(); ++j) {
+        relu_diff[j] *= (top_data[j] > 0) + negative_slope * (top_data[j] <= 0);
+      }
+    }
     const Dtype* top_diff = top[i]->cpu_diff();
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* bottom_diff = bottom[i]->mutable_cpu_diff();
@@ -1,12 +1,28 @@
 // TODO (sergeyk): effect should not be dependent on phase. wasted memcpy.
 
+#include <boost/bind.hpp>
 #include <vector>
 
 #include "caffe/layers/dropout_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+// Multiplies by the mask of the generator, regenerating it on the fly, and by
+// the scale: the same values caffe_rng_bernoulli would store in a mask.
+template <typename Dtype>
+static void dropout_apply(const int begin, const int end, const Dtype* in,
+    const Philox& philox, const Dtype keep, const Dtype scale, Dtype* out) {
+  uint32_t block[4];
+  for (int i = begin; i < end;) {
+    philox.Block(i / 4, block);
+    for (int j = i % 4; j < 4 && i < end; ++j, ++i) {
+      out[i] = (Philox::Uniform(block[j]) < keep) ? in[i] * scale : Dtype(0);
+    }
+  }
+}
+
 template <typename Dtype>
 void DropoutLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -16,6 +32,7 @@ void DropoutLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   DCHECK(threshold_ < 1.);
   scale_ = 1. / (1. - threshold_);
   uint_thres_ = static_cast<unsigned int>(UINT_MAX * threshold_);
+  rng_key_ = 0;
 }
 
 template <typename Dtype>
@@ -32,14 +49,13 @@ void DropoutLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  unsigned int* mask = rand_vec_.mutable_cpu_data();
   const int count = bottom[0]->count();
   if (this->phase_ == TRAIN) {
-    // Create random numbers
-    caffe_rng_bernoulli(count, 1. - threshold_, mask);
-    for (int i = 0; i < count; ++i) {
-      top_data[i] = bottom_data[i] * mask[i] * scale_;
-    }
+    // Draw a new mask; it is generated again in backward rather than stored.
+    rng_key_ = Philox::FromCaffeRNG().key();
+    parallel_for(count, boost::bind(&dropout_apply<Dtype>, _1, _2,
+        bottom_data, Philox(rng_key_, 0), Dtype(1. - threshold_), scale_,
+        top_data));
   } else {
     caffe_copy(bottom[0]->count(), bottom_data, top_data);
   }
@@ -53,11 +69,10 @@ void DropoutLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const Dtype* top_diff = top[0]->cpu_diff();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     if (this->phase_ == TRAIN) {
-      const unsigned int* mask = rand_vec_.cpu_data();
       const int count = bottom[0]->count();
-      for (int i = 0; i < count; ++i) {
-        bottom_diff[i] = top_diff[i] * mask[i] * scale_;
-      }
+      parallel_for(count, boost::bind(&dropout_apply<Dtype>, _1, _2,
+          top_diff, Philox(rng_key_, 0), Dtype(1. - threshold_), scale_,
+          bottom_diff));
     } else {
       caffe_copy(top[0]->count(), top_diff, bottom_diff);
     }
@@ -1,8 +1,9 @@
-#include <cfloat>
+#include <boost/bind.hpp>
 #include <vector>
 
 #include "caffe/layers/eltwise_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -44,34 +45,57 @@ void EltwiseLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void EltwiseLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  vector<const Dtype*> bottom_data(bottom.size());
+  for (int i = 0; i < bottom.size(); ++i) {
+    bottom_data[i] = bottom[i]->cpu_data();
+  }
   int* mask = NULL;
-  const Dtype* bottom_data_a = NULL;
-  const Dtype* bottom_data_b = NULL;
+  if (op_ == EltwiseParameter_EltwiseOp_MAX) {
+    mask = max_idx_.mutable_cpu_data();
+  }
   const int count = top[0]->count();
   Dtype* top_data = top[0]->mutable_cpu_data();
+  parallel_for(count, boost::bind(&EltwiseLayer<Dtype>::Forward_cpu_range,
+      this, boost::cref(bottom_data), top_data, mask, _1, _2));
+}
+
+template <typename Dtype>
+void EltwiseLayer<Dtype>::Forward_cpu_range(
+    const vector<const Dtype*>& bottom_data, Dtype* top_data, int* mask,
+    const int begin, const int end) {
+  const Dtype* bottom_data_a = NULL;
+  const Dtype* bottom_data_b = NULL;
   switch (op_) {
   case EltwiseParameter_EltwiseOp_PROD:
-    caffe_mul(count, bottom[0]->cpu_data(), bottom[1]->cpu_data(), top_data);
-    for (int i = 2; i < bottom.size(); ++i) {
-      caffe_mul(count, top_data, bottom[i]->cpu_data(), top_data);
+    bottom_data_a = bottom_data[0];
+    bottom_data_b = bottom_data[1];
+    for (int idx = begin; idx < end; ++idx) {
+      top_data[idx] = bottom_data_a[idx] * bottom_data_b[idx];
+    }
+    for (int i = 2; i < bottom_data.size(); ++i) {
+      bottom_data_b = bottom_data[i];
+      for (int idx = begin; idx < end; ++idx) {
+        top_data[idx] *= bottom_data_b[idx];
+      }
     }
     break;
   case EltwiseParameter_EltwiseOp_SUM:
-    caffe_set(count, Dtype(0), top_data);
-    // TODO(shelhamer) does BLAS optimize to sum for coeff = 1?
-    for (int i = 0; i < bottom.size(); ++i) {
-      caffe_axpy(count, coeffs_[i], bottom[i]->cpu_data(), top_data);
+    for (int idx = begin; idx < end; ++idx) {
+      top_data[idx] = 0;
+    }
+    for (int i = 0; i < bottom_data.size(); ++i) {
+      const Dtype coeff = coeffs_[i];
+      bottom_data_b = bottom_data[i];
+      for (int idx = begin; idx < end; ++idx) {
+        top_data[idx] += coeff * bottom_data_b[idx];
+      }
     }
     break;
   case EltwiseParameter_EltwiseOp_MAX:
-    // Initialize
-    mask = max_idx_.mutable_cpu_data();
-    caffe_set(count, -1, mask);
-    caffe_set(count, Dtype(-FLT_MAX), top_data);
     // bottom 0 & 1
-    bottom_data_a = bottom[0]->cpu_data();
-    bottom_data_b = bottom[1]->cpu_data();
-    for (int idx = 0; idx < count; ++idx) {
+    bottom_data_a = bottom_data[0];
+    bottom_data_b = bottom_data[1];
+    for (int idx = begin; idx < end; ++idx) {
       if (bottom_data_a[idx] > bottom_data_b[idx]) {
         top_data[idx] = bottom_data_a[idx];  // maxval
         mask[idx] = 0;  // maxid
@@ -81,9 +105,9 @@ void EltwiseLayer<Dtype>::Forward_cpu(
       }
     }
     // bottom 2++
-    for (int blob_idx = 2; blob_idx < bottom.size(); ++blob_idx) {
-      bottom_data_b = bottom[blob_idx]->cpu_data();
-      for (int idx = 0; idx < count; ++idx) {
+    for (int blob_idx = 2; blob_idx < bottom_data.size(); ++blob_idx) {
+      bottom_data_b = bottom_data[blob_idx];
+      for (int idx = begin; idx < end; ++idx) {
         if (bottom_data_b[idx] > top_data[idx]) {
           top_data[idx] = bottom_data_b[idx];  // maxval
           mask[idx] = blob_idx;  // maxid
@@ -99,54 +123,75 @@ void EltwiseLayer<Dtype>::Forward_cpu(
 template <typename Dtype>
 void EltwiseLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  vector<const Dtype*> bottom_data(bottom.size());
+  for (int i = 0; i < bottom.size(); ++i) {
+    bottom_data[i] = bottom[i]->cpu_data();
+  }
   const int* mask = NULL;
+  if (op_ == EltwiseParameter_EltwiseOp_MAX) {
+    mask = max_idx_.cpu_data();
+  }
   const int count = top[0]->count();
   const Dtype* top_data = top[0]->cpu_data();
   const Dtype* top_diff = top[0]->cpu_diff();
   for (int i = 0; i < bottom.size(); ++i) {
     if (propagate_down[i]) {
-      const Dtype* bottom_data = bottom[i]->cpu_data();
       Dtype* bottom_diff = bottom[i]->mutable_cpu_diff();
-      switch (op_) {
-      case EltwiseParameter_EltwiseOp_PROD:
-        if (stable_prod_grad_) {
-          bool initialized = false;
-          for (int j = 0; j < bottom.size(); ++j) {
-            if (i == j) { continue; }
-            if (!initialized) {
-              caffe_copy(count, bottom[j]->cpu_data(), bottom_diff);
-              initialized = true;
-            } else {
-              caffe_mul(count, bottom[j]->cpu_data(), bottom_diff,
-                        bottom_diff);
-            }
+      parallel_for(count, boost::bind(
+          &EltwiseLayer<Dtype>::Backward_cpu_range, this,
+          boost::cref(bottom_data), i, top_data, top_diff, mask, bottom_diff,
+          _1, _2));
+    }
+  }
+}
+
+template <typename Dtype>
+void EltwiseLayer<Dtype>::Backward_cpu_range(
+    const vector<const Dtype*>& bottom_data, const int bottom_id,
+    const Dtype* top_data, const Dtype* top_diff, const int* mask,
+    Dtype* bottom_diff, const int begin, const int end) {
+  switch (op_) {
+  case EltwiseParameter_EltwiseOp_PROD:
+    if (stable_prod_grad_) {
+      bool initialized = false;
+      for (int j = 0; j < bottom_data.size(); ++j) {
+        if (bottom_id == j) { continue; }
+        if (!initialized) {
+          for (int idx = begin; idx < end; ++idx) {
+            bottom_diff[idx] = bottom_data[j][idx];
           }
+          initialized = true;
         } else {
-          caffe_div(count, top_data, bottom_data, bottom_diff);
-        }
-        caffe_mul(count, bottom_diff, top_diff, bottom_diff);
-        break;
-      case EltwiseParameter_EltwiseOp_SUM:
-        if (coeffs_[i] == Dtype(1)) {
-          caffe_copy(count, top_diff, bottom_diff);
-        } else {
-          caffe_cpu_scale(count, coeffs_[i], top_diff, bottom_diff);
-        }
-        break;
-      case EltwiseParameter_EltwiseOp_MAX:
-        mask = max_idx_.cpu_data();
-        for (int index = 0; index < count; ++index) {
-          Dtype gradient = 0;
-          if (mask[index] == i) {
-            gradient += top_diff[index];
+          for (int idx = begin; idx < end; ++idx) {
+            bottom_diff[idx] *= bottom_data[j][idx];
           }
-          bottom_diff[index] = gradient;
         }
-        break;
-      default:
-        LOG(FATAL) << "Unknown elementwise operation.";
       }
+    } else {
+      for (int idx = begin; idx < end; ++idx) {
+        bottom_diff[idx] = top_data[idx] / bottom_data[bottom_id][idx];
+      }
+    }
+    for (int idx = begin; idx < end; ++idx) {
+      bottom_diff[idx] *= top_diff[idx];
     }
+    break;
+  case EltwiseParameter_EltwiseOp_SUM:
+    for (int idx = begin; idx < end; ++idx) {
+      bottom_diff[idx] = coeffs_[bottom_id] * top_diff[idx];
+    }
+    break;
+  case EltwiseParameter_EltwiseOp_MAX:
+    for (int index = begin; index < end; ++index) {
+      Dtype gradient = 0;
+      if (mask[index] == bottom_id) {
+        gradient += top_diff[index];
+      }
+      bottom_diff[index] = gradient;
+    }
+    break;
+  default:
+    LOG(FATAL) << "Unknown elementwise operation.";
   }
 }
 
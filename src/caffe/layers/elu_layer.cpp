@@ -1,10 +1,42 @@
+#include <boost/bind.hpp>
 #include <algorithm>
 #include <vector>
 
 #include "caffe/layers/elu_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+// The exponentials go through caffe_exp in chunks on the stack.
+template <typename Dtype>
+static void elu_forward(const int begin, const int end,
+    const Dtype* bottom_data, const Dtype alpha, Dtype* top_data) {
+  const int kChunk = 256;
+  Dtype exp_data[kChunk];
+  for (int i = begin; i < end; i += kChunk) {
+    const int len = std::min(kChunk, end - i);
+    for (int j = 0; j < len; ++j) {
+      exp_data[j] = std::min(bottom_data[i + j], Dtype(0));
+    }
+    caffe_exp(len, exp_data, exp_data);
+    for (int j = 0; j < len; ++j) {
+      top_data[i + j] = std::max(bottom_data[i + j], Dtype(0))
+          + alpha * (exp_data[j] - Dtype(1));
+    }
+  }
+}
+
+template <typename Dtype>
+static void elu_backward(const int begin, const int end,
+    const Dtype* bottom_data, const Dtype* top_data, const Dtype* top_diff,
+    const Dtype alpha, Dtype* bottom_diff) {
+  for (int i = begin; i < end; ++i) {
+    bottom_diff[i] = top_diff[i] * ((bottom_data[i] > 0)
+        + (alpha + top_data[i]) * (bottom_data[i] <= 0));
+  }
+}
+
 template <typename Dtype>
 void ELULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
@@ -12,10 +44,8 @@ void ELULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
   Dtype alpha = this->layer_param_.elu_param().alpha();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = std::max(bottom_data[i], Dtype(0))
-        + alpha * (exp(std::min(bottom_data[i], Dtype(0))) - Dtype(1));
-  }
+  parallel_for(count, boost::bind(&elu_forward<Dtype>, _1, _2,
+      bottom_data, alpha, top_data));
 }
 
 template <typename Dtype>
@@ -29,10 +59,8 @@ void ELULayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const int count = bottom[0]->count();
     Dtype alpha = this->layer_param_.elu_param().alpha();
-    for (int i = 0; i < count; ++i) {
-      bottom_diff[i] = top_diff[i] * ((bottom_data[i] > 0)
-          + (alpha + top_data[i]) * (bottom_data[i] <= 0));
-    }
+    parallel_for(count, boost::bind(&elu_backward<Dtype>, _1, _2,
+        bottom_data, top_data, top_diff, alpha, bottom_diff));
   }
 }
 
@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <climits>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "hdf5.h"
+
+#include "caffe/layers/hdf5_prefetch_data_layer.hpp"
+#include "caffe/util/hdf5.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/rng.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+HDF5PrefetchDataLayer<Dtype>::~HDF5PrefetchDataLayer<Dtype>() {
+  this->StopInternalThread();
+  if (file_id_ >= 0) {
+    H5Fclose(file_id_);
+  }
+}
+
+template <typename Dtype>
+void HDF5PrefetchDataLayer<Dtype>::DataLayerSetUp(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const HDF5DataParameter& param = this->layer_param_.hdf5_data_param();
+  // Refuse transformation parameters since HDF5 is totally generic.
+  CHECK(!this->layer_param_.has_transform_param()) <<
+      this->type() << " does not transform data.";
+  CHECK_GT(param.batch_size(), 0) << "Positive batch size required";
+  CHECK_GT(param.chunk_size(), 0) << "Positive chunk size required";
+  // Read the source to parse the filenames.
+  LOG(INFO) << "Loading list of HDF5 filenames from: " << param.source();
+  hdf_filenames_.clear();
+  std::ifstream source_file(param.source().c_str());
+  if (source_file.is_open()) {
+    std::string line;
+    while (source_file >> line) {
+      hdf_filenames_.push_back(line);
+    }
+  } else {
+    LOG(FATAL) << "Failed to open source file: " << param.source();
+  }
+  source_file.close();
+  LOG(INFO) << "Number of HDF5 files: " << hdf_filenames_.size();
+  CHECK_GE(hdf_filenames_.size(), 1)
+      << "Must have at least 1 HDF5 filename listed in " << param.source();
+  file_permutation_.resize(hdf_filenames_.size());
+  for (int i = 0; i < file_permutation_.size(); ++i) {
+    file_permutation_[i] = i;
+  }
+  if (param.shuffle()) {
+    const unsigned int prefetch_rng_seed = caffe_rng_rand();
+    prefetch_rng_.reset(new Caffe::RNG(prefetch_rng_seed));
+    Shuffle(&file_permutation_);
+  }
+  current_file_ = 0;
+  OpenFile();
+  chunk_blobs_.resize(top.size());
+  for (int i = 0; i < top.size(); ++i) {
+    chunk_blobs_[i].reset(new Blob<Dtype>());
+  }
+  row_permutation_.clear();
+  current_row_ = 0;
+
+  // Reshape the tops and the prefetch batches to the rows of the first file.
+  for (int i = 0; i < top.size(); ++i) {
+    vector<int> top_shape = hdf5_get_nd_dataset_shape(
+        file_id_, this->layer_param_.top(i).c_str(), 1, INT_MAX);
+    top_shape[0] = param.batch_size();
+    top[i]->Reshape(top_shape);
+    for (int j = 0; j < this->prefetch_.size(); ++j) {
+      if (i == 0) {
+        this->prefetch_[j]->data_.Reshape(top_shape);
+      } else {
+        this->prefetch_[j]->label_.Reshape(top_shape);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void HDF5PrefetchDataLayer<Dtype>::Shuffle(vector<int>* order) {
+  caffe::rng_t* prefetch_rng =
+      static_cast<caffe::rng_t*>(prefetch_rng_->generator());
+  shuffle(order->begin(), order->end(), prefetch_rng);
+}
+
+template <typename Dtype>
+void HDF5PrefetchDataLayer<Dtype>::OpenFile() {
+  if (file_id_ >= 0) {
+    herr_t status = H5Fclose(file_id_);
+    CHECK_GE(status, 0) << "Failed to close HDF5 file.";
+  }
+  const string& filename = hdf_filenames_[file_permutation_[current_file_]];
+  DLOG(INFO) << "Opening HDF5 file: " << filename;
+  file_id_ = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  if (file_id_ < 0) {
+    LOG(FATAL) << "Failed opening HDF5 file: " << filename;
+  }
+  for (int i = 0; i < this->layer_param_.top_size(); ++i) {
+    const vector<int> shape = hdf5_get_nd_dataset_shape(
+        file_id_, this->layer_param_.top(i).c_str(), 1, INT_MAX);
+    if (i == 0) {
+      num_rows_ = shape[0];
+    } else {
+      CHECK_EQ(shape[0], num_rows_) << "The datasets of HDF5 file "
+          << filename << " have different numbers of rows.";
+    }
+  }
+  CHECK_GT(num_rows_, 0) << "HDF5 file " << filename << " has no rows.";
+  const int chunk_size = this->layer_param_.hdf5_data_param().chunk_size();
+  chunk_starts_.clear();
+  for (int start = 0; start < num_rows_; start += chunk_size) {
+    chunk_starts_.push_back(start);
+  }
+  if (this->layer_param_.hdf5_data_param().shuffle()) {
+    Shuffle(&chunk_starts_);
+  }
+  current_chunk_ = 0;
+}
+
+template <typename Dtype>
+void HDF5PrefetchDataLayer<Dtype>::LoadChunk() {
+  if (current_chunk_ == chunk_starts_.size()) {
+    ++current_file_;
+    if (current_file_ == hdf_filenames_.size()) {
+      current_file_ = 0;
+      if (this->layer_param_.hdf5_data_param().shuffle()) {
+        Shuffle(&file_permutation_);
+      }
+      DLOG(INFO) << "Looping around to first file.";
+    }
+    OpenFile();
+  }
+  const int start = chunk_starts_[current_chunk_++];
+  const int num = std::min(
+      static_cast<int>(this->layer_param_.hdf5_data_param().chunk_size()),
+      num_rows_ - start);
+  for (int i = 0; i < chunk_blobs_.size(); ++i) {
+    hdf5_load_nd_dataset_rows(file_id_, this->layer_param_.top(i).c_str(),
+        start, num, chunk_blobs_[i].get());
+  }
+  row_permutation_.resize(num);
+  for (int i = 0; i < num; ++i) {
+    row_permutation_[i] = i;
+  }
+  if (this->layer_param_.hdf5_data_param().shuffle()) {
+    Shuffle(&row_permutation_);
+  }
+  current_row_ = 0;
+}
+
+// This function is called on prefetch thread
+template <typename Dtype>
+void HDF5PrefetchDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
+  const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
+  const bool shuffle = this->layer_param_.hdf5_data_param().shuffle();
+  vector<Blob<Dtype>*> batch_blobs(1, &batch->data_);
+  if (this->output_labels_) {
+    batch_blobs.push_back(&batch->label_);
+  }
+  int item_id = 0;
+  while (item_id < batch_size) {
+    if (current_row_ == row_permutation_.size()) {
+      LoadChunk();
+    }
+    // Copy the rows up to the end of the batch or of the chunk at once.
+    const int num = std::min(batch_size - item_id,
+        static_cast<int>(row_permutation_.size()) - current_row_);
+    for (int i = 0; i < batch_blobs.size(); ++i) {
+      const int dim = batch_blobs[i]->count(1);
+      CHECK_EQ(chunk_blobs_[i]->count(1), dim) << "The rows of dataset "
+          << this->layer_param_.top(i) << " changed shape between files.";
+      const Dtype* chunk_data = chunk_blobs_[i]->cpu_data();
+      Dtype* batch_data = batch_blobs[i]->mutable_cpu_data() + item_id * dim;
+      if (shuffle) {
+        for (int j = 0; j < num; ++j) {
+          caffe_copy(dim, chunk_data + row_permutation_[current_row_ + j] * dim,
+              batch_data + j * dim);
+        }
+      } else {
+        caffe_copy(num * dim, chunk_data + current_row_ * dim, batch_data);
+      }
+    }
+    item_id += num;
+    current_row_ += num;
+  }
+}
+
+INSTANTIATE_CLASS(HDF5PrefetchDataLayer);
+REGISTER_LAYER_CLASS(HDF5PrefetchData);
+
+}  // namespace caffe
@@ -1,6 +1,7 @@
 #ifdef USE_OPENCV
 #include <opencv2/core/core.hpp>
 
+#include <boost/bind.hpp>
 #include <fstream>  // NOLINT(readability/streams)
 #include <iostream>  // NOLINT(readability/streams)
 #include <string>
@@ -14,6 +15,7 @@
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -72,8 +74,8 @@ void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
   const int batch_size = this->layer_param_.image_data_param().batch_size();
   CHECK_GT(batch_size, 0) << "Positive batch size required";
   top_shape[0] = batch_size;
-  for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-    this->prefetch_[i].data_.Reshape(top_shape);
+  for (int i = 0; i < this->prefetch_.size(); ++i) {
+    this->prefetch_[i]->data_.Reshape(top_shape);
   }
   top[0]->Reshape(top_shape);
 
@@ -83,9 +85,19 @@ void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // label
   vector<int> label_shape(1, batch_size);
   top[1]->Reshape(label_shape);
-  for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-    this->prefetch_[i].label_.Reshape(label_shape);
+  for (int i = 0; i < this->prefetch_.size(); ++i) {
+    this->prefetch_[i]->label_.Reshape(label_shape);
   }
+
+  const int threads = this->layer_param_.image_data_param().threads();
+  CHECK_GT(threads, 0) << "Positive number of threads required";
+  read_pool_.reset(new ThreadPool(threads));
+  batch_lines_.clear();
+  next_lines_.clear();
+  read_time_ = 0;
+  wait_time_ = 0;
+  trans_time_ = 0;
+  timed_batches_ = 0;
 }
 
 template <typename Dtype>
@@ -95,30 +107,101 @@ void ImageDataLayer<Dtype>::ShuffleImages() {
   shuffle(lines_.begin(), lines_.end(), prefetch_rng);
 }
 
+template <typename Dtype>
+void ImageDataLayer<Dtype>::NextBatchLines() {
+  const int batch_size = this->layer_param_.image_data_param().batch_size();
+  const int lines_size = lines_.size();
+  next_lines_.resize(batch_size);
+  for (int item_id = 0; item_id < batch_size; ++item_id) {
+    CHECK_GT(lines_size, lines_id_);
+    next_lines_[item_id] = lines_[lines_id_];
+    // go to the next iter
+    lines_id_++;
+    if (lines_id_ >= lines_size) {
+      // We have reached the end. Restart from the first.
+      DLOG(INFO) << "Restarting data prefetching from start.";
+      lines_id_ = 0;
+      if (this->layer_param_.image_data_param().shuffle()) {
+        ShuffleImages();
+      }
+    }
+  }
+  next_images_.assign(batch_size, cv::Mat());
+  read_times_.assign(batch_size, 0);
+}
+
+// This function is called on the threads of read_pool_
+template <typename Dtype>
+void ImageDataLayer<Dtype>::ReadImage(int item_id) {
+  const ImageDataParameter& image_data_param =
+      this->layer_param_.image_data_param();
+  CPUTimer timer;
+  timer.Start();
+  const string& filename = next_lines_[item_id].first;
+  next_images_[item_id] = ReadImageToCVMat(
+      image_data_param.root_folder() + filename, image_data_param.new_height(),
+      image_data_param.new_width(), image_data_param.is_color());
+  CHECK(next_images_[item_id].data) << "Could not load " << filename;
+  read_times_[item_id] = timer.MicroSeconds();
+}
+
+// This function is called on the threads of read_pool_
+template <typename Dtype>
+void ImageDataLayer<Dtype>::TransformBatch(Batch<Dtype>* batch,
+    Dtype* prefetch_data, Dtype* prefetch_label) {
+  CPUTimer timer;
+  timer.Start();
+  for (int item_id = 0; item_id < batch_images_.size(); ++item_id) {
+    // Apply transformations (mirror, crop...) to the image
+    int offset = batch->data_.offset(item_id);
+    this->transformed_data_.set_cpu_data(prefetch_data + offset);
+    this->data_transformer_->Transform(batch_images_[item_id],
+        &(this->transformed_data_));
+    prefetch_label[item_id] = batch_lines_[item_id].second;
+  }
+  trans_time_ += timer.MicroSeconds();
+}
+
+template <typename Dtype>
+void ImageDataLayer<Dtype>::LoadBatchTask(Batch<Dtype>* batch,
+    Dtype* prefetch_data, Dtype* prefetch_label, int i) {
+  if (i == 0) {
+    TransformBatch(batch, prefetch_data, prefetch_label);
+  } else {
+    ReadImage(i - 1);
+  }
+}
+
 // This function is called on prefetch thread
 template <typename Dtype>
 void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   CPUTimer batch_timer;
   batch_timer.Start();
-  double read_time = 0;
-  double trans_time = 0;
   CPUTimer timer;
   CHECK(batch->data_.count());
   CHECK(this->transformed_data_.count());
-  ImageDataParameter image_data_param = this->layer_param_.image_data_param();
-  const int batch_size = image_data_param.batch_size();
-  const int new_height = image_data_param.new_height();
-  const int new_width = image_data_param.new_width();
-  const bool is_color = image_data_param.is_color();
-  string root_folder = image_data_param.root_folder();
+  const int batch_size = this->layer_param_.image_data_param().batch_size();
+
+  // Read the images of the first batch; the others were read ahead.
+  double read_time = 0;
+  if (next_lines_.empty()) {
+    NextBatchLines();
+    timer.Start();
+    read_pool_->Run(batch_size,
+        boost::bind(&ImageDataLayer<Dtype>::ReadImage, this, _1));
+    wait_time_ += timer.MicroSeconds();
+    for (int item_id = 0; item_id < batch_size; ++item_id) {
+      read_time += read_times_[item_id];
+    }
+  }
+  batch_lines_.swap(next_lines_);
+  batch_images_.swap(next_images_);
 
   // Reshape according to the first image of each batch
   // on single input batches allows for inputs of varying dimension.
-  cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first,
-      new_height, new_width, is_color);
-  CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first;
   // Use data_transformer to infer the expected blob shape from a cv_img.
-  vector<int> top_shape = this->data_transformer_->InferBlobShape(cv_img);
+  vector<int> top_shape =
+      this->data_transformer_->InferBlobShape(batch_images_[0]);
   this->transformed_data_.Reshape(top_shape);
   // Reshape batch according to the batch_size.
   top_shape[0] = batch_size;
@@ -127,39 +210,36 @@ void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   Dtype* prefetch_data = batch->data_.mutable_cpu_data();
   Dtype* prefetch_label = batch->label_.mutable_cpu_data();
 
-  // datum scales
-  const int lines_size = lines_.size();
+  // Transform this batch while reading the images of the next one.
+  NextBatchLines();
+  const double trans_time = trans_time_;
+  timer.Start();
+  read_pool_->Run(batch_size + 1,
+      boost::bind(&ImageDataLayer<Dtype>::LoadBatchTask, this, batch,
+                  prefetch_data, prefetch_label, _1));
+  wait_time_ += timer.MicroSeconds() - (trans_time_ - trans_time);
   for (int item_id = 0; item_id < batch_size; ++item_id) {
-    // get a blob
-    timer.Start();
-    CHECK_GT(lines_size, lines_id_);
-    cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first,
-        new_height, new_width, is_color);
-    CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first;
-    read_time += timer.MicroSeconds();
-    timer.Start();
-    // Apply transformations (mirror, crop...) to the image
-    int offset = batch->data_.offset(item_id);
-    this->transformed_data_.set_cpu_data(prefetch_data + offset);
-    this->data_transformer_->Transform(cv_img, &(this->transformed_data_));
-    trans_time += timer.MicroSeconds();
-
-    prefetch_label[item_id] = lines_[lines_id_].second;
-    // go to the next iter
-    lines_id_++;
-    if (lines_id_ >= lines_size) {
-      // We have reached the end. Restart from the first.
-      DLOG(INFO) << "Restarting data prefetching from start.";
-      lines_id_ = 0;
-      if (this->layer_param_.image_data_param().shuffle()) {
-        ShuffleImages();
-      }
-    }
+    read_time += read_times_[item_id];
   }
+  read_time_ += read_time;
+
   batch_timer.Stop();
   DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
   DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
-  DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
+  DLOG(INFO) << "Transform time: " << (trans_time_ - trans_time) / 1000
+             << " ms.";
+  const int kTimedBatches = 1000;
+  if (++timed_batches_ == kTimedBatches) {
+    LOG(INFO) << this->layer_param_.name() << " time per batch: read "
+        << read_time_ / kTimedBatches / 1000 << " ms by "
+        << read_pool_->size() << " threads, waiting for reads "
+        << wait_time_ / kTimedBatches / 1000 << " ms, transform "
+        << trans_time_ / kTimedBatches / 1000 << " ms.";
+    read_time_ = 0;
+    wait_time_ = 0;
+    trans_time_ = 0;
+    timed_batches_ = 0;
+  }
 }
 
 INSTANTIATE_CLASS(ImageDataLayer);
@@ -86,9 +86,19 @@ void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const Dtype* weight = this->blobs_[0]->cpu_data();
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
-      M_, N_, K_, (Dtype)1.,
-      bottom_data, weight, (Dtype)0., top_data);
+  if (this->phase_ == TEST && M_ <= kPackedGemmMaxRows) {
+    // Small batches at test time: the weights packed once, until they change,
+    // and shared by all the nets sharing them.
+    shared_ptr<const PackedMatrix<Dtype> > packed_weight =
+        caffe_cpu_packed<Dtype>(this->blobs_[0]->data().get(),
+        transpose_ ? CblasNoTrans : CblasTrans, K_, N_, 0);
+    caffe_cpu_gemm_packed_b<Dtype>(CblasNoTrans, M_, (Dtype)1., bottom_data,
+        *packed_weight, (Dtype)0., top_data);
+  } else {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
+        M_, N_, K_, (Dtype)1.,
+        bottom_data, weight, (Dtype)0., top_data);
+  }
   if (bias_term_) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, (Dtype)1.,
         bias_multiplier_.cpu_data(),
@@ -1,10 +1,17 @@
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/lrn_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+template <typename Dtype>
+const int LRNLayer<Dtype>::kTile;
+
 template <typename Dtype>
 void LRNLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -107,48 +114,61 @@ void LRNLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void LRNLayer<Dtype>::CrossChannelForward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* top_data = top[0]->mutable_cpu_data();
-  Dtype* scale_data = scale_.mutable_cpu_data();
-  // start with the constant value
-  for (int i = 0; i < scale_.count(); ++i) {
-    scale_data[i] = k_;
-  }
-  Blob<Dtype> padded_square(1, channels_ + size_ - 1, height_, width_);
-  Dtype* padded_square_data = padded_square.mutable_cpu_data();
-  caffe_set(padded_square.count(), Dtype(0), padded_square_data);
-  Dtype alpha_over_size = alpha_ / size_;
-  // go through the images
-  for (int n = 0; n < num_; ++n) {
-    // compute the padded square
-    caffe_sqr(channels_ * height_ * width_,
-        bottom_data + bottom[0]->offset(n),
-        padded_square_data + padded_square.offset(0, pre_pad_));
-    // Create the first channel scale
-    for (int c = 0; c < size_; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c),
-          scale_data + scale_.offset(n, 0));
+  const int tiles = (height_ * width_ + kTile - 1) / kTile;
+  parallel_for(num_ * tiles, boost::bind(
+      &LRNLayer<Dtype>::CrossChannelForwardTiles, this, _1, _2,
+      bottom[0]->cpu_data(), scale_.mutable_cpu_data(),
+      top[0]->mutable_cpu_data()),
+      std::max(16384 / (channels_ * kTile), 1));
+}
+
+// Each tile of kTile pixels of one image keeps the sum of squares over the
+// window of channels around c, adding the channel entering the window and
+// subtracting the one leaving it, so that every input is read twice and
+// every output written once.
+template <typename Dtype>
+void LRNLayer<Dtype>::CrossChannelForwardTiles(const int begin, const int end,
+    const Dtype* bottom_data, Dtype* scale_data, Dtype* top_data) const {
+  const int spatial = height_ * width_;
+  const int tiles = (spatial + kTile - 1) / kTile;
+  const Dtype alpha_over_size = alpha_ / size_;
+  Dtype accum[kTile];
+  for (int t = begin; t < end; ++t) {
+    const int offset = (t / tiles) * channels_ * spatial + (t % tiles) * kTile;
+    const int len = std::min(kTile, spatial - (t % tiles) * kTile);
+    const Dtype* x = bottom_data + offset;
+    std::fill(accum, accum + len, Dtype(0));
+    for (int c = 0; c < std::min(pre_pad_, channels_); ++c) {
+      const Dtype* head = x + c * spatial;
+      for (int j = 0; j < len; ++j) {
+        accum[j] += head[j] * head[j];
+      }
     }
-    for (int c = 1; c < channels_; ++c) {
-      // copy previous scale
-      caffe_copy<Dtype>(height_ * width_,
-          scale_data + scale_.offset(n, c - 1),
-          scale_data + scale_.offset(n, c));
-      // add head
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c + size_ - 1),
-          scale_data + scale_.offset(n, c));
-      // subtract tail
-      caffe_axpy<Dtype>(height_ * width_, -alpha_over_size,
-          padded_square_data + padded_square.offset(0, c - 1),
-          scale_data + scale_.offset(n, c));
+    for (int c = 0; c < channels_; ++c) {
+      if (c + pre_pad_ < channels_) {
+        const Dtype* head = x + (c + pre_pad_) * spatial;
+        for (int j = 0; j < len; ++j) {
+          accum[j] += head[j] * head[j];
+        }
+      }
+      const Dtype* x_c = x + c * spatial;
+      Dtype* scale_c = scale_data + offset + c * spatial;
+      Dtype* top_c = top_data + offset + c * spatial;
+      for (int j = 0; j < len; ++j) {
+        scale_c[j] = k_ + alpha_over_size * accum[j];
+      }
+      caffe_powx(len, scale_c, -beta_, top_c);
+      for (int j = 0; j < len; ++j) {
+        top_c[j] *= x_c[j];
+      }
+      if (c >= pre_pad_) {
+        const Dtype* tail = x + (c - pre_pad_) * spatial;
+        for (int j = 0; j < len; ++j) {
+          accum[j] -= tail[j] * tail[j];
+        }
+      }
     }
   }
-
-  // In the end, compute output
-  caffe_powx<Dtype>(scale_.count(), scale_data, -beta_, top_data);
-  caffe_mul<Dtype>(scale_.count(), top_data, bottom_data, top_data);
 }
 
 template <typename Dtype>
@@ -180,53 +200,57 @@ template <typename Dtype>
 void LRNLayer<Dtype>::CrossChannelBackward_cpu(
     const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
-  const Dtype* top_diff = top[0]->cpu_diff();
-  const Dtype* top_data = top[0]->cpu_data();
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  const Dtype* scale_data = scale_.cpu_data();
-  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-  Blob<Dtype> padded_ratio(1, channels_ + size_ - 1, height_, width_);
-  Blob<Dtype> accum_ratio(1, 1, height_, width_);
-  Dtype* padded_ratio_data = padded_ratio.mutable_cpu_data();
-  Dtype* accum_ratio_data = accum_ratio.mutable_cpu_data();
-  // We hack a little bit by using the diff() to store an additional result
-  Dtype* accum_ratio_times_bottom = accum_ratio.mutable_cpu_diff();
-  caffe_set(padded_ratio.count(), Dtype(0), padded_ratio_data);
-  Dtype cache_ratio_value = 2. * alpha_ * beta_ / size_;
-
-  caffe_powx<Dtype>(scale_.count(), scale_data, -beta_, bottom_diff);
-  caffe_mul<Dtype>(scale_.count(), top_diff, bottom_diff, bottom_diff);
+  const int tiles = (height_ * width_ + kTile - 1) / kTile;
+  parallel_for(num_ * tiles, boost::bind(
+      &LRNLayer<Dtype>::CrossChannelBackwardTiles, this, _1, _2,
+      top[0]->cpu_diff(), top[0]->cpu_data(), bottom[0]->cpu_data(),
+      scale_.cpu_data(), bottom[0]->mutable_cpu_diff()),
+      std::max(16384 / (channels_ * kTile), 1));
+}
 
-  // go through individual data
-  int inverse_pre_pad = size_ - (size_ + 1) / 2;
-  for (int n = 0; n < num_; ++n) {
-    int block_offset = scale_.offset(n);
-    // first, compute diff_i * y_i / s_i
-    caffe_mul<Dtype>(channels_ * height_ * width_,
-        top_diff + block_offset, top_data + block_offset,
-        padded_ratio_data + padded_ratio.offset(0, inverse_pre_pad));
-    caffe_div<Dtype>(channels_ * height_ * width_,
-        padded_ratio_data + padded_ratio.offset(0, inverse_pre_pad),
-        scale_data + block_offset,
-        padded_ratio_data + padded_ratio.offset(0, inverse_pre_pad));
-    // Now, compute the accumulated ratios and the bottom diff
-    caffe_set(accum_ratio.count(), Dtype(0), accum_ratio_data);
-    for (int c = 0; c < size_ - 1; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, 1.,
-          padded_ratio_data + padded_ratio.offset(0, c), accum_ratio_data);
+// As in forward, with the window summing the ratios top_diff * top / scale.
+template <typename Dtype>
+void LRNLayer<Dtype>::CrossChannelBackwardTiles(const int begin,
+    const int end, const Dtype* top_diff, const Dtype* top_data,
+    const Dtype* bottom_data, const Dtype* scale_data,
+    Dtype* bottom_diff) const {
+  const int spatial = height_ * width_;
+  const int tiles = (spatial + kTile - 1) / kTile;
+  const Dtype cache_ratio_value = 2. * alpha_ * beta_ / size_;
+  Dtype accum[kTile];
+  for (int t = begin; t < end; ++t) {
+    const int offset = (t / tiles) * channels_ * spatial + (t % tiles) * kTile;
+    const int len = std::min(kTile, spatial - (t % tiles) * kTile);
+    const Dtype* dy = top_diff + offset;
+    const Dtype* y = top_data + offset;
+    const Dtype* s = scale_data + offset;
+    std::fill(accum, accum + len, Dtype(0));
+    for (int c = 0; c < std::min(pre_pad_, channels_); ++c) {
+      const int head = c * spatial;
+      for (int j = 0; j < len; ++j) {
+        accum[j] += dy[head + j] * y[head + j] / s[head + j];
+      }
     }
     for (int c = 0; c < channels_; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, 1.,
-          padded_ratio_data + padded_ratio.offset(0, c + size_ - 1),
-          accum_ratio_data);
-      // compute bottom diff
-      caffe_mul<Dtype>(height_ * width_,
-          bottom_data + top[0]->offset(n, c),
-          accum_ratio_data, accum_ratio_times_bottom);
-      caffe_axpy<Dtype>(height_ * width_, -cache_ratio_value,
-          accum_ratio_times_bottom, bottom_diff + top[0]->offset(n, c));
-      caffe_axpy<Dtype>(height_ * width_, -1.,
-          padded_ratio_data + padded_ratio.offset(0, c), accum_ratio_data);
+      if (c + pre_pad_ < channels_) {
+        const int head = (c + pre_pad_) * spatial;
+        for (int j = 0; j < len; ++j) {
+          accum[j] += dy[head + j] * y[head + j] / s[head + j];
+        }
+      }
+      const int i = c * spatial;
+      const Dtype* x_c = bottom_data + offset + i;
+      Dtype* dx_c = bottom_diff + offset + i;
+      caffe_powx(len, s + i, -beta_, dx_c);
+      for (int j = 0; j < len; ++j) {
+        dx_c[j] = dy[i + j] * dx_c[j] - cache_ratio_value * x_c[j] * accum[j];
+      }
+      if (c >= pre_pad_) {
+        const int tail = (c - pre_pad_) * spatial;
+        for (int j = 0; j < len; ++j) {
+          accum[j] -= dy[tail + j] * y[tail + j] / s[tail + j];
+        }
+      }
     }
   }
 }
@@ -3,6 +3,7 @@
 #include <vector>
 
 #include "caffe/layers/pooling_layer.hpp"
+#include "caffe/util/cpu_dispatch.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
@@ -122,6 +123,152 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+// The shape of a pooling, over planes of one channel of one image.
+struct PoolingGeometry {
+  int planes;
+  int height, width;
+  int pooled_height, pooled_width;
+  int kernel_h, kernel_w;
+  int stride_h, stride_w;
+  int pad_h, pad_w;
+};
+
+// The kernels below run with the instruction set of Caffe::simd_level().
+// The mask of the maxima goes to mask, or as Dtype to top_mask if not NULL.
+template <typename Dtype>
+static CAFFE_CPU_INLINE void max_pool_forward(const PoolingGeometry& g,
+    const Dtype* bottom_data, Dtype* top_data, int* mask, Dtype* top_mask) {
+  const int bottom_size = g.height * g.width;
+  const int top_size = g.pooled_height * g.pooled_width;
+  for (int p = 0; p < g.planes; ++p) {
+    for (int ph = 0; ph < g.pooled_height; ++ph) {
+      for (int pw = 0; pw < g.pooled_width; ++pw) {
+        int hstart = ph * g.stride_h - g.pad_h;
+        int wstart = pw * g.stride_w - g.pad_w;
+        int hend = min(hstart + g.kernel_h, g.height);
+        int wend = min(wstart + g.kernel_w, g.width);
+        hstart = max(hstart, 0);
+        wstart = max(wstart, 0);
+        const int pool_index = ph * g.pooled_width + pw;
+        for (int h = hstart; h < hend; ++h) {
+          for (int w = wstart; w < wend; ++w) {
+            const int index = h * g.width + w;
+            if (bottom_data[index] > top_data[pool_index]) {
+              top_data[pool_index] = bottom_data[index];
+              if (top_mask) {
+                top_mask[pool_index] = static_cast<Dtype>(index);
+              } else {
+                mask[pool_index] = index;
+              }
+            }
+          }
+        }
+      }
+    }
+    bottom_data += bottom_size;
+    top_data += top_size;
+    if (top_mask) {
+      top_mask += top_size;
+    } else {
+      mask += top_size;
+    }
+  }
+}
+
+CAFFE_CPU_VARIANTS_TEMPLATE(Dtype, max_pool_forward, (const PoolingGeometry& g,
+    const Dtype* bottom_data, Dtype* top_data, int* mask, Dtype* top_mask),
+    (g, bottom_data, top_data, mask, top_mask))
+
+template <typename Dtype>
+static CAFFE_CPU_INLINE void ave_pool_forward(const PoolingGeometry& g,
+    const Dtype* bottom_data, Dtype* top_data) {
+  for (int p = 0; p < g.planes; ++p) {
+    for (int ph = 0; ph < g.pooled_height; ++ph) {
+      for (int pw = 0; pw < g.pooled_width; ++pw) {
+        int hstart = ph * g.stride_h - g.pad_h;
+        int wstart = pw * g.stride_w - g.pad_w;
+        int hend = min(hstart + g.kernel_h, g.height + g.pad_h);
+        int wend = min(wstart + g.kernel_w, g.width + g.pad_w);
+        int pool_size = (hend - hstart) * (wend - wstart);
+        hstart = max(hstart, 0);
+        wstart = max(wstart, 0);
+        hend = min(hend, g.height);
+        wend = min(wend, g.width);
+        for (int h = hstart; h < hend; ++h) {
+          for (int w = wstart; w < wend; ++w) {
+            top_data[ph * g.pooled_width + pw] +=
+                bottom_data[h * g.width + w];
+          }
+        }
+        top_data[ph * g.pooled_width + pw] /= pool_size;
+      }
+    }
+    bottom_data += g.height * g.width;
+    top_data += g.pooled_height * g.pooled_width;
+  }
+}
+
+CAFFE_CPU_VARIANTS_TEMPLATE(Dtype, ave_pool_forward, (const PoolingGeometry& g,
+    const Dtype* bottom_data, Dtype* top_data), (g, bottom_data, top_data))
+
+template <typename Dtype>
+static CAFFE_CPU_INLINE void max_pool_backward(const PoolingGeometry& g,
+    const Dtype* top_diff, const int* mask, const Dtype* top_mask,
+    Dtype* bottom_diff) {
+  const int top_size = g.pooled_height * g.pooled_width;
+  for (int p = 0; p < g.planes; ++p) {
+    for (int index = 0; index < top_size; ++index) {
+      const int bottom_index =
+          top_mask ? static_cast<int>(top_mask[index]) : mask[index];
+      bottom_diff[bottom_index] += top_diff[index];
+    }
+    bottom_diff += g.height * g.width;
+    top_diff += top_size;
+    if (top_mask) {
+      top_mask += top_size;
+    } else {
+      mask += top_size;
+    }
+  }
+}
+
+CAFFE_CPU_VARIANTS_TEMPLATE(Dtype, max_pool_backward,
+    (const PoolingGeometry& g, const Dtype* top_diff, const int* mask,
+    const Dtype* top_mask, Dtype* bottom_diff),
+    (g, top_diff, mask, top_mask, bottom_diff))
+
+template <typename Dtype>
+static CAFFE_CPU_INLINE void ave_pool_backward(const PoolingGeometry& g,
+    const Dtype* top_diff, Dtype* bottom_diff) {
+  for (int p = 0; p < g.planes; ++p) {
+    for (int ph = 0; ph < g.pooled_height; ++ph) {
+      for (int pw = 0; pw < g.pooled_width; ++pw) {
+        int hstart = ph * g.stride_h - g.pad_h;
+        int wstart = pw * g.stride_w - g.pad_w;
+        int hend = min(hstart + g.kernel_h, g.height + g.pad_h);
+        int wend = min(wstart + g.kernel_w, g.width + g.pad_w);
+        int pool_size = (hend - hstart) * (wend - wstart);
+        hstart = max(hstart, 0);
+        wstart = max(wstart, 0);
+        hend = min(hend, g.height);
+        wend = min(wend, g.width);
+        for (int h = hstart; h < hend; ++h) {
+          for (int w = wstart; w < wend; ++w) {
+            bottom_diff[h * g.width + w] +=
+              top_diff[ph * g.pooled_width + pw] / pool_size;
+          }
+        }
+      }
+    }
+    bottom_diff += g.height * g.width;
+    top_diff += g.pooled_height * g.pooled_width;
+  }
+}
+
+CAFFE_CPU_VARIANTS_TEMPLATE(Dtype, ave_pool_backward,
+    (const PoolingGeometry& g, const Dtype* top_diff, Dtype* bottom_diff),
+    (g, top_diff, bottom_diff))
+
 // TODO(Yangqing): Is there a faster way to do pooling in the channel-first
 // case?
 template <typename Dtype>
@@ -134,6 +281,10 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const bool use_top_mask = top.size() > 1;
   int* mask = NULL;  // suppress warnings about uninitalized variables
   Dtype* top_mask = NULL;
+  const PoolingGeometry geometry = {
+    bottom[0]->num() * channels_, height_, width_,
+    pooled_height_, pooled_width_, kernel_h_, kernel_w_,
+    stride_h_, stride_w_, pad_h_, pad_w_ };
   // Different pooling methods. We explicitly do the switch outside the for
   // loop to save time, although this results in more code.
   switch (this->layer_param_.pooling_param().pool()) {
@@ -147,76 +298,13 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       caffe_set(top_count, -1, mask);
     }
     caffe_set(top_count, Dtype(-FLT_MAX), top_data);
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_);
-            int wend = min(wstart + kernel_w_, width_);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            const int pool_index = ph * pooled_width_ + pw;
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                const int index = h * width_ + w;
-                if (bottom_data[index] > top_data[pool_index]) {
-                  top_data[pool_index] = bottom_data[index];
-                  if (use_top_mask) {
-                    top_mask[pool_index] = static_cast<Dtype>(index);
-                  } else {
-                    mask[pool_index] = index;
-                  }
-                }
-              }
-            }
-          }
-        }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-        if (use_top_mask) {
-          top_mask += top[0]->offset(0, 1);
-        } else {
-          mask += top[0]->offset(0, 1);
-        }
-      }
-    }
+    CAFFE_CPU_DISPATCH_TEMPLATE(max_pool_forward, Dtype)(geometry,
+        bottom_data, top_data, mask, top_mask);
     break;
   case PoolingParameter_PoolMethod_AVE:
-    for (int i = 0; i < top_count; ++i) {
-      top_data[i] = 0;
-    }
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_ + pad_h_);
-            int wend = min(wstart + kernel_w_, width_ + pad_w_);
-            int pool_size = (hend - hstart) * (wend - wstart);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            hend = min(hend, height_);
-            wend = min(wend, width_);
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                top_data[ph * pooled_width_ + pw] +=
-                    bottom_data[h * width_ + w];
-              }
-            }
-            top_data[ph * pooled_width_ + pw] /= pool_size;
-          }
-        }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-      }
-    }
+    caffe_set(top_count, Dtype(0), top_data);
+    CAFFE_CPU_DISPATCH_TEMPLATE(ave_pool_forward, Dtype)(geometry,
+        bottom_data, top_data);
     break;
   case PoolingParameter_PoolMethod_STOCHASTIC:
     NOT_IMPLEMENTED;
@@ -241,62 +329,23 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   const bool use_top_mask = top.size() > 1;
   const int* mask = NULL;  // suppress warnings about uninitialized variables
   const Dtype* top_mask = NULL;
+  const PoolingGeometry geometry = {
+    top[0]->num() * channels_, height_, width_,
+    pooled_height_, pooled_width_, kernel_h_, kernel_w_,
+    stride_h_, stride_w_, pad_h_, pad_w_ };
   switch (this->layer_param_.pooling_param().pool()) {
   case PoolingParameter_PoolMethod_MAX:
-    // The main loop
     if (use_top_mask) {
       top_mask = top[1]->cpu_data();
     } else {
       mask = max_idx_.cpu_data();
     }
-    for (int n = 0; n < top[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            const int index = ph * pooled_width_ + pw;
-            const int bottom_index =
-                use_top_mask ? top_mask[index] : mask[index];
-            bottom_diff[bottom_index] += top_diff[index];
-          }
-        }
-        bottom_diff += bottom[0]->offset(0, 1);
-        top_diff += top[0]->offset(0, 1);
-        if (use_top_mask) {
-          top_mask += top[0]->offset(0, 1);
-        } else {
-          mask += top[0]->offset(0, 1);
-        }
-      }
-    }
+    CAFFE_CPU_DISPATCH_TEMPLATE(max_pool_backward, Dtype)(geometry, top_diff,
+        mask, top_mask, bottom_diff);
     break;
   case PoolingParameter_PoolMethod_AVE:
-    // The main loop
-    for (int n = 0; n < top[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_ + pad_h_);
-            int wend = min(wstart + kernel_w_, width_ + pad_w_);
-            int pool_size = (hend - hstart) * (wend - wstart);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            hend = min(hend, height_);
-            wend = min(wend, width_);
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                bottom_diff[h * width_ + w] +=
-                  top_diff[ph * pooled_width_ + pw] / pool_size;
-              }
-            }
-          }
-        }
-        // offset
-        bottom_diff += bottom[0]->offset(0, 1);
-        top_diff += top[0]->offset(0, 1);
-      }
-    }
+    CAFFE_CPU_DISPATCH_TEMPLATE(ave_pool_backward, Dtype)(geometry, top_diff,
+        bottom_diff);
     break;
   case PoolingParameter_PoolMethod_STOCHASTIC:
     NOT_IMPLEMENTED;
@@ -306,7 +355,6 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
 }
 
-
 #ifdef CPU_ONLY
 STUB_GPU(PoolingLayer);
 #endif
@@ -1,10 +1,73 @@
+#include <boost/bind.hpp>
 #include <algorithm>
 #include <vector>
 
 #include "caffe/layers/relu_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+template <typename Dtype>
+static void relu_forward(const int begin, const int end,
+    const Dtype* bottom_data, const Dtype negative_slope, Dtype* top_data) {
+  for (int i = begin; i < end; ++i) {
+    top_data[i] = std::max(bottom_data[i], Dtype(0))
+        + negative_slope * std::min(bottom_data[i], Dtype(0));
+  }
+}
+
+template <typename Dtype>
+static void relu_backward(const int begin, const int end,
+    const Dtype* bottom_data, const Dtype* top_diff,
+    const Dtype negative_slope, Dtype* bottom_diff) {
+  for (int i = begin; i < end; ++i) {
+    bottom_diff[i] = top_diff[i] * ((bottom_data[i] > 0)
+        + negative_slope * (bottom_data[i] <= 0));
+  }
+}
+
+// The bit mask variants work on words of 32 inputs, so that the threads write
+// disjoint words.
+template <typename Dtype>
+static void relu_forward_mask(const int begin, const int end, const int count,
+    const Dtype* bottom_data, const Dtype negative_slope, Dtype* top_data,
+    unsigned int* mask) {
+  for (int w = begin; w < end; ++w) {
+    const int i_end = std::min(count, (w + 1) * 32);
+    unsigned int bits = 0;
+    for (int i = w * 32; i < i_end; ++i) {
+      const Dtype x = bottom_data[i];
+      bits |= static_cast<unsigned int>(x > 0) << (i % 32);
+      top_data[i] = std::max(x, Dtype(0))
+          + negative_slope * std::min(x, Dtype(0));
+    }
+    mask[w] = bits;
+  }
+}
+
+template <typename Dtype>
+static void relu_backward_mask(const int begin, const int end, const int count,
+    const unsigned int* mask, const Dtype* top_diff,
+    const Dtype negative_slope, Dtype* bottom_diff) {
+  for (int w = begin; w < end; ++w) {
+    const int i_end = std::min(count, (w + 1) * 32);
+    const unsigned int bits = mask[w];
+    for (int i = w * 32; i < i_end; ++i) {
+      bottom_diff[i] = top_diff[i] * (((bits >> (i % 32)) & 1) ?
+          Dtype(1) : negative_slope);
+    }
+  }
+}
+
+template <typename Dtype>
+void ReLULayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  NeuronLayer<Dtype>::Reshape(bottom, top);
+  if (this->layer_param_.relu_param().bit_mask()) {
+    mask_.Reshape(1, 1, 1, (bottom[0]->count() + 31) / 32);
+  }
+}
+
 template <typename Dtype>
 void ReLULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
@@ -12,10 +75,14 @@ void ReLULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
   Dtype negative_slope = this->layer_param_.relu_param().negative_slope();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = std::max(bottom_data[i], Dtype(0))
-        + negative_slope * std::min(bottom_data[i], Dtype(0));
+  if (this->layer_param_.relu_param().bit_mask()) {
+    parallel_for(mask_.count(), boost::bind(&relu_forward_mask<Dtype>, _1, _2,
+        count, bottom_data, negative_slope, top_data,
+        mask_.mutable_cpu_data()), 16384 / 32);
+    return;
   }
+  parallel_for(count, boost::bind(&relu_forward<Dtype>, _1, _2,
+      bottom_data, negative_slope, top_data));
 }
 
 template <typename Dtype>
@@ -23,15 +90,19 @@ void ReLULayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
   if (propagate_down[0]) {
-    const Dtype* bottom_data = bottom[0]->cpu_data();
     const Dtype* top_diff = top[0]->cpu_diff();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const int count = bottom[0]->count();
     Dtype negative_slope = this->layer_param_.relu_param().negative_slope();
-    for (int i = 0; i < count; ++i) {
-      bottom_diff[i] = top_diff[i] * ((bottom_data[i] > 0)
-          + negative_slope * (bottom_data[i] <= 0));
+    if (this->layer_param_.relu_param().bit_mask()) {
+      parallel_for(mask_.count(), boost::bind(&relu_backward_mask<Dtype>, _1,
+          _2, count, mask_.cpu_data(), top_diff, negative_slope,
+          bottom_diff), 16384 / 32);
+      return;
     }
+    const Dtype* bottom_data = bottom[0]->cpu_data();
+    parallel_for(count, boost::bind(&relu_backward<Dtype>, _1, _2,
+        bottom_data, top_diff, negative_slope, bottom_diff));
   }
 }
 
@@ -1,21 +1,39 @@
 // TanH neuron activation function layer.
 // Adapted from ReLU layer code written by Yangqing Jia
 
+#include <boost/bind.hpp>
 #include <vector>
 
 #include "caffe/layers/tanh_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+template <typename Dtype>
+static void tanh_forward(const int begin, const int end,
+    const Dtype* bottom_data, Dtype* top_data) {
+  caffe_tanh(end - begin, bottom_data + begin, top_data + begin);
+}
+
+template <typename Dtype>
+static void tanh_backward(const int begin, const int end,
+    const Dtype* top_data, const Dtype* top_diff, Dtype* bottom_diff) {
+  Dtype tanhx;
+  for (int i = begin; i < end; ++i) {
+    tanhx = top_data[i];
+    bottom_diff[i] = top_diff[i] * (1 - tanhx * tanhx);
+  }
+}
+
 template <typename Dtype>
 void TanHLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = tanh(bottom_data[i]);
-  }
+  parallel_for(count, boost::bind(&tanh_forward<Dtype>, _1, _2,
+      bottom_data, top_data));
 }
 
 template <typename Dtype>
@@ -27,11 +45,8 @@ void TanHLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const Dtype* top_diff = top[0]->cpu_diff();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const int count = bottom[0]->count();
-    Dtype tanhx;
-    for (int i = 0; i < count; ++i) {
-      tanhx = top_data[i];
-      bottom_diff[i] = top_diff[i] * (1 - tanhx * tanhx);
-    }
+    parallel_for(count, boost::bind(&tanh_backward<Dtype>, _1, _2,
+        top_data, top_diff, bottom_diff));
   }
 }
 
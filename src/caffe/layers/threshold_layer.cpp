@@ -1,9 +1,19 @@
+#include <boost/bind.hpp>
 #include <vector>
 
 #include "caffe/layers/threshold_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+template <typename Dtype>
+static void threshold_forward(const int begin, const int end,
+    const Dtype* bottom_data, const Dtype threshold, Dtype* top_data) {
+  for (int i = begin; i < end; ++i) {
+    top_data[i] = (bottom_data[i] > threshold) ? Dtype(1) : Dtype(0);
+  }
+}
+
 template <typename Dtype>
 void ThresholdLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -17,9 +27,8 @@ void ThresholdLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = (bottom_data[i] > threshold_) ? Dtype(1) : Dtype(0);
-  }
+  parallel_for(count, boost::bind(&threshold_forward<Dtype>, _1, _2,
+      bottom_data, threshold_, top_data));
 }
 
 #ifdef CPU_ONLY
@@ -1,4 +1,7 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
 #include <algorithm>
+#include <deque>
 #include <map>
 #include <set>
 #include <string>
@@ -12,9 +15,13 @@
 #include "caffe/net.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/fuse_layers.hpp"
 #include "caffe/util/hdf5.hpp"
+#include "caffe/util/in_place_activations.hpp"
 #include "caffe/util/insert_splits.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+#include "caffe/util/trace.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -23,19 +30,25 @@ namespace caffe {
 
 template <typename Dtype>
 Net<Dtype>::Net(const NetParameter& param, const Net* root_net)
-    : root_net_(root_net) {
+    : root_net_(root_net), weights_net_(NULL) {
   Init(param);
 }
 
 template <typename Dtype>
 Net<Dtype>::Net(const string& param_file, Phase phase, const Net* root_net)
-    : root_net_(root_net) {
+    : root_net_(root_net), weights_net_(NULL) {
   NetParameter param;
   ReadNetParamsFromTextFileOrDie(param_file, &param);
   param.mutable_state()->set_phase(phase);
   Init(param);
 }
 
+template <typename Dtype>
+Net<Dtype>::Net(const NetParameter& param, const Net& weights_net)
+    : root_net_(NULL), weights_net_(&weights_net) {
+  Init(param);
+}
+
 template <typename Dtype>
 void Net<Dtype>::Init(const NetParameter& in_param) {
   CHECK(Caffe::root_solver() || root_net_)
@@ -46,6 +59,17 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   // the current NetState.
   NetParameter filtered_param;
   FilterNet(in_param, &filtered_param);
+  // Fold layers for inference if requested.
+  fuse_layers_ = in_param.fuse_layers() && phase_ == TEST;
+  if (fuse_layers_) {
+    NetParameter unfused_param(filtered_param);
+    FuseLayers(unfused_param, NULL, &filtered_param, &fused_layer_names_);
+  }
+  // Compute activations in place where possible if requested.
+  if (in_param.save_memory()) {
+    NetParameter out_of_place_param(filtered_param);
+    MakeActivationsInPlace(out_of_place_param, &filtered_param);
+  }
   LOG_IF(INFO, Caffe::root_solver())
       << "Initializing net from parameters: " << std::endl
       << filtered_param.DebugString();
@@ -86,8 +110,25 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
       layers_[layer_id]->SetShared(true);
     } else {
       layers_.push_back(LayerRegistry<Dtype>::CreateLayer(layer_param));
+      if (weights_net_ && weights_net_->has_layer(layer_param.name())) {
+        // Layers with parameter blobs already skip filling them in SetUp.
+        Layer<Dtype>& source_layer =
+            *weights_net_->layer_by_name(layer_param.name());
+        CHECK_EQ(source_layer.layer_param().type(), layer_param.type())
+            << "Cannot share the parameters of layer " << layer_param.name()
+            << " with a layer of another type.";
+        vector<shared_ptr<Blob<Dtype> > >& blobs = layers_[layer_id]->blobs();
+        blobs.resize(source_layer.blobs().size());
+        for (int j = 0; j < blobs.size(); ++j) {
+          const Blob<Dtype>& source_blob = *source_layer.blobs()[j];
+          blobs[j].reset(new Blob<Dtype>(source_blob.shape()));
+          blobs[j]->ShareData(source_blob);
+        }
+      }
     }
     layer_names_.push_back(layer_param.name());
+    layer_workspace_tags_.push_back(
+        SyncedMemory::Tag(layer_param.name() + "/workspace"));
     LOG_IF(INFO, Caffe::root_solver())
         << "Creating Layer " << layer_param.name();
     bool need_backward = false;
@@ -136,6 +177,7 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
             << layer_param.name();
       }
     } else {
+      MemoryTagScope memory_tag(layer_workspace_tags_[layer_id]);
       layers_[layer_id]->SetUp(bottom_vecs_[layer_id], top_vecs_[layer_id]);
     }
     LOG_IF(INFO, Caffe::root_solver())
@@ -179,6 +221,7 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
       }
     }
   }
+  SetUpSharedBottoms();
   // Go through the net backwards to determine which blobs contribute to the
   // loss.  We can skip backward computation for blobs that don't contribute
   // to the loss.
@@ -187,6 +230,7 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   // computation for the entire layer
   set<string> blobs_under_loss;
   set<string> blobs_skip_backp;
+  set<string> blobs_need_backp;
   for (int layer_id = layers_.size() - 1; layer_id >= 0; --layer_id) {
     bool layer_contributes_loss = false;
     bool layer_skip_propagate_down = true;
@@ -202,6 +246,12 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
       if (layer_contributes_loss && !layer_skip_propagate_down)
         break;
     }
+    // The tops of this layer shadow any earlier (in-place) use of their names.
+    for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
+      const string& blob_name = blob_names_[top_id_vecs_[layer_id][top_id]];
+      blobs_skip_backp.erase(blob_name);
+      blobs_need_backp.erase(blob_name);
+    }
     // If this layer can skip backward computation, also all his bottom blobs
     // don't need backpropagation
     if (layer_need_backward_[layer_id] && layer_skip_propagate_down) {
@@ -229,10 +279,17 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
       } else {
         bottom_need_backward_[layer_id][bottom_id] = false;
       }
+      // A blob read by several layers can only skip backpropagation if none
+      // of them propagates down to it.
+      const string& blob_name =
+          blob_names_[bottom_id_vecs_[layer_id][bottom_id]];
       if (!bottom_need_backward_[layer_id][bottom_id]) {
-        const string& blob_name =
-                   blob_names_[bottom_id_vecs_[layer_id][bottom_id]];
-        blobs_skip_backp.insert(blob_name);
+        if (blobs_need_backp.find(blob_name) == blobs_need_backp.end()) {
+          blobs_skip_backp.insert(blob_name);
+        }
+      } else {
+        blobs_need_backp.insert(blob_name);
+        blobs_skip_backp.erase(blob_name);
       }
     }
   }
@@ -270,6 +327,10 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     layer_names_index_[layer_names_[layer_id]] = layer_id;
   }
   ShareWeights();
+  TagMemory();
+  InitCheckpoints(param);
+  ShareCheckpointScratch();
+  InitLayerGraph(param);
   debug_info_ = param.debug_info();
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
 }
@@ -417,7 +478,11 @@ int Net<Dtype>::AppendBottom(const NetParameter& param, const int layer_id,
     map<string, int>* blob_name_to_idx) {
   const LayerParameter& layer_param = param.layer(layer_id);
   const string& blob_name = layer_param.bottom(bottom_id);
-  if (available_blobs->find(blob_name) == available_blobs->end()) {
+  // Without splits (see NetParameter.insert_splits) a blob may already have
+  // been consumed by an earlier layer.
+  if (available_blobs->find(blob_name) == available_blobs->end() &&
+      (param.insert_splits() ||
+       blob_name_to_idx->find(blob_name) == blob_name_to_idx->end())) {
     LOG(FATAL) << "Unknown bottom blob '" << blob_name << "' (layer '"
                << layer_param.name() << "', bottom index " << bottom_id << ")";
   }
@@ -436,6 +501,423 @@ int Net<Dtype>::AppendBottom(const NetParameter& param, const int layer_id,
   return blob_id;
 }
 
+template <typename Dtype>
+void Net<Dtype>::SetUpSharedBottoms() {
+  // Group the bottoms by the blob they read, telling apart the versions of a
+  // blob that is overwritten by an in-place layer.
+  vector<int> blob_version(blobs_.size(), 0);
+  map<pair<int, int>, vector<pair<int, int> > > blob_consumers;
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    for (int bottom_id = 0; bottom_id < bottom_id_vecs_[layer_id].size();
+         ++bottom_id) {
+      const int blob_id = bottom_id_vecs_[layer_id][bottom_id];
+      blob_consumers[make_pair(blob_id, blob_version[blob_id])].push_back(
+          make_pair(layer_id, bottom_id));
+    }
+    for (int top_id = 0; top_id < top_id_vecs_[layer_id].size(); ++top_id) {
+      ++blob_version[top_id_vecs_[layer_id][top_id]];
+    }
+  }
+  shared_bottom_vecs_.resize(layers_.size());
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    shared_bottom_vecs_[layer_id].resize(bottom_vecs_[layer_id].size());
+  }
+  typename map<pair<int, int>, vector<pair<int, int> > >::const_iterator it;
+  for (it = blob_consumers.begin(); it != blob_consumers.end(); ++it) {
+    const vector<pair<int, int> >& consumers = it->second;
+    if (consumers.size() < 2) { continue; }
+    const int blob_id = it->first.first;
+    for (int i = 0; i < consumers.size(); ++i) {
+      const int layer_id = consumers[i].first;
+      const int bottom_id = consumers[i].second;
+      const vector<int>& top_ids = top_id_vecs_[layer_id];
+      CHECK(std::find(top_ids.begin(), top_ids.end(), blob_id) ==
+            top_ids.end()) << "Layer " << layer_names_[layer_id]
+          << " cannot compute in-place on blob " << blob_names_[blob_id]
+          << " shared with other layers";
+      shared_ptr<Blob<Dtype> > view(new Blob<Dtype>());
+      shared_bottom_vecs_[layer_id][bottom_id] = view;
+      bottom_vecs_[layer_id][bottom_id] = view.get();
+    }
+    LOG_IF(INFO, Caffe::root_solver()) << "Sharing blob "
+        << blob_names_[blob_id] << " among " << consumers.size() << " layers";
+  }
+  shared_diff_written_.resize(blobs_.size());
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    SyncSharedBottoms(layer_id);
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::SyncSharedBottoms(const int layer_id) {
+  const vector<shared_ptr<Blob<Dtype> > >& views =
+      shared_bottom_vecs_[layer_id];
+  for (int bottom_id = 0; bottom_id < views.size(); ++bottom_id) {
+    if (!views[bottom_id]) { continue; }
+    const Blob<Dtype>& blob = *blobs_[bottom_id_vecs_[layer_id][bottom_id]];
+    views[bottom_id]->ReshapeLike(blob);
+    views[bottom_id]->ShareData(blob);
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::InitCheckpoints(const NetParameter& param) {
+  live_segment_ = -1;
+  CHECK_GE(param.checkpoint_every(), 0)
+      << "checkpoint_every must not be negative";
+  // Without backward nothing is recomputed, and the blobs of a TEST net are
+  // read after Forward: keep them all.
+  if (phase_ != TRAIN) { return; }
+  const int num_layers = layers_.size();
+  vector<bool> cut_requested(num_layers, false);
+  bool checkpointing = false;
+  for (int layer_id = 0; layer_id + 1 < num_layers; ++layer_id) {
+    cut_requested[layer_id] = layers_[layer_id]->layer_param().checkpoint() ||
+        (param.checkpoint_every() > 0 &&
+         (layer_id + 1) % param.checkpoint_every() == 0);
+    checkpointing = checkpointing || cut_requested[layer_id];
+  }
+  if (!checkpointing) { return; }
+  // Cut only where no blob is written on both sides, so that the blobs kept
+  // at a cut stay as the segments after it first read them.
+  vector<int> first_writer(blobs_.size(), num_layers);
+  vector<int> last_writer(blobs_.size(), -1);
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    for (int top_id = 0; top_id < top_id_vecs_[layer_id].size(); ++top_id) {
+      const int blob_id = top_id_vecs_[layer_id][top_id];
+      first_writer[blob_id] = std::min(first_writer[blob_id], layer_id);
+      last_writer[blob_id] = std::max(last_writer[blob_id], layer_id);
+    }
+  }
+  layer_segments_.resize(num_layers);
+  segment_starts_.assign(1, 0);
+  bool cut_pending = false;
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    layer_segments_[layer_id] = segment_starts_.size() - 1;
+    cut_pending = cut_pending || cut_requested[layer_id];
+    if (!cut_pending || layer_id + 1 == num_layers) { continue; }
+    bool can_cut = true;
+    for (int blob_id = 0; blob_id < blobs_.size() && can_cut; ++blob_id) {
+      can_cut = layer_id < first_writer[blob_id] ||
+          layer_id >= last_writer[blob_id];
+    }
+    if (can_cut) {
+      segment_starts_.push_back(layer_id + 1);
+      cut_pending = false;
+    }
+  }
+  // A blob may live in scratch memory if the layers using it all belong to
+  // one segment, and if it neither enters nor leaves the net, has no loss
+  // weight and shares no memory with another blob, as the tops of Reshape and
+  // Flatten layers do.
+  const int kUnused = -1, kKept = -2;
+  vector<int> blob_segments(blobs_.size(), kUnused);
+  map<const SyncedMemory*, int> memory_users;
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    vector<int> blob_ids(bottom_id_vecs_[layer_id]);
+    blob_ids.insert(blob_ids.end(), top_id_vecs_[layer_id].begin(),
+                    top_id_vecs_[layer_id].end());
+    for (int i = 0; i < blob_ids.size(); ++i) {
+      int& segment = blob_segments[blob_ids[i]];
+      segment = (segment == kUnused || segment == layer_segments_[layer_id]) ?
+          layer_segments_[layer_id] : kKept;
+    }
+  }
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    ++memory_users[blobs_[blob_id]->data().get()];
+    ++memory_users[blobs_[blob_id]->diff().get()];
+  }
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    const Blob<Dtype>& blob = *blobs_[blob_id];
+    if (blob_loss_weights_[blob_id] != 0 || !blob.data() ||
+        memory_users[blob.data().get()] > 1 ||
+        memory_users[blob.diff().get()] > 1) {
+      blob_segments[blob_id] = kKept;
+    }
+  }
+  for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+    blob_segments[net_input_blob_indices_[i]] = kKept;
+  }
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    blob_segments[net_output_blob_indices_[i]] = kKept;
+  }
+  // Recompute the layers that can repeat their forward and write only scratch
+  // blobs; a blob is kept if a layer writing it is not recomputed. The tops of
+  // a Split layer share the data of its bottom in forward, so they are all
+  // kept if one of them is.
+  layer_recomputed_.resize(num_layers);
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    layer_recomputed_[layer_id] = !bottom_vecs_[layer_id].empty() &&
+        layers_[layer_id]->ForwardIsRepeatable();
+  }
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+      vector<int> blob_ids(top_id_vecs_[layer_id]);
+      const bool split = string(layers_[layer_id]->type()) == "Split";
+      if (split) {
+        blob_ids.push_back(bottom_id_vecs_[layer_id][0]);
+      }
+      bool keep = !layer_recomputed_[layer_id] || blob_ids.empty();
+      for (int i = 0; i < blob_ids.size(); ++i) {
+        keep = keep || blob_segments[blob_ids[i]] == kKept;
+      }
+      if (!keep) { continue; }
+      layer_recomputed_[layer_id] = false;
+      for (int i = 0; i < blob_ids.size(); ++i) {
+        changed = changed || blob_segments[blob_ids[i]] != kKept;
+        blob_segments[blob_ids[i]] = kKept;
+      }
+    }
+  }
+  segment_scratch_blobs_.assign(segment_starts_.size(), vector<int>());
+  int num_scratch_blobs = 0;
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    if (blob_segments[blob_id] >= 0) {
+      segment_scratch_blobs_[blob_segments[blob_id]].push_back(blob_id);
+      ++num_scratch_blobs;
+    }
+  }
+  layer_rngs_.resize(num_layers);
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Checkpointing " << segment_starts_.size() << " segments with "
+      << num_scratch_blobs << " blobs in scratch memory";
+}
+
+template <typename Dtype>
+void Net<Dtype>::ShareCheckpointScratch() {
+  if (layer_segments_.empty()) { return; }
+  // Give the largest blob of each segment slot 0, the next slot 1, and so on.
+  vector<size_t> slot_sizes;
+  for (int segment = 0; segment < segment_scratch_blobs_.size(); ++segment) {
+    vector<int>& blob_ids = segment_scratch_blobs_[segment];
+    vector<pair<int, int> > by_count;
+    for (int i = 0; i < blob_ids.size(); ++i) {
+      by_count.push_back(make_pair(-blobs_[blob_ids[i]]->count(),
+                                   blob_ids[i]));
+    }
+    std::sort(by_count.begin(), by_count.end());
+    if (slot_sizes.size() < by_count.size()) {
+      slot_sizes.resize(by_count.size(), 0);
+    }
+    for (int i = 0; i < by_count.size(); ++i) {
+      blob_ids[i] = by_count[i].second;
+      slot_sizes[i] = std::max(slot_sizes[i],
+                               -by_count[i].first * sizeof(Dtype));
+    }
+  }
+  MemoryTagScope memory_tag(SyncedMemory::Tag("checkpoint/scratch"));
+  scratch_data_.resize(slot_sizes.size());
+  scratch_diff_.resize(slot_sizes.size());
+  for (int i = 0; i < slot_sizes.size(); ++i) {
+    if (!scratch_data_[i] || scratch_data_[i]->size() < slot_sizes[i]) {
+      scratch_data_[i].reset(new SyncedMemory(slot_sizes[i]));
+      scratch_diff_[i].reset(new SyncedMemory(slot_sizes[i]));
+    }
+  }
+  for (int segment = 0; segment < segment_scratch_blobs_.size(); ++segment) {
+    const vector<int>& blob_ids = segment_scratch_blobs_[segment];
+    for (int i = 0; i < blob_ids.size(); ++i) {
+      blobs_[blob_ids[i]]->UseMemory(scratch_data_[i], scratch_diff_[i]);
+    }
+  }
+  live_segment_ = -1;
+}
+
+template <typename Dtype>
+void Net<Dtype>::RecomputeSegment(const int segment) {
+  const int start = segment_starts_[segment];
+  const int end = segment + 1 < segment_starts_.size() ?
+      segment_starts_[segment + 1] : layers_.size();
+  const rng_t rng = *caffe_rng();
+  for (int layer_id = start; layer_id < end; ++layer_id) {
+    if (!layer_recomputed_[layer_id]) { continue; }
+    TraceScope trace("recompute", layer_names_[layer_id].c_str());
+    MemoryTagScope memory_tag(layer_workspace_tags_[layer_id]);
+    Layer<Dtype>& layer = *layers_[layer_id];
+    vector<shared_ptr<Blob<Dtype> > > saved_blobs;
+    if (layer.ForwardChangesBlobs()) {
+      for (int i = 0; i < layer.blobs().size(); ++i) {
+        saved_blobs.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+        saved_blobs[i]->CopyFrom(*layer.blobs()[i], false, true);
+      }
+    }
+    *caffe_rng() = layer_rngs_[layer_id];
+    SyncSharedBottoms(layer_id);
+    layer.Forward(bottom_vecs_[layer_id], top_vecs_[layer_id]);
+    for (int i = 0; i < saved_blobs.size(); ++i) {
+      layer.blobs()[i]->CopyFrom(*saved_blobs[i]);
+    }
+  }
+  *caffe_rng() = rng;
+  live_segment_ = segment;
+}
+
+template <typename Dtype>
+void Net<Dtype>::InitLayerGraph(const NetParameter& param) {
+  CHECK_GE(param.branch_threads(), 1) << "branch_threads must be positive";
+  if (param.branch_threads() == 1) { return; }
+  // In forward, a layer waits for the last layer writing each blob it reads
+  // or writes, and for the layers reading a blob it overwrites (in-place).
+  const int num_layers = layers_.size();
+  vector<int> last_writer(blobs_.size(), -1);
+  vector<vector<int> > readers(blobs_.size());
+  forward_layer_deps_.resize(num_layers);
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    set<int> deps;
+    for (int bottom_id = 0; bottom_id < bottom_id_vecs_[layer_id].size();
+         ++bottom_id) {
+      const int blob_id = bottom_id_vecs_[layer_id][bottom_id];
+      if (last_writer[blob_id] >= 0) { deps.insert(last_writer[blob_id]); }
+    }
+    for (int top_id = 0; top_id < top_id_vecs_[layer_id].size(); ++top_id) {
+      const int blob_id = top_id_vecs_[layer_id][top_id];
+      if (last_writer[blob_id] >= 0) { deps.insert(last_writer[blob_id]); }
+      deps.insert(readers[blob_id].begin(), readers[blob_id].end());
+    }
+    for (int bottom_id = 0; bottom_id < bottom_id_vecs_[layer_id].size();
+         ++bottom_id) {
+      readers[bottom_id_vecs_[layer_id][bottom_id]].push_back(layer_id);
+    }
+    for (int top_id = 0; top_id < top_id_vecs_[layer_id].size(); ++top_id) {
+      const int blob_id = top_id_vecs_[layer_id][top_id];
+      last_writer[blob_id] = layer_id;
+      readers[blob_id].clear();
+    }
+    forward_layer_deps_[layer_id].assign(deps.begin(), deps.end());
+  }
+  // In backward, a layer waits for the layers that waited for it in forward,
+  // and for the later layers accumulating into the diff of a shared param.
+  // The diffs of blobs shared without Split layers are accumulated in order,
+  // so backward then runs in order.
+  bool has_shared_bottoms = false;
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    for (int bottom_id = 0; bottom_id < shared_bottom_vecs_[layer_id].size();
+         ++bottom_id) {
+      if (shared_bottom_vecs_[layer_id][bottom_id]) {
+        has_shared_bottoms = true;
+      }
+    }
+  }
+  if (!has_shared_bottoms) {
+    vector<set<int> > deps(num_layers);
+    for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+      for (int i = 0; i < forward_layer_deps_[layer_id].size(); ++i) {
+        deps[forward_layer_deps_[layer_id][i]].insert(layer_id);
+      }
+    }
+    vector<int> last_param_user(params_.size(), -1);
+    for (int param_id = params_.size() - 1; param_id >= 0; --param_id) {
+      const int owner_id = param_owners_[param_id] < 0 ?
+          param_id : param_owners_[param_id];
+      const int layer_id = param_layer_indices_[param_id].first;
+      if (last_param_user[owner_id] > layer_id) {
+        deps[layer_id].insert(last_param_user[owner_id]);
+      }
+      last_param_user[owner_id] = layer_id;
+    }
+    backward_layer_deps_.resize(num_layers);
+    for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+      backward_layer_deps_[layer_id].assign(deps[layer_id].begin(),
+                                            deps[layer_id].end());
+    }
+  }
+  branch_pool_.reset(new ThreadPool(param.branch_threads()));
+  layer_losses_.resize(num_layers);
+  LOG_IF(INFO, Caffe::root_solver()) << "Running independent layers on "
+      << param.branch_threads() << " threads";
+}
+
+template <typename Dtype>
+class Net<Dtype>::LayerGraphRun {
+ public:
+  boost::mutex mutex_;
+  boost::condition_variable layer_ready_;
+  // The number of layers each layer still waits for, and the layers waiting
+  // for it, indexed by layer id.
+  vector<int> num_deps_;
+  vector<vector<int> > dependents_;
+  std::deque<int> ready_;
+  int num_left_;
+};
+
+template <typename Dtype>
+void Net<Dtype>::RunLayerGraph(const int start, const int end,
+                               const bool forward) {
+  const vector<vector<int> >& deps =
+      forward ? forward_layer_deps_ : backward_layer_deps_;
+  const int first = std::min(start, end);
+  const int last = std::max(start, end);
+  LayerGraphRun run;
+  run.num_deps_.resize(layers_.size(), 0);
+  run.dependents_.resize(layers_.size());
+  for (int layer_id = first; layer_id <= last; ++layer_id) {
+    for (int i = 0; i < deps[layer_id].size(); ++i) {
+      const int dep_id = deps[layer_id][i];
+      if (dep_id < first || dep_id > last) { continue; }
+      ++run.num_deps_[layer_id];
+      run.dependents_[dep_id].push_back(layer_id);
+    }
+  }
+  const int step = forward ? 1 : -1;
+  for (int layer_id = start; layer_id != end + step; layer_id += step) {
+    if (run.num_deps_[layer_id] == 0) { run.ready_.push_back(layer_id); }
+  }
+  run.num_left_ = last - first + 1;
+  // Split the BLAS threads among the branch threads.
+  const int blas_threads = caffe_blas_num_threads();
+  caffe_set_blas_num_threads(
+      std::max(1, blas_threads / branch_pool_->size()));
+  branch_pool_->Run(branch_pool_->size(), boost::bind(
+      &Net<Dtype>::RunLayerGraphWorker, this, &run, forward));
+  caffe_set_blas_num_threads(blas_threads);
+}
+
+template <typename Dtype>
+void Net<Dtype>::RunLayerGraphWorker(LayerGraphRun* run, const bool forward) {
+  boost::mutex::scoped_lock lock(run->mutex_);
+  int layer_id = -1;
+  while (true) {
+    if (layer_id < 0) {
+      while (run->ready_.empty() && run->num_left_ > 0) {
+        run->layer_ready_.wait(lock);
+      }
+      if (run->num_left_ == 0) { return; }
+      layer_id = run->ready_.front();
+      run->ready_.pop_front();
+    }
+    lock.unlock();
+    MemoryTagScope memory_tag(layer_workspace_tags_[layer_id]);
+    if (forward) {
+      TraceScope trace("forward", layer_names_[layer_id].c_str());
+      SyncSharedBottoms(layer_id);
+      layer_losses_[layer_id] = layers_[layer_id]->Forward(
+          bottom_vecs_[layer_id], top_vecs_[layer_id]);
+    } else if (layer_need_backward_[layer_id]) {
+      TraceScope trace("backward", layer_names_[layer_id].c_str());
+      layers_[layer_id]->Backward(top_vecs_[layer_id],
+          bottom_need_backward_[layer_id], bottom_vecs_[layer_id]);
+    }
+    lock.lock();
+    // Continue with a layer that became ready, while its inputs are still
+    // in cache, and leave any others to the other threads.
+    const vector<int>& dependents = run->dependents_[layer_id];
+    layer_id = -1;
+    for (int i = 0; i < dependents.size(); ++i) {
+      if (--run->num_deps_[dependents[i]] > 0) { continue; }
+      if (layer_id < 0) {
+        layer_id = dependents[i];
+      } else {
+        run->ready_.push_back(dependents[i]);
+        run->layer_ready_.notify_one();
+      }
+    }
+    if (--run->num_left_ == 0) {
+      run->layer_ready_.notify_all();
+    }
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::AppendParam(const NetParameter& param, const int layer_id,
                              const int param_id) {
@@ -536,8 +1018,23 @@ Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
   CHECK_GE(start, 0);
   CHECK_LT(end, layers_.size());
   Dtype loss = 0;
+  if (branch_pool_ && layer_segments_.empty() && Caffe::mode() == Caffe::CPU &&
+      !debug_info_) {
+    RunLayerGraph(start, end, true);
+    for (int i = start; i <= end; ++i) {
+      loss += layer_losses_[i];
+    }
+    return loss;
+  }
   for (int i = start; i <= end; ++i) {
     // LOG(ERROR) << "Forwarding " << layer_names_[i];
+    TraceScope trace("forward", layer_names_[i].c_str());
+    MemoryTagScope memory_tag(layer_workspace_tags_[i]);
+    SyncSharedBottoms(i);
+    if (!layer_segments_.empty()) {
+      if (layer_recomputed_[i]) { layer_rngs_[i] = *caffe_rng(); }
+      live_segment_ = layer_segments_[i];
+    }
     Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
     loss += layer_loss;
     if (debug_info_) { ForwardDebugInfo(i); }
@@ -581,10 +1078,65 @@ template <typename Dtype>
 void Net<Dtype>::BackwardFromTo(int start, int end) {
   CHECK_GE(end, 0);
   CHECK_LT(start, layers_.size());
+  if (branch_pool_ && !backward_layer_deps_.empty() &&
+      layer_segments_.empty() && Caffe::mode() == Caffe::CPU && !debug_info_) {
+    RunLayerGraph(start, end, false);
+    return;
+  }
+  std::fill(shared_diff_written_.begin(), shared_diff_written_.end(), false);
   for (int i = start; i >= end; --i) {
+    if (layer_need_backward_[i] && !layer_segments_.empty() &&
+        layer_segments_[i] != live_segment_) {
+      RecomputeSegment(layer_segments_[i]);
+    }
     if (layer_need_backward_[i]) {
+      TraceScope trace("backward", layer_names_[i].c_str());
+      MemoryTagScope memory_tag(layer_workspace_tags_[i]);
+      const vector<shared_ptr<Blob<Dtype> > >& views = shared_bottom_vecs_[i];
+      SyncSharedBottoms(i);
+      // The first layer to propagate down to a shared blob writes its diff
+      // directly; the others write to scratch and accumulate below.
+      for (int j = 0; j < views.size(); ++j) {
+        if (!views[j] || !bottom_need_backward_[i][j]) { continue; }
+        const int blob_id = bottom_id_vecs_[i][j];
+        if (!shared_diff_written_[blob_id]) {
+          views[j]->ShareDiff(*blobs_[blob_id]);
+          continue;
+        }
+        if (shared_bottom_diffs_.size() <= j) {
+          shared_bottom_diffs_.resize(j + 1);
+        }
+        if (!shared_bottom_diffs_[j]) {
+          shared_bottom_diffs_[j].reset(new Blob<Dtype>());
+        }
+        shared_bottom_diffs_[j]->ReshapeLike(*blobs_[blob_id]);
+        views[j]->ShareDiff(*shared_bottom_diffs_[j]);
+      }
       layers_[i]->Backward(
           top_vecs_[i], bottom_need_backward_[i], bottom_vecs_[i]);
+      for (int j = 0; j < views.size(); ++j) {
+        if (!views[j] || !bottom_need_backward_[i][j]) { continue; }
+        const int blob_id = bottom_id_vecs_[i][j];
+        Blob<Dtype>* blob = blobs_[blob_id].get();
+        if (!shared_diff_written_[blob_id]) {
+          shared_diff_written_[blob_id] = true;
+          continue;
+        }
+        switch (Caffe::mode()) {
+        case Caffe::CPU:
+          caffe_axpy(blob->count(), Dtype(1), views[j]->cpu_diff(),
+                     blob->mutable_cpu_diff());
+          break;
+        case Caffe::GPU:
+#ifndef CPU_ONLY
+          caffe_gpu_axpy(blob->count(), Dtype(1), views[j]->gpu_diff(),
+                         blob->mutable_gpu_diff());
+#else
+          NO_GPU;
+#endif
+          break;
+        }
+      }
       if (debug_info_) { BackwardDebugInfo(i); }
     }
   }
@@ -621,7 +1173,7 @@ void Net<Dtype>::BackwardDebugInfo(const int layer_id) {
   const vector<Blob<Dtype>*>& bottom_vec = bottom_vecs_[layer_id];
   for (int bottom_id = 0; bottom_id < bottom_vec.size(); ++bottom_id) {
     if (!bottom_need_backward_[layer_id][bottom_id]) { continue; }
-    const Blob<Dtype>& blob = *bottom_vec[bottom_id];
+    const Blob<Dtype>& blob = *blobs_[bottom_id_vecs_[layer_id][bottom_id]];
     const string& blob_name = blob_names_[bottom_id_vecs_[layer_id][bottom_id]];
     const Dtype diff_abs_val_mean = blob.asum_diff() / blob.count();
     LOG_IF(INFO, Caffe::root_solver())
@@ -671,6 +1223,10 @@ void Net<Dtype>::UpdateDebugInfo(const int param_id) {
 
 template <typename Dtype>
 void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
+  CHECK(!fuse_layers_ || (other->fuse_layers_ &&
+      other->fused_layer_names_ == fused_layer_names_))
+      << "Cannot share the layers of a net fused differently with net "
+      << name_ << " whose layers are fused.";
   int num_source_layers = other->layers().size();
   for (int i = 0; i < num_source_layers; ++i) {
     Layer<Dtype>* source_layer = other->layers()[i].get();
@@ -733,12 +1289,31 @@ void Net<Dtype>::Backward() {
 template <typename Dtype>
 void Net<Dtype>::Reshape() {
   for (int i = 0; i < layers_.size(); ++i) {
+    MemoryTagScope memory_tag(layer_workspace_tags_[i]);
+    SyncSharedBottoms(i);
     layers_[i]->Reshape(bottom_vecs_[i], top_vecs_[i]);
   }
+  ShareCheckpointScratch();
 }
 
 template <typename Dtype>
-void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
+void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& in_param) {
+  // Fold the source layers that were folded in this net, and only those;
+  // the source is commonly a snapshot of the TRAIN net.
+  NetParameter fused_param;
+  if (fuse_layers_) {
+    NetParameter source_param(in_param);
+    source_param.mutable_state()->set_phase(TEST);
+    for (int i = 0; i < source_param.layer_size(); ++i) {
+      LayerParameter* source_layer = source_param.mutable_layer(i);
+      source_layer->clear_phase();
+      if (source_layer->has_batch_norm_param()) {
+        source_layer->mutable_batch_norm_param()->clear_use_global_stats();
+      }
+    }
+    FuseLayers(source_param, &fused_layer_names_, &fused_param, NULL);
+  }
+  const NetParameter& param = fuse_layers_ ? fused_param : in_param;
   int num_source_layers = param.layer_size();
   for (int i = 0; i < num_source_layers; ++i) {
     const LayerParameter& source_layer = param.layer(i);
@@ -795,6 +1370,8 @@ void Net<Dtype>::CopyTrainedLayersFromBinaryProto(
 
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
+  CHECK(!fuse_layers_) << "Folding the layers of HDF5 weights is not "
+      << "supported; use binary proto weights for net " << name_ << ".";
   hid_t file_hid = H5Fopen(trained_filename.c_str(), H5F_ACC_RDONLY,
                            H5P_DEFAULT);
   CHECK_GE(file_hid, 0) << "Couldn't open " << trained_filename;
@@ -949,6 +1526,29 @@ void Net<Dtype>::ShareWeights() {
   }
 }
 
+template <typename Dtype>
+void Net<Dtype>::TagMemory() {
+  vector<bool> tagged(blobs_.size(), false);
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    const string& name = layer_names_[layer_id];
+    // An in-place top stays with the layer that first produced it.
+    for (int i = 0; i < top_id_vecs_[layer_id].size(); ++i) {
+      const int blob_id = top_id_vecs_[layer_id][i];
+      if (tagged[blob_id]) { continue; }
+      blobs_[blob_id]->set_memory_tags(SyncedMemory::Tag(name + "/data"),
+                                       SyncedMemory::Tag(name + "/diff"));
+      tagged[blob_id] = true;
+    }
+    const int params_tag = SyncedMemory::Tag(name + "/params");
+    for (int i = 0; i < param_id_vecs_[layer_id].size(); ++i) {
+      const int param_id = param_id_vecs_[layer_id][i];
+      if (param_owners_[param_id] < 0) {
+        params_[param_id]->set_memory_tags(params_tag, params_tag);
+      }
+    }
+  }
+}
+
 template <typename Dtype>
 bool Net<Dtype>::has_blob(const string& blob_name) const {
   return blob_names_index_.find(blob_name) != blob_names_index_.end();
@@ -1,12 +1,102 @@
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
 #include "caffe/common.hpp"
 #include "caffe/syncedmem.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
+// The usage of every tag, indexed by tag id, tag 0 being the untagged memory.
+static boost::mutex usage_mutex_;
+static std::map<string, int> tag_ids_;
+static vector<SyncedMemory::Usage> tag_usage_(1);
+static SyncedMemory::Usage total_usage_;
+static boost::thread_specific_ptr<int> scope_tag_;
+
+static void AddBytes(int64_t bytes, size_t* current, size_t* peak) {
+  *current += bytes;
+  *peak = std::max(*peak, *current);
+}
+
+void SyncedMemory::Account(bool gpu, int64_t bytes) {
+  boost::mutex::scoped_lock lock(usage_mutex_);
+  Usage& usage = tag_usage_[tag_];
+  if (gpu) {
+    AddBytes(bytes, &usage.gpu, &usage.gpu_peak);
+    AddBytes(bytes, &total_usage_.gpu, &total_usage_.gpu_peak);
+  } else {
+    AddBytes(bytes, &usage.cpu, &usage.cpu_peak);
+    AddBytes(bytes, &total_usage_.cpu, &total_usage_.cpu_peak);
+  }
+}
+
+void SyncedMemory::set_tag(int tag) {
+  CHECK_GE(tag, 0) << "Unknown memory tag " << tag;
+  if (tag == tag_) { return; }
+  const size_t cpu = (cpu_ptr_ && own_cpu_data_) ? size_ : 0;
+  const size_t gpu = (gpu_ptr_ && own_gpu_data_) ? size_ : 0;
+  boost::mutex::scoped_lock lock(usage_mutex_);
+  CHECK_LT(tag, tag_usage_.size()) << "Unknown memory tag " << tag;
+  tag_usage_[tag_].cpu -= cpu;
+  tag_usage_[tag_].gpu -= gpu;
+  tag_ = tag;
+  AddBytes(cpu, &tag_usage_[tag_].cpu, &tag_usage_[tag_].cpu_peak);
+  AddBytes(gpu, &tag_usage_[tag_].gpu, &tag_usage_[tag_].gpu_peak);
+}
+
+int SyncedMemory::Tag(const string& name) {
+  boost::mutex::scoped_lock lock(usage_mutex_);
+  std::map<string, int>::const_iterator it = tag_ids_.find(name);
+  if (it != tag_ids_.end()) {
+    return it->second;
+  }
+  const int tag = tag_usage_.size();
+  tag_ids_[name] = tag;
+  tag_usage_.push_back(Usage());
+  return tag;
+}
+
+SyncedMemory::Usage SyncedMemory::TagUsage(int tag) {
+  boost::mutex::scoped_lock lock(usage_mutex_);
+  CHECK_LT(tag, tag_usage_.size()) << "Unknown memory tag " << tag;
+  return tag_usage_[tag];
+}
+
+SyncedMemory::Usage SyncedMemory::TotalUsage() {
+  boost::mutex::scoped_lock lock(usage_mutex_);
+  return total_usage_;
+}
+
+void SyncedMemory::ResetPeakUsage() {
+  boost::mutex::scoped_lock lock(usage_mutex_);
+  for (int i = 0; i < tag_usage_.size(); ++i) {
+    tag_usage_[i].cpu_peak = tag_usage_[i].cpu;
+    tag_usage_[i].gpu_peak = tag_usage_[i].gpu;
+  }
+  total_usage_.cpu_peak = total_usage_.cpu;
+  total_usage_.gpu_peak = total_usage_.gpu;
+}
+
+int SyncedMemory::scope_tag() {
+  return scope_tag_.get() ? *scope_tag_ : 0;
+}
+
+void SyncedMemory::set_scope_tag(int tag) {
+  if (!scope_tag_.get()) {
+    scope_tag_.reset(new int(tag));
+  } else {
+    *scope_tag_ = tag;
+  }
+}
+
 SyncedMemory::~SyncedMemory() {
   if (cpu_ptr_ && own_cpu_data_) {
     CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
+    Account(false, -static_cast<int64_t>(size_));
   }
 
 #ifndef CPU_ONLY
@@ -18,6 +108,7 @@ SyncedMemory::~SyncedMemory() {
     }
     CUDA_CHECK(cudaFree(gpu_ptr_));
     cudaSetDevice(initial_device);
+    Account(true, -static_cast<int64_t>(size_));
   }
 #endif  // CPU_ONLY
 }
@@ -29,12 +120,14 @@ inline void SyncedMemory::to_cpu() {
     caffe_memset(size_, 0, cpu_ptr_);
     head_ = HEAD_AT_CPU;
     own_cpu_data_ = true;
+    Account(false, size_);
     break;
   case HEAD_AT_GPU:
 #ifndef CPU_ONLY
     if (cpu_ptr_ == NULL) {
       CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
       own_cpu_data_ = true;
+      Account(false, size_);
     }
     caffe_gpu_memcpy(size_, gpu_ptr_, cpu_ptr_);
     head_ = SYNCED;
@@ -57,12 +150,14 @@ inline void SyncedMemory::to_gpu() {
     caffe_gpu_memset(size_, 0, gpu_ptr_);
     head_ = HEAD_AT_GPU;
     own_gpu_data_ = true;
+    Account(true, size_);
     break;
   case HEAD_AT_CPU:
     if (gpu_ptr_ == NULL) {
       CUDA_CHECK(cudaGetDevice(&gpu_device_));
       CUDA_CHECK(cudaMalloc(&gpu_ptr_, size_));
       own_gpu_data_ = true;
+      Account(true, size_);
     }
     caffe_gpu_memcpy(size_, cpu_ptr_, gpu_ptr_);
     head_ = SYNCED;
@@ -85,10 +180,12 @@ void SyncedMemory::set_cpu_data(void* data) {
   CHECK(data);
   if (own_cpu_data_) {
     CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
+    Account(false, -static_cast<int64_t>(size_));
   }
   cpu_ptr_ = data;
   head_ = HEAD_AT_CPU;
   own_cpu_data_ = false;
+  ++version_;
 }
 
 const void* SyncedMemory::gpu_data() {
@@ -112,10 +209,12 @@ void SyncedMemory::set_gpu_data(void* data) {
     }
     CUDA_CHECK(cudaFree(gpu_ptr_));
     cudaSetDevice(initial_device);
+    Account(true, -static_cast<int64_t>(size_));
   }
   gpu_ptr_ = data;
   head_ = HEAD_AT_GPU;
   own_gpu_data_ = false;
+  ++version_;
 #else
   NO_GPU;
 #endif
@@ -124,6 +223,7 @@ void SyncedMemory::set_gpu_data(void* data) {
 void* SyncedMemory::mutable_cpu_data() {
   to_cpu();
   head_ = HEAD_AT_CPU;
+  ++version_;
   return cpu_ptr_;
 }
 
@@ -131,6 +231,7 @@ void* SyncedMemory::mutable_gpu_data() {
 #ifndef CPU_ONLY
   to_gpu();
   head_ = HEAD_AT_GPU;
+  ++version_;
   return gpu_ptr_;
 #else
   NO_GPU;
@@ -145,6 +246,7 @@ void SyncedMemory::async_gpu_push(const cudaStream_t& stream) {
     CUDA_CHECK(cudaGetDevice(&gpu_device_));
     CUDA_CHECK(cudaMalloc(&gpu_ptr_, size_));
     own_gpu_data_ = true;
+    Account(true, size_);
   }
   const cudaMemcpyKind put = cudaMemcpyHostToDevice;
   CUDA_CHECK(cudaMemcpyAsync(gpu_ptr_, cpu_ptr_, size_, put, stream));
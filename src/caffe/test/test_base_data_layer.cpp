@@ -0,0 +1,109 @@
+#include <boost/thread.hpp>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/base_data_layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+// Loads batches of increasing values, taking burst_time ms every
+// burst_interval batches.
+template <typename Dtype>
+class BurstyDataLayer : public BasePrefetchingDataLayer<Dtype> {
+ public:
+  BurstyDataLayer(const LayerParameter& param, int burst_interval,
+      int burst_time)
+      : BasePrefetchingDataLayer<Dtype>(param), burst_interval_(burst_interval),
+        burst_time_(burst_time), batch_count_(0) {}
+  virtual ~BurstyDataLayer() { this->StopInternalThread(); }
+  virtual void DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+    vector<int> shape(2, 3);
+    top[0]->Reshape(shape);
+    for (int i = 0; i < this->prefetch_.size(); ++i) {
+      this->prefetch_[i]->data_.Reshape(shape);
+    }
+  }
+
+  virtual inline const char* type() const { return "BurstyData"; }
+  int prefetch_count() const { return this->prefetch_.size(); }
+
+ protected:
+  virtual void load_batch(Batch<Dtype>* batch) {
+    if (++batch_count_ % burst_interval_ == 0) {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(burst_time_));
+    }
+    caffe_set(batch->data_.count(), Dtype(batch_count_),
+        batch->data_.mutable_cpu_data());
+  }
+
+  int burst_interval_;
+  int burst_time_;
+  int batch_count_;
+};
+
+template <typename Dtype>
+class BasePrefetchingDataLayerTest : public ::testing::Test {
+ protected:
+  BasePrefetchingDataLayerTest() : blob_top_data_(new Blob<Dtype>()) {
+    blob_top_vec_.push_back(blob_top_data_);
+  }
+  virtual ~BasePrefetchingDataLayerTest() { delete blob_top_data_; }
+
+  Blob<Dtype>* const blob_top_data_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(BasePrefetchingDataLayerTest, TestDtypes);
+
+TYPED_TEST(BasePrefetchingDataLayerTest, TestPrefetchCount) {
+  Caffe::set_mode(Caffe::CPU);
+  LayerParameter param;
+  {
+    BurstyDataLayer<TypeParam> layer(param, 1000, 0);
+    EXPECT_EQ(BasePrefetchingDataLayer<TypeParam>::kDefaultPrefetch,
+        layer.prefetch_count());
+  }
+  param.mutable_data_param()->set_prefetch(5);
+  BurstyDataLayer<TypeParam> layer(param, 1000, 0);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(5, layer.prefetch_count());
+  for (int iter = 1; iter <= 20; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < this->blob_top_data_->count(); ++i) {
+      EXPECT_EQ(iter, this->blob_top_data_->cpu_data()[i]);
+    }
+  }
+  EXPECT_EQ(5, layer.prefetch_count());
+}
+
+TYPED_TEST(BasePrefetchingDataLayerTest, TestAdaptivePrefetch) {
+  Caffe::set_mode(Caffe::CPU);
+  LayerParameter param;
+  param.mutable_data_param()->set_prefetch(2);
+  param.mutable_data_param()->set_max_prefetch(4);
+  // The layer loads batches faster than they are consumed on average, but
+  // stalls for longer than the initial ring absorbs every 20 batches.
+  BurstyDataLayer<TypeParam> layer(param, 20, 30);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(2, layer.prefetch_count());
+  for (int iter = 1; iter <= 100; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < this->blob_top_data_->count(); ++i) {
+      EXPECT_EQ(iter, this->blob_top_data_->cpu_data()[i]);
+    }
+    boost::this_thread::sleep(boost::posix_time::milliseconds(3));
+  }
+  EXPECT_GT(layer.prefetch_count(), 2);
+  EXPECT_LE(layer.prefetch_count(), 4);
+}
+
+}  // namespace caffe
@@ -8,6 +8,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/batch_norm_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -120,6 +121,78 @@ namespace caffe {
     }
   }
 
+  TYPED_TEST(BatchNormLayerTest, TestForwardLargeMean) {
+    typedef typename TypeParam::Dtype Dtype;
+    // Statistics far from zero, over more values than one thread handles.
+    Blob<Dtype> bottom(8, 3, 32, 32);
+    FillerParameter filler_param;
+    filler_param.set_mean(1000);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&bottom);
+    vector<Blob<Dtype>*> blob_bottom_vec(1, &bottom);
+    LayerParameter layer_param;
+
+    BatchNormLayer<Dtype> layer(layer_param);
+    Caffe::set_num_threads(4);
+    layer.SetUp(blob_bottom_vec, this->blob_top_vec_);
+    layer.Forward(blob_bottom_vec, this->blob_top_vec_);
+    Caffe::set_num_threads(1);
+
+    const int spatial_dim = bottom.height() * bottom.width();
+    for (int j = 0; j < bottom.channels(); ++j) {
+      double sum = 0, var = 0;
+      for (int i = 0; i < bottom.num(); ++i) {
+        const Dtype* data = this->blob_top_->cpu_data()
+            + this->blob_top_->offset(i, j);
+        for (int k = 0; k < spatial_dim; ++k) {
+          sum += data[k];
+          var += data[k] * data[k];
+        }
+      }
+      sum /= spatial_dim * bottom.num();
+      var /= spatial_dim * bottom.num();
+
+      const Dtype kErrorBound = 0.001;
+      EXPECT_NEAR(0, sum, kErrorBound);
+      EXPECT_NEAR(1, var, kErrorBound);
+    }
+  }
+
+  TYPED_TEST(BatchNormLayerTest, TestBackwardInplace) {
+    typedef typename TypeParam::Dtype Dtype;
+    LayerParameter layer_param;
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    vector<bool> propagate_down(1, true);
+
+    BatchNormLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    filler.Fill(this->blob_top_);
+    caffe_copy(this->blob_top_->count(), this->blob_top_->cpu_data(),
+        this->blob_top_->mutable_cpu_diff());
+    layer.Backward(this->blob_top_vec_, propagate_down,
+        this->blob_bottom_vec_);
+
+    // The same, in place, with the top clobbered between the passes.
+    Blob<Dtype> blob_inplace(5, 2, 3, 4);
+    blob_inplace.CopyFrom(*this->blob_bottom_);
+    vector<Blob<Dtype>*> blob_inplace_vec(1, &blob_inplace);
+    BatchNormLayer<Dtype> layer_inplace(layer_param);
+    layer_inplace.SetUp(blob_inplace_vec, blob_inplace_vec);
+    layer_inplace.Forward(blob_inplace_vec, blob_inplace_vec);
+    caffe_set(blob_inplace.count(), Dtype(0), blob_inplace.mutable_cpu_data());
+    caffe_copy(blob_inplace.count(), this->blob_top_->cpu_diff(),
+        blob_inplace.mutable_cpu_diff());
+    layer_inplace.Backward(blob_inplace_vec, propagate_down,
+        blob_inplace_vec);
+
+    for (int i = 0; i < blob_inplace.count(); ++i) {
+      EXPECT_NEAR(this->blob_bottom_->cpu_diff()[i],
+          blob_inplace.cpu_diff()[i], 1e-5);
+    }
+  }
+
   TYPED_TEST(BatchNormLayerTest, TestGradient) {
     typedef typename TypeParam::Dtype Dtype;
     LayerParameter layer_param;
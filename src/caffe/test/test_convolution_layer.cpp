@@ -495,6 +495,42 @@ TYPED_TEST(ConvolutionLayerTest, TestSimpleConvolutionGroup) {
   }
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestConvolutionPacked) {
+  // At test time, a small output goes through the packed weights, repacked
+  // when they change. The groups go through GEMM, not the direct kernels of
+  // few channels per group, as force_nd_im2col selects.
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->set_force_nd_im2col(true);
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(1);
+  convolution_param->set_num_output(6);
+  convolution_param->set_group(3);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("constant");
+  convolution_param->mutable_bias_filler()->set_value(0.1);
+  shared_ptr<Layer<Dtype> > layer(
+      new ConvolutionLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int pass = 0; pass < 2; ++pass) {
+    if (pass) {
+      caffe_scal<Dtype>(layer->blobs()[0]->count(), Dtype(-2),
+          layer->blobs()[0]->mutable_cpu_data());
+    }
+    layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    caffe_conv(this->blob_bottom_, convolution_param, layer->blobs(),
+        this->MakeReferenceTop(this->blob_top_));
+    const Dtype* top_data = this->blob_top_->cpu_data();
+    const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+    for (int i = 0; i < this->blob_top_->count(); ++i) {
+      EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+    }
+  }
+}
+
 TYPED_TEST(ConvolutionLayerTest, TestSobelConvolution) {
   // Test separable convolution by computing the Sobel operator
   // as a single filter then comparing the result
@@ -588,6 +624,87 @@ TYPED_TEST(ConvolutionLayerTest, TestSobelConvolution) {
   }
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestGroupedAgainstGEMM) {
+  // The direct kernels of many groups of few channels against im2col and
+  // GEMM, which force_nd_im2col selects: depthwise with stride, padding and
+  // dilation, with two outputs per channel, and two channels per group with
+  // a kernel wider than high. The rows are wide enough for whole blocks of
+  // columns inside the image.
+  typedef typename TypeParam::Dtype Dtype;
+  vector<int> bottom_shape(4);
+  bottom_shape[0] = 2;
+  bottom_shape[1] = 6;
+  bottom_shape[2] = 9;
+  bottom_shape[3] = 40;
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  this->blob_bottom_->Reshape(bottom_shape);
+  filler.Fill(this->blob_bottom_);
+  for (int config = 0; config < 3; ++config) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    if (config < 2) {
+      convolution_param->add_kernel_size(3);
+      convolution_param->add_stride(config + 1);
+      convolution_param->add_pad(config + 1);
+      convolution_param->add_dilation(config + 1);
+      convolution_param->set_group(6);
+      convolution_param->set_num_output(6 * (config + 1));
+    } else {
+      convolution_param->set_kernel_h(2);
+      convolution_param->set_kernel_w(5);
+      convolution_param->set_pad_h(0);
+      convolution_param->set_pad_w(2);
+      convolution_param->set_stride_h(2);
+      convolution_param->set_stride_w(1);
+      convolution_param->set_group(3);
+      convolution_param->set_num_output(9);
+    }
+    ConvolutionLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    Blob<Dtype> top_diff;
+    top_diff.ReshapeLike(*this->blob_top_);
+    filler.Fill(&top_diff);
+    vector<Blob<Dtype>*> results;
+    for (int nd = 0; nd < 2; ++nd) {
+      convolution_param->set_force_nd_im2col(nd);
+      ConvolutionLayer<Dtype> layer_nd(layer_param);
+      layer_nd.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      for (int i = 0; i < layer.blobs().size(); ++i) {
+        layer_nd.blobs()[i]->CopyFrom(*layer.blobs()[i]);
+      }
+      layer_nd.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      caffe_copy(top_diff.count(), top_diff.cpu_data(),
+          this->blob_top_->mutable_cpu_diff());
+      layer_nd.Backward(this->blob_top_vec_, vector<bool>(1, true),
+          this->blob_bottom_vec_);
+      results.push_back(new Blob<Dtype>());
+      results.back()->CopyFrom(*this->blob_top_, false, true);
+      results.push_back(new Blob<Dtype>());
+      results.back()->CopyFrom(*this->blob_bottom_, true, true);
+      results.push_back(new Blob<Dtype>());
+      results.back()->CopyFrom(*layer_nd.blobs()[0], true, true);
+    }
+    for (int i = 0; i < 3; ++i) {
+      const Blob<Dtype>& direct = *results[i];
+      const Blob<Dtype>& gemm = *results[i + 3];
+      ASSERT_EQ(gemm.count(), direct.count());
+      const Dtype* direct_values = i ? direct.cpu_diff() : direct.cpu_data();
+      const Dtype* gemm_values = i ? gemm.cpu_diff() : gemm.cpu_data();
+      for (int j = 0; j < gemm.count(); ++j) {
+        EXPECT_NEAR(gemm_values[j], direct_values[j], 1e-4)
+            << "config " << config << ", result " << i;
+      }
+    }
+    for (int i = 0; i < results.size(); ++i) {
+      delete results[i];
+    }
+  }
+}
+
 TYPED_TEST(ConvolutionLayerTest, TestNDAgainst2D) {
   typedef typename TypeParam::Dtype Dtype;
   const int kernel_h = 11;
@@ -689,14 +806,16 @@ TYPED_TEST(ConvolutionLayerTest, TestNDAgainst2D) {
     backward_result_nd.CopyFrom(*this->blob_bottom_, copy_diff, reshape);
     backward_weight_result_nd.CopyFrom(weights, copy_diff, reshape);
   }
+  // With 3 channels per group, the 2D layer runs the direct grouped kernels
+  // on the CPU, which sum in another order than im2col and GEMM.
   ASSERT_EQ(result_nd.count(), result_2d.count());
   for (int i = 0; i < result_2d.count(); ++i)  {
-    EXPECT_EQ(result_2d.cpu_data()[i], result_nd.cpu_data()[i]);
+    EXPECT_NEAR(result_2d.cpu_data()[i], result_nd.cpu_data()[i], 1e-4);
   }
   ASSERT_EQ(backward_result_nd.count(), backward_result_2d.count());
   for (int i = 0; i < backward_result_2d.count(); ++i) {
-    EXPECT_EQ(backward_result_2d.cpu_diff()[i],
-              backward_result_nd.cpu_diff()[i]);
+    EXPECT_NEAR(backward_result_2d.cpu_diff()[i],
+                backward_result_nd.cpu_diff()[i], 1e-4);
   }
   ASSERT_EQ(backward_weight_result_nd.count(),
             backward_weight_result_2d.count());
@@ -724,6 +843,40 @@ TYPED_TEST(ConvolutionLayerTest, TestGradient) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestFusedReLUGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(2);
+  convolution_param->set_fuse_relu(true);
+  convolution_param->set_relu_negative_slope(0.1);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  ConvolutionLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Check the fused leaky ReLU against the output of the plain convolution.
+  Blob<Dtype> fused_top;
+  fused_top.CopyFrom(*this->blob_top_, false, true);
+  layer_param.mutable_convolution_param()->set_fuse_relu(false);
+  ConvolutionLayer<Dtype> plain_layer(layer_param);
+  plain_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  plain_layer.blobs()[0]->CopyFrom(*layer.blobs()[0]);
+  plain_layer.blobs()[1]->CopyFrom(*layer.blobs()[1]);
+  plain_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype* top_data = this->blob_top_->cpu_data();
+  for (int i = 0; i < fused_top.count(); ++i) {
+    const Dtype expected = top_data[i] > 0 ? top_data[i] : 0.1 * top_data[i];
+    EXPECT_NEAR(expected, fused_top.cpu_data()[i], 1e-4);
+  }
+  GradientChecker<Dtype> checker(1e-2, 1e-3, 1701, 0., 0.01);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
 TYPED_TEST(ConvolutionLayerTest, TestDilatedGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -0,0 +1,169 @@
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/data_transformer.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/pooling_layer.hpp"
+#include "caffe/util/cpu_dispatch.hpp"
+#include "caffe/util/im2col.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class CPUDispatchTest : public ::testing::Test {
+ protected:
+  CPUDispatchTest() : level_(Caffe::simd_level()) {}
+
+  virtual ~CPUDispatchTest() {
+    Caffe::set_simd_level(level_);
+  }
+
+  // Runs the pooling method forward and backward on blob_bottom, with the
+  // outputs appended to out.
+  void Pool(const Blob<Dtype>& blob_bottom,
+      const PoolingParameter_PoolMethod method, vector<Dtype>* out) {
+    Blob<Dtype> bottom;
+    Blob<Dtype> top;
+    bottom.CopyFrom(blob_bottom, false, true);
+    vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+    vector<Blob<Dtype>*> top_vec(1, &top);
+    LayerParameter layer_param;
+    PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+    pooling_param->set_kernel_size(3);
+    pooling_param->set_stride(2);
+    pooling_param->set_pad(1);
+    pooling_param->set_pool(method);
+    PoolingLayer<Dtype> layer(layer_param);
+    layer.SetUp(bottom_vec, top_vec);
+    layer.Forward(bottom_vec, top_vec);
+    for (int i = 0; i < top.count(); ++i) {
+      top.mutable_cpu_diff()[i] = i % 7 - 3;
+    }
+    layer.Backward(top_vec, vector<bool>(1, true), bottom_vec);
+    out->insert(out->end(), top.cpu_data(), top.cpu_data() + top.count());
+    out->insert(out->end(), bottom.cpu_diff(),
+        bottom.cpu_diff() + bottom.count());
+  }
+
+  // The outputs of the dispatched kernels for one input.
+  vector<Dtype> Run(const Blob<Dtype>& blob) {
+    vector<Dtype> out;
+    // im2col and col2im, with padding and dilation.
+    const int channels = blob.num() * blob.channels();
+    const int height = blob.height();
+    const int width = blob.width();
+    const int output_h = (height + 2 - (2 * 2 + 1)) / 1 + 1;
+    const int output_w = (width + 2 - (2 * 2 + 1)) / 1 + 1;
+    vector<Dtype> col(channels * 9 * output_h * output_w);
+    im2col_cpu(blob.cpu_data(), channels, height, width, 3, 3, 1, 1, 1, 1,
+        2, 2, &col[0]);
+    out.insert(out.end(), col.begin(), col.end());
+    vector<Dtype> im(blob.count());
+    col2im_cpu(&col[0], channels, height, width, 3, 3, 1, 1, 1, 1, 2, 2,
+        &im[0]);
+    out.insert(out.end(), im.begin(), im.end());
+    Pool(blob, PoolingParameter_PoolMethod_MAX, &out);
+    Pool(blob, PoolingParameter_PoolMethod_AVE, &out);
+    return out;
+  }
+
+  const Caffe::SIMDLevel level_;
+};
+
+TYPED_TEST_CASE(CPUDispatchTest, TestDtypes);
+
+TYPED_TEST(CPUDispatchTest, TestLevels) {
+  EXPECT_EQ(DetectSIMDLevel(), this->level_);
+  for (int level = Caffe::BASELINE; level <= Caffe::AVX512; ++level) {
+    const Caffe::SIMDLevel simd_level = static_cast<Caffe::SIMDLevel>(level);
+    EXPECT_EQ(simd_level, ParseSIMDLevel(SIMDLevelName(simd_level)));
+  }
+  Caffe::set_simd_level(Caffe::BASELINE);
+  EXPECT_EQ(Caffe::BASELINE, Caffe::simd_level());
+}
+
+TYPED_TEST(CPUDispatchTest, TestKernelsAgree) {
+  Blob<TypeParam> blob(2, 3, 9, 11);
+  FillerParameter filler_param;
+  GaussianFiller<TypeParam> filler(filler_param);
+  filler.Fill(&blob);
+  Caffe::set_simd_level(Caffe::BASELINE);
+  const vector<TypeParam> expected = this->Run(blob);
+  for (int level = Caffe::SSE4; level <= this->level_; ++level) {
+    Caffe::set_simd_level(static_cast<Caffe::SIMDLevel>(level));
+    const vector<TypeParam> out = this->Run(blob);
+    ASSERT_EQ(expected.size(), out.size());
+    for (int i = 0; i < out.size(); ++i) {
+      EXPECT_EQ(expected[i], out[i])
+          << SIMDLevelName(static_cast<Caffe::SIMDLevel>(level));
+    }
+  }
+}
+
+TYPED_TEST(CPUDispatchTest, TestTransformAgrees) {
+  Datum datum;
+  datum.set_channels(3);
+  datum.set_height(4);
+  datum.set_width(21);
+  std::string* data = datum.mutable_data();
+  for (int i = 0; i < 3 * 4 * 21; ++i) {
+    data->push_back(static_cast<char>(i * 37));
+  }
+  TransformationParameter param;
+  param.set_scale(0.5);
+  param.set_mirror(true);
+  param.add_mean_value(10);
+  param.add_mean_value(20);
+  param.add_mean_value(30);
+  Blob<TypeParam> blob(1, 3, 4, 21);
+  for (int level = Caffe::BASELINE; level <= this->level_; ++level) {
+    Caffe::set_simd_level(static_cast<Caffe::SIMDLevel>(level));
+    // Mirrored or not, at random.
+    DataTransformer<TypeParam> transformer(param, TEST);
+    transformer.InitRand();
+    transformer.Transform(datum, &blob);
+    const TypeParam* y = blob.cpu_data();
+    const bool mirrored = (y[0] != (static_cast<uint8_t>(data->at(0)) - 10)
+        * TypeParam(0.5));
+    for (int c = 0; c < 3; ++c) {
+      for (int h = 0; h < 4; ++h) {
+        for (int w = 0; w < 21; ++w) {
+          const int i = (c * 4 + h) * 21 + w;
+          const int j = (c * 4 + h) * 21 + (mirrored ? 20 - w : w);
+          EXPECT_EQ((static_cast<uint8_t>(data->at(i)) - 10 * (c + 1))
+              * TypeParam(0.5), y[j]);
+        }
+      }
+    }
+  }
+}
+
+TEST(CPUDispatchMathTest, TestExpAgrees) {
+  const Caffe::SIMDLevel level = Caffe::simd_level();
+  vector<float> x(37);
+  for (int i = 0; i < x.size(); ++i) {
+    x[i] = (i - 18) * 2.5f;
+  }
+  vector<float> expected(x.size());
+  Caffe::set_simd_level(Caffe::BASELINE);
+  caffe_exp<float>(x.size(), &x[0], &expected[0]);
+  vector<float> y(x.size());
+  for (int l = Caffe::SSE4; l <= level; ++l) {
+    Caffe::set_simd_level(static_cast<Caffe::SIMDLevel>(l));
+    caffe_exp<float>(x.size(), &x[0], &y[0]);
+    for (int i = 0; i < x.size(); ++i) {
+      // Only FMA contraction may differ.
+      EXPECT_NEAR(expected[i], y[i], 1e-6 * expected[i]);
+    }
+  }
+  Caffe::set_simd_level(level);
+}
+
+}  // namespace caffe
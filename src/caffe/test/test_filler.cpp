@@ -140,6 +140,33 @@ TYPED_TEST(GaussianFillerTest, TestFill) {
   EXPECT_LE(var, target_var * 5.);
 }
 
+TYPED_TEST(GaussianFillerTest, TestFillParallel) {
+  // Large enough to be filled by a Philox generator on several threads.
+  Blob<TypeParam> blob(1, 1, 300, 300);
+  Blob<TypeParam> single_thread(1, 1, 300, 300);
+  Caffe::set_random_seed(1701);
+  this->filler_->Fill(&single_thread);
+  Caffe::set_num_threads(4);
+  Caffe::set_random_seed(1701);
+  this->filler_->Fill(&blob);
+  Caffe::set_num_threads(1);
+  const int count = blob.count();
+  const TypeParam* data = blob.cpu_data();
+  TypeParam mean = 0.;
+  TypeParam var = 0.;
+  for (int i = 0; i < count; ++i) {
+    EXPECT_EQ(single_thread.cpu_data()[i], data[i]);
+    mean += data[i];
+    var += (data[i] - this->filler_param_.mean()) *
+        (data[i] - this->filler_param_.mean());
+  }
+  mean /= count;
+  var /= count;
+  const TypeParam std = this->filler_param_.std();
+  EXPECT_NEAR(this->filler_param_.mean(), mean, std * 0.05);
+  EXPECT_NEAR(std * std, var, std * std * 0.05);
+}
+
 template <typename Dtype>
 class XavierFillerTest : public ::testing::Test {
  protected:
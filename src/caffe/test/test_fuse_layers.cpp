@@ -0,0 +1,337 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/fuse_layers.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class FuseLayersTest : public ::testing::Test {
+ protected:
+  void RunFuseLayersTest(
+      const string& input_param_string, const string& output_param_string) {
+    // Test that FuseLayers called on the proto specified by
+    // input_param_string results in the proto specified by
+    // output_param_string.
+    NetParameter input_param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(
+        input_param_string, &input_param));
+    NetParameter expected_output_param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(
+        output_param_string, &expected_output_param));
+    NetParameter actual_output_param;
+    FuseLayers(input_param, &actual_output_param);
+    EXPECT_EQ(expected_output_param.DebugString(),
+        actual_output_param.DebugString());
+    // Also test idempotence.
+    NetParameter double_fused_param;
+    FuseLayers(actual_output_param, &double_fused_param);
+    EXPECT_EQ(actual_output_param.DebugString(),
+       double_fused_param.DebugString());
+  }
+};
+
+TEST_F(FuseLayersTest, TestFuseChain) {
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  convolution_param { bias_term: false } "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'bn1' "
+      "  type: 'BatchNorm' "
+      "  bottom: 'conv1' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'scale1' "
+      "  type: 'Scale' "
+      "  bottom: 'conv1' "
+      "  top: 'scale1' "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  relu_param { negative_slope: 0.1 } "
+      "  bottom: 'scale1' "
+      "  top: 'scale1' "
+      "} "
+      "layer { "
+      "  name: 'conv2' "
+      "  type: 'Convolution' "
+      "  bottom: 'scale1' "
+      "  top: 'conv2' "
+      "} "
+      "layer { "
+      "  name: 'relu2' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv2' "
+      "  top: 'conv2' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'conv2' "
+      "  bottom: 'scale1' "
+      "} ";
+  const string& expected_output_proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  convolution_param { "
+      "    bias_term: true "
+      "    fuse_relu: true "
+      "    relu_negative_slope: 0.1 "
+      "  } "
+      "  bottom: 'data' "
+      "  top: 'scale1' "
+      "} "
+      "layer { "
+      "  name: 'conv2' "
+      "  type: 'Convolution' "
+      "  convolution_param { "
+      "    fuse_relu: true "
+      "    relu_negative_slope: 0 "
+      "  } "
+      "  bottom: 'scale1' "
+      "  top: 'conv2' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'conv2' "
+      "  bottom: 'scale1' "
+      "} ";
+  this->RunFuseLayersTest(input_proto, expected_output_proto);
+}
+
+TEST_F(FuseLayersTest, TestNoFuse) {
+  // Nothing is fused across a blob with several consumers, or into a
+  // BatchNorm computing the batch statistics.
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv1' "
+      "  top: 'relu1' "
+      "} "
+      "layer { "
+      "  name: 'conv2' "
+      "  type: 'Convolution' "
+      "  bottom: 'conv1' "
+      "  top: 'conv2' "
+      "} "
+      "layer { "
+      "  name: 'bn2' "
+      "  type: 'BatchNorm' "
+      "  batch_norm_param { use_global_stats: false } "
+      "  bottom: 'conv2' "
+      "  top: 'conv2' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'relu1' "
+      "  bottom: 'conv2' "
+      "} ";
+  this->RunFuseLayersTest(input_proto, input_proto);
+}
+
+template <typename TypeParam>
+class FuseLayersNetTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  FuseLayersNetTest() : seed_(1701) {}
+
+  // Without the global statistics, BatchNorm normalizes by those of the batch
+  // and cannot be folded.
+  virtual void InitNet(const bool fuse_layers,
+      const bool use_global_stats = true) {
+    const string& proto =
+        "name: 'FuseTestNetwork' "
+        "state { phase: TEST } "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { shape: { dim: 2 dim: 3 dim: 6 dim: 5 } } "
+        "} "
+        "layer { "
+        "  name: 'conv' "
+        "  type: 'Convolution' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    bias_term: false "
+        "    weight_filler { type: 'gaussian' std: 1 } "
+        "  } "
+        "  bottom: 'data' "
+        "  top: 'conv' "
+        "} "
+        "layer { "
+        "  name: 'bn' "
+        "  type: 'BatchNorm' "
+        "  bottom: 'conv' "
+        "  top: 'conv' "
+        "} "
+        "layer { "
+        "  name: 'scale' "
+        "  type: 'Scale' "
+        "  scale_param { "
+        "    bias_term: true "
+        "    filler { type: 'gaussian' std: 1 } "
+        "    bias_filler { type: 'gaussian' std: 1 } "
+        "  } "
+        "  bottom: 'conv' "
+        "  top: 'conv' "
+        "} "
+        "layer { "
+        "  name: 'relu' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv' "
+        "  top: 'conv' "
+        "} ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    param.set_fuse_layers(fuse_layers);
+    if (!use_global_stats) {
+      param.mutable_layer(2)->mutable_batch_norm_param()->
+          set_use_global_stats(false);
+    }
+    net_.reset(new Net<Dtype>(param));
+  }
+
+  int seed_;
+  shared_ptr<Net<Dtype> > net_;
+};
+
+TYPED_TEST_CASE(FuseLayersNetTest, TestDtypesAndDevices);
+
+TYPED_TEST(FuseLayersNetTest, TestForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitNet(false);
+  // Give the BatchNorm layer accumulated statistics.
+  FillerParameter filler_param;
+  filler_param.set_min(0.5);
+  filler_param.set_max(2);
+  UniformFiller<Dtype> filler(filler_param);
+  Layer<Dtype>* bn = this->net_->layer_by_name("bn").get();
+  filler.Fill(bn->blobs()[0].get());
+  filler.Fill(bn->blobs()[1].get());
+  bn->blobs()[2]->mutable_cpu_data()[0] = 1.5;
+  Blob<Dtype>* data = this->net_->input_blobs()[0];
+  FillerParameter data_filler_param;
+  GaussianFiller<Dtype> data_filler(data_filler_param);
+  data_filler.Fill(data);
+  Blob<Dtype> input;
+  input.CopyFrom(*data, false, true);
+  this->net_->Forward();
+  Blob<Dtype> expected;
+  expected.CopyFrom(*this->net_->output_blobs()[0], false, true);
+  NetParameter trained_param;
+  this->net_->ToProto(&trained_param);
+
+  this->InitNet(true);
+  ASSERT_EQ(2, this->net_->layers().size());
+  EXPECT_EQ(2, this->net_->layers()[1]->blobs().size());
+  this->net_->CopyTrainedLayersFrom(trained_param);
+  this->net_->input_blobs()[0]->CopyFrom(input);
+  this->net_->Forward();
+  const Blob<Dtype>& output = *this->net_->output_blobs()[0];
+  ASSERT_EQ(expected.count(), output.count());
+  for (int i = 0; i < output.count(); ++i) {
+    EXPECT_NEAR(expected.cpu_data()[i], output.cpu_data()[i], 1e-4);
+  }
+}
+
+TYPED_TEST(FuseLayersNetTest, TestCopyUnfoldedBatchNorm) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitNet(false);
+  FillerParameter filler_param;
+  filler_param.set_min(0.5);
+  filler_param.set_max(2);
+  UniformFiller<Dtype> filler(filler_param);
+  Layer<Dtype>* bn = this->net_->layer_by_name("bn").get();
+  filler.Fill(bn->blobs()[0].get());
+  filler.Fill(bn->blobs()[1].get());
+  bn->blobs()[2]->mutable_cpu_data()[0] = 1.5;
+  Blob<Dtype> mean;
+  mean.CopyFrom(*bn->blobs()[0], false, true);
+  NetParameter trained_param;
+  this->net_->ToProto(&trained_param);
+  // The trained net would fold its BatchNorm, but this one keeps it: the
+  // source must be copied unfolded too.
+  this->InitNet(false, false);
+  Blob<Dtype>* data = this->net_->input_blobs()[0];
+  FillerParameter data_filler_param;
+  GaussianFiller<Dtype> data_filler(data_filler_param);
+  data_filler.Fill(data);
+  Blob<Dtype> input;
+  input.CopyFrom(*data, false, true);
+  this->net_->CopyTrainedLayersFrom(trained_param);
+  this->net_->Forward();
+  Blob<Dtype> expected;
+  expected.CopyFrom(*this->net_->output_blobs()[0], false, true);
+
+  this->InitNet(true, false);
+  ASSERT_EQ(5, this->net_->layers().size());
+  EXPECT_EQ(1, this->net_->layers()[1]->blobs().size());
+  this->net_->CopyTrainedLayersFrom(trained_param);
+  const Blob<Dtype>& bn_mean =
+      *this->net_->layer_by_name("bn")->blobs()[0];
+  for (int i = 0; i < bn_mean.count(); ++i) {
+    EXPECT_EQ(mean.cpu_data()[i], bn_mean.cpu_data()[i]);
+  }
+  this->net_->input_blobs()[0]->CopyFrom(input);
+  this->net_->Forward();
+  const Blob<Dtype>& output = *this->net_->output_blobs()[0];
+  ASSERT_EQ(expected.count(), output.count());
+  for (int i = 0; i < output.count(); ++i) {
+    EXPECT_NEAR(expected.cpu_data()[i], output.cpu_data()[i], 1e-4);
+  }
+}
+
+}  // namespace caffe
@@ -1,3 +1,4 @@
+#include <set>
 #include <string>
 #include <vector>
 
@@ -8,6 +9,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/layers/hdf5_data_layer.hpp"
+#include "caffe/layers/hdf5_prefetch_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -133,4 +135,97 @@ TYPED_TEST(HDF5DataLayerTest, TestRead) {
   }
 }
 
+TYPED_TEST(HDF5DataLayerTest, TestPrefetchRead) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Read the same data as TestRead in chunks of 3 rows, which do not divide
+  // the 10 rows of a file or the batches.
+  LayerParameter param;
+  param.add_top("data");
+  param.add_top("label");
+  HDF5DataParameter* hdf5_data_param = param.mutable_hdf5_data_param();
+  const int batch_size = 5;
+  hdf5_data_param->set_batch_size(batch_size);
+  hdf5_data_param->set_chunk_size(3);
+  hdf5_data_param->set_source(*(this->filename));
+  const int num_cols = 8;
+  const int height = 6;
+  const int width = 5;
+  vector<Blob<Dtype>*> blob_top_vec;
+  blob_top_vec.push_back(this->blob_top_data_);
+  blob_top_vec.push_back(this->blob_top_label_);
+
+  HDF5PrefetchDataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, blob_top_vec);
+  EXPECT_EQ(this->blob_top_data_->num(), batch_size);
+  EXPECT_EQ(this->blob_top_data_->channels(), num_cols);
+  EXPECT_EQ(this->blob_top_data_->height(), height);
+  EXPECT_EQ(this->blob_top_data_->width(), width);
+  EXPECT_EQ(this->blob_top_label_->num_axes(), 2);
+  EXPECT_EQ(this->blob_top_label_->shape(0), batch_size);
+  EXPECT_EQ(this->blob_top_label_->shape(1), 1);
+
+  const int data_size = num_cols * height * width;
+  for (int iter = 0; iter < 10; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, blob_top_vec);
+    int label_offset = 1 + ((iter % 2 == 0) ? 0 : batch_size);
+    int data_offset = (iter % 2 == 0) ? 0 : batch_size * data_size;
+    int file_offset = (iter % 4 < 2) ? 0 : 2400;
+    for (int i = 0; i < batch_size; ++i) {
+      EXPECT_EQ(label_offset + i, this->blob_top_label_->cpu_data()[i]);
+    }
+    for (int i = 0; i < batch_size * data_size; ++i) {
+      EXPECT_EQ(file_offset + data_offset + i,
+                this->blob_top_data_->cpu_data()[i]) << "iter " << iter;
+    }
+  }
+}
+
+TYPED_TEST(HDF5DataLayerTest, TestPrefetchShuffle) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param;
+  param.add_top("data");
+  param.add_top("label");
+  HDF5DataParameter* hdf5_data_param = param.mutable_hdf5_data_param();
+  const int batch_size = 5;
+  hdf5_data_param->set_batch_size(batch_size);
+  hdf5_data_param->set_chunk_size(4);
+  hdf5_data_param->set_shuffle(true);
+  hdf5_data_param->set_source(*(this->filename));
+  const int data_size = 8 * 6 * 5;
+  vector<Blob<Dtype>*> blob_top_vec;
+  blob_top_vec.push_back(this->blob_top_data_);
+  blob_top_vec.push_back(this->blob_top_label_);
+
+  HDF5PrefetchDataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, blob_top_vec);
+  // Every two batches output all the rows of one file, in any order, and
+  // the data rows stay with their labels.
+  for (int epoch = 0; epoch < 3; ++epoch) {
+    std::set<int> file_offsets;
+    for (int file = 0; file < 2; ++file) {
+      std::set<int> labels;
+      int file_offset = -1;
+      for (int iter = 0; iter < 2; ++iter) {
+        layer.Forward(this->blob_bottom_vec_, blob_top_vec);
+        for (int i = 0; i < batch_size; ++i) {
+          const int label = this->blob_top_label_->cpu_data()[i];
+          labels.insert(label);
+          const Dtype* data = this->blob_top_data_->cpu_data() + i * data_size;
+          if (file_offset < 0) {
+            file_offset = data[0] - (label - 1) * data_size;
+          }
+          for (int j = 0; j < data_size; ++j) {
+            EXPECT_EQ(file_offset + (label - 1) * data_size + j, data[j]);
+          }
+        }
+      }
+      EXPECT_EQ(10, labels.size());
+      EXPECT_EQ(1, *labels.begin());
+      EXPECT_EQ(10, *labels.rbegin());
+      file_offsets.insert(file_offset);
+    }
+    EXPECT_EQ(2, file_offsets.size());
+  }
+}
+
 }  // namespace caffe
@@ -177,5 +177,56 @@ TYPED_TEST(ImageDataLayerTest, TestShuffle) {
   }
 }
 
+TYPED_TEST(ImageDataLayerTest, TestThreads) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Images of both sizes, resized to batch them.
+  string filename;
+  MakeTempFilename(&filename);
+  std::ofstream outfile(filename.c_str(), std::ofstream::out);
+  for (int i = 0; i < 7; ++i) {
+    outfile << EXAMPLES_SOURCE_DIR "images/"
+            << (i % 2 ? "fish-bike.jpg " : "cat.jpg ") << i;
+  }
+  outfile.close();
+  LayerParameter param;
+  param.mutable_transform_param()->set_mirror(true);
+  ImageDataParameter* image_data_param = param.mutable_image_data_param();
+  image_data_param->set_batch_size(3);
+  image_data_param->set_source(filename.c_str());
+  image_data_param->set_new_height(32);
+  image_data_param->set_new_width(48);
+  image_data_param->set_shuffle(true);
+  // The batches are the same whatever the number of threads.
+  vector<shared_ptr<Blob<Dtype> > > expected_data;
+  vector<shared_ptr<Blob<Dtype> > > expected_labels;
+  const int kThreads[] = {1, 4};
+  for (int t = 0; t < 2; ++t) {
+    image_data_param->set_threads(kThreads[t]);
+    Caffe::set_random_seed(this->seed_);
+    ImageDataLayer<Dtype> layer(param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int iter = 0; iter < 5; ++iter) {
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      if (t == 0) {
+        expected_data.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+        expected_data.back()->CopyFrom(*this->blob_top_data_, false, true);
+        expected_labels.push_back(
+            shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+        expected_labels.back()->CopyFrom(*this->blob_top_label_, false, true);
+        continue;
+      }
+      for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(expected_labels[iter]->cpu_data()[i],
+                  this->blob_top_label_->cpu_data()[i]);
+      }
+      ASSERT_EQ(expected_data[iter]->count(), this->blob_top_data_->count());
+      for (int i = 0; i < this->blob_top_data_->count(); ++i) {
+        EXPECT_EQ(expected_data[iter]->cpu_data()[i],
+                  this->blob_top_data_->cpu_data()[i]);
+      }
+    }
+  }
+}
+
 }  // namespace caffe
 #endif  // USE_OPENCV
@@ -0,0 +1,398 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/in_place_activations.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class InPlaceActivationsTest : public ::testing::Test {
+ protected:
+  void RunInPlaceActivationsTest(
+      const string& input_param_string, const string& output_param_string) {
+    // Test that MakeActivationsInPlace called on the proto specified by
+    // input_param_string results in the proto specified by
+    // output_param_string.
+    NetParameter input_param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(
+        input_param_string, &input_param));
+    NetParameter expected_output_param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(
+        output_param_string, &expected_output_param));
+    NetParameter actual_output_param;
+    MakeActivationsInPlace(input_param, &actual_output_param);
+    EXPECT_EQ(expected_output_param.DebugString(),
+        actual_output_param.DebugString());
+    // Also test idempotence.
+    NetParameter double_param;
+    MakeActivationsInPlace(actual_output_param, &double_param);
+    EXPECT_EQ(actual_output_param.DebugString(), double_param.DebugString());
+  }
+};
+
+TEST_F(InPlaceActivationsTest, TestChain) {
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'data' "
+      "  top: 'ip' "
+      "} "
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  bottom: 'ip' "
+      "  top: 'relu' "
+      "} "
+      "layer { "
+      "  name: 'drop' "
+      "  type: 'Dropout' "
+      "  bottom: 'relu' "
+      "  top: 'relu' "
+      "} "
+      "layer { "
+      "  name: 'drop2' "
+      "  type: 'Dropout' "
+      "  bottom: 'relu' "
+      "  top: 'drop2' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'drop2' "
+      "  bottom: 'data' "
+      "} ";
+  const string& expected_output_proto =
+      "name: 'TestNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'data' "
+      "  top: 'ip' "
+      "} "
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  relu_param { bit_mask: true } "
+      "  bottom: 'ip' "
+      "  top: 'ip' "
+      "} "
+      "layer { "
+      "  name: 'drop' "
+      "  type: 'Dropout' "
+      "  bottom: 'ip' "
+      "  top: 'ip' "
+      "} "
+      "layer { "
+      "  name: 'drop2' "
+      "  type: 'Dropout' "
+      "  bottom: 'ip' "
+      "  top: 'ip' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'ip' "
+      "  bottom: 'data' "
+      "} ";
+  this->RunInPlaceActivationsTest(input_proto, expected_output_proto);
+}
+
+TEST_F(InPlaceActivationsTest, TestKeepBlobs) {
+  // A blob is kept if another layer reads it, if it has a loss weight, if the
+  // layer producing it reads it in backward, or if a later layer reuses its
+  // name.
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'data' "
+      "  top: 'relu1' "
+      "} "
+      "layer { "
+      "  name: 'ip1' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'relu1' "
+      "  top: 'ip1' "
+      "} "
+      "layer { "
+      "  name: 'relu2' "
+      "  type: 'ReLU' "
+      "  bottom: 'ip1' "
+      "  top: 'relu2' "
+      "} "
+      "layer { "
+      "  name: 'sigmoid' "
+      "  type: 'Sigmoid' "
+      "  bottom: 'ip1' "
+      "  top: 'sigmoid' "
+      "} "
+      "layer { "
+      "  name: 'drop' "
+      "  type: 'Dropout' "
+      "  bottom: 'sigmoid' "
+      "  top: 'drop' "
+      "} "
+      "layer { "
+      "  name: 'ip2' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'drop' "
+      "  top: 'ip2' "
+      "  loss_weight: 1 "
+      "} "
+      "layer { "
+      "  name: 'relu3' "
+      "  type: 'ReLU' "
+      "  bottom: 'ip2' "
+      "  top: 'relu3' "
+      "} "
+      "layer { "
+      "  name: 'ip3' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'relu3' "
+      "  top: 'ip3' "
+      "} "
+      "layer { "
+      "  name: 'relu4' "
+      "  type: 'ReLU' "
+      "  bottom: 'ip3' "
+      "  top: 'relu4' "
+      "} "
+      "layer { "
+      "  name: 'ip4' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'relu4' "
+      "  top: 'ip3' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'relu4' "
+      "  bottom: 'ip3' "
+      "  bottom: 'relu2' "
+      "} ";
+  const string& expected_output_proto =
+      "name: 'TestNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  relu_param { bit_mask: true } "
+      "  bottom: 'data' "
+      "  top: 'relu1' "
+      "} "
+      "layer { "
+      "  name: 'ip1' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'relu1' "
+      "  top: 'ip1' "
+      "} "
+      "layer { "
+      "  name: 'relu2' "
+      "  type: 'ReLU' "
+      "  relu_param { bit_mask: true } "
+      "  bottom: 'ip1' "
+      "  top: 'relu2' "
+      "} "
+      "layer { "
+      "  name: 'sigmoid' "
+      "  type: 'Sigmoid' "
+      "  bottom: 'ip1' "
+      "  top: 'sigmoid' "
+      "} "
+      "layer { "
+      "  name: 'drop' "
+      "  type: 'Dropout' "
+      "  bottom: 'sigmoid' "
+      "  top: 'drop' "
+      "} "
+      "layer { "
+      "  name: 'ip2' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'drop' "
+      "  top: 'ip2' "
+      "  loss_weight: 1 "
+      "} "
+      "layer { "
+      "  name: 'relu3' "
+      "  type: 'ReLU' "
+      "  relu_param { bit_mask: true } "
+      "  bottom: 'ip2' "
+      "  top: 'relu3' "
+      "} "
+      "layer { "
+      "  name: 'ip3' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'relu3' "
+      "  top: 'ip3' "
+      "} "
+      "layer { "
+      "  name: 'relu4' "
+      "  type: 'ReLU' "
+      "  relu_param { bit_mask: true } "
+      "  bottom: 'ip3' "
+      "  top: 'relu4' "
+      "} "
+      "layer { "
+      "  name: 'ip4' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'relu4' "
+      "  top: 'ip3' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'relu4' "
+      "  bottom: 'ip3' "
+      "  bottom: 'relu2' "
+      "} ";
+  this->RunInPlaceActivationsTest(input_proto, expected_output_proto);
+}
+
+template <typename TypeParam>
+class InPlaceActivationsNetTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  InPlaceActivationsNetTest() : seed_(1701) {}
+
+  void InitNet(const bool save_memory) {
+    const string& proto =
+        "name: 'TestNetwork' "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'DummyData' "
+        "  dummy_data_param { "
+        "    shape { dim: 2 dim: 3 dim: 6 dim: 6 } "
+        "    shape { dim: 2 dim: 8 } "
+        "    data_filler { type: 'gaussian' } "
+        "  } "
+        "  top: 'data' "
+        "  top: 'target' "
+        "} "
+        "layer { "
+        "  name: 'conv' "
+        "  type: 'Convolution' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "    bias_filler { type: 'gaussian' std: 0.5 } "
+        "  } "
+        "  bottom: 'data' "
+        "  top: 'conv' "
+        "} "
+        "layer { "
+        "  name: 'relu1' "
+        "  type: 'ReLU' "
+        "  relu_param { negative_slope: 0.1 } "
+        "  bottom: 'conv' "
+        "  top: 'relu1' "
+        "} "
+        "layer { "
+        "  name: 'pool' "
+        "  type: 'Pooling' "
+        "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } "
+        "  bottom: 'relu1' "
+        "  top: 'pool' "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  inner_product_param { "
+        "    num_output: 8 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "  } "
+        "  bottom: 'pool' "
+        "  top: 'ip' "
+        "} "
+        "layer { "
+        "  name: 'drop' "
+        "  type: 'Dropout' "
+        "  bottom: 'ip' "
+        "  top: 'drop' "
+        "} "
+        "layer { "
+        "  name: 'relu2' "
+        "  type: 'ReLU' "
+        "  bottom: 'drop' "
+        "  top: 'relu2' "
+        "} "
+        "layer { "
+        "  name: 'loss' "
+        "  type: 'EuclideanLoss' "
+        "  bottom: 'relu2' "
+        "  bottom: 'target' "
+        "} ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    param.set_save_memory(save_memory);
+    Caffe::set_random_seed(seed_);
+    net_.reset(new Net<Dtype>(param));
+  }
+
+  int seed_;
+  shared_ptr<Net<Dtype> > net_;
+};
+
+TYPED_TEST_CASE(InPlaceActivationsNetTest, TestDtypesAndDevices);
+
+TYPED_TEST(InPlaceActivationsNetTest, TestForwardBackward) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitNet(false);
+  EXPECT_EQ(9, this->net_->blobs().size());
+  const Dtype expected_loss = this->net_->ForwardBackward();
+  vector<shared_ptr<Blob<Dtype> > > expected_diffs;
+  for (int i = 0; i < this->net_->learnable_params().size(); ++i) {
+    expected_diffs.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    expected_diffs[i]->CopyFrom(*this->net_->learnable_params()[i], true,
+                                true);
+  }
+
+  this->InitNet(true);
+  // The ReLU and Dropout layers compute in place.
+  EXPECT_EQ(6, this->net_->blobs().size());
+  EXPECT_TRUE(this->net_->has_blob("ip"));
+  EXPECT_FALSE(this->net_->has_blob("relu2"));
+  const Dtype loss = this->net_->ForwardBackward();
+  EXPECT_NEAR(expected_loss, loss, 1e-5);
+  ASSERT_EQ(expected_diffs.size(), this->net_->learnable_params().size());
+  for (int i = 0; i < expected_diffs.size(); ++i) {
+    const Blob<Dtype>& diff = *this->net_->learnable_params()[i];
+    ASSERT_EQ(expected_diffs[i]->count(), diff.count());
+    for (int j = 0; j < diff.count(); ++j) {
+      EXPECT_NEAR(expected_diffs[i]->cpu_diff()[j], diff.cpu_diff()[j], 1e-5);
+    }
+  }
+}
+
+}  // namespace caffe
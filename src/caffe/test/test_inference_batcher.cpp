@@ -0,0 +1,182 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/inference_batcher.hpp"
+#include "caffe/inference_engine.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class InferenceBatcherTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ public:
+  InferenceBatcherTest() : seed_(1701) {}
+
+  virtual void InitEngine(int num_requests) {
+    const string& proto =
+        "name: 'BatcherTestNetwork' "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { shape: { dim: 1 dim: 2 dim: 4 dim: 3 } } "
+        "} "
+        "layer { "
+        "  name: 'conv' "
+        "  type: 'Convolution' "
+        "  convolution_param { "
+        "    num_output: 3 "
+        "    kernel_size: 2 "
+        "    weight_filler { type: 'gaussian' std: 1 } "
+        "    bias_filler { type: 'gaussian' std: 1 } "
+        "  } "
+        "  bottom: 'data' "
+        "  top: 'conv' "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  inner_product_param { "
+        "    num_output: 5 "
+        "    weight_filler { type: 'gaussian' std: 1 } "
+        "    bias_filler { type: 'gaussian' std: 1 } "
+        "  } "
+        "  bottom: 'conv' "
+        "  top: 'ip' "
+        "} "
+        "layer { "
+        "  name: 'prob' "
+        "  type: 'Softmax' "
+        "  bottom: 'ip' "
+        "  top: 'prob' "
+        "} ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    engine_.reset(new InferenceEngine<Dtype>(param));
+    // Compute the expected outputs of random inputs one at a time.
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    Net<Dtype>& net = *engine_->net();
+    for (int i = 0; i < num_requests; ++i) {
+      inputs_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      inputs_[i]->ReshapeLike(*net.input_blobs()[0]);
+      filler.Fill(inputs_[i].get());
+      net.input_blobs()[0]->CopyFrom(*inputs_[i]);
+      net.Forward();
+      expected_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      expected_[i]->CopyFrom(*net.output_blobs()[0], false, true);
+    }
+    results_.resize(num_requests);
+  }
+
+  void SubmitRequests(InferenceBatcher<Dtype>* batcher, int first, int step) {
+    for (int i = first; i < inputs_.size(); i += step) {
+      results_[i] = batcher->Submit(boost::bind(&caffe_copy<Dtype>,
+          inputs_[i]->count(), inputs_[i]->cpu_data(), _1)).get();
+    }
+  }
+
+  void CheckResults() {
+    for (int i = 0; i < expected_.size(); ++i) {
+      ASSERT_EQ(expected_[i]->count(), results_[i].size());
+      for (int j = 0; j < results_[i].size(); ++j) {
+        EXPECT_NEAR(expected_[i]->cpu_data()[j], results_[i][j], 1e-5);
+      }
+    }
+  }
+
+  int seed_;
+  shared_ptr<InferenceEngine<Dtype> > engine_;
+  vector<shared_ptr<Blob<Dtype> > > inputs_;
+  vector<shared_ptr<Blob<Dtype> > > expected_;
+  vector<vector<Dtype> > results_;
+};
+
+TYPED_TEST_CASE(InferenceBatcherTest, TestDtypesAndDevices);
+
+TYPED_TEST(InferenceBatcherTest, TestBatches) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  const int kNumRequests = 8;
+  this->InitEngine(kNumRequests);
+  // A long timeout: the batches close once full.
+  InferenceBatcher<Dtype> batcher(this->engine_, 4, 10000);
+  vector<boost::unique_future<vector<Dtype> > > futures;
+  for (int i = 0; i < kNumRequests; ++i) {
+    futures.push_back(batcher.Submit(boost::bind(&caffe_copy<Dtype>,
+        this->inputs_[i]->count(), this->inputs_[i]->cpu_data(), _1)));
+  }
+  for (int i = 0; i < kNumRequests; ++i) {
+    this->results_[i] = futures[i].get();
+  }
+  this->CheckResults();
+  EXPECT_EQ(2, batcher.num_batches());
+  EXPECT_EQ(kNumRequests, batcher.num_requests());
+  EXPECT_EQ(0, batcher.queue_size());
+}
+
+TYPED_TEST(InferenceBatcherTest, TestTimeout) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitEngine(1);
+  // The only request is answered alone once the timeout expires.
+  InferenceBatcher<Dtype> batcher(this->engine_, 4, 10);
+  this->SubmitRequests(&batcher, 0, 1);
+  this->CheckResults();
+  EXPECT_EQ(1, batcher.num_batches());
+}
+
+TYPED_TEST(InferenceBatcherTest, TestTrySubmit) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitEngine(2);
+  vector<boost::unique_future<vector<Dtype> > > futures(2);
+  {
+    // The first request waits for its batch to fill, and fills the queue.
+    InferenceBatcher<Dtype> batcher(this->engine_, 4, 10000, 1, 1);
+    for (int i = 0; i < 2; ++i) {
+      EXPECT_EQ(i == 0, batcher.TrySubmit(boost::bind(&caffe_copy<Dtype>,
+          this->inputs_[i]->count(), this->inputs_[i]->cpu_data(), _1),
+          &futures[i]));
+    }
+    EXPECT_EQ(1, batcher.queue_size());
+  }
+  // Stopping the batcher answered the queued request.
+  this->results_[0] = futures[0].get();
+  this->results_.resize(1);
+  this->expected_.resize(1);
+  this->CheckResults();
+}
+
+TYPED_TEST(InferenceBatcherTest, TestConcurrentSubmit) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  const int kNumRequests = 32;
+  const int kNumThreads = 4;
+  this->InitEngine(kNumRequests);
+  InferenceBatcher<Dtype> batcher(this->engine_, 3, 1, 2, 2);
+  boost::thread_group threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.create_thread(boost::bind(
+        &InferenceBatcherTest<TypeParam>::SubmitRequests, this, &batcher, i,
+        kNumThreads));
+  }
+  threads.join_all();
+  this->CheckResults();
+  EXPECT_EQ(kNumRequests, batcher.num_requests());
+}
+
+}  // namespace caffe
@@ -0,0 +1,176 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/inference_engine.hpp"
+#include "caffe/net.hpp"
+#include "caffe/syncedmem.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class InferenceEngineTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ public:
+  InferenceEngineTest() : seed_(1701) {}
+
+  virtual void InitEngine() {
+    const string& proto =
+        "name: 'InferenceTestNetwork' "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { shape: { dim: 2 dim: 3 dim: 6 dim: 5 } } "
+        "} "
+        "layer { "
+        "  name: 'conv' "
+        "  type: 'Convolution' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    weight_filler { type: 'gaussian' std: 1 } "
+        "    bias_filler { type: 'gaussian' std: 1 } "
+        "  } "
+        "  bottom: 'data' "
+        "  top: 'conv' "
+        "} "
+        "layer { "
+        "  name: 'relu' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv' "
+        "  top: 'conv' "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  inner_product_param { "
+        "    num_output: 5 "
+        "    weight_filler { type: 'gaussian' std: 1 } "
+        "    bias_filler { type: 'gaussian' std: 1 } "
+        "  } "
+        "  bottom: 'conv' "
+        "  top: 'ip' "
+        "} "
+        "layer { "
+        "  name: 'prob' "
+        "  type: 'Softmax' "
+        "  bottom: 'ip' "
+        "  top: 'prob' "
+        "} ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    engine_.reset(new InferenceEngine<Dtype>(param));
+  }
+
+  void RunExecutors(Caffe::Brew mode, int device, int first, int step) {
+#ifndef CPU_ONLY
+    CUDA_CHECK(cudaSetDevice(device));
+#endif
+    Caffe::set_mode(mode);
+    for (int i = first; i < executors_.size(); i += step) {
+      executors_[i]->Forward();
+    }
+  }
+
+  int seed_;
+  shared_ptr<InferenceEngine<Dtype> > engine_;
+  vector<shared_ptr<Net<Dtype> > > executors_;
+};
+
+TYPED_TEST_CASE(InferenceEngineTest, TestDtypesAndDevices);
+
+TYPED_TEST(InferenceEngineTest, TestSharesWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitEngine();
+  const Net<Dtype>& net = *this->engine_->net();
+  shared_ptr<Net<Dtype> > executor = this->engine_->CreateExecutor();
+  ASSERT_EQ(net.params().size(), executor->params().size());
+  EXPECT_EQ(4, executor->params().size());
+  for (int i = 0; i < net.params().size(); ++i) {
+    EXPECT_NE(net.params()[i].get(), executor->params()[i].get());
+    EXPECT_EQ(net.params()[i]->data().get(),
+              executor->params()[i]->data().get());
+  }
+  EXPECT_NE(net.input_blobs()[0], executor->input_blobs()[0]);
+  EXPECT_NE(net.output_blobs()[0], executor->output_blobs()[0]);
+}
+
+TYPED_TEST(InferenceEngineTest, TestSharesPackedWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitEngine();
+  const int kNumExecutors = 4;
+  for (int i = 0; i < kNumExecutors; ++i) {
+    this->executors_.push_back(this->engine_->CreateExecutor());
+  }
+  // The small batch runs on weights packed in the workspace of the layers:
+  // once for all the executors, not once each.
+  const int conv_tag = SyncedMemory::Tag("conv/workspace");
+  const int ip_tag = SyncedMemory::Tag("ip/workspace");
+  this->executors_[0]->Forward();
+  const size_t conv_usage = SyncedMemory::TagUsage(conv_tag).cpu;
+  const size_t ip_usage = SyncedMemory::TagUsage(ip_tag).cpu;
+  if (Caffe::mode() == Caffe::CPU) {
+    EXPECT_GE(ip_usage, 5 * 4 * 4 * 3 * sizeof(Dtype));
+  }
+  for (int i = 1; i < kNumExecutors; ++i) {
+    this->executors_[i]->Forward();
+  }
+  EXPECT_EQ(conv_usage, SyncedMemory::TagUsage(conv_tag).cpu);
+  EXPECT_EQ(ip_usage, SyncedMemory::TagUsage(ip_tag).cpu);
+}
+
+TYPED_TEST(InferenceEngineTest, TestConcurrentForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitEngine();
+  const int kNumExecutors = 8;
+  const int kNumThreads = 4;
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  vector<shared_ptr<Blob<Dtype> > > expected(kNumExecutors);
+  Net<Dtype>& net = *this->engine_->net();
+  for (int i = 0; i < kNumExecutors; ++i) {
+    shared_ptr<Net<Dtype> > executor = this->engine_->CreateExecutor();
+    filler.Fill(executor->input_blobs()[0]);
+    net.input_blobs()[0]->CopyFrom(*executor->input_blobs()[0]);
+    net.Forward();
+    expected[i].reset(new Blob<Dtype>());
+    expected[i]->CopyFrom(*net.output_blobs()[0], false, true);
+    this->executors_.push_back(executor);
+  }
+  int device = 0;
+#ifndef CPU_ONLY
+  if (Caffe::mode() == Caffe::GPU) {
+    CUDA_CHECK(cudaGetDevice(&device));
+  }
+#endif
+  boost::thread_group threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.create_thread(boost::bind(
+        &InferenceEngineTest<TypeParam>::RunExecutors, this, Caffe::mode(),
+        device, i, kNumThreads));
+  }
+  threads.join_all();
+  for (int i = 0; i < kNumExecutors; ++i) {
+    const Blob<Dtype>& output = *this->executors_[i]->output_blobs()[0];
+    ASSERT_EQ(expected[i]->count(), output.count());
+    for (int j = 0; j < output.count(); ++j) {
+      EXPECT_EQ(expected[i]->cpu_data()[j], output.cpu_data()[j]);
+    }
+  }
+}
+
+}  // namespace caffe
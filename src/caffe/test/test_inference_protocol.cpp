@@ -0,0 +1,102 @@
+#include <stdint.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/util/inference_protocol.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class InferenceProtocolTest : public ::testing::Test {
+ protected:
+  InferenceProtocolTest() : max_sizes_(1, 4 * sizeof(float)) {}
+
+  virtual void SetUp() {
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds_), 0);
+  }
+
+  virtual void TearDown() {
+    close(fds_[0]);
+    close(fds_[1]);
+  }
+
+  // Sends a bare header announcing size bytes of payload.
+  void SendHeader(uint32_t code, uint32_t size) {
+    const uint32_t header[2] = { code, size };
+    ASSERT_TRUE(inference::WriteFully(fds_[0], header, sizeof(header)));
+  }
+
+  int fds_[2];
+  // PREDICT of up to 4 floats, no payload otherwise.
+  const vector<uint32_t> max_sizes_;
+};
+
+TEST_F(InferenceProtocolTest, TestReadMessage) {
+  const float input[4] = { 1, 2, 3, 4 };
+  ASSERT_TRUE(inference::WriteMessage(fds_[0], inference::PREDICT, input,
+      sizeof(input)));
+  ASSERT_TRUE(inference::WriteMessage(fds_[0], inference::METRICS, NULL, 0));
+  uint32_t code;
+  vector<char> payload;
+  bool oversized;
+  ASSERT_TRUE(inference::ReadMessage(fds_[1], &code, &payload, max_sizes_,
+      &oversized));
+  EXPECT_FALSE(oversized);
+  EXPECT_EQ(code, inference::PREDICT);
+  ASSERT_EQ(payload.size(), sizeof(input));
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(reinterpret_cast<const float*>(&payload[0])[i], input[i]);
+  }
+  ASSERT_TRUE(inference::ReadMessage(fds_[1], &code, &payload, max_sizes_,
+      &oversized));
+  EXPECT_FALSE(oversized);
+  EXPECT_EQ(code, inference::METRICS);
+  EXPECT_TRUE(payload.empty());
+}
+
+TEST_F(InferenceProtocolTest, TestReadMessageOversized) {
+  // A header announcing 4 GiB must be refused before any allocation.
+  SendHeader(inference::PREDICT, 0xffffffffu);
+  uint32_t code;
+  vector<char> payload;
+  bool oversized;
+  EXPECT_FALSE(inference::ReadMessage(fds_[1], &code, &payload, max_sizes_,
+      &oversized));
+  EXPECT_TRUE(oversized);
+  EXPECT_EQ(code, inference::PREDICT);
+  EXPECT_TRUE(payload.empty());
+  EXPECT_EQ(payload.capacity(), static_cast<size_t>(0));
+}
+
+TEST_F(InferenceProtocolTest, TestReadMessageUnexpectedPayload) {
+  // Requests other than PREDICT take no payload.
+  SendHeader(inference::INPUT_SHAPE, 1);
+  uint32_t code;
+  vector<char> payload;
+  bool oversized;
+  EXPECT_FALSE(inference::ReadMessage(fds_[1], &code, &payload, max_sizes_,
+      &oversized));
+  EXPECT_TRUE(oversized);
+  SendHeader(42, 1);
+  EXPECT_FALSE(inference::ReadMessage(fds_[1], &code, &payload, max_sizes_,
+      &oversized));
+  EXPECT_TRUE(oversized);
+}
+
+TEST_F(InferenceProtocolTest, TestReadMessageClosed) {
+  close(fds_[0]);
+  fds_[0] = -1;
+  uint32_t code;
+  vector<char> payload;
+  bool oversized;
+  EXPECT_FALSE(inference::ReadMessage(fds_[1], &code, &payload, max_sizes_,
+      &oversized));
+  EXPECT_FALSE(oversized);
+}
+
+}  // namespace caffe
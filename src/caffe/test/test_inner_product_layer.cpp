@@ -208,6 +208,46 @@ TYPED_TEST(InnerProductLayerTest, TestForwardTranspose) {
   }
 }
 
+/**
+ * @brief At test time, a small batch goes through the packed weights: check
+ * that it gives the result of training time, also after the weights change.
+ */
+TYPED_TEST(InnerProductLayerTest, TestForwardPacked) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  for (int transpose = 0; transpose < 2; ++transpose) {
+    LayerParameter layer_param;
+    InnerProductParameter* inner_product_param =
+        layer_param.mutable_inner_product_param();
+    inner_product_param->set_num_output(21);
+    inner_product_param->set_transpose(transpose);
+    inner_product_param->mutable_weight_filler()->set_type("gaussian");
+    InnerProductLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer_param.set_phase(TEST);
+    InnerProductLayer<Dtype> layer_test(layer_param);
+    Blob<Dtype> top_test;
+    vector<Blob<Dtype>*> top_test_vec(1, &top_test);
+    layer_test.SetUp(this->blob_bottom_vec_, top_test_vec);
+    for (int i = 0; i < layer.blobs().size(); ++i) {
+      layer_test.blobs()[i]->ShareData(*layer.blobs()[i]);
+    }
+    for (int pass = 0; pass < 2; ++pass) {
+      if (pass) {
+        caffe_scal<Dtype>(layer.blobs()[0]->count(), Dtype(-2),
+            layer.blobs()[0]->mutable_cpu_data());
+      }
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer_test.Forward(this->blob_bottom_vec_, top_test_vec);
+      ASSERT_EQ(this->blob_top_->count(), top_test.count());
+      for (int i = 0; i < top_test.count(); ++i) {
+        EXPECT_NEAR(this->blob_top_->cpu_data()[i], top_test.cpu_data()[i],
+            1e-4);
+      }
+    }
+  }
+}
+
 TYPED_TEST(InnerProductLayerTest, TestForwardNoBatch) {
   typedef typename TypeParam::Dtype Dtype;
   this->blob_bottom_vec_.push_back(this->blob_bottom_nobatch_);
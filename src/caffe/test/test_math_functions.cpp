@@ -1,6 +1,7 @@
 #include <stdint.h>  // for uint32_t & uint64_t
 #include <time.h>
 #include <cmath>  // for std::fabs
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -119,6 +120,78 @@ TYPED_TEST(CPUMathFunctionsTest, TestCopy) {
   }
 }
 
+TYPED_TEST(CPUMathFunctionsTest, TestGemmPacked) {
+  // Row counts below, at and above a multiple of the rows of the kernel and
+  // kPackedGemmMaxRows, columns around the panel width.
+  const int rows[] = { 1, 3, 4, 5, kPackedGemmMaxRows, kPackedGemmMaxRows + 1 };
+  const int cols[] = { 1, 16, 33 };
+  const int K = 37;
+  const TypeParam* x = this->blob_bottom_->cpu_data();
+  const TypeParam* w = x + 1000;
+  vector<TypeParam> expected(kPackedGemmMaxRows * 40);
+  vector<TypeParam> y(expected.size());
+  for (int t = 0; t < 4; ++t) {
+    const CBLAS_TRANSPOSE trans_packed = t & 1 ? CblasTrans : CblasNoTrans;
+    const CBLAS_TRANSPOSE trans_other = t & 2 ? CblasTrans : CblasNoTrans;
+    for (int r = 0; r < sizeof(rows) / sizeof(rows[0]); ++r) {
+      for (int c = 0; c < sizeof(cols) / sizeof(cols[0]); ++c) {
+        const int M = rows[r];
+        const int N = cols[c];
+        expected.resize(M * N);
+        y.resize(M * N);
+        // C = 2 op(A) B - C, with B packed.
+        PackedMatrix<TypeParam> packed;
+        packed.Pack(trans_packed, K, N, w, 0);
+        caffe_copy(M * N, x + 3000, &expected[0]);
+        caffe_copy(M * N, x + 3000, &y[0]);
+        caffe_cpu_gemm<TypeParam>(trans_other, trans_packed, M, N, K, 2., x, w,
+            -1., &expected[0]);
+        caffe_cpu_gemm_packed_b<TypeParam>(trans_other, M, 2., x, packed, -1.,
+            &y[0]);
+        for (int i = 0; i < M * N; ++i) {
+          EXPECT_NEAR(expected[i], y[i], 1e-4);
+        }
+        // C = 2 A op(B), with A^T packed.
+        caffe_cpu_gemm<TypeParam>(trans_packed == CblasNoTrans ? CblasTrans
+            : CblasNoTrans, trans_other, N, M, K, 2., w, x, 0., &expected[0]);
+        caffe_cpu_gemm_packed_a<TypeParam>(packed, trans_other, M, 2., x, 0.,
+            &y[0]);
+        for (int i = 0; i < M * N; ++i) {
+          EXPECT_NEAR(expected[i], y[i], 1e-4);
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestGemmPackedRepack) {
+  // A packed matrix follows the version of its source, and only it.
+  Blob<TypeParam> weights(1, 1, 5, 7);
+  caffe_copy(weights.count(), this->blob_bottom_->cpu_data(),
+      weights.mutable_cpu_data());
+  const TypeParam* w = weights.cpu_data();
+  const TypeParam* x = this->blob_top_->cpu_data();
+  PackedMatrix<TypeParam> packed;
+  packed.Pack(CblasNoTrans, 5, 7, w, weights.data()->version());
+  vector<TypeParam> y(7);
+  vector<TypeParam> expected(7);
+  caffe_cpu_gemm<TypeParam>(CblasNoTrans, CblasNoTrans, 1, 7, 5, 1., x, w, 0.,
+      &expected[0]);
+  caffe_scal<TypeParam>(weights.count(), 2., weights.mutable_cpu_data());
+  caffe_cpu_gemm_packed_b<TypeParam>(CblasNoTrans, 1, 1., x, packed, 0.,
+      &y[0]);
+  for (int i = 0; i < 7; ++i) {
+    EXPECT_NEAR(expected[i], y[i], 1e-4);
+  }
+  // Packed again at the new version.
+  packed.Pack(CblasNoTrans, 5, 7, w, weights.data()->version());
+  caffe_cpu_gemm_packed_b<TypeParam>(CblasNoTrans, 1, 1., x, packed, 0.,
+      &y[0]);
+  for (int i = 0; i < 7; ++i) {
+    EXPECT_NEAR(2 * expected[i], y[i], 1e-4);
+  }
+}
+
 #ifndef CPU_ONLY
 
 template <typename Dtype>
@@ -1,3 +1,4 @@
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
@@ -771,6 +772,172 @@ class NetTest : public MultiDeviceTest<TypeParam> {
     InitNetFromProtoString(proto);
   }
 
+  virtual void InitFanOutNet(const bool insert_splits,
+                             const int branch_threads = 1) {
+    ostringstream proto;
+    proto <<
+        "name: 'FanOutTestNetwork' "
+        "force_backward: true "
+        "insert_splits: " << (insert_splits ? "true " : "false ") <<
+        "branch_threads: " << branch_threads << " " <<
+        "layer { "
+        "  name: 'data' "
+        "  type: 'DummyData' "
+        "  dummy_data_param { "
+        "    shape { dim: 5 dim: 2 dim: 3 dim: 4 } "
+        "    data_filler { "
+        "      type: 'gaussian' "
+        "      std: 1 "
+        "    } "
+        "  } "
+        "  top: 'data' "
+        "} ";
+    for (int i = 1; i <= 3; ++i) {
+      proto <<
+          "layer { "
+          "  name: 'innerproduct" << i << "' "
+          "  type: 'InnerProduct' "
+          "  inner_product_param { "
+          "    num_output: 10 "
+          "    weight_filler { "
+          "      type: 'gaussian' "
+          "      std: 1 "
+          "    } "
+          "  } "
+          "  bottom: 'data' "
+          "  top: 'innerproduct" << i << "' "
+          "} ";
+    }
+    proto <<
+        "layer { "
+        "  name: 'sum' "
+        "  type: 'Eltwise' "
+        "  bottom: 'innerproduct1' "
+        "  bottom: 'innerproduct2' "
+        "  top: 'sum' "
+        "} "
+        "layer { "
+        "  name: 'loss' "
+        "  type: 'EuclideanLoss' "
+        "  bottom: 'sum' "
+        "  bottom: 'innerproduct3' "
+        "} ";
+    InitNetFromProtoString(proto.str());
+  }
+
+  virtual void InitCheckpointNet(const int checkpoint_every,
+                                 const bool checkpoint_pool = false,
+                                 const Phase phase = TRAIN) {
+    ostringstream proto;
+    proto <<
+        "name: 'CheckpointTestNetwork' "
+        "state { phase: " << (phase == TRAIN ? "TRAIN" : "TEST") << " } "
+        "checkpoint_every: " << checkpoint_every << " "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'DummyData' "
+        "  dummy_data_param { "
+        "    shape { dim: 4 dim: 3 dim: 8 dim: 8 } "
+        "    shape { dim: 4 dim: 5 } "
+        "    data_filler { type: 'gaussian' } "
+        "  } "
+        "  top: 'data' "
+        "  top: 'target' "
+        "} "
+        "layer { "
+        "  name: 'conv1' "
+        "  type: 'Convolution' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.3 } "
+        "  } "
+        "  bottom: 'data' "
+        "  top: 'conv1' "
+        "} "
+        "layer { "
+        "  name: 'bn1' "
+        "  type: 'BatchNorm' "
+        "  bottom: 'conv1' "
+        "  top: 'conv1' "
+        "} "
+        "layer { "
+        "  name: 'relu1' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv1' "
+        "  top: 'conv1' "
+        "} "
+        "layer { "
+        "  name: 'conv2' "
+        "  type: 'Convolution' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.3 } "
+        "  } "
+        "  bottom: 'conv1' "
+        "  top: 'conv2' "
+        "} "
+        "layer { "
+        "  name: 'relu2' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv2' "
+        "  top: 'relu2' "
+        "} "
+        "layer { "
+        "  name: 'drop' "
+        "  type: 'Dropout' "
+        "  bottom: 'relu2' "
+        "  top: 'relu2' "
+        "} "
+        "layer { "
+        "  name: 'pool' "
+        "  type: 'Pooling' "
+        "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } "
+        "  bottom: 'relu2' "
+        "  top: 'pool' "
+        << (checkpoint_pool ? "checkpoint: true " : "") <<
+        "} "
+        "layer { "
+        "  name: 'ip1' "
+        "  type: 'InnerProduct' "
+        "  inner_product_param { "
+        "    num_output: 8 "
+        "    weight_filler { type: 'gaussian' std: 0.3 } "
+        "  } "
+        "  bottom: 'pool' "
+        "  top: 'ip1' "
+        "} ";
+    for (int i = 2; i <= 3; ++i) {
+      proto <<
+          "layer { "
+          "  name: 'ip" << i << "' "
+          "  type: 'InnerProduct' "
+          "  inner_product_param { "
+          "    num_output: 5 "
+          "    weight_filler { type: 'gaussian' std: 0.3 } "
+          "  } "
+          "  bottom: 'ip1' "
+          "  top: 'ip" << i << "' "
+          "} ";
+    }
+    proto <<
+        "layer { "
+        "  name: 'sum' "
+        "  type: 'Eltwise' "
+        "  bottom: 'ip2' "
+        "  bottom: 'ip3' "
+        "  top: 'sum' "
+        "} "
+        "layer { "
+        "  name: 'loss' "
+        "  type: 'EuclideanLoss' "
+        "  bottom: 'sum' "
+        "  bottom: 'target' "
+        "} ";
+    InitNetFromProtoString(proto.str());
+  }
+
   int seed_;
   shared_ptr<Net<Dtype> > net_;
 };
@@ -824,6 +991,36 @@ TYPED_TEST(NetTest, TestBottomNeedBackward) {
   EXPECT_EQ(false, bottom_need_backward[2][1]);
 }
 
+TYPED_TEST(NetTest, TestMemoryTags) {
+  typedef typename TypeParam::Dtype Dtype;
+  const char* tags[] = { "data/data", "innerproduct/data",
+      "innerproduct/diff", "innerproduct/params", "loss/workspace" };
+  vector<size_t> before;
+  for (int i = 0; i < 5; ++i) {
+    const SyncedMemory::Usage usage =
+        SyncedMemory::TagUsage(SyncedMemory::Tag(tags[i]));
+    before.push_back(Caffe::mode() == Caffe::CPU ? usage.cpu : usage.gpu);
+  }
+  this->InitTinyNet();
+  this->net_->Forward();
+  this->net_->Backward();
+  // The data is 5 x 24, the weights 1000 x 24 and the bias 1000; the loss
+  // keeps at least the 5 x 1000 probabilities as workspace.
+  const size_t expected[] = { 5 * 24 + 5, 5 * 1000, 5 * 1000,
+      1000 * 24 * 2 + 1000 * 2, 5 * 1000 };
+  for (int i = 0; i < 5; ++i) {
+    const SyncedMemory::Usage usage =
+        SyncedMemory::TagUsage(SyncedMemory::Tag(tags[i]));
+    const size_t used =
+        (Caffe::mode() == Caffe::CPU ? usage.cpu : usage.gpu) - before[i];
+    if (i < 4) {
+      EXPECT_EQ(expected[i] * sizeof(Dtype), used) << tags[i];
+    } else {
+      EXPECT_GE(used, expected[i] * sizeof(Dtype)) << tags[i];
+    }
+  }
+}
+
 TYPED_TEST(NetTest, TestBottomNeedBackwardForce) {
   const bool force_backward = true;
   this->InitTinyNet(force_backward);
@@ -2473,4 +2670,151 @@ TYPED_TEST(NetTest, TestForcePropagateDown) {
   }
 }
 
+TYPED_TEST(NetTest, TestFanOutWithoutSplits) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Run forward and backward with and without Split layers and check that
+  // the loss and all gradients agree.
+  Caffe::set_random_seed(this->seed_);
+  this->InitFanOutNet(true);
+  Dtype split_loss;
+  this->net_->Forward(&split_loss);
+  this->net_->Backward();
+  EXPECT_EQ(this->net_->layers().size(), 7);
+  vector<shared_ptr<Blob<Dtype> > > split_params;
+  this->CopyNetParams(true, &split_params);
+  Blob<Dtype> split_data_diff;
+  split_data_diff.CopyFrom(*this->net_->blob_by_name("data"), true, true);
+
+  Caffe::set_random_seed(this->seed_);
+  this->InitFanOutNet(false);
+  for (int i = 0; i < this->net_->layers().size(); ++i) {
+    EXPECT_STRNE("Split", this->net_->layers()[i]->type());
+  }
+  EXPECT_EQ(this->net_->layers().size(), 6);
+  Dtype loss;
+  this->net_->Forward(&loss);
+  this->net_->Backward();
+  EXPECT_FLOAT_EQ(split_loss, loss);
+  vector<shared_ptr<Blob<Dtype> > > params;
+  this->CopyNetParams(true, &params);
+  ASSERT_EQ(split_params.size(), params.size());
+  for (int i = 0; i < params.size(); ++i) {
+    for (int j = 0; j < params[i]->count(); ++j) {
+      EXPECT_FLOAT_EQ(split_params[i]->cpu_diff()[j], params[i]->cpu_diff()[j]);
+    }
+  }
+  const Blob<Dtype>& data = *this->net_->blob_by_name("data");
+  ASSERT_EQ(split_data_diff.count(), data.count());
+  for (int i = 0; i < data.count(); ++i) {
+    EXPECT_NEAR(split_data_diff.cpu_diff()[i], data.cpu_diff()[i],
+                1e-4 * std::max(Dtype(1), fabs(data.cpu_diff()[i])));
+  }
+}
+
+TYPED_TEST(NetTest, TestParallelBranches) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Run the independent layers concurrently, with and without Split layers,
+  // and check that the loss and all gradients match the serial run. The data
+  // of the serial run is reused, as the data layer may run on any thread.
+  Caffe::set_random_seed(this->seed_);
+  this->InitFanOutNet(true);
+  Dtype serial_loss;
+  this->net_->Forward(&serial_loss);
+  this->net_->Backward();
+  vector<shared_ptr<Blob<Dtype> > > serial_params;
+  this->CopyNetParams(true, &serial_params);
+  Blob<Dtype> serial_data;
+  serial_data.CopyFrom(*this->net_->blob_by_name("data"), false, true);
+  serial_data.CopyFrom(*this->net_->blob_by_name("data"), true, true);
+  for (int insert_splits = 1; insert_splits >= 0; --insert_splits) {
+    Caffe::set_random_seed(this->seed_);
+    this->InitFanOutNet(insert_splits, 3);
+    for (int iter = 0; iter < 3; ++iter) {
+      this->net_->ClearParamDiffs();
+      this->net_->blob_by_name("data")->CopyFrom(serial_data);
+      const Dtype loss = this->net_->ForwardFrom(1);
+      this->net_->Backward();
+      EXPECT_FLOAT_EQ(serial_loss, loss);
+      vector<shared_ptr<Blob<Dtype> > > params;
+      this->CopyNetParams(true, &params);
+      ASSERT_EQ(serial_params.size(), params.size());
+      for (int i = 0; i < params.size(); ++i) {
+        for (int j = 0; j < params[i]->count(); ++j) {
+          EXPECT_FLOAT_EQ(serial_params[i]->cpu_diff()[j],
+                          params[i]->cpu_diff()[j]);
+        }
+      }
+      const Blob<Dtype>& data = *this->net_->blob_by_name("data");
+      ASSERT_EQ(serial_data.count(), data.count());
+      for (int i = 0; i < data.count(); ++i) {
+        EXPECT_NEAR(serial_data.cpu_diff()[i], data.cpu_diff()[i],
+                    1e-4 * std::max(Dtype(1), fabs(data.cpu_diff()[i])));
+      }
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestCheckpointing) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Recompute the activations in backward, cutting the layers every few
+  // layers or after a chosen layer, and check that the losses, the gradients
+  // and the BatchNorm statistics of a few iterations match exactly.
+  const int kNumIters = 2;
+  Caffe::set_random_seed(this->seed_);
+  this->InitCheckpointNet(0);
+  vector<Dtype> expected_losses;
+  for (int iter = 0; iter < kNumIters; ++iter) {
+    this->net_->ClearParamDiffs();
+    expected_losses.push_back(this->net_->ForwardBackward());
+  }
+  vector<shared_ptr<Blob<Dtype> > > expected_params, expected_diffs;
+  this->CopyNetParams(false, &expected_params);
+  this->CopyNetParams(true, &expected_diffs);
+  set<const SyncedMemory*> expected_memory;
+  for (int i = 0; i < this->net_->blobs().size(); ++i) {
+    expected_memory.insert(this->net_->blobs()[i]->data().get());
+  }
+  const int checkpoint_every[] = { 2, 3, 0 };
+  for (int c = 0; c < 3; ++c) {
+    Caffe::set_random_seed(this->seed_);
+    this->InitCheckpointNet(checkpoint_every[c], checkpoint_every[c] == 0);
+    for (int iter = 0; iter < kNumIters; ++iter) {
+      this->net_->ClearParamDiffs();
+      EXPECT_EQ(expected_losses[iter], this->net_->ForwardBackward());
+    }
+    const vector<shared_ptr<Blob<Dtype> > >& params = this->net_->params();
+    ASSERT_EQ(expected_params.size(), params.size());
+    for (int i = 0; i < params.size(); ++i) {
+      for (int j = 0; j < params[i]->count(); ++j) {
+        EXPECT_EQ(expected_params[i]->cpu_data()[j], params[i]->cpu_data()[j]);
+        EXPECT_EQ(expected_diffs[i]->cpu_diff()[j], params[i]->cpu_diff()[j]);
+      }
+    }
+    // The blobs within the segments share memory.
+    set<const SyncedMemory*> memory;
+    for (int i = 0; i < this->net_->blobs().size(); ++i) {
+      memory.insert(this->net_->blobs()[i]->data().get());
+    }
+    EXPECT_LT(memory.size(), expected_memory.size());
+  }
+  // A TEST net has no backward: it keeps every blob, to be read after Forward.
+  Caffe::set_random_seed(this->seed_);
+  this->InitCheckpointNet(0, false, TEST);
+  this->net_->Forward();
+  vector<shared_ptr<Blob<Dtype> > > expected_blobs;
+  this->CopyNetBlobs(false, &expected_blobs);
+  Caffe::set_random_seed(this->seed_);
+  this->InitCheckpointNet(2, false, TEST);
+  this->net_->Forward();
+  const vector<shared_ptr<Blob<Dtype> > >& blobs = this->net_->blobs();
+  ASSERT_EQ(expected_blobs.size(), blobs.size());
+  for (int i = 0; i < blobs.size(); ++i) {
+    ASSERT_EQ(expected_blobs[i]->count(), blobs[i]->count());
+    for (int j = 0; j < blobs[i]->count(); ++j) {
+      EXPECT_EQ(expected_blobs[i]->cpu_data()[j], blobs[i]->cpu_data()[j])
+          << "blob " << this->net_->blob_names()[i];
+    }
+  }
+}
+
 }  // namespace caffe
@@ -7,6 +7,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/layer_factory.hpp"
 
 #include "caffe/layers/absval_layer.hpp"
 #include "caffe/layers/bnll_layer.hpp"
@@ -220,6 +221,63 @@ TYPED_TEST(NeuronLayerTest, TestReLU) {
   }
 }
 
+TYPED_TEST(NeuronLayerTest, TestThreads) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Check that splitting the elements among threads gives the same results.
+  // The blobs are large enough for parallel_for to split them.
+  Blob<Dtype> bottom(4, 3, 64, 64);
+  Blob<Dtype> top;
+  Blob<Dtype> top_diff(bottom.shape());
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&bottom);
+  filler.Fill(&top_diff);
+  vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+  vector<Blob<Dtype>*> top_vec(1, &top);
+  vector<bool> propagate_down(1, true);
+  const char* layer_protos[] = {
+    "type: 'ReLU' relu_param { negative_slope: 0.01 }",
+    "type: 'ReLU' relu_param { negative_slope: 0.01 bit_mask: true }",
+    "type: 'Sigmoid'",
+    "type: 'TanH'",
+    "type: 'BNLL'",
+    "type: 'ELU'",
+    "type: 'Power' power_param { power: 3 scale: 0.5 shift: 1 }",
+    "type: 'Threshold'",
+  };
+  for (int i = 0; i < sizeof(layer_protos) / sizeof(layer_protos[0]); ++i) {
+    LayerParameter layer_param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(
+        layer_protos[i], &layer_param));
+    shared_ptr<Layer<Dtype> > layer =
+        LayerRegistry<Dtype>::CreateLayer(layer_param);
+    layer->SetUp(bottom_vec, top_vec);
+    vector<shared_ptr<Blob<Dtype> > > results;
+    for (int num_threads = 1; num_threads <= 3; num_threads += 2) {
+      Caffe::set_num_threads(num_threads);
+      layer->Forward(bottom_vec, top_vec);
+      const bool has_backward = layer_param.type() != "Threshold";
+      if (has_backward) {
+        caffe_copy(top.count(), top_diff.cpu_data(), top.mutable_cpu_diff());
+        layer->Backward(top_vec, propagate_down, bottom_vec);
+      }
+      shared_ptr<Blob<Dtype> > result(new Blob<Dtype>());
+      result->CopyFrom(top, false, true);
+      if (has_backward) {
+        result->CopyFrom(bottom, true, true);
+      }
+      results.push_back(result);
+    }
+    Caffe::set_num_threads(1);
+    for (int j = 0; j < top.count(); ++j) {
+      EXPECT_EQ(results[0]->cpu_data()[j], results[1]->cpu_data()[j])
+          << layer_protos[i];
+      EXPECT_EQ(results[0]->cpu_diff()[j], results[1]->cpu_diff()[j])
+          << layer_protos[i];
+    }
+  }
+}
+
 TYPED_TEST(NeuronLayerTest, TestReLUGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -260,6 +318,43 @@ TYPED_TEST(NeuronLayerTest, TestReLUGradientWithNegativeSlope) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(NeuronLayerTest, TestReLUGradientBitMask) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      "relu_param { negative_slope: 0.01 bit_mask: true }", &layer_param));
+  ReLULayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3, 1701, 0., 0.01);
+  checker.CheckGradientEltwise(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(NeuronLayerTest, TestReLUBitMaskInPlace) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The bit mask is kept on the CPU only.
+  if (Caffe::mode() != Caffe::CPU) { return; }
+  LayerParameter layer_param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      "relu_param { negative_slope: 0.01 bit_mask: true }", &layer_param));
+  ReLULayer<Dtype> layer(layer_param);
+  Blob<Dtype> input;
+  input.CopyFrom(*this->blob_bottom_, false, true);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_bottom_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_bottom_vec_);
+  // The backward must not depend on the data a later in-place layer leaves.
+  caffe_set(this->blob_bottom_->count(), Dtype(-1),
+            this->blob_bottom_->mutable_cpu_data());
+  caffe_set(this->blob_bottom_->count(), Dtype(2),
+            this->blob_bottom_->mutable_cpu_diff());
+  vector<bool> propagate_down(1, true);
+  layer.Backward(this->blob_bottom_vec_, propagate_down,
+                 this->blob_bottom_vec_);
+  const Dtype* bottom_diff = this->blob_bottom_->cpu_diff();
+  for (int i = 0; i < input.count(); ++i) {
+    EXPECT_FLOAT_EQ(input.cpu_data()[i] > 0 ? 2 : 0.02, bottom_diff[i]);
+  }
+}
+
 TYPED_TEST(NeuronLayerTest, TestELU) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -335,6 +430,28 @@ TYPED_TEST(NeuronLayerTest, TestSigmoid) {
   }
 }
 
+TYPED_TEST(NeuronLayerTest, TestSigmoidTails) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  SigmoidLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Far in the negative tail sigmoid(x) ~ exp(x) must keep its relative
+  // precision rather than round to 0.
+  Dtype* bottom_data = this->blob_bottom_->mutable_cpu_data();
+  const int count = this->blob_bottom_->count();
+  for (int i = 0; i < count; ++i) {
+    bottom_data[i] = -80 + 160. * i / (count - 1);
+  }
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype* top_data = this->blob_top_->cpu_data();
+  for (int i = 0; i < count; ++i) {
+    const double x = bottom_data[i];
+    const double expected = 1. / (1 + exp(-x));
+    EXPECT_NEAR(top_data[i], expected, 1e-5 * expected);
+    EXPECT_GT(top_data[i], 0.);
+  }
+}
+
 TYPED_TEST(NeuronLayerTest, TestSigmoidGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -597,6 +714,32 @@ TYPED_TEST(NeuronLayerTest, TestDropoutGradient) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(NeuronLayerTest, TestDropoutThreads) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The CPU masks follow the seed whatever the number of threads.
+  if (Caffe::mode() != Caffe::CPU) { return; }
+  Blob<Dtype> bottom(10, 10, 10, 100);
+  caffe_set(bottom.count(), Dtype(1), bottom.mutable_cpu_data());
+  vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+  LayerParameter layer_param;
+  layer_param.set_phase(TRAIN);
+  DropoutLayer<Dtype> layer(layer_param);
+  layer.SetUp(bottom_vec, this->blob_top_vec_);
+  Blob<Dtype> single_thread;
+  for (int num_threads = 1; num_threads <= 3; num_threads += 2) {
+    Caffe::set_num_threads(num_threads);
+    Caffe::set_random_seed(1701);
+    layer.Forward(bottom_vec, this->blob_top_vec_);
+    if (num_threads == 1) {
+      single_thread.CopyFrom(*this->blob_top_, false, true);
+    }
+  }
+  Caffe::set_num_threads(1);
+  for (int i = 0; i < bottom.count(); ++i) {
+    EXPECT_EQ(single_thread.cpu_data()[i], this->blob_top_->cpu_data()[i]);
+  }
+}
+
 TYPED_TEST(NeuronLayerTest, TestDropoutGradientTest) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
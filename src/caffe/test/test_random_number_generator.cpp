@@ -1,4 +1,5 @@
 #include <cmath>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -258,6 +259,87 @@ TYPED_TEST(RandomNumberGeneratorTest, TestRngBernoulli2) {
 }
 
 
+TEST(PhiloxTest, TestKnownAnswers) {
+  // The known answers of the Random123 library for Philox4x32-10.
+  const uint64_t keys[] = { 0, 0xffffffffffffffffull, 0x299f31d0a4093822ull };
+  const uint64_t blocks[] = { 0, 0xffffffffffffffffull,
+                              0x85a308d3243f6a88ull };
+  const uint64_t streams[] = { 0, 0xffffffffffffffffull,
+                               0x0370734413198a2eull };
+  const uint32_t expected[][4] = {
+    { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 },
+    { 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd },
+    { 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 }
+  };
+  for (int i = 0; i < 3; ++i) {
+    uint32_t block[4];
+    Philox(keys[i], streams[i]).Block(blocks[i], block);
+    for (int j = 0; j < 4; ++j) {
+      EXPECT_EQ(expected[i][j], block[j]);
+    }
+  }
+}
+
+TYPED_TEST(RandomNumberGeneratorTest, TestRngGaussianPhilox) {
+  const TypeParam mu = -2;
+  const TypeParam sigma = 3;
+  TypeParam* gaussian_data =
+      static_cast<TypeParam*>(this->data_->mutable_cpu_data());
+  caffe_rng_gaussian(this->sample_size_, mu, sigma, gaussian_data,
+                     Philox(this->seed_, 0));
+  this->RngGaussianChecks(mu, sigma, gaussian_data);
+}
+
+TYPED_TEST(RandomNumberGeneratorTest, TestRngUniformPhilox) {
+  const TypeParam lower = -7.3;
+  const TypeParam upper = -2.3;
+  TypeParam* uniform_data =
+      static_cast<TypeParam*>(this->data_->mutable_cpu_data());
+  const Philox philox(this->seed_, 0);
+  caffe_rng_uniform(this->sample_size_, lower, upper, uniform_data, philox);
+  this->RngUniformChecks(lower, upper, uniform_data);
+  // Each value is the value of its index in the stream.
+  for (int i = 0; i < this->sample_size_; ++i) {
+    EXPECT_EQ(lower + (upper - lower) * Philox::Uniform(philox(i)),
+              uniform_data[i]);
+  }
+}
+
+TYPED_TEST(RandomNumberGeneratorTest, TestRngBernoulliPhilox) {
+  const TypeParam p = 0.3;
+  unsigned int* bernoulli_data =
+      static_cast<unsigned int*>(this->int_data_->mutable_cpu_data());
+  caffe_rng_bernoulli(this->sample_size_, p, bernoulli_data,
+                      Philox(this->seed_, 0));
+  this->RngBernoulliChecks(p, bernoulli_data);
+  // Another stream is another sequence.
+  unsigned int* bernoulli_data_2 =
+      static_cast<unsigned int*>(this->int_data_2_->mutable_cpu_data());
+  caffe_rng_bernoulli(this->sample_size_, p, bernoulli_data_2,
+                      Philox(this->seed_, 1));
+  int num_equal = 0;
+  for (int i = 0; i < this->sample_size_; ++i) {
+    num_equal += bernoulli_data[i] == bernoulli_data_2[i];
+  }
+  EXPECT_LT(num_equal, this->sample_size_ * 0.65);
+}
+
+TYPED_TEST(RandomNumberGeneratorTest, TestRngPhiloxThreads) {
+  // Large enough to be split among the threads.
+  const int n = 100000;
+  vector<TypeParam> single(n);
+  vector<TypeParam> multi(n);
+  const Philox philox(this->seed_, 5);
+  caffe_rng_gaussian(n, TypeParam(0), TypeParam(1), &single[0], philox);
+  Caffe::set_num_threads(4);
+  caffe_rng_gaussian(n, TypeParam(0), TypeParam(1), &multi[0], philox);
+  Caffe::set_num_threads(1);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(single[i], multi[i]);
+  }
+}
+
+
 TYPED_TEST(RandomNumberGeneratorTest, TestRngGaussianTimesGaussian) {
   const TypeParam mu = 0;
   const TypeParam sigma = 1;
@@ -0,0 +1,163 @@
+#include <stdint.h>
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/simd_math.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class SimdMathTest : public ::testing::Test {
+ protected:
+  // The distance between two finite floats in units in the last place.
+  static int64_t Ulps(const float a, const float b) {
+    return std::abs(Ordered(a) - Ordered(b));
+  }
+
+  // Floats mapped to integers in the same order, consecutive floats to
+  // consecutive integers.
+  static int64_t Ordered(const float x) {
+    int32_t bits;
+    memcpy(&bits, &x, sizeof(bits));  // NOLINT(caffe/alt_fn)
+    return bits < 0 ? -static_cast<int64_t>(bits & 0x7fffffff) : bits;
+  }
+
+  // The floats with bit patterns evenly spread from lo to hi.
+  static vector<float> Spread(const float lo, const float hi, const int n) {
+    vector<float> x(n);
+    const int64_t a = Ordered(lo);
+    const int64_t b = Ordered(hi);
+    for (int i = 0; i < n; ++i) {
+      const int32_t bits = static_cast<int32_t>(a + (b - a) * i / (n - 1));
+      const int32_t pattern = bits < 0 ? (-bits | 0x80000000) : bits;
+      memcpy(&x[i], &pattern, sizeof(x[i]));  // NOLINT(caffe/alt_fn)
+    }
+    return x;
+  }
+};
+
+TEST_F(SimdMathTest, TestExpAccuracy) {
+  const vector<float> x = Spread(-87.f, 88.f, 100003);
+  vector<float> y(x.size());
+  simd_exp(x.size(), &x[0], &y[0]);
+  for (int i = 0; i < x.size(); ++i) {
+    const float expected = std::exp(static_cast<double>(x[i]));
+    EXPECT_LE(Ulps(y[i], expected), 2) << "exp(" << x[i] << ")";
+  }
+}
+
+TEST_F(SimdMathTest, TestLogAccuracy) {
+  // From the denormals up.
+  const vector<float> x = Spread(1e-44f, FLT_MAX, 100003);
+  vector<float> y(x.size());
+  simd_log(x.size(), &x[0], &y[0]);
+  for (int i = 0; i < x.size(); ++i) {
+    const float expected = std::log(static_cast<double>(x[i]));
+    EXPECT_LE(Ulps(y[i], expected), 2) << "log(" << x[i] << ")";
+  }
+}
+
+TEST_F(SimdMathTest, TestTanhAccuracy) {
+  const vector<float> x = Spread(-20.f, 20.f, 100003);
+  vector<float> y(x.size());
+  simd_tanh(x.size(), &x[0], &y[0]);
+  for (int i = 0; i < x.size(); ++i) {
+    const float expected = std::tanh(static_cast<double>(x[i]));
+    EXPECT_LE(Ulps(y[i], expected), 2) << "tanh(" << x[i] << ")";
+  }
+}
+
+TEST_F(SimdMathTest, TestPowxAccuracy) {
+  const float exponents[] = { -2.f, -0.75f, 0.75f, 1.5f, 2.5f, 3.f };
+  const vector<float> x = Spread(1e-3f, 1e3f, 10007);
+  vector<float> y(x.size());
+  for (int k = 0; k < sizeof(exponents) / sizeof(exponents[0]); ++k) {
+    const float b = exponents[k];
+    simd_powx(x.size(), &x[0], b, &y[0]);
+    for (int i = 0; i < x.size(); ++i) {
+      const double log_a = std::log(static_cast<double>(x[i]));
+      const float expected = std::pow(static_cast<double>(x[i]),
+          static_cast<double>(b));
+      EXPECT_LE(Ulps(y[i], expected), 2 + 2 * std::fabs(b * log_a))
+          << x[i] << "^" << b;
+    }
+  }
+}
+
+TEST_F(SimdMathTest, TestSpecialValues) {
+  const float inf = std::numeric_limits<float>::infinity();
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  const float x[] = { 0.f, -0.f, 1.f, -1.f, inf, -inf, nan, 100.f, -100.f };
+  const int kCount = sizeof(x) / sizeof(x[0]);
+  float y[kCount];
+  simd_exp(kCount, x, y);
+  EXPECT_EQ(y[0], 1.f);
+  EXPECT_EQ(y[1], 1.f);
+  EXPECT_EQ(y[4], inf);
+  EXPECT_EQ(y[5], 0.f);
+  EXPECT_TRUE(std::isnan(y[6]));
+  EXPECT_EQ(y[7], inf);
+  // Below FLT_MIN, flushed to zero.
+  EXPECT_EQ(y[8], 0.f);
+  simd_log(kCount, x, y);
+  EXPECT_EQ(y[0], -inf);
+  EXPECT_EQ(y[1], -inf);
+  EXPECT_EQ(y[2], 0.f);
+  EXPECT_TRUE(std::isnan(y[3]));
+  EXPECT_EQ(y[4], inf);
+  EXPECT_TRUE(std::isnan(y[5]));
+  EXPECT_TRUE(std::isnan(y[6]));
+  simd_tanh(kCount, x, y);
+  EXPECT_EQ(y[0], 0.f);
+  EXPECT_TRUE(std::signbit(y[1]));
+  EXPECT_EQ(y[4], 1.f);
+  EXPECT_EQ(y[5], -1.f);
+  EXPECT_TRUE(std::isnan(y[6]));
+  EXPECT_EQ(y[7], 1.f);
+  EXPECT_EQ(y[8], -1.f);
+  // Negative bases: odd powers keep the sign, fractional ones give NaN.
+  simd_powx(kCount, x, 3.f, y);
+  EXPECT_EQ(y[3], -1.f);
+  EXPECT_EQ(y[5], -inf);
+  simd_powx(kCount, x, -0.75f, y);
+  EXPECT_EQ(y[0], inf);
+  EXPECT_EQ(y[2], 1.f);
+  EXPECT_TRUE(std::isnan(y[3]));
+  EXPECT_EQ(y[4], 0.f);
+  EXPECT_EQ(y[5], 0.f);
+  EXPECT_TRUE(std::isnan(y[6]));
+}
+
+TEST_F(SimdMathTest, TestTails) {
+  // Lengths around the vector width give the results of a long array, and
+  // leave the elements past them alone.
+  const vector<float> x = Spread(0.01f, 10.f, 40);
+  vector<float> expected(x.size());
+  simd_exp(x.size(), &x[0], &expected[0]);
+  for (int n = 1; n < 20; ++n) {
+    vector<float> y(x.size(), -1.f);
+    simd_exp(n, &x[0], &y[0]);
+    for (int i = 0; i < n; ++i) {
+      EXPECT_EQ(y[i], expected[i]);
+    }
+    for (int i = n; i < y.size(); ++i) {
+      EXPECT_EQ(y[i], -1.f);
+    }
+  }
+  // And in place.
+  vector<float> y(x);
+  simd_powx(13, &y[0], 1.5f, &y[0]);
+  for (int i = 0; i < 13; ++i) {
+    EXPECT_FLOAT_EQ(y[i], std::pow(x[i], 1.5f));
+  }
+}
+
+}  // namespace caffe
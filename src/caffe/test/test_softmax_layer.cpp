@@ -7,6 +7,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/softmax_layer.hpp"
+#include "caffe/util/softmax.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_softmax_layer.hpp"
@@ -74,6 +75,50 @@ TYPED_TEST(SoftmaxLayerTest, TestForward) {
   }
 }
 
+TYPED_TEST(SoftmaxLayerTest, TestForwardTiles) {
+  typedef typename TypeParam::Dtype Dtype;
+  // More inner positions than one tile of the CPU kernel, the last partial.
+  this->blob_bottom_->Reshape(2, 10, 9, 11);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  SoftmaxLayer<Dtype> layer(layer_param);
+  Caffe::set_num_threads(4);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Caffe::set_num_threads(1);
+  for (int i = 0; i < this->blob_bottom_->num(); ++i) {
+    for (int k = 0; k < this->blob_bottom_->height(); ++k) {
+      for (int l = 0; l < this->blob_bottom_->width(); ++l) {
+        Dtype scale = 0;
+        for (int j = 0; j < this->blob_bottom_->channels(); ++j) {
+          scale += exp(this->blob_bottom_->data_at(i, j, k, l));
+        }
+        for (int j = 0; j < this->blob_bottom_->channels(); ++j) {
+          EXPECT_NEAR(exp(this->blob_bottom_->data_at(i, j, k, l)) / scale,
+              this->blob_top_->data_at(i, j, k, l), 1e-4);
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(SoftmaxLayerTest, TestForwardEmpty) {
+  typedef typename TypeParam::Dtype Dtype;
+  // An empty axis, as after reshaping to nothing, gives nothing to do.
+  Dtype data = 1;
+  Dtype diff = 2;
+  softmax_cpu(2, 10, 0, &data, &diff);
+  softmax_cpu(2, 0, 3, &data, &diff);
+  softmax_backward_cpu(2, 10, 0, &data, &data, &diff);
+  int count = -1;
+  EXPECT_EQ(0, softmax_loss_cpu(2, 10, 0, &data, &data, false, 0, &count));
+  EXPECT_EQ(0, count);
+  EXPECT_EQ(1, data);
+  EXPECT_EQ(2, diff);
+}
+
 TYPED_TEST(SoftmaxLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -84,6 +84,37 @@ TYPED_TEST(SoftmaxWithLossLayerTest, TestForwardIgnoreLabel) {
   EXPECT_NEAR(4 * full_loss, accum_loss, 1e-4);
 }
 
+TYPED_TEST(SoftmaxWithLossLayerTest, TestForwardBackwardTestPhase) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_loss_param()->set_ignore_label(0);
+  SoftmaxWithLossLayer<Dtype> train_layer(layer_param);
+  train_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  train_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype train_loss = this->blob_top_loss_->cpu_data()[0];
+  this->blob_top_loss_->mutable_cpu_diff()[0] = 1;
+  vector<bool> propagate_down(2, false);
+  propagate_down[0] = true;
+  train_layer.Backward(this->blob_top_vec_, propagate_down,
+      this->blob_bottom_vec_);
+  Blob<Dtype> train_diff;
+  train_diff.CopyFrom(*this->blob_bottom_data_, true, true);
+  // The loss alone, without the probabilities on CPU, and then the gradient
+  // from the probabilities computed in backward.
+  layer_param.set_phase(TEST);
+  SoftmaxWithLossLayer<Dtype> test_layer(layer_param);
+  test_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  test_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_NEAR(train_loss, this->blob_top_loss_->cpu_data()[0], 1e-4);
+  this->blob_top_loss_->mutable_cpu_diff()[0] = 1;
+  test_layer.Backward(this->blob_top_vec_, propagate_down,
+      this->blob_bottom_vec_);
+  for (int i = 0; i < train_diff.count(); ++i) {
+    EXPECT_NEAR(train_diff.cpu_diff()[i],
+        this->blob_bottom_data_->cpu_diff()[i], 1e-6);
+  }
+}
+
 TYPED_TEST(SoftmaxWithLossLayerTest, TestGradientIgnoreLabel) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -980,4 +980,117 @@ TEST_F(SplitLayerInsertionTest, TestWithInPlace) {
   this->RunInsertionTest(input_proto, expected_output_proto);
 }
 
+TEST_F(SplitLayerInsertionTest, TestInsertionWithoutSplits) {
+  // Without insert_splits, only the shared blob overwritten in-place by one of
+  // its consumers and the shared blob with a loss weight still get a split.
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "insert_splits: false "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Data' "
+      "  top: 'data' "
+      "  top: 'label' "
+      "} "
+      "layer { "
+      "  name: 'innerprod1' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'data' "
+      "  top: 'innerprod1' "
+      "  loss_weight: 0.5 "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'data' "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'innerprod2' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'data' "
+      "  top: 'innerprod2' "
+      "} "
+      "layer { "
+      "  name: 'relu2' "
+      "  type: 'ReLU' "
+      "  bottom: 'innerprod2' "
+      "  top: 'innerprod2' "
+      "} "
+      "layer { "
+      "  name: 'loss1' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'innerprod1' "
+      "  bottom: 'innerprod2' "
+      "} "
+      "layer { "
+      "  name: 'loss2' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'innerprod2' "
+      "  bottom: 'label' "
+      "} ";
+  const string& expected_output_proto =
+      "name: 'TestNetwork' "
+      "insert_splits: false "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Data' "
+      "  top: 'data' "
+      "  top: 'label' "
+      "} "
+      "layer { "
+      "  name: 'data_data_0_split' "
+      "  type: 'Split' "
+      "  bottom: 'data' "
+      "  top: 'data_data_0_split_0' "
+      "  top: 'data_data_0_split_1' "
+      "} "
+      "layer { "
+      "  name: 'innerprod1' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'data_data_0_split_0' "
+      "  top: 'innerprod1' "
+      "} "
+      "layer { "
+      "  name: 'innerprod1_innerprod1_0_split' "
+      "  type: 'Split' "
+      "  bottom: 'innerprod1' "
+      "  top: 'innerprod1_innerprod1_0_split_0' "
+      "  top: 'innerprod1_innerprod1_0_split_1' "
+      "  loss_weight: 0.5 "
+      "  loss_weight: 0 "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'data_data_0_split_1' "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'innerprod2' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'data' "
+      "  top: 'innerprod2' "
+      "} "
+      "layer { "
+      "  name: 'relu2' "
+      "  type: 'ReLU' "
+      "  bottom: 'innerprod2' "
+      "  top: 'innerprod2' "
+      "} "
+      "layer { "
+      "  name: 'loss1' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'innerprod1_innerprod1_0_split_1' "
+      "  bottom: 'innerprod2' "
+      "} "
+      "layer { "
+      "  name: 'loss2' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'innerprod2' "
+      "  bottom: 'label' "
+      "} ";
+  this->RunInsertionTest(input_proto, expected_output_proto);
+}
+
 }  // namespace caffe
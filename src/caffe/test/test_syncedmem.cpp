@@ -22,6 +22,48 @@ TEST_F(SyncedMemoryTest, TestInitialization) {
   delete p_mem;
 }
 
+TEST_F(SyncedMemoryTest, TestUsageCPU) {
+  const SyncedMemory::Usage before = SyncedMemory::TotalUsage();
+  {
+    SyncedMemory mem(10);
+    EXPECT_EQ(before.cpu, SyncedMemory::TotalUsage().cpu);
+    mem.cpu_data();
+    EXPECT_EQ(before.cpu + 10, SyncedMemory::TotalUsage().cpu);
+    EXPECT_GE(SyncedMemory::TotalUsage().cpu_peak, before.cpu + 10);
+    // Memory set from outside is not counted.
+    float data[2];
+    mem.set_cpu_data(data);
+    EXPECT_EQ(before.cpu, SyncedMemory::TotalUsage().cpu);
+  }
+  EXPECT_EQ(before.cpu, SyncedMemory::TotalUsage().cpu);
+  SyncedMemory::ResetPeakUsage();
+  EXPECT_EQ(before.cpu, SyncedMemory::TotalUsage().cpu_peak);
+}
+
+TEST_F(SyncedMemoryTest, TestTags) {
+  const int tag = SyncedMemory::Tag("SyncedMemoryTest/scope");
+  const int other_tag = SyncedMemory::Tag("SyncedMemoryTest/other");
+  EXPECT_GT(tag, 0);
+  EXPECT_NE(tag, other_tag);
+  EXPECT_EQ(tag, SyncedMemory::Tag("SyncedMemoryTest/scope"));
+  shared_ptr<SyncedMemory> mem;
+  {
+    MemoryTagScope scope(tag);
+    EXPECT_EQ(tag, SyncedMemory::scope_tag());
+    mem.reset(new SyncedMemory(10));
+  }
+  EXPECT_EQ(0, SyncedMemory::scope_tag());
+  EXPECT_EQ(tag, mem->tag());
+  mem->cpu_data();
+  EXPECT_EQ(10, SyncedMemory::TagUsage(tag).cpu);
+  mem->set_tag(other_tag);
+  EXPECT_EQ(0, SyncedMemory::TagUsage(tag).cpu);
+  EXPECT_EQ(10, SyncedMemory::TagUsage(tag).cpu_peak);
+  EXPECT_EQ(10, SyncedMemory::TagUsage(other_tag).cpu);
+  mem.reset();
+  EXPECT_EQ(0, SyncedMemory::TagUsage(other_tag).cpu);
+}
+
 #ifndef CPU_ONLY  // GPU test
 
 TEST_F(SyncedMemoryTest, TestAllocationCPUGPU) {
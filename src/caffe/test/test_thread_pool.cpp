@@ -0,0 +1,87 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ThreadPoolTest : public ::testing::Test {
+ public:
+  void Count(int i) {
+    boost::mutex::scoped_lock lock(mutex_);
+    ++counts_[i];
+  }
+
+  void CountRange(int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      Count(i);
+    }
+  }
+
+  void CountWithOffset(int offset, int i) {
+    Count(offset + i);
+  }
+
+  void CountNested(ThreadPool* pool, int i) {
+    pool->Run(3, boost::bind(&ThreadPoolTest::CountWithOffset, this, 3 * i,
+                             _1));
+  }
+
+  boost::mutex mutex_;
+  vector<int> counts_;
+};
+
+TEST_F(ThreadPoolTest, TestRunsEveryTaskOnce) {
+  ThreadPool pool(4);
+  EXPECT_EQ(4, pool.size());
+  for (int job = 0; job < 10; ++job) {
+    counts_.assign(100, 0);
+    pool.Run(counts_.size(), boost::bind(&ThreadPoolTest::Count, this, _1));
+    for (int i = 0; i < counts_.size(); ++i) {
+      EXPECT_EQ(1, counts_[i]);
+    }
+  }
+}
+
+TEST_F(ThreadPoolTest, TestNestedRun) {
+  ThreadPool pool(3);
+  counts_.assign(30, 0);
+  pool.Run(10, boost::bind(&ThreadPoolTest::CountNested, this, &pool, _1));
+  for (int i = 0; i < counts_.size(); ++i) {
+    EXPECT_EQ(1, counts_[i]);
+  }
+}
+
+TEST_F(ThreadPoolTest, TestSingleThread) {
+  ThreadPool pool(1);
+  EXPECT_EQ(1, pool.size());
+  counts_.assign(5, 0);
+  pool.Run(counts_.size(), boost::bind(&ThreadPoolTest::Count, this, _1));
+  for (int i = 0; i < counts_.size(); ++i) {
+    EXPECT_EQ(1, counts_[i]);
+  }
+}
+
+TEST_F(ThreadPoolTest, TestParallelFor) {
+  Caffe::set_num_threads(4);
+  EXPECT_EQ(4, Caffe::num_threads());
+  EXPECT_EQ(4, Caffe::thread_pool()->size());
+  const int kSizes[] = {0, 1, 999, 1000, 4321};
+  for (int i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); ++i) {
+    counts_.assign(kSizes[i], 0);
+    parallel_for(counts_.size(),
+        boost::bind(&ThreadPoolTest::CountRange, this, _1, _2), 100);
+    for (int j = 0; j < counts_.size(); ++j) {
+      EXPECT_EQ(1, counts_[j]);
+    }
+  }
+  Caffe::set_num_threads(1);
+  EXPECT_EQ(1, Caffe::thread_pool()->size());
+}
+
+}  // namespace caffe
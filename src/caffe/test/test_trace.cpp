@@ -0,0 +1,173 @@
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <cstdio>
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/trace.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class TraceTest : public ::testing::Test {
+ protected:
+  virtual void TearDown() {
+    Tracer::Stop();
+  }
+};
+
+TEST_F(TraceTest, TestDisabled) {
+  Tracer::Start(4);
+  Tracer::Stop();
+  {
+    TraceScope trace("test", "ignored");
+  }
+  Tracer::Record("test", "ignored", 0, 1);
+  EXPECT_EQ(0, Tracer::Events().size());
+}
+
+TEST_F(TraceTest, TestRecord) {
+  Tracer::Start(4);
+  {
+    TraceScope trace("test", "scope");
+  }
+  Tracer::Record("test", "event", 3, 5);
+  const vector<TraceEvent> events = Tracer::Events();
+  ASSERT_EQ(2, events.size());
+  EXPECT_STREQ("test", events[0].category);
+  EXPECT_STREQ("scope", events[0].name);
+  EXPECT_LE(events[0].begin, events[0].end);
+  EXPECT_STREQ("event", events[1].name);
+  EXPECT_EQ(3, events[1].begin);
+  EXPECT_EQ(5, events[1].end);
+  EXPECT_EQ(events[0].thread, events[1].thread);
+}
+
+TEST_F(TraceTest, TestRingKeepsNewest) {
+  Tracer::Start(3);
+  const char* names[] = { "a", "b", "c", "d", "e" };
+  for (int i = 0; i < 5; ++i) {
+    Tracer::Record("test", names[i], i, i + 1);
+  }
+  const vector<TraceEvent> events = Tracer::Events();
+  ASSERT_EQ(3, events.size());
+  EXPECT_STREQ("c", events[0].name);
+  EXPECT_STREQ("d", events[1].name);
+  EXPECT_STREQ("e", events[2].name);
+}
+
+TEST_F(TraceTest, TestTruncatesNames) {
+  Tracer::Start(1);
+  const string name(2 * TraceEvent::kMaxName, 'x');
+  Tracer::Record("test", name.c_str(), 0, 1);
+  EXPECT_EQ(string(TraceEvent::kMaxName - 1, 'x'),
+            Tracer::Events()[0].name);
+}
+
+TEST_F(TraceTest, TestNetLayers) {
+  const string proto =
+      "name: 'TraceTestNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 2 dim: 3 } "
+      "    shape { dim: 2 dim: 4 } "
+      "    data_filler { type: 'gaussian' } "
+      "  } "
+      "  top: 'data' "
+      "  top: 'target' "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { "
+      "    num_output: 4 "
+      "    weight_filler { type: 'gaussian' } "
+      "  } "
+      "  bottom: 'data' "
+      "  top: 'ip' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'ip' "
+      "  bottom: 'target' "
+      "  top: 'loss' "
+      "} ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Caffe::set_mode(Caffe::CPU);
+  Net<float> net(param);
+  Tracer::Start();
+  net.Forward();
+  net.Backward();
+  Tracer::Stop();
+  const vector<TraceEvent> events = Tracer::Events();
+  const char* expected[][2] = {
+    { "forward", "data" }, { "forward", "ip" }, { "forward", "loss" },
+    { "backward", "loss" }, { "backward", "ip" }
+  };
+  ASSERT_EQ(5, events.size());
+  for (int i = 0; i < events.size(); ++i) {
+    EXPECT_STREQ(expected[i][0], events[i].category);
+    EXPECT_STREQ(expected[i][1], events[i].name);
+  }
+}
+
+static void RecordUntil(const boost::atomic<bool>* done) {
+  while (!*done) {
+    TraceScope trace("test", "concurrent");
+  }
+}
+
+TEST_F(TraceTest, TestRestartWhileRecording) {
+  // Start replaces the ring only once the threads recording into it are out.
+  Tracer::Start(1);
+  boost::atomic<bool> done(false);
+  boost::thread_group threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.create_thread(boost::bind(&RecordUntil, &done));
+  }
+  for (int i = 0; i < 200; ++i) {
+    Tracer::Start(1 + i % 7);
+  }
+  done = true;
+  threads.join_all();
+  Tracer::Stop();
+  const vector<TraceEvent> events = Tracer::Events();
+  for (int i = 0; i < events.size(); ++i) {
+    EXPECT_STREQ("concurrent", events[i].name);
+  }
+}
+
+TEST_F(TraceTest, TestWriteChromeTrace) {
+  Tracer::Start(4);
+  Tracer::Record("test", "a \"quoted\" name", 10, 25);
+  Tracer::Stop();
+  string filename;
+  MakeTempFilename(&filename);
+  Tracer::WriteChromeTrace(filename);
+  std::ifstream file(filename.c_str());
+  std::stringstream contents;
+  contents << file.rdbuf();
+  std::ostringstream expected;
+  expected << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n"
+           << "{\"name\": \"a \\\"quoted\\\" name\", \"cat\": \"test\", "
+           << "\"ph\": \"X\", \"ts\": 10, \"dur\": 15, \"pid\": 0, "
+           << "\"tid\": " << Tracer::Events()[0].thread << "}\n]}\n";
+  EXPECT_EQ(expected.str(), contents.str());
+  std::remove(filename.c_str());
+}
+
+}  // namespace caffe
@@ -0,0 +1,46 @@
+#include <string>
+
+#include "caffe/util/cpu_dispatch.hpp"
+
+namespace caffe {
+
+static const char* kSIMDLevelNames[] = { "baseline", "sse4", "avx2", "avx512" };
+
+const char* SIMDLevelName(const Caffe::SIMDLevel level) {
+  CHECK_GE(level, Caffe::BASELINE);
+  CHECK_LE(level, Caffe::AVX512);
+  return kSIMDLevelNames[level];
+}
+
+Caffe::SIMDLevel ParseSIMDLevel(const std::string& name) {
+  for (int level = Caffe::BASELINE; level <= Caffe::AVX512; ++level) {
+    if (name == kSIMDLevelNames[level]) {
+      return static_cast<Caffe::SIMDLevel>(level);
+    }
+  }
+  LOG(FATAL) << "Unknown instruction set " << name
+      << "; expected baseline, sse4, avx2 or avx512.";
+  return Caffe::BASELINE;  // not reachable
+}
+
+// The compiler asks the CPU, and for AVX whether the operating system saves
+// the wider registers.
+Caffe::SIMDLevel DetectSIMDLevel() {
+#ifdef CAFFE_CPU_DISPATCH_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+      && __builtin_cpu_supports("avx512dq")
+      && __builtin_cpu_supports("avx512vl")) {
+    return Caffe::AVX512;
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return Caffe::AVX2;
+  }
+  if (__builtin_cpu_supports("sse4.2")) {
+    return Caffe::SSE4;
+  }
+#endif
+  return Caffe::BASELINE;
+}
+
+}  // namespace caffe
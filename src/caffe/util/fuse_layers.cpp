@@ -0,0 +1,219 @@
+#include <cmath>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/fuse_layers.hpp"
+
+namespace caffe {
+
+// Read a BlobProto stored in either precision.
+static vector<double> BlobProtoData(const BlobProto& proto) {
+  vector<double> data;
+  if (proto.double_data_size() > 0) {
+    data.assign(proto.double_data().begin(), proto.double_data().end());
+  } else {
+    data.assign(proto.data().begin(), proto.data().end());
+  }
+  return data;
+}
+
+// Write a BlobProto keeping the precision it was stored in.
+static void SetBlobProtoData(const vector<double>& data, BlobProto* proto) {
+  const bool use_double = proto->double_data_size() > 0;
+  proto->clear_data();
+  proto->clear_double_data();
+  for (int i = 0; i < data.size(); ++i) {
+    if (use_double) {
+      proto->add_double_data(data[i]);
+    } else {
+      proto->add_data(data[i]);
+    }
+  }
+}
+
+// Fold the BatchNorm and Scale layers of a chain into the convolution
+// weights and bias: with a_c the combined per-channel scale,
+// W'_c = a_c W_c and b'_c = a_c (b_c - mean_c) + beta_c.
+static void FoldConvolutionBlobs(const LayerParameter* batch_norm,
+    const LayerParameter* scale, LayerParameter* conv) {
+  const int channels = conv->convolution_param().num_output();
+  vector<double> multiplier(channels, 1);
+  vector<double> shift(channels, 0);
+  if (conv->convolution_param().bias_term()) {
+    CHECK_GE(conv->blobs_size(), 2) << "Missing bias of " << conv->name();
+    shift = BlobProtoData(conv->blobs(1));
+  }
+  if (batch_norm) {
+    CHECK_EQ(batch_norm->blobs_size(), 3)
+        << "Missing statistics of " << batch_norm->name();
+    const vector<double> mean = BlobProtoData(batch_norm->blobs(0));
+    const vector<double> variance = BlobProtoData(batch_norm->blobs(1));
+    const double moving_average_sum = BlobProtoData(batch_norm->blobs(2))[0];
+    const double scale_factor =
+        moving_average_sum == 0 ? 0 : 1 / moving_average_sum;
+    const double eps = batch_norm->batch_norm_param().eps();
+    CHECK_EQ(mean.size(), channels) << "Cannot fold " << batch_norm->name()
+        << " into " << conv->name() << "; channel mismatch.";
+    for (int c = 0; c < channels; ++c) {
+      const double inv_std =
+          1 / std::sqrt(variance[c] * scale_factor + eps);
+      shift[c] = (shift[c] - mean[c] * scale_factor) * inv_std;
+      multiplier[c] *= inv_std;
+    }
+  }
+  if (scale) {
+    CHECK_GE(scale->blobs_size(), 1) << "Missing scale of " << scale->name();
+    const vector<double> gamma = BlobProtoData(scale->blobs(0));
+    CHECK_EQ(gamma.size(), channels) << "Cannot fold " << scale->name()
+        << " into " << conv->name() << "; channel mismatch.";
+    vector<double> beta(channels, 0);
+    if (scale->scale_param().bias_term()) {
+      CHECK_EQ(scale->blobs_size(), 2) << "Missing bias of " << scale->name();
+      beta = BlobProtoData(scale->blobs(1));
+    }
+    for (int c = 0; c < channels; ++c) {
+      shift[c] = shift[c] * gamma[c] + beta[c];
+      multiplier[c] *= gamma[c];
+    }
+  }
+  vector<double> weights = BlobProtoData(conv->blobs(0));
+  CHECK_EQ(weights.size() % channels, 0);
+  const int kernel_dim = weights.size() / channels;
+  for (int c = 0; c < channels; ++c) {
+    for (int k = 0; k < kernel_dim; ++k) {
+      weights[c * kernel_dim + k] *= multiplier[c];
+    }
+  }
+  SetBlobProtoData(weights, conv->mutable_blobs(0));
+  if (conv->blobs_size() < 2) {
+    BlobProto* bias = conv->add_blobs();
+    bias->mutable_shape()->add_dim(channels);
+    if (conv->blobs(0).double_data_size() > 0) {
+      bias->add_double_data(0);
+    }
+  }
+  SetBlobProtoData(shift, conv->mutable_blobs(1));
+}
+
+void FuseLayers(const NetParameter& param, NetParameter* param_fused) {
+  FuseLayers(param, NULL, param_fused, NULL);
+}
+
+void FuseLayers(const NetParameter& param, const set<string>* fusable,
+    NetParameter* param_fused, set<string>* fused_names) {
+  // Find the consumers of every top blob, following the reuse of blob names
+  // by in-place layers as in InsertSplits. A loss weight counts as a consumer.
+  const int kLossConsumer = -1;
+  map<string, pair<int, int> > blob_name_to_last_top_idx;
+  map<pair<int, int>, vector<int> > top_idx_to_consumers;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& layer_param = param.layer(i);
+    for (int j = 0; j < layer_param.bottom_size(); ++j) {
+      const string& blob_name = layer_param.bottom(j);
+      if (blob_name_to_last_top_idx.count(blob_name)) {
+        top_idx_to_consumers[blob_name_to_last_top_idx[blob_name]].push_back(i);
+      }
+    }
+    for (int j = 0; j < layer_param.top_size(); ++j) {
+      blob_name_to_last_top_idx[layer_param.top(j)] = make_pair(i, j);
+      if (j < layer_param.loss_weight_size() && layer_param.loss_weight(j)) {
+        top_idx_to_consumers[make_pair(i, j)].push_back(kLossConsumer);
+      }
+    }
+  }
+  // Follow each chain starting at a convolution.
+  vector<bool> fused(param.layer_size(), false);
+  map<int, LayerParameter> fused_layers;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& conv = param.layer(i);
+    if (conv.type() != "Convolution" || conv.bottom_size() != 1 ||
+        conv.top_size() != 1 || conv.convolution_param().axis() != 1) {
+      continue;
+    }
+    const LayerParameter* batch_norm = NULL;
+    const LayerParameter* scale = NULL;
+    const LayerParameter* relu = NULL;
+    vector<int> chain;
+    int last = i;
+    while (true) {
+      const vector<int>& consumers = top_idx_to_consumers[make_pair(last, 0)];
+      if (consumers.size() != 1 || consumers[0] == kLossConsumer) { break; }
+      const int next = consumers[0];
+      const LayerParameter& layer_param = param.layer(next);
+      if (layer_param.bottom_size() != 1 || layer_param.top_size() != 1 ||
+          layer_param.loss_weight_size() > 0 ||
+          (fusable && !fusable->count(layer_param.name()))) {
+        break;
+      }
+      if (layer_param.type() == "BatchNorm" && !batch_norm && !scale &&
+          !relu) {
+        const Phase phase = layer_param.has_phase() ?
+            layer_param.phase() : param.state().phase();
+        const BatchNormParameter& bn_param = layer_param.batch_norm_param();
+        const bool use_global_stats = bn_param.has_use_global_stats() ?
+            bn_param.use_global_stats() : phase == TEST;
+        if (!use_global_stats) { break; }
+        batch_norm = &layer_param;
+      } else if (layer_param.type() == "Scale" && !scale && !relu) {
+        const ScaleParameter& scale_param = layer_param.scale_param();
+        if (scale_param.axis() != 1 || scale_param.num_axes() != 1) { break; }
+        scale = &layer_param;
+      } else if (layer_param.type() == "ReLU" && !relu) {
+        relu = &layer_param;
+      } else {
+        break;
+      }
+      chain.push_back(next);
+      last = next;
+    }
+    if (chain.empty()) { continue; }
+    // Fold the parameters only if all of them are given.
+    const int num_parametric = 1 + (batch_norm != NULL) + (scale != NULL);
+    int num_with_blobs = conv.blobs_size() > 0;
+    if (batch_norm) { num_with_blobs += batch_norm->blobs_size() > 0; }
+    if (scale) { num_with_blobs += scale->blobs_size() > 0; }
+    const bool fold_blobs = num_with_blobs > 0;
+    CHECK(!fold_blobs || num_with_blobs == num_parametric)
+        << "Cannot fuse layer " << conv.name() << " with its successors; "
+        << "only some of them have parameters.";
+    LayerParameter& fused_conv = fused_layers[i];
+    fused_conv.CopyFrom(conv);
+    fused_conv.set_top(0, param.layer(last).top(0));
+    if (fold_blobs && (batch_norm || scale)) {
+      FoldConvolutionBlobs(batch_norm, scale, &fused_conv);
+    }
+    if (batch_norm || scale) {
+      fused_conv.mutable_convolution_param()->set_bias_term(true);
+    }
+    if (relu) {
+      ConvolutionParameter* conv_param =
+          fused_conv.mutable_convolution_param();
+      conv_param->set_fuse_relu(true);
+      conv_param->set_relu_negative_slope(relu->relu_param().negative_slope());
+    }
+    for (int k = 0; k < chain.size(); ++k) {
+      fused[chain[k]] = true;
+      if (fused_names) {
+        fused_names->insert(param.layer(chain[k]).name());
+      }
+      LOG(INFO) << "Fusing layer " << param.layer(chain[k]).name()
+                << " into " << conv.name();
+    }
+  }
+  param_fused->CopyFrom(param);
+  param_fused->clear_layer();
+  for (int i = 0; i < param.layer_size(); ++i) {
+    if (fused[i]) { continue; }
+    if (fused_layers.count(i)) {
+      param_fused->add_layer()->CopyFrom(fused_layers[i]);
+    } else {
+      param_fused->add_layer()->CopyFrom(param.layer(i));
+    }
+  }
+}
+
+}  // namespace caffe
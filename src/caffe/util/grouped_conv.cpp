@@ -0,0 +1,339 @@
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/cpu_dispatch.hpp"
+#include "caffe/util/grouped_conv.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// The output columns the kernels keep in registers at a time.
+static const int kBlock = 16;
+
+// For each column kw of the kernel, the output columns [columns[2 kw],
+// columns[2 kw + 1]) whose input column, ow * stride_w + kw * dilation_w -
+// pad_w, falls inside the image. Last, the columns inside it for every kw.
+static vector<int> tap_columns(const GroupedConvGeometry& g) {
+  vector<int> columns(2 * g.kernel_w + 2);
+  int inside_begin = 0;
+  int inside_end = g.output_w;
+  for (int kw = 0; kw < g.kernel_w; ++kw) {
+    const int offset = kw * g.dilation_w - g.pad_w;
+    columns[2 * kw] = offset >= 0 ? 0 : (g.stride_w - 1 - offset) / g.stride_w;
+    columns[2 * kw + 1] = offset >= g.width ? 0
+        : std::min(g.output_w, (g.width - 1 - offset) / g.stride_w + 1);
+    inside_begin = std::max(inside_begin, columns[2 * kw]);
+    inside_end = std::min(inside_end, columns[2 * kw + 1]);
+  }
+  columns[2 * g.kernel_w] = std::min(inside_begin, g.output_w);
+  columns[2 * g.kernel_w + 1] = std::max(columns[2 * g.kernel_w], inside_end);
+  return columns;
+}
+
+// y[ow] += w * x[ow * stride] over [begin, end).
+template <typename Dtype>
+static CAFFE_CPU_INLINE void tap_row(const int begin, const int end,
+    const Dtype w, const Dtype* x, const int stride, Dtype* y) {
+  if (stride == 1) {
+    for (int i = begin; i < end; ++i) {
+      y[i] += w * x[i];
+    }
+  } else {
+    for (int i = begin; i < end; ++i) {
+      y[i] += w * x[i * stride];
+    }
+  }
+}
+
+// The output channels [begin, end), a row at a time: blocks of kBlock
+// columns inside the image for every tap summed over all taps in registers,
+// and the columns around them a tap at a time.
+template <typename Dtype>
+static CAFFE_CPU_INLINE void grouped_conv_forward_kernel(const int begin,
+    const int end, const GroupedConvGeometry* geometry, const int* columns,
+    const Dtype* input, const Dtype* weights, Dtype* output) {
+  const GroupedConvGeometry& g = *geometry;
+  const int group_channels = g.channels / g.groups;
+  const int group_outputs = g.num_output / g.groups;
+  const int blocks_begin = columns[2 * g.kernel_w];
+  const int blocks_end = blocks_begin
+      + (columns[2 * g.kernel_w + 1] - blocks_begin) / kBlock * kBlock;
+  for (int c_out = begin; c_out < end; ++c_out) {
+    const Dtype* in = input
+        + (c_out / group_outputs) * group_channels * g.height * g.width;
+    const Dtype* w = weights + c_out * group_channels * g.kernel_h * g.kernel_w;
+    Dtype* out = output + c_out * g.output_h * g.output_w;
+    for (int oh = 0; oh < g.output_h; ++oh) {
+      Dtype* out_row = out + oh * g.output_w;
+      const int ih_begin = oh * g.stride_h - g.pad_h;
+      for (int ow = blocks_begin; ow < blocks_end; ow += kBlock) {
+        Dtype sums[kBlock];
+        for (int j = 0; j < kBlock; ++j) {
+          sums[j] = 0;
+        }
+        for (int c = 0; c < group_channels; ++c) {
+          for (int kh = 0; kh < g.kernel_h; ++kh) {
+            const int ih = ih_begin + kh * g.dilation_h;
+            if (ih < 0 || ih >= g.height) {
+              continue;
+            }
+            const Dtype* in_row = in + (c * g.height + ih) * g.width
+                + ow * g.stride_w - g.pad_w;
+            const Dtype* w_row = w + (c * g.kernel_h + kh) * g.kernel_w;
+            for (int kw = 0; kw < g.kernel_w; ++kw) {
+              const Dtype w_k = w_row[kw];
+              const Dtype* x = in_row + kw * g.dilation_w;
+              if (g.stride_w == 1) {
+                for (int j = 0; j < kBlock; ++j) {
+                  sums[j] += w_k * x[j];
+                }
+              } else {
+                for (int j = 0; j < kBlock; ++j) {
+                  sums[j] += w_k * x[j * g.stride_w];
+                }
+              }
+            }
+          }
+        }
+        for (int j = 0; j < kBlock; ++j) {
+          out_row[ow + j] = sums[j];
+        }
+      }
+      std::fill(out_row, out_row + blocks_begin, Dtype(0));
+      std::fill(out_row + blocks_end, out_row + g.output_w, Dtype(0));
+      for (int c = 0; c < group_channels; ++c) {
+        for (int kh = 0; kh < g.kernel_h; ++kh) {
+          const int ih = ih_begin + kh * g.dilation_h;
+          if (ih < 0 || ih >= g.height) {
+            continue;
+          }
+          const Dtype* in_row = in + (c * g.height + ih) * g.width;
+          const Dtype* w_row = w + (c * g.kernel_h + kh) * g.kernel_w;
+          for (int kw = 0; kw < g.kernel_w; ++kw) {
+            const int offset = kw * g.dilation_w - g.pad_w;
+            const int ow_begin = columns[2 * kw];
+            const int ow_end = columns[2 * kw + 1];
+            tap_row(ow_begin, std::min(ow_end, blocks_begin), w_row[kw],
+                in_row + offset, g.stride_w, out_row);
+            tap_row(std::max(ow_begin, blocks_end), ow_end, w_row[kw],
+                in_row + offset, g.stride_w, out_row);
+          }
+        }
+      }
+    }
+  }
+}
+
+CAFFE_CPU_VARIANTS_TEMPLATE(Dtype, grouped_conv_forward_kernel,
+    (const int begin, const int end, const GroupedConvGeometry* geometry,
+    const int* columns, const Dtype* input, const Dtype* weights,
+    Dtype* output), (begin, end, geometry, columns, input, weights, output))
+
+// With strides, the input channels [begin, end), each the taps of the
+// outputs of its group scattered back a row at a time.
+template <typename Dtype>
+static CAFFE_CPU_INLINE void grouped_conv_backward_kernel(const int begin,
+    const int end, const GroupedConvGeometry* geometry, const int* columns,
+    const Dtype* output_diff, const Dtype* weights, Dtype* input_diff) {
+  const GroupedConvGeometry& g = *geometry;
+  const int group_channels = g.channels / g.groups;
+  const int group_outputs = g.num_output / g.groups;
+  const int kernel_size = g.kernel_h * g.kernel_w;
+  for (int c_in = begin; c_in < end; ++c_in) {
+    const int c = c_in % group_channels;
+    const int first_output = (c_in / group_channels) * group_outputs;
+    Dtype* in = input_diff + c_in * g.height * g.width;
+    std::fill(in, in + g.height * g.width, Dtype(0));
+    for (int c_out = first_output; c_out < first_output + group_outputs;
+        ++c_out) {
+      const Dtype* out = output_diff + c_out * g.output_h * g.output_w;
+      const Dtype* w = weights + (c_out * group_channels + c) * kernel_size;
+      for (int oh = 0; oh < g.output_h; ++oh) {
+        const Dtype* out_row = out + oh * g.output_w;
+        for (int kh = 0; kh < g.kernel_h; ++kh) {
+          const int ih = oh * g.stride_h - g.pad_h + kh * g.dilation_h;
+          if (ih < 0 || ih >= g.height) {
+            continue;
+          }
+          Dtype* in_row = in + ih * g.width;
+          for (int kw = 0; kw < g.kernel_w; ++kw) {
+            const int offset = kw * g.dilation_w - g.pad_w;
+            const Dtype w_k = w[kh * g.kernel_w + kw];
+            for (int ow = columns[2 * kw]; ow < columns[2 * kw + 1]; ++ow) {
+              in_row[ow * g.stride_w + offset] += w_k * out_row[ow];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+CAFFE_CPU_VARIANTS_TEMPLATE(Dtype, grouped_conv_backward_kernel,
+    (const int begin, const int end, const GroupedConvGeometry* geometry,
+    const int* columns, const Dtype* output_diff, const Dtype* weights,
+    Dtype* input_diff),
+    (begin, end, geometry, columns, output_diff, weights, input_diff))
+
+// The weights of the output channels [begin, end), each tap the sum of the
+// products of kBlock columns down the rows in registers, then across.
+template <typename Dtype>
+static CAFFE_CPU_INLINE void grouped_conv_weight_kernel(const int begin,
+    const int end, const GroupedConvGeometry* geometry, const int* columns,
+    const Dtype* input, const Dtype* output_diff, Dtype* weight_diff) {
+  const GroupedConvGeometry& g = *geometry;
+  const int group_channels = g.channels / g.groups;
+  const int group_outputs = g.num_output / g.groups;
+  for (int c_out = begin; c_out < end; ++c_out) {
+    const Dtype* in = input
+        + (c_out / group_outputs) * group_channels * g.height * g.width;
+    const Dtype* out = output_diff + c_out * g.output_h * g.output_w;
+    Dtype* w = weight_diff
+        + c_out * group_channels * g.kernel_h * g.kernel_w;
+    for (int c = 0; c < group_channels; ++c) {
+      for (int kh = 0; kh < g.kernel_h; ++kh) {
+        // The output rows whose tap falls inside the image.
+        const int top = kh * g.dilation_h - g.pad_h;
+        const int oh_begin = top >= 0 ? 0
+            : (g.stride_h - 1 - top) / g.stride_h;
+        const int oh_end = top >= g.height ? 0
+            : std::min(g.output_h, (g.height - 1 - top) / g.stride_h + 1);
+        for (int kw = 0; kw < g.kernel_w; ++kw) {
+          const int offset = kw * g.dilation_w - g.pad_w;
+          const int ow_begin = columns[2 * kw];
+          const int ow_end = columns[2 * kw + 1];
+          const int blocks_end = ow_begin
+              + std::max(ow_end - ow_begin, 0) / kBlock * kBlock;
+          Dtype sums[kBlock];
+          for (int j = 0; j < kBlock; ++j) {
+            sums[j] = 0;
+          }
+          for (int oh = oh_begin; oh < oh_end; ++oh) {
+            const Dtype* in_row = in
+                + (c * g.height + oh * g.stride_h + top) * g.width + offset;
+            const Dtype* out_row = out + oh * g.output_w;
+            for (int ow = ow_begin; ow < blocks_end; ow += kBlock) {
+              if (g.stride_w == 1) {
+                for (int j = 0; j < kBlock; ++j) {
+                  sums[j] += out_row[ow + j] * in_row[ow + j];
+                }
+              } else {
+                for (int j = 0; j < kBlock; ++j) {
+                  sums[j] += out_row[ow + j] * in_row[(ow + j) * g.stride_w];
+                }
+              }
+            }
+            for (int ow = blocks_end; ow < ow_end; ++ow) {
+              sums[ow - blocks_end] += out_row[ow] * in_row[ow * g.stride_w];
+            }
+          }
+          Dtype sum = 0;
+          for (int j = 0; j < kBlock; ++j) {
+            sum += sums[j];
+          }
+          w[(c * g.kernel_h + kh) * g.kernel_w + kw] += sum;
+        }
+      }
+    }
+  }
+}
+
+CAFFE_CPU_VARIANTS_TEMPLATE(Dtype, grouped_conv_weight_kernel,
+    (const int begin, const int end, const GroupedConvGeometry* geometry,
+    const int* columns, const Dtype* input, const Dtype* output_diff,
+    Dtype* weight_diff),
+    (begin, end, geometry, columns, input, output_diff, weight_diff))
+
+// The fewest channels worth handing to another thread, at about 16K
+// multiply-adds each.
+static int grouped_conv_grain(const GroupedConvGeometry& g) {
+  return std::max(16384 / ((g.channels / g.groups) * g.kernel_h * g.kernel_w
+      * g.output_h * g.output_w), 1);
+}
+
+template <typename Dtype>
+void grouped_conv_forward_cpu(const GroupedConvGeometry& geometry,
+    const Dtype* input, const Dtype* weights, Dtype* output) {
+  const vector<int> columns = tap_columns(geometry);
+  parallel_for(geometry.num_output, boost::bind(
+      CAFFE_CPU_DISPATCH_TEMPLATE(grouped_conv_forward_kernel, Dtype), _1, _2,
+      &geometry, &columns[0], input, weights, output),
+      grouped_conv_grain(geometry));
+}
+
+template void grouped_conv_forward_cpu<float>(
+    const GroupedConvGeometry& geometry, const float* input,
+    const float* weights, float* output);
+template void grouped_conv_forward_cpu<double>(
+    const GroupedConvGeometry& geometry, const double* input,
+    const double* weights, double* output);
+
+// With unit strides, the gradient is the convolution of output_diff with the
+// kernels flipped and their channels transposed, padded to the full extent
+// of a kernel less the padding, which the forward kernel computes.
+template <typename Dtype>
+void grouped_conv_backward_cpu(const GroupedConvGeometry& geometry,
+    const Dtype* output_diff, const Dtype* weights, Dtype* input_diff) {
+  if (geometry.stride_h == 1 && geometry.stride_w == 1) {
+    const GroupedConvGeometry& g = geometry;
+    GroupedConvGeometry transposed = g;
+    transposed.channels = g.num_output;
+    transposed.num_output = g.channels;
+    transposed.height = g.output_h;
+    transposed.width = g.output_w;
+    transposed.output_h = g.height;
+    transposed.output_w = g.width;
+    transposed.pad_h = g.dilation_h * (g.kernel_h - 1) - g.pad_h;
+    transposed.pad_w = g.dilation_w * (g.kernel_w - 1) - g.pad_w;
+    const int group_channels = g.channels / g.groups;
+    const int group_outputs = g.num_output / g.groups;
+    const int kernel_size = g.kernel_h * g.kernel_w;
+    vector<Dtype> flipped(g.num_output * group_channels * kernel_size);
+    for (int c_out = 0; c_out < g.num_output; ++c_out) {
+      for (int c = 0; c < group_channels; ++c) {
+        const Dtype* w = weights + (c_out * group_channels + c) * kernel_size;
+        // Input channel c of group c_out / group_outputs.
+        const int c_in = (c_out / group_outputs) * group_channels + c;
+        Dtype* w_t = &flipped[0]
+            + (c_in * group_outputs + c_out % group_outputs) * kernel_size;
+        std::reverse_copy(w, w + kernel_size, w_t);
+      }
+    }
+    grouped_conv_forward_cpu(transposed, output_diff, &flipped[0],
+        input_diff);
+    return;
+  }
+  const vector<int> columns = tap_columns(geometry);
+  parallel_for(geometry.channels, boost::bind(
+      CAFFE_CPU_DISPATCH_TEMPLATE(grouped_conv_backward_kernel, Dtype), _1,
+      _2, &geometry, &columns[0], output_diff, weights, input_diff),
+      grouped_conv_grain(geometry));
+}
+
+template void grouped_conv_backward_cpu<float>(
+    const GroupedConvGeometry& geometry, const float* output_diff,
+    const float* weights, float* input_diff);
+template void grouped_conv_backward_cpu<double>(
+    const GroupedConvGeometry& geometry, const double* output_diff,
+    const double* weights, double* input_diff);
+
+template <typename Dtype>
+void grouped_conv_weight_cpu(const GroupedConvGeometry& geometry,
+    const Dtype* input, const Dtype* output_diff, Dtype* weight_diff) {
+  const vector<int> columns = tap_columns(geometry);
+  parallel_for(geometry.num_output, boost::bind(
+      CAFFE_CPU_DISPATCH_TEMPLATE(grouped_conv_weight_kernel, Dtype), _1, _2,
+      &geometry, &columns[0], input, output_diff, weight_diff),
+      grouped_conv_grain(geometry));
+}
+
+template void grouped_conv_weight_cpu<float>(
+    const GroupedConvGeometry& geometry, const float* input,
+    const float* output_diff, float* weight_diff);
+template void grouped_conv_weight_cpu<double>(
+    const GroupedConvGeometry& geometry, const double* input,
+    const double* output_diff, double* weight_diff);
+
+}  // namespace caffe
@@ -1,15 +1,14 @@
 #include "caffe/util/hdf5.hpp"
 
+#include <climits>
 #include <string>
 #include <vector>
 
 namespace caffe {
 
-// Verifies format of data stored in HDF5 file and reshapes blob accordingly.
-template <typename Dtype>
-void hdf5_load_nd_dataset_helper(
-    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
-    Blob<Dtype>* blob) {
+// Verifies format of data stored in HDF5 file and returns its shape.
+vector<int> hdf5_get_nd_dataset_shape(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim) {
   // Verify that the dataset exists.
   CHECK(H5LTfind_dataset(file_id, dataset_name_))
       << "Failed to find HDF5 dataset " << dataset_name_;
@@ -60,7 +59,16 @@ void hdf5_load_nd_dataset_helper(
   for (int i = 0; i < dims.size(); ++i) {
     blob_dims[i] = dims[i];
   }
-  blob->Reshape(blob_dims);
+  return blob_dims;
+}
+
+// Verifies format of data stored in HDF5 file and reshapes blob accordingly.
+template <typename Dtype>
+void hdf5_load_nd_dataset_helper(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
+    Blob<Dtype>* blob) {
+  blob->Reshape(
+      hdf5_get_nd_dataset_shape(file_id, dataset_name_, min_dim, max_dim));
 }
 
 template <>
@@ -81,6 +89,56 @@ void hdf5_load_nd_dataset<double>(hid_t file_id, const char* dataset_name_,
   CHECK_GE(status, 0) << "Failed to read double dataset " << dataset_name_;
 }
 
+// Reads the rows [start, start + num) of the first axis of a dataset with
+// a hyperslab selection, so that only those rows are held in memory.
+template <typename Dtype>
+static void hdf5_load_nd_dataset_rows_helper(
+    hid_t file_id, const char* dataset_name_, int start, int num,
+    hid_t mem_type_id, Blob<Dtype>* blob) {
+  vector<int> shape =
+      hdf5_get_nd_dataset_shape(file_id, dataset_name_, 1, INT_MAX);
+  CHECK_GE(start, 0);
+  CHECK_GE(num, 0);
+  CHECK_LE(start + num, shape[0])
+      << "Rows out of range for HDF5 dataset " << dataset_name_;
+  shape[0] = num;
+  blob->Reshape(shape);
+  if (num == 0) { return; }
+  std::vector<hsize_t> offset(shape.size(), 0);
+  std::vector<hsize_t> count(shape.begin(), shape.end());
+  offset[0] = start;
+  hid_t dataset_id = H5Dopen2(file_id, dataset_name_, H5P_DEFAULT);
+  CHECK_GE(dataset_id, 0) << "Failed to open HDF5 dataset " << dataset_name_;
+  hid_t file_space_id = H5Dget_space(dataset_id);
+  CHECK_GE(file_space_id, 0) << "Failed to get dataspace of " << dataset_name_;
+  herr_t status = H5Sselect_hyperslab(file_space_id, H5S_SELECT_SET,
+      offset.data(), NULL, count.data(), NULL);
+  CHECK_GE(status, 0) << "Failed to select rows of " << dataset_name_;
+  hid_t mem_space_id = H5Screate_simple(count.size(), count.data(), NULL);
+  CHECK_GE(mem_space_id, 0) << "Failed to create dataspace for "
+      << dataset_name_;
+  status = H5Dread(dataset_id, mem_type_id, mem_space_id, file_space_id,
+      H5P_DEFAULT, blob->mutable_cpu_data());
+  CHECK_GE(status, 0) << "Failed to read rows of dataset " << dataset_name_;
+  H5Sclose(mem_space_id);
+  H5Sclose(file_space_id);
+  H5Dclose(dataset_id);
+}
+
+template <>
+void hdf5_load_nd_dataset_rows<float>(hid_t file_id, const char* dataset_name_,
+        int start, int num, Blob<float>* blob) {
+  hdf5_load_nd_dataset_rows_helper(file_id, dataset_name_, start, num,
+      H5T_NATIVE_FLOAT, blob);
+}
+
+template <>
+void hdf5_load_nd_dataset_rows<double>(hid_t file_id, const char* dataset_name_,
+        int start, int num, Blob<double>* blob) {
+  hdf5_load_nd_dataset_rows_helper(file_id, dataset_name_, start, num,
+      H5T_NATIVE_DOUBLE, blob);
+}
+
 template <>
 void hdf5_save_nd_dataset<float>(
     const hid_t file_id, const string& dataset_name, const Blob<float>& blob,
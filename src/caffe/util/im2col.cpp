@@ -1,5 +1,6 @@
 #include <vector>
 
+#include "caffe/util/cpu_dispatch.hpp"
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/math_functions.hpp"
 
@@ -16,9 +17,9 @@ inline bool is_a_ge_zero_and_a_lt_b(int a, int b) {
 }
 
 template <typename Dtype>
-void im2col_cpu(const Dtype* data_im, const int channels,
-    const int height, const int width, const int kernel_h, const int kernel_w,
-    const int pad_h, const int pad_w,
+static CAFFE_CPU_INLINE void im2col_kernel(const Dtype* data_im,
+    const int channels, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
     const int stride_h, const int stride_w,
     const int dilation_h, const int dilation_w,
     Dtype* data_col) {
@@ -54,6 +55,26 @@ void im2col_cpu(const Dtype* data_im, const int channels,
   }
 }
 
+CAFFE_CPU_VARIANTS_TEMPLATE(Dtype, im2col_kernel, (const Dtype* data_im,
+    const int channels, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, Dtype* data_col),
+    (data_im, channels, height, width, kernel_h, kernel_w, pad_h, pad_w,
+    stride_h, stride_w, dilation_h, dilation_w, data_col))
+
+template <typename Dtype>
+void im2col_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w,
+    Dtype* data_col) {
+  CAFFE_CPU_DISPATCH_TEMPLATE(im2col_kernel, Dtype)(data_im, channels, height,
+      width, kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w,
+      dilation_h, dilation_w, data_col);
+}
+
 // Explicit instantiation
 template void im2col_cpu<float>(const float* data_im, const int channels,
     const int height, const int width, const int kernel_h, const int kernel_w,
@@ -160,13 +181,12 @@ template void im2col_nd_cpu<double>(const double* data_im,
     const int* dilation, double* data_col);
 
 template <typename Dtype>
-void col2im_cpu(const Dtype* data_col, const int channels,
-    const int height, const int width, const int kernel_h, const int kernel_w,
-    const int pad_h, const int pad_w,
+static CAFFE_CPU_INLINE void col2im_kernel(const Dtype* data_col,
+    const int channels, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
     const int stride_h, const int stride_w,
     const int dilation_h, const int dilation_w,
     Dtype* data_im) {
-  caffe_set(height * width * channels, Dtype(0), data_im);
   const int output_h = (height + 2 * pad_h -
     (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
   const int output_w = (width + 2 * pad_w -
@@ -196,6 +216,27 @@ void col2im_cpu(const Dtype* data_col, const int channels,
   }
 }
 
+CAFFE_CPU_VARIANTS_TEMPLATE(Dtype, col2im_kernel, (const Dtype* data_col,
+    const int channels, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, Dtype* data_im),
+    (data_col, channels, height, width, kernel_h, kernel_w, pad_h, pad_w,
+    stride_h, stride_w, dilation_h, dilation_w, data_im))
+
+template <typename Dtype>
+void col2im_cpu(const Dtype* data_col, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w,
+    Dtype* data_im) {
+  caffe_set(height * width * channels, Dtype(0), data_im);
+  CAFFE_CPU_DISPATCH_TEMPLATE(col2im_kernel, Dtype)(data_col, channels, height,
+      width, kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w,
+      dilation_h, dilation_w, data_im);
+}
+
 // Explicit instantiation
 template void col2im_cpu<float>(const float* data_col, const int channels,
     const int height, const int width, const int kernel_h, const int kernel_w,
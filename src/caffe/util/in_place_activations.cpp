@@ -0,0 +1,102 @@
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/in_place_activations.hpp"
+
+namespace caffe {
+
+// Whether the backward of a layer leaves its top data alone, so that a later
+// layer may overwrite it in place.
+static bool IgnoresTopInBackward(const LayerParameter& layer_param) {
+  const string& type = layer_param.type();
+  if (type == "Convolution") {
+    // The fused ReLU backpropagates through the sign of the top.
+    return !layer_param.convolution_param().fuse_relu();
+  }
+  return type == "Deconvolution" || type == "InnerProduct" ||
+      type == "Pooling" || type == "Concat" || type == "BatchNorm" ||
+      type == "Scale" || type == "ReLU" || type == "Dropout";
+}
+
+void MakeActivationsInPlace(const NetParameter& param,
+                            NetParameter* param_in_place) {
+  // Find the consumers of every top blob as in FuseLayers; a loss weight
+  // counts as a consumer.
+  const int kLossConsumer = -1;
+  map<string, pair<int, int> > blob_name_to_last_top_idx;
+  map<pair<int, int>, vector<int> > top_idx_to_consumers;
+  vector<pair<int, int> > bottom_top_idx(param.layer_size(),
+                                         make_pair(-1, -1));
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& layer_param = param.layer(i);
+    for (int j = 0; j < layer_param.bottom_size(); ++j) {
+      const string& blob_name = layer_param.bottom(j);
+      if (blob_name_to_last_top_idx.count(blob_name)) {
+        top_idx_to_consumers[blob_name_to_last_top_idx[blob_name]].push_back(i);
+        if (j == 0) {
+          bottom_top_idx[i] = blob_name_to_last_top_idx[blob_name];
+        }
+      }
+    }
+    for (int j = 0; j < layer_param.top_size(); ++j) {
+      blob_name_to_last_top_idx[layer_param.top(j)] = make_pair(i, j);
+      if (j < layer_param.loss_weight_size() && layer_param.loss_weight(j)) {
+        top_idx_to_consumers[make_pair(i, j)].push_back(kLossConsumer);
+      }
+    }
+  }
+  param_in_place->CopyFrom(param);
+  // The new names of the tops renamed so far, until their names are reused.
+  map<string, string> renamed;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& original = param.layer(i);
+    LayerParameter* layer_param = param_in_place->mutable_layer(i);
+    for (int j = 0; j < layer_param->bottom_size(); ++j) {
+      if (renamed.count(original.bottom(j))) {
+        layer_param->set_bottom(j, renamed[original.bottom(j)]);
+      }
+    }
+    // Tops computed in place follow their bottoms; other tops are new blobs.
+    for (int j = 0; j < layer_param->top_size(); ++j) {
+      if (j < original.bottom_size() && original.top(j) == original.bottom(j)) {
+        layer_param->set_top(j, layer_param->bottom(j));
+      } else {
+        renamed.erase(original.top(j));
+      }
+    }
+    if (layer_param->type() == "ReLU") {
+      layer_param->mutable_relu_param()->set_bit_mask(true);
+    }
+    bool in_place = (original.type() == "ReLU" ||
+        original.type() == "Dropout") && original.bottom_size() == 1 &&
+        original.top_size() == 1 && original.bottom(0) != original.top(0) &&
+        original.loss_weight_size() == 0 && bottom_top_idx[i].first >= 0;
+    if (in_place) {
+      const vector<int>& consumers = top_idx_to_consumers[bottom_top_idx[i]];
+      in_place = consumers.size() == 1 && consumers[0] == i &&
+          IgnoresTopInBackward(param.layer(bottom_top_idx[i].first));
+    }
+    if (!in_place) { continue; }
+    // Keep the blob if a later layer writes a new blob of the bottom's name.
+    const string& bottom_name = layer_param->bottom(0);
+    for (int k = i + 1; in_place && k < param.layer_size(); ++k) {
+      const LayerParameter& later = param.layer(k);
+      for (int j = 0; j < later.top_size(); ++j) {
+        if (later.top(j) == bottom_name &&
+            (j >= later.bottom_size() || later.bottom(j) != later.top(j))) {
+          in_place = false;
+        }
+      }
+    }
+    if (in_place) {
+      LOG(INFO) << "Computing layer " << layer_param->name() << " in place";
+      renamed[original.top(0)] = bottom_name;
+      layer_param->set_top(0, bottom_name);
+    }
+  }
+}
+
+}  // namespace caffe
@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <map>
+#include <set>
 #include <sstream>
 #include <string>
 #include <utility>
@@ -18,6 +19,7 @@ void InsertSplits(const NetParameter& param, NetParameter* param_split) {
   map<pair<int, int>, int> top_idx_to_bottom_count;
   map<pair<int, int>, float> top_idx_to_loss_weight;
   map<pair<int, int>, int> top_idx_to_bottom_split_idx;
+  set<pair<int, int> > top_idx_requires_split;
   map<int, string> layer_idx_to_layer_name;
   for (int i = 0; i < param.layer_size(); ++i) {
     const LayerParameter& layer_param = param.layer(i);
@@ -33,6 +35,18 @@ void InsertSplits(const NetParameter& param, NetParameter* param_split) {
       const pair<int, int>& top_idx = blob_name_to_last_top_idx[blob_name];
       bottom_idx_to_source_top_idx[bottom_idx] = top_idx;
       ++top_idx_to_bottom_count[top_idx];
+      // A shared blob can only be fanned out without a split if none of its
+      // consumers overwrites it in-place or takes it as several bottoms.
+      for (int k = 0; k < layer_param.top_size(); ++k) {
+        if (layer_param.top(k) == blob_name) {
+          top_idx_requires_split.insert(top_idx);
+        }
+      }
+      for (int k = 0; k < j; ++k) {
+        if (layer_param.bottom(k) == blob_name) {
+          top_idx_requires_split.insert(top_idx);
+        }
+      }
     }
     for (int j = 0; j < layer_param.top_size(); ++j) {
       const string& blob_name = layer_param.top(j);
@@ -48,6 +62,7 @@ void InsertSplits(const NetParameter& param, NetParameter* param_split) {
       top_idx_to_loss_weight[top_idx] = layer_param.loss_weight(j);
       if (top_idx_to_loss_weight[top_idx]) {
         ++top_idx_to_bottom_count[top_idx];
+        top_idx_requires_split.insert(top_idx);
       }
     }
   }
@@ -59,7 +74,8 @@ void InsertSplits(const NetParameter& param, NetParameter* param_split) {
       const pair<int, int>& top_idx =
           bottom_idx_to_source_top_idx[make_pair(i, j)];
       const int split_count = top_idx_to_bottom_count[top_idx];
-      if (split_count > 1) {
+      if (split_count > 1 && (param.insert_splits() ||
+                              top_idx_requires_split.count(top_idx))) {
         const string& layer_name = layer_idx_to_layer_name[top_idx.first];
         const string& blob_name = layer_param->bottom(j);
         layer_param->set_bottom(j, SplitBlobName(layer_name,
@@ -71,7 +87,8 @@ void InsertSplits(const NetParameter& param, NetParameter* param_split) {
     for (int j = 0; j < layer_param->top_size(); ++j) {
       const pair<int, int>& top_idx = make_pair(i, j);
       const int split_count = top_idx_to_bottom_count[top_idx];
-      if (split_count > 1) {
+      if (split_count > 1 && (param.insert_splits() ||
+                              top_idx_requires_split.count(top_idx))) {
         const string& layer_name = layer_idx_to_layer_name[i];
         const string& blob_name = layer_param->top(j);
         LayerParameter* split_layer_param = param_split->add_layer();
@@ -1,11 +1,18 @@
+#include <boost/bind.hpp>
 #include <boost/math/special_functions/next.hpp>
 #include <boost/random.hpp>
+#include <boost/thread.hpp>
 
+#include <algorithm>
 #include <limits>
+#include <vector>
 
 #include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/cpu_dispatch.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -31,6 +38,252 @@ void caffe_cpu_gemm<double>(const CBLAS_TRANSPOSE TransA,
       ldb, beta, C, N);
 }
 
+template <typename Dtype>
+const int PackedMatrix<Dtype>::kPanel;
+
+template <typename Dtype>
+void PackedMatrix<Dtype>::Pack(const CBLAS_TRANSPOSE TransB, const int K,
+    const int P, const Dtype* B, const uint64_t version) {
+  if (data_ && B == source_ && version == version_ && K == K_ && P == P_
+      && TransB == trans_) {
+    return;
+  }
+  const int panels = (P + kPanel - 1) / kPanel;
+  const size_t size = sizeof(Dtype) * panels * K * kPanel;
+  if (!data_ || data_->size() != size) {
+    data_.reset(new SyncedMemory(size));
+  }
+  Dtype* packed = static_cast<Dtype*>(data_->mutable_cpu_data());
+  for (int p = 0; p < panels; ++p) {
+    Dtype* panel = packed + p * K * kPanel;
+    for (int j = 0; j < kPanel; ++j) {
+      const int col = p * kPanel + j;
+      for (int k = 0; k < K; ++k) {
+        if (col >= P) {
+          panel[k * kPanel + j] = 0;
+        } else if (TransB == CblasNoTrans) {
+          panel[k * kPanel + j] = B[k * P + col];
+        } else {
+          panel[k * kPanel + j] = B[col * K + k];
+        }
+      }
+    }
+  }
+  K_ = K;
+  P_ = P;
+  trans_ = TransB;
+  source_ = B;
+  version_ = version;
+}
+
+template <typename Dtype>
+const Dtype* PackedMatrix<Dtype>::data() const {
+  CHECK(data_) << "Nothing packed.";
+  return static_cast<const Dtype*>(data_->cpu_data());
+}
+
+template class PackedMatrix<float>;
+template class PackedMatrix<double>;
+
+// The packings of parts of a SyncedMemory, each from offsets[i]. A stale
+// packing is replaced rather than packed over, since other threads may still
+// be reading it.
+template <typename Dtype>
+class PackedMatrixCache : public SyncedMemory::Derived {
+ public:
+  vector<int> offsets;
+  vector<shared_ptr<const PackedMatrix<Dtype> > > packed;
+};
+
+static boost::mutex packed_cache_mutex_;
+
+template <typename Dtype>
+shared_ptr<const PackedMatrix<Dtype> > caffe_cpu_packed(SyncedMemory* memory,
+    const CBLAS_TRANSPOSE TransB, const int K, const int P, const int offset) {
+  const Dtype* B = static_cast<const Dtype*>(memory->cpu_data()) + offset;
+  const uint64_t version = memory->version();
+  boost::mutex::scoped_lock lock(packed_cache_mutex_);
+  shared_ptr<PackedMatrixCache<Dtype> > cache =
+      boost::dynamic_pointer_cast<PackedMatrixCache<Dtype> >(
+      memory->derived());
+  if (!cache) {
+    cache.reset(new PackedMatrixCache<Dtype>());
+    memory->set_derived(cache);
+  }
+  for (int i = 0; i < cache->packed.size(); ++i) {
+    const PackedMatrix<Dtype>& packed = *cache->packed[i];
+    if (cache->offsets[i] == offset && packed.trans() == TransB
+        && packed.K() == K && packed.P() == P) {
+      if (packed.source() != B || packed.version() != version) {
+        shared_ptr<PackedMatrix<Dtype> > repacked(new PackedMatrix<Dtype>());
+        repacked->Pack(TransB, K, P, B, version);
+        cache->packed[i] = repacked;
+      }
+      return cache->packed[i];
+    }
+  }
+  shared_ptr<PackedMatrix<Dtype> > packed(new PackedMatrix<Dtype>());
+  packed->Pack(TransB, K, P, B, version);
+  cache->offsets.push_back(offset);
+  cache->packed.push_back(packed);
+  return packed;
+}
+
+template shared_ptr<const PackedMatrix<float> > caffe_cpu_packed<float>(
+    SyncedMemory* memory, const CBLAS_TRANSPOSE TransB, const int K,
+    const int P, const int offset);
+template shared_ptr<const PackedMatrix<double> > caffe_cpu_packed<double>(
+    SyncedMemory* memory, const CBLAS_TRANSPOSE TransB, const int K,
+    const int P, const int offset);
+
+// A product of rows of a small operand with a packed matrix: out[r][c] =
+// alpha sum_k a[r][k] packed[k][c] + beta out[r][c], the operands strided so
+// that either may be transposed.
+template <typename Dtype>
+struct PackedProduct {
+  int rows;
+  int K;
+  int P;
+  const Dtype* a;
+  int a_row_stride;
+  int a_k_stride;
+  const Dtype* packed;
+  Dtype alpha;
+  Dtype beta;
+  Dtype* out;
+  int out_row_stride;
+  int out_col_stride;
+};
+
+static const int kPackedRows = 4;
+
+// Computes the panels [begin, end) of the product, kPackedRows rows at a
+// time, the accumulators of a panel of that many rows in registers.
+template <typename Dtype>
+static CAFFE_CPU_INLINE void packed_product_panels(const int begin,
+    const int end, const PackedProduct<Dtype>* product) {
+  const PackedProduct<Dtype>& g = *product;
+  const int kPanel = PackedMatrix<Dtype>::kPanel;
+  for (int p = begin; p < end; ++p) {
+    const Dtype* panel = g.packed + p * g.K * kPanel;
+    const int cols = std::min(kPanel, g.P - p * kPanel);
+    for (int i = 0; i < g.rows; i += kPackedRows) {
+      const int rows = std::min(kPackedRows, g.rows - i);
+      // Missing rows repeat the last one, and are not stored.
+      const Dtype* a[kPackedRows];
+      for (int r = 0; r < kPackedRows; ++r) {
+        a[r] = g.a + std::min(i + r, g.rows - 1) * g.a_row_stride;
+      }
+      Dtype acc[kPackedRows][kPanel];
+      for (int r = 0; r < kPackedRows; ++r) {
+        for (int j = 0; j < kPanel; ++j) {
+          acc[r][j] = 0;
+        }
+      }
+      for (int k = 0; k < g.K; ++k) {
+        const Dtype* b = panel + k * kPanel;
+        for (int r = 0; r < kPackedRows; ++r) {
+          const Dtype a_rk = a[r][k * g.a_k_stride];
+          for (int j = 0; j < kPanel; ++j) {
+            acc[r][j] += a_rk * b[j];
+          }
+        }
+      }
+      for (int r = 0; r < rows; ++r) {
+        Dtype* out = g.out + (i + r) * g.out_row_stride
+            + p * kPanel * g.out_col_stride;
+        for (int j = 0; j < cols; ++j) {
+          Dtype* y = out + j * g.out_col_stride;
+          *y = g.beta == Dtype(0) ? g.alpha * acc[r][j]
+              : g.alpha * acc[r][j] + g.beta * *y;
+        }
+      }
+    }
+  }
+}
+
+CAFFE_CPU_VARIANTS_TEMPLATE(Dtype, packed_product_panels, (const int begin,
+    const int end, const PackedProduct<Dtype>* product), (begin, end, product))
+
+template <typename Dtype>
+static void packed_product(const PackedProduct<Dtype>& product) {
+  const int kPanel = PackedMatrix<Dtype>::kPanel;
+  const int panels = (product.P + kPanel - 1) / kPanel;
+  parallel_for(panels, boost::bind(
+      CAFFE_CPU_DISPATCH_TEMPLATE(packed_product_panels, Dtype), _1, _2,
+      &product), std::max(16384 / (product.K * kPanel), 1));
+}
+
+template <typename Dtype>
+void caffe_cpu_gemm_packed_b(const CBLAS_TRANSPOSE TransA, const int M,
+    const Dtype alpha, const Dtype* A, const PackedMatrix<Dtype>& B,
+    const Dtype beta, Dtype* C) {
+  const int K = B.K();
+  const int N = B.P();
+  if (M > kPackedGemmMaxRows) {
+    caffe_cpu_gemm(TransA, B.trans(), M, N, K, alpha, A, B.source(), beta,
+        C);
+    return;
+  }
+  PackedProduct<Dtype> product;
+  product.rows = M;
+  product.K = K;
+  product.P = N;
+  product.a = A;
+  product.a_row_stride = TransA == CblasNoTrans ? K : 1;
+  product.a_k_stride = TransA == CblasNoTrans ? 1 : M;
+  product.packed = B.data();
+  product.alpha = alpha;
+  product.beta = beta;
+  product.out = C;
+  product.out_row_stride = N;
+  product.out_col_stride = 1;
+  packed_product(product);
+}
+
+template void caffe_cpu_gemm_packed_b<float>(const CBLAS_TRANSPOSE TransA,
+    const int M, const float alpha, const float* A,
+    const PackedMatrix<float>& B, const float beta, float* C);
+template void caffe_cpu_gemm_packed_b<double>(const CBLAS_TRANSPOSE TransA,
+    const int M, const double alpha, const double* A,
+    const PackedMatrix<double>& B, const double beta, double* C);
+
+// As C^T = op(B)^T A^T, with op(B)^T the small operand.
+template <typename Dtype>
+void caffe_cpu_gemm_packed_a(const PackedMatrix<Dtype>& A,
+    const CBLAS_TRANSPOSE TransB, const int N, const Dtype alpha,
+    const Dtype* B, const Dtype beta, Dtype* C) {
+  const int K = A.K();
+  const int M = A.P();
+  if (N > kPackedGemmMaxRows) {
+    // A is the transpose of op(source).
+    caffe_cpu_gemm(A.trans() == CblasNoTrans ? CblasTrans : CblasNoTrans,
+        TransB, M, N, K, alpha, A.source(), B, beta, C);
+    return;
+  }
+  PackedProduct<Dtype> product;
+  product.rows = N;
+  product.K = K;
+  product.P = M;
+  product.a = B;
+  product.a_row_stride = TransB == CblasNoTrans ? 1 : K;
+  product.a_k_stride = TransB == CblasNoTrans ? N : 1;
+  product.packed = A.data();
+  product.alpha = alpha;
+  product.beta = beta;
+  product.out = C;
+  product.out_row_stride = 1;
+  product.out_col_stride = N;
+  packed_product(product);
+}
+
+template void caffe_cpu_gemm_packed_a<float>(const PackedMatrix<float>& A,
+    const CBLAS_TRANSPOSE TransB, const int N, const float alpha,
+    const float* B, const float beta, float* C);
+template void caffe_cpu_gemm_packed_a<double>(const PackedMatrix<double>& A,
+    const CBLAS_TRANSPOSE TransB, const int N, const double alpha,
+    const double* B, const double beta, double* C);
+
 template <>
 void caffe_cpu_gemv<float>(const CBLAS_TRANSPOSE TransA, const int M,
     const int N, const float alpha, const float* A, const float* x,
@@ -53,6 +306,25 @@ template <>
 void caffe_axpy<double>(const int N, const double alpha, const double* X,
     double* Y) { cblas_daxpy(N, alpha, X, 1, Y, 1); }
 
+int caffe_blas_num_threads() {
+#if defined(USE_MKL)
+  return mkl_get_max_threads();
+#elif defined(USE_OPENBLAS)
+  return openblas_get_num_threads();
+#else
+  return 1;
+#endif
+}
+
+void caffe_set_blas_num_threads(const int num_threads) {
+  CHECK_GE(num_threads, 1);
+#if defined(USE_MKL)
+  mkl_set_num_threads(num_threads);
+#elif defined(USE_OPENBLAS)
+  openblas_set_num_threads(num_threads);
+#endif
+}
+
 template <typename Dtype>
 void caffe_set(const int N, const Dtype alpha, Dtype* Y) {
   if (alpha == 0) {
@@ -216,6 +488,16 @@ void caffe_log<double>(const int n, const double* a, double* y) {
   vdLn(n, a, y);
 }
 
+template <>
+void caffe_tanh<float>(const int n, const float* a, float* y) {
+  vsTanh(n, a, y);
+}
+
+template <>
+void caffe_tanh<double>(const int n, const double* a, double* y) {
+  vdTanh(n, a, y);
+}
+
 template <>
 void caffe_abs<float>(const int n, const float* a, float* y) {
     vsAbs(n, a, y);
@@ -230,6 +512,11 @@ unsigned int caffe_rng_rand() {
   return (*caffe_rng())();
 }
 
+Philox Philox::FromCaffeRNG(uint64_t stream) {
+  const uint64_t key = caffe_rng_rand();
+  return Philox((key << 32) | caffe_rng_rand(), stream);
+}
+
 template <typename Dtype>
 Dtype caffe_nextafter(const Dtype b) {
   return boost::math::nextafter<Dtype>(
@@ -325,6 +612,111 @@ void caffe_rng_bernoulli<double>(const int n, const double p, unsigned int* r);
 template
 void caffe_rng_bernoulli<float>(const int n, const float p, unsigned int* r);
 
+// Helpers for the Philox generators: generate r[begin, end), from the blocks
+// covering the range.
+template <typename Dtype>
+static void philox_uniform(const int begin, const int end, const Dtype a,
+    const Dtype b, Dtype* r, const Philox& philox) {
+  uint32_t block[4];
+  for (int i = begin; i < end;) {
+    philox.Block(i / 4, block);
+    for (int j = i % 4; j < 4 && i < end; ++j, ++i) {
+      r[i] = a + (b - a) * Philox::Uniform(block[j]);
+    }
+  }
+}
+
+template <typename Dtype>
+static void philox_gaussian(const int begin, const int end, const Dtype mu,
+    const Dtype sigma, Dtype* r, const Philox& philox) {
+  uint32_t block[4];
+  Dtype values[4];
+  for (int i = begin; i < end;) {
+    philox.Block(i / 4, block);
+    // Box-Muller on the two pairs of the block; the first value of a pair is
+    // moved to (0, 1] for the logarithm.
+    for (int j = 0; j < 4; j += 2) {
+      const Dtype radius = sigma * std::sqrt(Dtype(-2) *
+          std::log(Philox::Uniform(block[j]) + Dtype(1. / (1 << 24))));
+      const Dtype angle = Dtype(2 * M_PI) * Philox::Uniform(block[j + 1]);
+      values[j] = mu + radius * std::cos(angle);
+      values[j + 1] = mu + radius * std::sin(angle);
+    }
+    for (int j = i % 4; j < 4 && i < end; ++j, ++i) {
+      r[i] = values[j];
+    }
+  }
+}
+
+template <typename Dtype>
+static void philox_bernoulli(const int begin, const int end, const Dtype p,
+    unsigned int* r, const Philox& philox) {
+  uint32_t block[4];
+  for (int i = begin; i < end;) {
+    philox.Block(i / 4, block);
+    for (int j = i % 4; j < 4 && i < end; ++j, ++i) {
+      r[i] = Philox::Uniform(block[j]) < p;
+    }
+  }
+}
+
+template <typename Dtype>
+void caffe_rng_uniform(const int n, const Dtype a, const Dtype b, Dtype* r,
+                       const Philox& philox) {
+  CHECK_GE(n, 0);
+  CHECK(r);
+  CHECK_LE(a, b);
+  parallel_for(n, boost::bind(&philox_uniform<Dtype>, _1, _2, a, b, r,
+      philox));
+}
+
+template
+void caffe_rng_uniform<float>(const int n, const float a, const float b,
+                              float* r, const Philox& philox);
+
+template
+void caffe_rng_uniform<double>(const int n, const double a, const double b,
+                               double* r, const Philox& philox);
+
+template <typename Dtype>
+void caffe_rng_gaussian(const int n, const Dtype mu, const Dtype sigma,
+                        Dtype* r, const Philox& philox) {
+  CHECK_GE(n, 0);
+  CHECK(r);
+  CHECK_GT(sigma, 0);
+  parallel_for(n, boost::bind(&philox_gaussian<Dtype>, _1, _2, mu, sigma, r,
+      philox));
+}
+
+template
+void caffe_rng_gaussian<float>(const int n, const float mu,
+                               const float sigma, float* r,
+                               const Philox& philox);
+
+template
+void caffe_rng_gaussian<double>(const int n, const double mu,
+                                const double sigma, double* r,
+                                const Philox& philox);
+
+template <typename Dtype>
+void caffe_rng_bernoulli(const int n, const Dtype p, unsigned int* r,
+                         const Philox& philox) {
+  CHECK_GE(n, 0);
+  CHECK(r);
+  CHECK_GE(p, 0);
+  CHECK_LE(p, 1);
+  parallel_for(n, boost::bind(&philox_bernoulli<Dtype>, _1, _2, p, r,
+      philox));
+}
+
+template
+void caffe_rng_bernoulli<float>(const int n, const float p, unsigned int* r,
+                                const Philox& philox);
+
+template
+void caffe_rng_bernoulli<double>(const int n, const double p,
+                                 unsigned int* r, const Philox& philox);
+
 template <>
 float caffe_cpu_strided_dot<float>(const int n, const float* x, const int incx,
     const float* y, const int incy) {
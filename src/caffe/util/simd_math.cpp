@@ -0,0 +1,242 @@
+#include <stdint.h>
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "caffe/util/cpu_dispatch.hpp"
+#include "caffe/util/simd_math.hpp"
+
+namespace caffe {
+
+#ifdef __GNUC__
+
+// Everything below is inlined into the loops of this file, so that passing
+// 32-byte vectors without AVX never crosses a call. GCC notes the ABI of
+// such calls all the same, and only -Wno-psabi silences the note: the build
+// passes it for this file.
+
+typedef float vfloat __attribute__((vector_size(32)));
+typedef int32_t vint __attribute__((vector_size(32)));
+static const int kLanes = 8;
+
+#define SIMD_INLINE inline __attribute__((always_inline))
+
+static SIMD_INLINE vfloat splat(const float x) {
+  const vfloat v = { x, x, x, x, x, x, x, x };
+  return v;
+}
+
+static SIMD_INLINE vint splat_int(const int32_t x) {
+  const vint v = { x, x, x, x, x, x, x, x };
+  return v;
+}
+
+// The lanes of a where mask is set, those of b elsewhere.
+static SIMD_INLINE vfloat blend(const vint mask, const vfloat a,
+    const vfloat b) {
+  return (vfloat)((mask & (vint)a) | (~mask & (vint)b));
+}
+
+static SIMD_INLINE vfloat fabs_lanes(const vfloat x) {
+  return (vfloat)((vint)x & splat_int(0x7fffffff));
+}
+
+// Adding 1.5 * 2^23 rounds to an integer, which the low bits of the sum then
+// hold as an int, and back.
+static const float kRound = 12582912.f;
+
+static SIMD_INLINE vfloat int_to_float(const vint i) {
+  return (vfloat)(i + (vint)splat(kRound)) - splat(kRound);
+}
+
+static const float kExpHi = 88.72283905f;   // log(FLT_MAX)
+static const float kExpLo = -87.33654475f;  // log(FLT_MIN)
+
+static SIMD_INLINE vfloat exp_lanes(const vfloat x) {
+  const vint nan = x != x;
+  vfloat xc = blend(nan, splat(0), x);
+  xc = blend(xc > splat(kExpHi), splat(kExpHi), xc);
+  xc = blend(xc < splat(kExpLo), splat(kExpLo), xc);
+  // x = n log(2) + r, |r| <= log(2) / 2
+  const vfloat t = xc * splat(1.44269504088896341f) + splat(kRound);
+  const vfloat n = t - splat(kRound);
+  const vint n_int = (vint)t - (vint)splat(kRound);
+  const vfloat r = xc - n * splat(0.693359375f) - n * splat(-2.12194440e-4f);
+  vfloat p = splat(1.9875691500E-4f);
+  p = p * r + splat(1.3981999507E-3f);
+  p = p * r + splat(8.3334519073E-3f);
+  p = p * r + splat(4.1665795894E-2f);
+  p = p * r + splat(1.6666665459E-1f);
+  p = p * r + splat(5.0000001201E-1f);
+  p = p * r * r + r + splat(1);
+  // 2^n in two factors, normal for all n in [-126, 128].
+  const vint n1 = n_int >> 1;
+  const vint n2 = n_int - n1;
+  vfloat y = p * (vfloat)((n1 + splat_int(127)) << 23)
+      * (vfloat)((n2 + splat_int(127)) << 23);
+  y = blend(x < splat(kExpLo), splat(0), y);
+  y = blend(x > splat(kExpHi),
+      splat(std::numeric_limits<float>::infinity()), y);
+  return blend(nan, x, y);
+}
+
+static SIMD_INLINE vfloat log_lanes(const vfloat x) {
+  // Denormals scaled by 2^23 first.
+  const vint denormal = x < splat(FLT_MIN);
+  const vint bits = (vint)blend(denormal, x * splat(8388608.f), x);
+  // x = m 2^e, m in [sqrt(1/2), sqrt(2))
+  vint e = ((bits >> 23) & splat_int(0xff)) - splat_int(126)
+      - (denormal & splat_int(23));
+  vfloat m = (vfloat)((bits & splat_int(0x007fffff))
+      | splat_int(0x3f000000));
+  const vint small = m < splat(0.707106781186547524f);
+  e += small;
+  m = blend(small, m + m, m) - splat(1);
+  const vfloat ef = int_to_float(e);
+  const vfloat z = m * m;
+  vfloat p = splat(7.0376836292E-2f);
+  p = p * m + splat(-1.1514610310E-1f);
+  p = p * m + splat(1.1676998740E-1f);
+  p = p * m + splat(-1.2420140846E-1f);
+  p = p * m + splat(1.4249322787E-1f);
+  p = p * m + splat(-1.6668057665E-1f);
+  p = p * m + splat(2.0000714765E-1f);
+  p = p * m + splat(-2.4999993993E-1f);
+  p = p * m + splat(3.3333331174E-1f);
+  vfloat y = p * m * z + ef * splat(-2.12194440e-4f) - splat(0.5f) * z;
+  y = m + y + ef * splat(0.693359375f);
+  const float inf = std::numeric_limits<float>::infinity();
+  y = blend(x == splat(0), splat(-inf), y);
+  y = blend(x == splat(inf), splat(inf), y);
+  return blend((x < splat(0)) | (x != x),
+      splat(std::numeric_limits<float>::quiet_NaN()), y);
+}
+
+static SIMD_INLINE vfloat tanh_lanes(const vfloat x) {
+  const vfloat ax = fabs_lanes(x);
+  // tanh(|x|) by an odd polynomial near 0, elsewhere 1 - 2 / (exp(2 |x|) + 1),
+  // with the sign of x.
+  const vfloat z = ax * ax;
+  vfloat p = splat(-5.70498872745E-3f);
+  p = p * z + splat(2.06390887954E-2f);
+  p = p * z + splat(-5.37397155531E-2f);
+  p = p * z + splat(1.33314422036E-1f);
+  p = p * z + splat(-3.33332819422E-1f);
+  p = p * z * ax + ax;
+  const vfloat t = splat(1) - splat(2) / (exp_lanes(ax + ax) + splat(1));
+  const vfloat y = blend(ax < splat(0.625f), p, t);
+  return (vfloat)((vint)y | ((vint)x & splat_int(~0x7fffffff)));
+}
+
+struct ExpLanes {
+  SIMD_INLINE vfloat operator()(const vfloat x) const { return exp_lanes(x); }
+};
+
+struct LogLanes {
+  SIMD_INLINE vfloat operator()(const vfloat x) const { return log_lanes(x); }
+};
+
+struct TanhLanes {
+  SIMD_INLINE vfloat operator()(const vfloat x) const { return tanh_lanes(x); }
+};
+
+// a^b = exp(b log |a|), negated for odd b and negative a, NaN for other b
+// and finite negative a.
+struct PowLanes {
+  explicit PowLanes(const float b) : b(b) {
+    const bool integer = std::floor(b) == b;
+    odd = integer && std::fmod(b, 2.f) != 0;
+    nan_if_negative = !integer;
+  }
+  SIMD_INLINE vfloat operator()(const vfloat x) const {
+    vfloat y = exp_lanes(splat(b) * log_lanes(fabs_lanes(x)));
+    if (odd) {
+      y = (vfloat)((vint)y | ((vint)x & splat_int(~0x7fffffff)));
+    }
+    if (nan_if_negative) {
+      y = blend((x < splat(0)) & (x != splat(-HUGE_VALF)),
+          splat(std::numeric_limits<float>::quiet_NaN()), y);
+    }
+    return y;
+  }
+  float b;
+  bool odd;
+  bool nan_if_negative;
+};
+
+// Runs op over whole vectors of a, then over the rest padded to one.
+template <typename Op>
+static CAFFE_CPU_INLINE void lanes(const int n, const float* a, float* y,
+    const Op& op) {
+  int i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    vfloat v;
+    memcpy(&v, a + i, sizeof(v));  // NOLINT(caffe/alt_fn)
+    v = op(v);
+    memcpy(y + i, &v, sizeof(v));  // NOLINT(caffe/alt_fn)
+  }
+  if (i < n) {
+    vfloat v = splat(1);
+    memcpy(&v, a + i, (n - i) * sizeof(float));  // NOLINT(caffe/alt_fn)
+    v = op(v);
+    memcpy(y + i, &v, (n - i) * sizeof(float));  // NOLINT(caffe/alt_fn)
+  }
+}
+
+// The vectors take two SSE registers below AVX2.
+CAFFE_CPU_VARIANTS_TEMPLATE(Op, lanes, (const int n, const float* a,
+    float* y, const Op& op), (n, a, y, op))
+
+void simd_exp(const int n, const float* a, float* y) {
+  CAFFE_CPU_DISPATCH_TEMPLATE(lanes, ExpLanes)(n, a, y, ExpLanes());
+}
+
+void simd_log(const int n, const float* a, float* y) {
+  CAFFE_CPU_DISPATCH_TEMPLATE(lanes, LogLanes)(n, a, y, LogLanes());
+}
+
+void simd_tanh(const int n, const float* a, float* y) {
+  CAFFE_CPU_DISPATCH_TEMPLATE(lanes, TanhLanes)(n, a, y, TanhLanes());
+}
+
+void simd_powx(const int n, const float* a, const float b, float* y) {
+  // The common exponents are exact, or as exact as the division and the
+  // square root.
+  if (b == 0) {
+    for (int i = 0; i < n; ++i) { y[i] = 1; }
+  } else if (b == 1) {
+    memmove(y, a, n * sizeof(float));
+  } else if (b == 2) {
+    for (int i = 0; i < n; ++i) { y[i] = a[i] * a[i]; }
+  } else if (b == -1) {
+    for (int i = 0; i < n; ++i) { y[i] = 1 / a[i]; }
+  } else if (b == 0.5f) {
+    for (int i = 0; i < n; ++i) { y[i] = std::sqrt(a[i]); }
+  } else {
+    CAFFE_CPU_DISPATCH_TEMPLATE(lanes, PowLanes)(n, a, y, PowLanes(b));
+  }
+}
+
+#else  // Without vector extensions, the C library.
+
+void simd_exp(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) { y[i] = std::exp(a[i]); }
+}
+
+void simd_log(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) { y[i] = std::log(a[i]); }
+}
+
+void simd_tanh(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) { y[i] = std::tanh(a[i]); }
+}
+
+void simd_powx(const int n, const float* a, const float b, float* y) {
+  for (int i = 0; i < n; ++i) { y[i] = std::pow(a[i], b); }
+}
+
+#endif  // __GNUC__
+
+}  // namespace caffe
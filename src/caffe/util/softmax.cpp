@@ -0,0 +1,277 @@
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/softmax.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+static const int kTile = 64;
+
+// The tiles of up to kTile inner positions of one outer index, numbered in
+// memory order; none if an axis is empty.
+struct SoftmaxTiles {
+  SoftmaxTiles(const int outer_num, const int channels, const int inner_num)
+      : channels(channels), inner_num(inner_num),
+        per_outer((inner_num + kTile - 1) / kTile),
+        count(channels > 0 ? outer_num * per_outer : 0) {}
+
+  // The first position of tile t, as an index into the labels.
+  inline int position(const int t) const {
+    return (t / per_outer) * inner_num + (t % per_outer) * kTile;
+  }
+  // The first element of tile t in the array.
+  inline int offset(const int t) const {
+    return (t / per_outer) * channels * inner_num + (t % per_outer) * kTile;
+  }
+  inline int length(const int t) const {
+    return std::min(kTile, inner_num - (t % per_outer) * kTile);
+  }
+  // The fewest tiles worth handing to another thread.
+  inline int grain() const {
+    return std::max(16384 / std::max(channels * std::min(kTile, inner_num), 1),
+        1);
+  }
+
+  int channels;
+  int inner_num;
+  int per_outer;
+  int count;
+};
+
+// Writes exp(x - max) over the channels of the len positions of a tile to y
+// and their sums to sum. The channels of x are inner_num apart, those of y
+// y_stride apart.
+template <typename Dtype>
+static void exp_tile(const int channels, const int inner_num, const int len,
+    const Dtype* x, Dtype* y, const int y_stride, Dtype* max_val,
+    Dtype* sum) {
+  std::copy(x, x + len, max_val);
+  for (int c = 1; c < channels; ++c) {
+    const Dtype* x_c = x + c * inner_num;
+    for (int j = 0; j < len; ++j) {
+      max_val[j] = std::max(max_val[j], x_c[j]);
+    }
+  }
+  for (int c = 0; c < channels; ++c) {
+    const Dtype* x_c = x + c * inner_num;
+    Dtype* y_c = y + c * y_stride;
+    for (int j = 0; j < len; ++j) {
+      y_c[j] = x_c[j] - max_val[j];
+    }
+  }
+  // Channels of one position, as with inner_num 1, go in a single call.
+  if (y_stride == len) {
+    caffe_exp(channels * len, y, y);
+  } else {
+    for (int c = 0; c < channels; ++c) {
+      caffe_exp(len, y + c * y_stride, y + c * y_stride);
+    }
+  }
+  std::fill(sum, sum + len, Dtype(0));
+  for (int c = 0; c < channels; ++c) {
+    const Dtype* y_c = y + c * y_stride;
+    for (int j = 0; j < len; ++j) {
+      sum[j] += y_c[j];
+    }
+  }
+}
+
+template <typename Dtype>
+static void softmax_tiles(const int begin, const int end,
+    const SoftmaxTiles& tiles, const Dtype* bottom_data, Dtype* top_data) {
+  Dtype max_val[kTile];
+  Dtype sum[kTile];
+  for (int t = begin; t < end; ++t) {
+    const int offset = tiles.offset(t);
+    const int len = tiles.length(t);
+    Dtype* y = top_data + offset;
+    exp_tile(tiles.channels, tiles.inner_num, len, bottom_data + offset, y,
+        tiles.inner_num, max_val, sum);
+    for (int j = 0; j < len; ++j) {
+      sum[j] = Dtype(1) / sum[j];
+    }
+    for (int c = 0; c < tiles.channels; ++c) {
+      Dtype* y_c = y + c * tiles.inner_num;
+      for (int j = 0; j < len; ++j) {
+        y_c[j] *= sum[j];
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void softmax_cpu(const int outer_num, const int channels, const int inner_num,
+    const Dtype* bottom_data, Dtype* top_data) {
+  const SoftmaxTiles tiles(outer_num, channels, inner_num);
+  parallel_for(tiles.count, boost::bind(&softmax_tiles<Dtype>, _1, _2, tiles,
+      bottom_data, top_data), tiles.grain());
+}
+
+template <typename Dtype>
+static void softmax_backward_tiles(const int begin, const int end,
+    const SoftmaxTiles& tiles, const Dtype* top_data, const Dtype* top_diff,
+    Dtype* bottom_diff) {
+  Dtype dot[kTile];
+  for (int t = begin; t < end; ++t) {
+    const int offset = tiles.offset(t);
+    const int len = tiles.length(t);
+    std::fill(dot, dot + len, Dtype(0));
+    for (int c = 0; c < tiles.channels; ++c) {
+      const int i = offset + c * tiles.inner_num;
+      for (int j = 0; j < len; ++j) {
+        dot[j] += top_diff[i + j] * top_data[i + j];
+      }
+    }
+    for (int c = 0; c < tiles.channels; ++c) {
+      const int i = offset + c * tiles.inner_num;
+      for (int j = 0; j < len; ++j) {
+        bottom_diff[i + j] = (top_diff[i + j] - dot[j]) * top_data[i + j];
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void softmax_backward_cpu(const int outer_num, const int channels,
+    const int inner_num, const Dtype* top_data, const Dtype* top_diff,
+    Dtype* bottom_diff) {
+  const SoftmaxTiles tiles(outer_num, channels, inner_num);
+  parallel_for(tiles.count, boost::bind(&softmax_backward_tiles<Dtype>, _1,
+      _2, tiles, top_data, top_diff, bottom_diff), tiles.grain());
+}
+
+// The exponentials of a tile go to a buffer of the range, so that only the
+// loss and the count of each tile are written out.
+template <typename Dtype>
+static void softmax_loss_tiles(const int begin, const int end,
+    const SoftmaxTiles& tiles, const Dtype* bottom_data, const Dtype* label,
+    const bool has_ignore_label, const int ignore_label, Dtype* tile_loss,
+    int* tile_count) {
+  vector<Dtype> exp_data(tiles.channels * std::min(kTile, tiles.inner_num));
+  Dtype max_val[kTile];
+  Dtype sum[kTile];
+  for (int t = begin; t < end; ++t) {
+    const int len = tiles.length(t);
+    const Dtype* x = bottom_data + tiles.offset(t);
+    const Dtype* label_t = label + tiles.position(t);
+    exp_tile(tiles.channels, tiles.inner_num, len, x, &exp_data[0], len,
+        max_val, sum);
+    Dtype loss = 0;
+    int count = 0;
+    for (int j = 0; j < len; ++j) {
+      const int label_value = static_cast<int>(label_t[j]);
+      if (has_ignore_label && label_value == ignore_label) {
+        continue;
+      }
+      DCHECK_GE(label_value, 0);
+      DCHECK_LT(label_value, tiles.channels);
+      // -log(prob) = log(sum) - (x - max), with prob at least FLT_MIN.
+      loss += std::min(std::log(sum[j])
+          - (x[label_value * tiles.inner_num + j] - max_val[j]),
+          Dtype(-std::log(FLT_MIN)));
+      ++count;
+    }
+    tile_loss[t] = loss;
+    tile_count[t] = count;
+  }
+}
+
+template <typename Dtype>
+Dtype softmax_loss_cpu(const int outer_num, const int channels,
+    const int inner_num, const Dtype* bottom_data, const Dtype* label,
+    const bool has_ignore_label, const int ignore_label, int* count) {
+  const SoftmaxTiles tiles(outer_num, channels, inner_num);
+  *count = 0;
+  if (tiles.count == 0) {
+    return 0;
+  }
+  vector<Dtype> tile_loss(tiles.count);
+  vector<int> tile_count(tiles.count);
+  parallel_for(tiles.count, boost::bind(&softmax_loss_tiles<Dtype>, _1, _2,
+      tiles, bottom_data, label, has_ignore_label, ignore_label,
+      &tile_loss[0], &tile_count[0]), tiles.grain());
+  // Summed in order, so that the loss does not depend on the threads.
+  Dtype loss = 0;
+  for (int t = 0; t < tiles.count; ++t) {
+    loss += tile_loss[t];
+    *count += tile_count[t];
+  }
+  return loss;
+}
+
+template <typename Dtype>
+static void softmax_loss_backward_tiles(const int begin, const int end,
+    const SoftmaxTiles& tiles, const Dtype* prob_data, const Dtype* label,
+    const bool has_ignore_label, const int ignore_label, const Dtype scale,
+    Dtype* bottom_diff) {
+  for (int t = begin; t < end; ++t) {
+    const int offset = tiles.offset(t);
+    const int len = tiles.length(t);
+    const Dtype* label_t = label + tiles.position(t);
+    Dtype* dx = bottom_diff + offset;
+    for (int c = 0; c < tiles.channels; ++c) {
+      const Dtype* p_c = prob_data + offset + c * tiles.inner_num;
+      Dtype* dx_c = dx + c * tiles.inner_num;
+      for (int j = 0; j < len; ++j) {
+        dx_c[j] = scale * p_c[j];
+      }
+    }
+    for (int j = 0; j < len; ++j) {
+      const int label_value = static_cast<int>(label_t[j]);
+      if (has_ignore_label && label_value == ignore_label) {
+        for (int c = 0; c < tiles.channels; ++c) {
+          dx[c * tiles.inner_num + j] = 0;
+        }
+      } else {
+        dx[label_value * tiles.inner_num + j] -= scale;
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void softmax_loss_backward_cpu(const int outer_num, const int channels,
+    const int inner_num, const Dtype* prob_data, const Dtype* label,
+    const bool has_ignore_label, const int ignore_label, const Dtype scale,
+    Dtype* bottom_diff) {
+  const SoftmaxTiles tiles(outer_num, channels, inner_num);
+  parallel_for(tiles.count, boost::bind(&softmax_loss_backward_tiles<Dtype>,
+      _1, _2, tiles, prob_data, label, has_ignore_label, ignore_label, scale,
+      bottom_diff), tiles.grain());
+}
+
+// Explicit instantiation
+template void softmax_cpu<float>(const int outer_num, const int channels,
+    const int inner_num, const float* bottom_data, float* top_data);
+template void softmax_cpu<double>(const int outer_num, const int channels,
+    const int inner_num, const double* bottom_data, double* top_data);
+template void softmax_backward_cpu<float>(const int outer_num,
+    const int channels, const int inner_num, const float* top_data,
+    const float* top_diff, float* bottom_diff);
+template void softmax_backward_cpu<double>(const int outer_num,
+    const int channels, const int inner_num, const double* top_data,
+    const double* top_diff, double* bottom_diff);
+template float softmax_loss_cpu<float>(const int outer_num,
+    const int channels, const int inner_num, const float* bottom_data,
+    const float* label, const bool has_ignore_label, const int ignore_label,
+    int* count);
+template double softmax_loss_cpu<double>(const int outer_num,
+    const int channels, const int inner_num, const double* bottom_data,
+    const double* label, const bool has_ignore_label, const int ignore_label,
+    int* count);
+template void softmax_loss_backward_cpu<float>(const int outer_num,
+    const int channels, const int inner_num, const float* prob_data,
+    const float* label, const bool has_ignore_label, const int ignore_label,
+    const float scale, float* bottom_diff);
+template void softmax_loss_backward_cpu<double>(const int outer_num,
+    const int channels, const int inner_num, const double* prob_data,
+    const double* label, const bool has_ignore_label, const int ignore_label,
+    const double scale, double* bottom_diff);
+
+}  // namespace caffe
@@ -0,0 +1,157 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#include <algorithm>
+#include <exception>
+
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// The pool whose tasks the current thread is running, if any.
+static boost::thread_specific_ptr<ThreadPool*> current_pool_;
+
+class ThreadPool::sync {
+ public:
+  sync() : num_tasks_(0), next_task_(0), num_running_(0), job_(0),
+      stop_(false), mode_(Caffe::CPU) {}
+
+  boost::mutex mutex_;
+  boost::condition_variable job_started_;
+  boost::condition_variable job_done_;
+  // Held for the whole of a job to run the jobs of different threads in turn.
+  boost::mutex run_mutex_;
+
+  boost::function<void(int)> task_;
+  int num_tasks_;
+  int next_task_;
+  // The number of tasks taken but not finished yet.
+  int num_running_;
+  // Counts the jobs started, so that workers notice a new one.
+  int job_;
+  bool stop_;
+  Caffe::Brew mode_;
+};
+
+ThreadPool::ThreadPool(int num_threads)
+    : sync_(new sync()) {
+  CHECK_GE(num_threads, 1) << "A thread pool needs at least one thread.";
+  try {
+    for (int i = 1; i < num_threads; ++i) {
+      threads_.push_back(shared_ptr<boost::thread>(
+          new boost::thread(&ThreadPool::Entry, this)));
+    }
+  } catch (std::exception& e) {
+    LOG(FATAL) << "Thread exception: " << e.what();
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    sync_->stop_ = true;
+  }
+  sync_->job_started_.notify_all();
+  for (int i = 0; i < threads_.size(); ++i) {
+    try {
+      threads_[i]->join();
+    } catch (std::exception& e) {
+      LOG(FATAL) << "Thread exception: " << e.what();
+    }
+  }
+}
+
+void ThreadPool::Entry() {
+  current_pool_.reset(new ThreadPool*(this));
+  int job = 0;
+  while (true) {
+    {
+      boost::mutex::scoped_lock lock(sync_->mutex_);
+      while (!sync_->stop_ && sync_->job_ == job) {
+        sync_->job_started_.wait(lock);
+      }
+      if (sync_->stop_) { return; }
+      job = sync_->job_;
+      Caffe::set_mode(sync_->mode_);
+    }
+    RunTasks();
+  }
+}
+
+void ThreadPool::RunTasks() {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (sync_->next_task_ < sync_->num_tasks_) {
+    const int i = sync_->next_task_++;
+    ++sync_->num_running_;
+    lock.unlock();
+    sync_->task_(i);
+    lock.lock();
+    --sync_->num_running_;
+  }
+  if (sync_->num_running_ == 0) {
+    sync_->job_done_.notify_all();
+  }
+}
+
+void ThreadPool::Run(int num_tasks, const boost::function<void(int)>& task) {
+  ThreadPool** current_pool = current_pool_.get();
+  boost::mutex::scoped_try_lock run_lock(sync_->run_mutex_, boost::defer_lock);
+  if (threads_.empty() || num_tasks <= 1 || (current_pool && *current_pool) ||
+      !run_lock.try_lock()) {
+    for (int i = 0; i < num_tasks; ++i) {
+      task(i);
+    }
+    return;
+  }
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    sync_->task_ = task;
+    sync_->num_tasks_ = num_tasks;
+    sync_->next_task_ = 0;
+    sync_->mode_ = Caffe::mode();
+    ++sync_->job_;
+  }
+  sync_->job_started_.notify_all();
+  current_pool_.reset(new ThreadPool*(this));
+  RunTasks();
+  current_pool_.reset(new ThreadPool*(NULL));
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (sync_->num_running_ > 0) {
+    sync_->job_done_.wait(lock);
+  }
+  sync_->task_.clear();
+  sync_->num_tasks_ = 0;
+}
+
+int ThreadPool::NumAvailableCores() {
+#ifdef __linux__
+  cpu_set_t cpus;
+  if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0) {
+    return CPU_COUNT(&cpus);
+  }
+#endif
+  return std::max(1u, boost::thread::hardware_concurrency());
+}
+
+static void RunRange(const boost::function<void(int, int)>* body,
+    const int n, const int num_ranges, const int i) {
+  const int begin = static_cast<int64_t>(n) * i / num_ranges;
+  const int end = static_cast<int64_t>(n) * (i + 1) / num_ranges;
+  (*body)(begin, end);
+}
+
+void parallel_for(const int n, const boost::function<void(int, int)>& body,
+    const int grain_size) {
+  const int max_ranges = n / std::max(grain_size, 1);
+  if (max_ranges <= 1 || Caffe::num_threads() == 1) {
+    if (n > 0) { body(0, n); }
+    return;
+  }
+  shared_ptr<ThreadPool> pool = Caffe::thread_pool();
+  const int num_ranges = std::min(pool->size(), max_ranges);
+  pool->Run(num_ranges, boost::bind(&RunRange, &body, n, num_ranges, _1));
+}
+
+}  // namespace caffe
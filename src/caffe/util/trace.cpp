@@ -0,0 +1,131 @@
+#include <boost/atomic.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "caffe/util/trace.hpp"
+
+namespace caffe {
+
+boost::atomic<bool> Tracer::enabled_(false);
+
+static vector<TraceEvent> ring_;
+// The number of events recorded since the start, the next one going to
+// ring_[next_event_ % ring_.size()].
+static boost::atomic<uint64_t> next_event_(0);
+// The number of threads in Record, which Start waits out before it replaces
+// the ring. A thread counts itself before it checks enabled_, and Start
+// clears enabled_ before it reads the count, so none is missed.
+static boost::atomic<int> recording_(0);
+static const boost::posix_time::ptime epoch_ =
+    boost::posix_time::microsec_clock::universal_time();
+// The start of the trace, in microseconds since epoch_.
+static boost::atomic<int64_t> start_time_(0);
+
+static boost::atomic<int> num_threads_(0);
+static boost::thread_specific_ptr<int> thread_id_;
+
+static int ThreadId() {
+  if (!thread_id_.get()) {
+    thread_id_.reset(new int(num_threads_++));
+  }
+  return *thread_id_;
+}
+
+static int64_t MicrosecondsSinceEpoch() {
+  return (boost::posix_time::microsec_clock::universal_time() - epoch_)
+      .total_microseconds();
+}
+
+void Tracer::Start(int capacity) {
+  CHECK_GT(capacity, 0) << "The trace needs room for events.";
+  enabled_ = false;
+  while (recording_ > 0) {
+    boost::this_thread::yield();
+  }
+  ring_.assign(capacity, TraceEvent());
+  next_event_ = 0;
+  start_time_ = MicrosecondsSinceEpoch();
+  enabled_.store(true, boost::memory_order_release);
+}
+
+void Tracer::Stop() {
+  enabled_.store(false, boost::memory_order_release);
+}
+
+int64_t Tracer::Now() {
+  return MicrosecondsSinceEpoch() -
+      start_time_.load(boost::memory_order_relaxed);
+}
+
+void Tracer::Record(const char* category, const char* name, int64_t begin,
+                    int64_t end) {
+  ++recording_;
+  if (enabled_) {
+    const uint64_t index =
+        next_event_.fetch_add(1, boost::memory_order_relaxed);
+    TraceEvent& event = ring_[index % ring_.size()];
+    event.category = category;
+    strncpy(event.name, name, TraceEvent::kMaxName - 1);
+    event.name[TraceEvent::kMaxName - 1] = '\0';
+    event.begin = begin;
+    event.end = end;
+    event.thread = ThreadId();
+  }
+  recording_.fetch_sub(1, boost::memory_order_release);
+}
+
+vector<TraceEvent> Tracer::Events() {
+  const uint64_t next = next_event_;
+  const uint64_t num_events = std::min<uint64_t>(next, ring_.size());
+  vector<TraceEvent> events;
+  events.reserve(num_events);
+  for (uint64_t i = next - num_events; i < next; ++i) {
+    events.push_back(ring_[i % ring_.size()]);
+  }
+  return events;
+}
+
+// Writes s as a JSON string.
+static void WriteJSONString(const char* s, std::ostream* out) {
+  *out << '"';
+  for (; *s; ++s) {
+    if (*s == '"' || *s == '\\') {
+      *out << '\\' << *s;
+    } else if (static_cast<unsigned char>(*s) < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", *s);
+      *out << escaped;
+    } else {
+      *out << *s;
+    }
+  }
+  *out << '"';
+}
+
+void Tracer::WriteChromeTrace(const string& filename) {
+  const vector<TraceEvent> events = Events();
+  std::ofstream out(filename.c_str());
+  CHECK(out) << "Failed to open trace file " << filename;
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  for (int i = 0; i < events.size(); ++i) {
+    const TraceEvent& event = events[i];
+    out << (i ? ",\n" : "\n") << "{\"name\": ";
+    WriteJSONString(event.name, &out);
+    out << ", \"cat\": ";
+    WriteJSONString(event.category, &out);
+    out << ", \"ph\": \"X\", \"ts\": " << event.begin << ", \"dur\": "
+        << event.end - event.begin << ", \"pid\": 0, \"tid\": "
+        << event.thread << "}";
+  }
+  out << "\n]}\n";
+  CHECK(out) << "Failed to write trace file " << filename;
+  LOG(INFO) << "Wrote " << events.size() << " trace events to " << filename;
+}
+
+}  // namespace caffe
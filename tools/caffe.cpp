@@ -7,12 +7,17 @@ namespace bp = boost::python;
 #include <glog/logging.h>
 
 #include <cstring>
+#include <iomanip>
 #include <map>
 #include <string>
 #include <vector>
 
 #include "boost/algorithm/string.hpp"
 #include "caffe/caffe.hpp"
+#ifdef WITH_PYTHON_LAYER
+#include "caffe/layers/python_layer.hpp"
+#endif
+#include "caffe/util/cpu_dispatch.hpp"
 #include "caffe/util/signal_handler.h"
 
 using caffe::Blob;
@@ -22,6 +27,7 @@ using caffe::Layer;
 using caffe::Solver;
 using caffe::shared_ptr;
 using caffe::string;
+using caffe::SyncedMemory;
 using caffe::Timer;
 using caffe::vector;
 using std::ostringstream;
@@ -41,6 +47,20 @@ DEFINE_string(weights, "",
     "separated by ','. Cannot be set simultaneously with snapshot.");
 DEFINE_int32(iterations, 50,
     "The number of iterations to run.");
+DEFINE_int32(threads, 1,
+    "Optional; the number of threads sharing the CPU computation of a layer. "
+    "Use '-threads 0' to run on all available cores.");
+DEFINE_string(simd, "",
+    "Optional; the instruction set of the hand-written CPU kernels: baseline, "
+    "sse4, avx2 or avx512. By default, the best one the CPU supports.");
+DEFINE_string(phase, "TRAIN",
+    "Optional; network phase (TRAIN or TEST). Only used for 'memory'.");
+DEFINE_string(trace, "",
+    "Optional; record the time spent in each layer, data prefetch, solver "
+    "update and snapshot, and write it to the given file for "
+    "chrome://tracing.");
+DEFINE_int32(trace_events, caffe::Tracer::kDefaultCapacity,
+    "Optional; the number of most recent events kept for the trace.");
 DEFINE_string(sigint_effect, "stop",
              "Optional; action to take when a SIGINT signal is received: "
               "snapshot, stop or none.");
@@ -107,8 +127,16 @@ static void get_gpus(vector<int>* gpus) {
 // To add a command, define a function "int command()" and register it with
 // RegisterBrewFunction(action);
 
-// Device Query: show diagnostic information for a GPU device.
+// Device Query: show diagnostic information for the CPU and a GPU device.
 int device_query() {
+  LOG(INFO) << "CPU instruction set:           "
+      << caffe::SIMDLevelName(caffe::DetectSIMDLevel());
+  LOG(INFO) << "CPU kernels run with:          "
+      << caffe::SIMDLevelName(Caffe::simd_level());
+  LOG(INFO) << "CPU threads:                   " << Caffe::num_threads();
+  if (FLAGS_gpu.empty()) {
+    return 0;
+  }
   LOG(INFO) << "Querying GPUs " << FLAGS_gpu;
   vector<int> gpus;
   get_gpus(&gpus);
@@ -386,6 +414,102 @@ int time() {
 }
 RegisterBrewFunction(time);
 
+// The bytes of a usage on the device of the current mode, in MB.
+static double MegaBytes(const SyncedMemory::Usage& usage) {
+  return (Caffe::mode() == Caffe::GPU ? usage.gpu : usage.cpu) / 1048576.;
+}
+
+static double MegaBytes(const string& tag) {
+  return MegaBytes(SyncedMemory::TagUsage(SyncedMemory::Tag(tag)));
+}
+
+// Memory: break down the memory used by a model.
+int memory() {
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to inspect.";
+  caffe::Phase phase;
+  if (FLAGS_phase == "TRAIN") {
+    phase = caffe::TRAIN;
+  } else if (FLAGS_phase == "TEST") {
+    phase = caffe::TEST;
+  } else {
+    LOG(FATAL) << "phase must be \"TRAIN\" or \"TEST\"";
+  }
+
+  // Set device id and mode
+  vector<int> gpus;
+  get_gpus(&gpus);
+  if (gpus.size() != 0) {
+    LOG(INFO) << "Use GPU with device ID " << gpus[0];
+    Caffe::SetDevice(gpus[0]);
+    Caffe::set_mode(Caffe::GPU);
+  } else {
+    LOG(INFO) << "Use CPU.";
+    Caffe::set_mode(Caffe::CPU);
+  }
+  SyncedMemory::ResetPeakUsage();
+  // Instantiate the caffe net.
+  Net<float> caffe_net(FLAGS_model, phase);
+  if (FLAGS_weights.size()) {
+    caffe_net.CopyTrainedLayersFrom(FLAGS_weights);
+  }
+
+  // Run a pass, so that the memory allocated lazily is allocated.
+  LOG(INFO) << "Performing Forward";
+  caffe_net.Forward();
+  if (phase == caffe::TRAIN) {
+    LOG(INFO) << "Performing Backward";
+    caffe_net.Backward();
+  }
+
+  LOG(INFO) << "Memory per layer (MB):";
+  LOG(INFO) << std::setw(20) << "layer" << std::setw(10) << "data"
+            << std::setw(10) << "diff" << std::setw(10) << "params"
+            << std::setw(10) << "col" << std::setw(10) << "workspace"
+            << std::setw(10) << "total";
+  const char* kinds[] = { "/data", "/diff", "/params", "/col", "/workspace" };
+  const int num_kinds = sizeof(kinds) / sizeof(kinds[0]);
+  const vector<string>& layer_names = caffe_net.layer_names();
+  for (int i = 0; i < layer_names.size(); ++i) {
+    ostringstream line;
+    line << std::fixed << std::setprecision(2) << std::setw(20)
+         << layer_names[i];
+    double total = 0;
+    for (int j = 0; j < num_kinds; ++j) {
+      const double mb = MegaBytes(layer_names[i] + kinds[j]);
+      line << std::setw(10) << mb;
+      total += mb;
+    }
+    line << std::setw(10) << total;
+    LOG(INFO) << line.str();
+  }
+  const SyncedMemory::Usage total = SyncedMemory::TotalUsage();
+  SyncedMemory::Usage peak;
+  peak.cpu = total.cpu_peak;
+  peak.gpu = total.gpu_peak;
+  LOG(INFO) << std::fixed << std::setprecision(2) << "Untagged: "
+            << MegaBytes(SyncedMemory::TagUsage(0)) << " MB";
+  LOG(INFO) << std::fixed << std::setprecision(2) << "Total: "
+            << MegaBytes(total) << " MB";
+  LOG(INFO) << std::fixed << std::setprecision(2) << "Peak: "
+            << MegaBytes(peak) << " MB";
+
+  // Blobs only grow, so a blob may hold more than its current shape needs.
+  LOG(INFO) << "Memory per blob (MB):";
+  LOG(INFO) << std::setw(20) << "blob" << std::setw(10) << "capacity"
+            << std::setw(10) << "used";
+  const vector<string>& blob_names = caffe_net.blob_names();
+  const vector<shared_ptr<Blob<float> > >& blobs = caffe_net.blobs();
+  for (int i = 0; i < blobs.size(); ++i) {
+    const size_t capacity = blobs[i]->count() ? blobs[i]->data()->size() : 0;
+    LOG(INFO) << std::fixed << std::setprecision(2) << std::setw(20)
+              << blob_names[i] << std::setw(10) << capacity / 1048576.
+              << std::setw(10)
+              << blobs[i]->count() * sizeof(float) / 1048576.;
+  }
+  return 0;
+}
+RegisterBrewFunction(memory);
+
 int main(int argc, char** argv) {
   // Print output to stderr (while still logging).
   FLAGS_alsologtostderr = 1;
@@ -397,21 +521,36 @@ int main(int argc, char** argv) {
       "commands:\n"
       "  train           train or finetune a model\n"
       "  test            score a model\n"
-      "  device_query    show GPU diagnostic information\n"
-      "  time            benchmark model execution time");
+      "  device_query    show CPU and GPU diagnostic information\n"
+      "  time            benchmark model execution time\n"
+      "  memory          break down the memory used by a model");
   // Run tool or show usage.
   caffe::GlobalInit(&argc, &argv);
+  Caffe::set_num_threads(FLAGS_threads);
+  if (FLAGS_simd.size()) {
+    Caffe::set_simd_level(caffe::ParseSIMDLevel(FLAGS_simd));
+  }
   if (argc == 2) {
+    if (FLAGS_trace.size()) {
+      caffe::Tracer::Start(FLAGS_trace_events);
+    }
+    int result;
 #ifdef WITH_PYTHON_LAYER
     try {
 #endif
-      return GetBrewFunction(caffe::string(argv[1]))();
+      result = GetBrewFunction(caffe::string(argv[1]))();
 #ifdef WITH_PYTHON_LAYER
     } catch (bp::error_already_set) {
+      caffe::AcquireGIL gil;
       PyErr_Print();
       return 1;
     }
 #endif
+    if (FLAGS_trace.size()) {
+      caffe::Tracer::Stop();
+      caffe::Tracer::WriteChromeTrace(FLAGS_trace);
+    }
+    return result;
   } else {
     gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/caffe");
   }
@@ -0,0 +1,48 @@
+// This is a script to fold the BatchNorm and Scale layers of a deployment net
+// into the convolutions they follow, and to fuse following ReLUs into them.
+// Usage:
+//    fuse_layers net_proto_file_in weights_file_in
+//        net_proto_file_out weights_file_out
+
+#include <string>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/fuse_layers.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+  if (argc != 5) {
+    LOG(ERROR) << "Usage: fuse_layers net_proto_file_in weights_file_in "
+               << "net_proto_file_out weights_file_out";
+    return 1;
+  }
+
+  NetParameter net_param;
+  ReadNetParamsFromTextFileOrDie(string(argv[1]), &net_param);
+  net_param.mutable_state()->set_phase(TEST);
+  net_param.set_fuse_layers(true);
+
+  // Fold the weights by loading them into a fused net.
+  Net<float> net(net_param);
+  net.CopyTrainedLayersFrom(string(argv[2]));
+  NetParameter fused_weights;
+  net.ToProto(&fused_weights, false);
+  WriteProtoToBinaryFile(fused_weights, argv[4]);
+  LOG(INFO) << "Wrote fused weights to " << argv[4];
+
+  // Write the fused net structure; it no longer needs to be fused on load.
+  NetParameter filtered_param;
+  Net<float>::FilterNet(net_param, &filtered_param);
+  NetParameter fused_param;
+  FuseLayers(filtered_param, &fused_param);
+  fused_param.clear_fuse_layers();
+  fused_param.clear_state();
+  WriteProtoToTextFile(fused_param, argv[3]);
+  LOG(INFO) << "Wrote fused net to " << argv[3];
+  return 0;
+}
@@ -0,0 +1,181 @@
+// Generates load on an inference_server and reports the throughput and the
+// latencies it sees, followed by the metrics of the server.
+// Usage:
+//    inference_loadgen [-socket /tmp/caffe_inference.sock] [FLAGS]
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/inference_protocol.hpp"
+#include "caffe/util/math_functions.hpp"
+
+using caffe::string;
+using caffe::vector;
+namespace inference = caffe::inference;
+
+DEFINE_string(socket, "/tmp/caffe_inference.sock",
+    "The path of the Unix socket of the server.");
+DEFINE_int32(requests, 10000,
+    "The number of requests to send.");
+DEFINE_double(rate, 0,
+    "The mean number of requests per second, arriving at random; 0 to send "
+    "each request as soon as its connection is free.");
+DEFINE_int32(connections, 32,
+    "The number of connections sending requests at once.");
+
+typedef boost::posix_time::ptime Time;
+
+// The server answers with a payload only when OK, of any size.
+static const vector<uint32_t> kResponseSizes(1,
+    std::numeric_limits<uint32_t>::max());
+
+static Time Now() {
+  return boost::posix_time::microsec_clock::universal_time();
+}
+
+static int Connect() {
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  CHECK_GE(fd, 0) << "socket: " << strerror(errno);
+  sockaddr_un address = sockaddr_un();
+  address.sun_family = AF_UNIX;
+  CHECK_LT(FLAGS_socket.size(), sizeof(address.sun_path))
+      << "Socket path too long: " << FLAGS_socket;
+  strncpy(address.sun_path, FLAGS_socket.c_str(), sizeof(address.sun_path));
+  CHECK_EQ(connect(fd, reinterpret_cast<sockaddr*>(&address),
+      sizeof(address)), 0) << "connect " << FLAGS_socket << ": "
+      << strerror(errno);
+  return fd;
+}
+
+// Sends a request without payload and returns the payload of the response.
+static vector<char> Query(int fd, inference::RequestType type) {
+  uint32_t status;
+  vector<char> response;
+  bool oversized;
+  CHECK(inference::WriteMessage(fd, type, NULL, 0) &&
+      inference::ReadMessage(fd, &status, &response, kResponseSizes,
+      &oversized))
+      << "Connection to the server lost";
+  CHECK_EQ(status, inference::OK) << "Request refused by the server";
+  return response;
+}
+
+// Sends the requests assigned to one connection: each one at its arrival
+// time, or as soon as the previous one is answered if that is later.
+// Latencies are measured from the arrival times, so that a connection
+// falling behind does not hide the queueing delay, or from the sending times
+// in a closed loop.
+static void SendRequests(const vector<float>* input,
+    const vector<double>* arrivals, Time start, int first, int step,
+    vector<double>* latencies, vector<int>* statuses) {
+  const int fd = Connect();
+  uint32_t status;
+  vector<char> response;
+  bool oversized;
+  for (int i = first; i < arrivals->size(); i += step) {
+    Time arrival = start + boost::posix_time::microseconds(
+        static_cast<int64_t>((*arrivals)[i] * 1e6));
+    if (Now() < arrival) {
+      boost::this_thread::sleep(arrival);
+    }
+    if (FLAGS_rate == 0) {
+      arrival = Now();
+    }
+    CHECK(inference::WriteMessage(fd, inference::PREDICT, &(*input)[0],
+        input->size() * sizeof(float)) &&
+        inference::ReadMessage(fd, &status, &response, kResponseSizes,
+        &oversized))
+        << "Connection to the server lost";
+    (*latencies)[i] = (Now() - arrival).total_microseconds() / 1000.;
+    (*statuses)[i] = status;
+  }
+  close(fd);
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Generate load on an inference_server.\n"
+      "Usage: inference_loadgen [FLAGS]");
+  caffe::GlobalInit(&argc, &argv);
+  CHECK_GT(FLAGS_requests, 0);
+  CHECK_GT(FLAGS_connections, 0);
+  CHECK_GE(FLAGS_rate, 0);
+
+  // Make a random input of the shape the server expects.
+  const int fd = Connect();
+  const vector<char> shape_data = Query(fd, inference::INPUT_SHAPE);
+  const int32_t* shape = reinterpret_cast<const int32_t*>(&shape_data[0]);
+  int input_dim = 1;
+  for (int i = 1; i < shape_data.size() / sizeof(int32_t); ++i) {
+    input_dim *= shape[i];
+  }
+  vector<float> input(input_dim);
+  caffe::caffe_rng_gaussian<float>(input_dim, 0, 1, &input[0]);
+
+  // The arrival times, all at the start for a closed loop.
+  vector<double> arrivals(FLAGS_requests, 0);
+  if (FLAGS_rate > 0) {
+    vector<double> gaps(FLAGS_requests);
+    caffe::caffe_rng_uniform<double>(FLAGS_requests, 1e-9, 1, &gaps[0]);
+    double arrival = 0;
+    for (int i = 0; i < FLAGS_requests; ++i) {
+      arrival += -std::log(gaps[i]) / FLAGS_rate;
+      arrivals[i] = arrival;
+    }
+  }
+
+  vector<double> latencies(FLAGS_requests);
+  vector<int> statuses(FLAGS_requests);
+  const Time start = Now();
+  boost::thread_group connections;
+  for (int i = 0; i < FLAGS_connections; ++i) {
+    connections.create_thread(boost::bind(&SendRequests, &input, &arrivals,
+        start, i, FLAGS_connections, &latencies, &statuses));
+  }
+  connections.join_all();
+  const double elapsed = (Now() - start).total_microseconds() / 1e6;
+
+  vector<double> answered;
+  int busy = 0;
+  for (int i = 0; i < FLAGS_requests; ++i) {
+    if (statuses[i] == inference::OK) {
+      answered.push_back(latencies[i]);
+    } else if (statuses[i] == inference::BUSY) {
+      ++busy;
+    }
+  }
+  LOG(INFO) << "Sent " << FLAGS_requests << " requests in " << elapsed
+            << " s: " << answered.size() << " answered, " << busy
+            << " refused as busy.";
+  LOG(INFO) << "Throughput: " << answered.size() / elapsed << " requests/s.";
+  if (!answered.empty()) {
+    std::sort(answered.begin(), answered.end());
+    double sum = 0;
+    for (int i = 0; i < answered.size(); ++i) {
+      sum += answered[i];
+    }
+    LOG(INFO) << "Latency: mean " << sum / answered.size()
+              << " ms, p50 " << answered[answered.size() / 2]
+              << " ms, p90 " << answered[answered.size() * 9 / 10]
+              << " ms, p99 " << answered[answered.size() * 99 / 100]
+              << " ms, max " << answered.back() << " ms.";
+  }
+  const vector<char> report = Query(fd, inference::METRICS);
+  LOG(INFO) << "Server: " << string(report.begin(), report.end());
+  close(fd);
+  return 0;
+}
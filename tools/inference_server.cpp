@@ -0,0 +1,247 @@
+// Serves the predictions of a net over a Unix socket, batching the requests
+// of all clients dynamically (see caffe/util/inference_protocol.hpp for the
+// protocol).
+// Usage:
+//    inference_server -model deploy.prototxt -weights net.caffemodel
+//        [-socket /tmp/caffe_inference.sock] [FLAGS]
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/inference_protocol.hpp"
+#include "caffe/util/math_functions.hpp"
+
+using caffe::Caffe;
+using caffe::InferenceBatcher;
+using caffe::InferenceEngine;
+using caffe::shared_ptr;
+using caffe::string;
+using caffe::vector;
+namespace inference = caffe::inference;
+
+DEFINE_string(model, "",
+    "The model definition protocol buffer text file.");
+DEFINE_string(weights, "",
+    "The trained weights of the model.");
+DEFINE_string(socket, "/tmp/caffe_inference.sock",
+    "The path of the Unix socket to listen on.");
+DEFINE_int32(gpu, -1,
+    "Optional; run in GPU mode on the given device ID.");
+DEFINE_int32(threads, 1,
+    "Optional; the number of threads sharing the CPU computation of a layer "
+    "and the preparation of a batch. Use '-threads 0' to run on all "
+    "available cores.");
+DEFINE_int32(batch_size, 32,
+    "The maximum number of requests run in one batch.");
+DEFINE_int32(timeout_ms, 5,
+    "The longest a request waits for its batch to fill, in ms.");
+DEFINE_int32(workers, 1,
+    "The number of batches run at once, sharing the weights.");
+DEFINE_int32(max_queue, 256,
+    "The number of requests waiting for a batch beyond which new ones are "
+    "refused as busy.");
+DEFINE_int32(metrics_interval, 10,
+    "The interval between metrics reports in the log, in seconds; 0 for "
+    "none.");
+
+typedef boost::posix_time::ptime Time;
+
+static Time Now() {
+  return boost::posix_time::microsec_clock::universal_time();
+}
+
+// The latencies of the last requests answered and the queue depths they
+// found, along with the totals since the start.
+class Metrics {
+ public:
+  explicit Metrics(int window)
+      : latencies_(window), num_latencies_(0), requests_(0), rejected_(0),
+        depth_sum_(0), max_depth_(0) {}
+
+  void Arrive(int queue_depth) {
+    boost::mutex::scoped_lock lock(mutex_);
+    ++requests_;
+    depth_sum_ += queue_depth;
+    max_depth_ = std::max(max_depth_, queue_depth);
+  }
+
+  void Reject() {
+    boost::mutex::scoped_lock lock(mutex_);
+    ++rejected_;
+  }
+
+  void Answer(double latency_ms) {
+    boost::mutex::scoped_lock lock(mutex_);
+    latencies_[num_latencies_++ % latencies_.size()] = latency_ms;
+  }
+
+  string Report(const InferenceBatcher<float>& batcher) {
+    vector<double> latencies;
+    std::ostringstream report;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      latencies.assign(latencies_.begin(), latencies_.begin() +
+          std::min<int64_t>(num_latencies_, latencies_.size()));
+      report << "requests " << requests_ << ", rejected " << rejected_
+             << ", queue depth " << batcher.queue_size() << " (mean "
+             << (requests_ ? static_cast<double>(depth_sum_) / requests_ : 0)
+             << ", max " << max_depth_ << ")";
+    }
+    const int batches = batcher.num_batches();
+    report << ", batches " << batches << " (mean size "
+           << (batches ? static_cast<double>(batcher.num_requests()) / batches
+               : 0) << ")";
+    if (!latencies.empty()) {
+      std::sort(latencies.begin(), latencies.end());
+      report << ", latency p50 " << latencies[latencies.size() / 2]
+             << " ms, p99 " << latencies[latencies.size() * 99 / 100]
+             << " ms over the last " << latencies.size() << " requests";
+    }
+    return report.str();
+  }
+
+ private:
+  boost::mutex mutex_;
+  vector<double> latencies_;
+  int64_t num_latencies_;
+  int64_t requests_;
+  int64_t rejected_;
+  int64_t depth_sum_;
+  int max_depth_;
+};
+
+static void ServeConnection(int fd, InferenceEngine<float>* engine,
+    InferenceBatcher<float>* batcher, Metrics* metrics) {
+  const vector<int>& input_shape = engine->net()->input_blobs()[0]->shape();
+  const int input_dim = batcher->input_dim();
+  // Only PREDICT carries a payload, of one input item.
+  const vector<uint32_t> max_sizes(1, input_dim * sizeof(float));
+  uint32_t type;
+  vector<char> payload;
+  bool oversized;
+  bool connected = true;
+  while (connected && inference::ReadMessage(fd, &type, &payload, max_sizes,
+      &oversized)) {
+    switch (type) {
+    case inference::PREDICT: {
+      const Time arrival = Now();
+      if (payload.size() != input_dim * sizeof(float)) {
+        connected = inference::WriteMessage(fd, inference::BAD_REQUEST,
+            NULL, 0);
+        break;
+      }
+      metrics->Arrive(batcher->queue_size());
+      boost::unique_future<vector<float> > result;
+      if (!batcher->TrySubmit(boost::bind(&caffe::caffe_copy<float>,
+          input_dim, reinterpret_cast<const float*>(&payload[0]), _1),
+          &result)) {
+        metrics->Reject();
+        connected = inference::WriteMessage(fd, inference::BUSY, NULL, 0);
+        break;
+      }
+      const vector<float> output = result.get();
+      metrics->Answer((Now() - arrival).total_microseconds() / 1000.);
+      connected = inference::WriteMessage(fd, inference::OK, &output[0],
+          output.size() * sizeof(float));
+      break;
+    }
+    case inference::INPUT_SHAPE: {
+      const vector<int32_t> shape(input_shape.begin(), input_shape.end());
+      connected = inference::WriteMessage(fd, inference::OK, &shape[0],
+          shape.size() * sizeof(int32_t));
+      break;
+    }
+    case inference::METRICS: {
+      const string report = metrics->Report(*batcher);
+      connected = inference::WriteMessage(fd, inference::OK, report.data(),
+          report.size());
+      break;
+    }
+    default:
+      connected = inference::WriteMessage(fd, inference::BAD_REQUEST, NULL,
+          0);
+    }
+  }
+  if (connected && oversized) {
+    inference::WriteMessage(fd, inference::BAD_REQUEST, NULL, 0);
+  }
+  close(fd);
+}
+
+static void ReportMetrics(InferenceBatcher<float>* batcher,
+    Metrics* metrics) {
+  while (true) {
+    boost::this_thread::sleep(
+        boost::posix_time::seconds(FLAGS_metrics_interval));
+    LOG(INFO) << metrics->Report(*batcher);
+  }
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Serve the predictions of a net over a Unix "
+      "socket.\n"
+      "Usage: inference_server -model deploy.prototxt "
+      "-weights net.caffemodel [FLAGS]");
+  caffe::GlobalInit(&argc, &argv);
+  if (FLAGS_model.empty() || FLAGS_weights.empty()) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/inference_server");
+    return 1;
+  }
+  if (FLAGS_gpu >= 0) {
+    Caffe::SetDevice(FLAGS_gpu);
+    Caffe::set_mode(Caffe::GPU);
+  } else {
+    Caffe::set_mode(Caffe::CPU);
+  }
+  Caffe::set_num_threads(FLAGS_threads);
+
+  shared_ptr<InferenceEngine<float> > engine(
+      new InferenceEngine<float>(FLAGS_model, FLAGS_weights));
+  InferenceBatcher<float> batcher(engine, FLAGS_batch_size, FLAGS_timeout_ms,
+      FLAGS_workers, FLAGS_max_queue);
+  Metrics metrics(10000);
+  if (FLAGS_metrics_interval > 0) {
+    boost::thread(&ReportMetrics, &batcher, &metrics).detach();
+  }
+
+  const int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  CHECK_GE(server_fd, 0) << "socket: " << strerror(errno);
+  sockaddr_un address = sockaddr_un();
+  address.sun_family = AF_UNIX;
+  CHECK_LT(FLAGS_socket.size(), sizeof(address.sun_path))
+      << "Socket path too long: " << FLAGS_socket;
+  strncpy(address.sun_path, FLAGS_socket.c_str(), sizeof(address.sun_path));
+  unlink(FLAGS_socket.c_str());
+  CHECK_EQ(bind(server_fd, reinterpret_cast<sockaddr*>(&address),
+      sizeof(address)), 0) << "bind " << FLAGS_socket << ": "
+      << strerror(errno);
+  CHECK_EQ(listen(server_fd, SOMAXCONN), 0) << "listen: " << strerror(errno);
+  LOG(INFO) << "Serving " << FLAGS_model << " on " << FLAGS_socket;
+
+  while (true) {
+    const int fd = accept(server_fd, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG(FATAL) << "accept: " << strerror(errno);
+    }
+    boost::thread(&ServeConnection, fd, engine.get(), &batcher, &metrics)
+        .detach();
+  }
+  return 0;
+}
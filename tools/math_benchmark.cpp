@@ -0,0 +1,81 @@
+// Times the float elementwise functions of math_functions.hpp against the C
+// library on one thread, in millions of elements per second.
+// Usage:
+//    math_benchmark [-n 1048576] [-iterations 50]
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/math_functions.hpp"
+
+using caffe::vector;
+
+DEFINE_int32(n, 1 << 20,
+    "The number of elements of each call.");
+DEFINE_int32(iterations, 50,
+    "The number of calls to time.");
+
+// The C library over an array, as mkl_alternate.hpp computed it before.
+static void libm_exp(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) { y[i] = std::exp(a[i]); }
+}
+static void libm_log(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) { y[i] = std::log(a[i]); }
+}
+static void libm_tanh(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) { y[i] = std::tanh(a[i]); }
+}
+static void libm_pow(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) { y[i] = std::pow(a[i], -0.75f); }
+}
+static void caffe_pow(const int n, const float* a, float* y) {
+  caffe::caffe_powx(n, a, -0.75f, y);
+}
+
+// Millions of elements per second of f.
+static double Throughput(void (*f)(const int, const float*, float*),
+    const vector<float>& a, vector<float>* y) {
+  f(FLAGS_n, &a[0], &(*y)[0]);
+  caffe::CPUTimer timer;
+  timer.Start();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    f(FLAGS_n, &a[0], &(*y)[0]);
+  }
+  timer.Stop();
+  return static_cast<double>(FLAGS_n) * FLAGS_iterations
+      / timer.MicroSeconds();
+}
+
+static void Report(const char* name, const float lo, const float hi,
+    void (*simd)(const int, const float*, float*),
+    void (*libm)(const int, const float*, float*)) {
+  vector<float> a(FLAGS_n);
+  vector<float> y(FLAGS_n);
+  caffe::caffe_rng_uniform(FLAGS_n, lo, hi, &a[0]);
+  const double simd_rate = Throughput(simd, a, &y);
+  const double libm_rate = Throughput(libm, a, &y);
+  printf("%-6s %10.1f %10.1f %8.2fx\n", name, simd_rate, libm_rate,
+      simd_rate / libm_rate);
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  gflags::SetUsageMessage("Times caffe_exp, caffe_log, caffe_tanh and "
+      "caffe_powx against the C library.");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_n, 0);
+  CHECK_GT(FLAGS_iterations, 0);
+  caffe::Caffe::set_mode(caffe::Caffe::CPU);
+  printf("%-6s %10s %10s %9s\n", "", "caffe", "libm", "speedup");
+  Report("exp", -80, 80, &caffe::caffe_exp<float>, &libm_exp);
+  Report("log", 1e-30f, 1e30f, &caffe::caffe_log<float>, &libm_log);
+  Report("tanh", -5, 5, &caffe::caffe_tanh<float>, &libm_tanh);
+  Report("powx", 1e-3f, 1e3f, &caffe_pow, &libm_pow);
+  return 0;
+}